@@ -0,0 +1,49 @@
+// bench_gen.cpp - generate a large copper program to benchmark copasm (see "bench" target in Makefile)
+//
+// Usage: bench_gen [lines] > bench.casm
+//
+// Writes a copper program of about lines source lines (default 100000) using a mix of labels, macros,
+// directives and upper/lower case mnemonics (the copper program is much too large to run, but assembles).
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char ** argv)
+{
+    long lines = argc > 1 ? strtol(argv[1], nullptr, 0) : 100000;
+    if (argc > 2 || lines <= 0)
+    {
+        printf("Usage: bench_gen [lines] > bench.casm\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("                .list    false\n");
+    printf("                .include \"xosera_m68k_defs.inc\"\n");
+    printf("                .list    true\n");
+    printf("LINE_LEN        =       80\n");
+    printf("                .macro  setcol idx,val\n");
+    printf("                MOVI    #\\val,XR_COLOR_ADDR+\\idx\n");
+    printf("                .endm\n");
+    long count = 7;
+
+    for (int i = 0; i < 64; i++)        // tables at start so LDM addresses are in range
+    {
+        printf("tbl%d            .word   %d*LINE_LEN\n", i, i);
+        count++;
+    }
+
+    for (long n = 0; count < lines; n++, count += 8)
+    {
+        printf("blk%ld           VPOS    #%ld\n", n, n % 480);
+        printf("                ldm     tbl%ld\n", n % 64);
+        printf("                ADDI    #LINE_LEN\n");
+        printf("                stm     XR_PA_DISP_ADDR\n");
+        printf("                setcol  %ld,$%03lx\n", n % 16, n & 0xfff);
+        printf("                CMPI    #%ld\n", n % 100);
+        printf("                brlt    blk%ld\n", n % 64);
+        printf("                HPOS    #H_EOL\n");
+    }
+    printf("                VPOS    #V_EOF\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+// cro_test.cpp - check relocatable copper output (.cro) by loading it at another address
+//
+// Usage: cro_test <file.cro> <file.bin> <address>
+//
+// Relocates file.cro from copasm to address (like xosera_upload_cro in xosera_m68k_api.c) and compares it with
+// file.bin (the same program assembled at address, e.g. with ORG).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+static bool read_words(const char * name, std::vector<uint16_t> & words)
+{
+    FILE * fp = fopen(name, "rb");
+    if (!fp)
+    {
+        printf("cro_test: can't open \"%s\"\n", name);
+        return false;
+    }
+    words.clear();
+    int hi, lo;
+    while ((hi = fgetc(fp)) != EOF && (lo = fgetc(fp)) != EOF)
+    {
+        words.push_back(static_cast<uint16_t>((hi << 8) | lo));
+    }
+    fclose(fp);
+
+    return true;
+}
+
+// relocate .cro words to load_addr, returns false if not valid
+static bool relocate(const std::vector<uint16_t> & cro, uint16_t load_addr, std::vector<uint16_t> & out)
+{
+    if (cro.size() < 4 || cro[0] != 0x4352 || cro.size() != 4U + cro[2] + cro[3])
+        return false;
+
+    uint16_t delta = static_cast<uint16_t>(load_addr - cro[1]);
+    size_t   reloc = 4U + cro[2];
+    out.assign(cro.begin() + 4, cro.begin() + 4 + cro[2]);
+    for (size_t r = reloc; r < cro.size(); r++)
+    {
+        if (cro[r] >= out.size() || (r > reloc && cro[r] <= cro[r - 1]))
+            return false;
+        out[cro[r]] = static_cast<uint16_t>(out[cro[r]] + delta);
+    }
+
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 4)
+    {
+        printf("Usage: cro_test <file.cro> <file.bin> <address>\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint16_t> cro, bin, out;
+    uint16_t              addr = static_cast<uint16_t>(strtoul(argv[3], nullptr, 0));
+    if (!read_words(argv[1], cro) || !read_words(argv[2], bin))
+    {
+        return EXIT_FAILURE;
+    }
+    if (!relocate(cro, addr, out) || out != bin)
+    {
+        printf("cro_test: \"%s\" relocated to 0x%04x does not match \"%s\"\n", argv[1], addr, argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("cro_test: \"%s\" (%u relocations) at 0x%04x matches \"%s\"\n", argv[1], cro[3], addr, argv[2]);
+
+    return EXIT_SUCCESS;
+}
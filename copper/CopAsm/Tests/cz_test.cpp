@@ -0,0 +1,100 @@
+// cz_test.cpp - check compressed copper output (.cz) with reference decoder
+//
+// Usage: cz_test <file.cz> <file.bin>
+//
+// Decompresses file.cz from copasm and compares it with file.bin (the same source assembled uncompressed), then
+// checks compress/decompress of generated data (long literal runs, repeats and matches at maximum distance).
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+#include "../xlasmcz.h"
+
+static bool read_words(const char * name, std::vector<uint16_t> & words)
+{
+    FILE * fp = fopen(name, "rb");
+    if (!fp)
+    {
+        printf("cz_test: can't open \"%s\"\n", name);
+        return false;
+    }
+    words.clear();
+    int hi, lo;
+    while ((hi = fgetc(fp)) != EOF && (lo = fgetc(fp)) != EOF)
+    {
+        words.push_back(static_cast<uint16_t>((hi << 8) | lo));
+    }
+    fclose(fp);
+
+    return true;
+}
+
+static bool round_trip(const char * what, const std::vector<uint16_t> & words)
+{
+    std::vector<uint16_t> cz = xlasmcz::compress(words, 0xC000);
+    std::vector<uint16_t> out;
+    uint16_t              addr = 0;
+    if (!xlasmcz::decompress(cz.data(), cz.size(), &addr, out) || out != words || addr != 0xC000)
+    {
+        printf("cz_test: %s round trip FAILED\n", what);
+        return false;
+    }
+    printf("cz_test: %s %zu words compressed to %zu words\n", what, words.size(), cz.size());
+
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: cz_test <file.cz> <file.bin>\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint16_t> cz, bin, out;
+    uint16_t              addr = 0;
+    if (!read_words(argv[1], cz) || !read_words(argv[2], bin))
+    {
+        return EXIT_FAILURE;
+    }
+    if (!xlasmcz::decompress(cz.data(), cz.size(), &addr, out) || out != bin)
+    {
+        printf("cz_test: \"%s\" does not decompress to \"%s\"\n", argv[1], argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("cz_test: \"%s\" (%zu words at 0x%04x) matches \"%s\"\n", argv[1], cz.size(), addr, argv[2]);
+
+    std::mt19937          rng(0xC0FFEE);
+    std::vector<uint16_t> words;
+    bool                  ok = true;
+
+    ok = ok && round_trip("empty", words);
+
+    for (int i = 0; i < 40000; i++)        // more than one literal token
+        words.push_back(static_cast<uint16_t>(rng()));
+    ok = ok && round_trip("random", words);
+
+    words.assign(1000, 0x1234);        // repeat (more than one match token)
+    ok = ok && round_trip("repeat", words);
+
+    words.clear();
+    for (int i = 0; i < xlasmcz::WINDOW; i++)        // match at maximum distance
+        words.push_back(static_cast<uint16_t>(rng()));
+    words.insert(words.end(), words.begin(), words.begin() + 100);
+    ok = ok && round_trip("window", words);
+
+    // truncated data must be rejected
+    std::vector<uint16_t> bad = xlasmcz::compress(words, 0xC000);
+    bad.pop_back();
+    if (xlasmcz::decompress(bad.data(), bad.size(), &addr, out))
+    {
+        printf("cz_test: truncated data not rejected\n");
+        ok = false;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
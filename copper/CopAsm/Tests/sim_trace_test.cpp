@@ -0,0 +1,108 @@
+// sim_trace_test.cpp - check copper --simulate traces of optimized (-O) and unoptimized code have the same effect
+//
+// Usage: sim_trace_test <optimized.trace> <unoptimized.trace>
+//
+// Compares the XR register and copper memory writes and HPOS/VPOS waits of each frame in order, ignoring cycle
+// timing and copper addresses (which -O changes).  A write immediately followed by another write to the same
+// register is only counted once when it is a register -O may remove the first write for (see plain_xr_dest in
+// xlasmcopper.cpp).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+struct trace_event
+{
+    unsigned    frame;
+    unsigned    dest;        // XR write destination (or ~0U for wait or stop)
+    unsigned    data;
+    std::string text;
+};
+
+// XR address where a write only sets the value (must match plain_xr_dest in xlasmcopper.cpp)
+static bool plain_xr_dest(unsigned addr)
+{
+    return addr == 0x0800 || addr == 0x07FF ||                // RA, RA_CMP
+           addr == 0x0000 ||                                  // VID_CTRL
+           (addr >= 0x0004 && addr <= 0x0007) ||              // VID_LEFT, VID_RIGHT, POINTER_H, POINTER_V
+           (addr >= 0x0010 && addr <= 0x001F) ||              // playfield A and B registers
+           (addr >= 0x4000 && addr < 0x5400) ||               // tile memory
+           (addr >= 0x8000 && addr < 0x8300);                 // color and pointer memory
+}
+
+static bool read_trace(const char * name, std::vector<trace_event> & events)
+{
+    FILE * fp = fopen(name, "r");
+    if (!fp)
+    {
+        printf("sim_trace_test: can't open \"%s\"\n", name);
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        unsigned frame, vline, hpos, addr;
+        int      len = 0;
+        if (line[0] == ';' || sscanf(line, "%u %u %u %x %n", &frame, &vline, &hpos, &addr, &len) != 4 || !len)
+            continue;
+
+        trace_event ev;
+        ev.frame = frame;
+        ev.dest  = ~0U;
+        ev.data  = 0;
+        ev.text  = line + len;
+        if (sscanf(line + len, "XR 0x%x <= 0x%x", &ev.dest, &ev.data) != 2)
+        {
+            ev.dest = ~0U;
+        }
+        else if (!events.empty() && events.back().frame == frame && events.back().dest == ev.dest &&
+                 plain_xr_dest(ev.dest))
+        {
+            events.back() = ev;        // only last write has an effect
+            continue;
+        }
+        events.push_back(ev);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: sim_trace_test <optimized.trace> <unoptimized.trace>\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<trace_event> opt, ref;
+    if (!read_trace(argv[1], opt) || !read_trace(argv[2], ref))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < opt.size() || i < ref.size(); i++)
+    {
+        if (i >= opt.size() || i >= ref.size() || opt[i].frame != ref[i].frame || opt[i].text != ref[i].text)
+        {
+            printf("sim_trace_test: FAILED at event %zu\n", i + 1);
+            for (int f = 0; f < 2; f++)
+            {
+                const std::vector<trace_event> & events = f ? ref : opt;
+                if (i < events.size())
+                    printf("  %s frame %u: %s", argv[1 + f], events[i].frame, events[i].text.c_str());
+                else
+                    printf("  %s: (end of trace)\n", argv[1 + f]);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+    printf("sim_trace_test: %zu writes and waits match\n", opt.size());
+
+    return EXIT_SUCCESS;
+}
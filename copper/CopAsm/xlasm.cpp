@@ -2,17 +2,23 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <ctime>
 #include <ctype.h>
 #include <errno.h>
 #include <locale>
+#include <set>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
 #if defined(_MSC_VER)
 #include <codecvt>
+#include <direct.h>
+#else
+#include <unistd.h>
 #endif
 
 #include <sys/stat.h>
@@ -21,6 +27,7 @@
 #include "xlasmexpr.h"
 
 #include "xlasmcopper.h"
+#include "xlasmcz.h"
 
 // utility classes and helper functions
 
@@ -66,6 +73,40 @@ static void rtrim(std::string & str, const std::string & ws)
         str.clear();        // str is all whitespace
 }
 
+// FNV-1a 64-bit hash of data
+static uint64_t hash_bytes(uint64_t hash, const void * data, size_t len)
+{
+    const uint8_t * p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// hash string (including terminating zero, so concatenated strings hash differently)
+static uint64_t hash_string(uint64_t hash, const std::string & str)
+{
+    return hash_bytes(hash, str.c_str(), str.size() + 1);
+}
+
+static bool read_file_data(const std::string & path, std::string & data)
+{
+    FILE * fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    char   buf[16384];
+    size_t n;
+    data.clear();
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, n);
+    bool ok = !ferror(fp);
+    fclose(fp);
+
+    return ok;
+}
+
 // using these to avoid some "strict" type conversion warnings with system version returning int
 char uppercase(char v)
 {
@@ -77,26 +118,78 @@ char lowercase(char v)
     return static_cast<char>(::tolower(v));
 }
 
+// -j job output buffer for this thread (nullptr to print to stdout)
+thread_local std::string * job_output;
+
+// thrown by fatal_exit to end a -j job (so other jobs finish and all output is printed in job order)
+struct job_exit_t
+{
+    int code;
+};
+
+int voutprintf(const char * fmt, va_list va)
+{
+    if (!job_output)
+        return vprintf(fmt, va);
+
+    va_list va2;
+    va_copy(va2, va);
+    int len = vsnprintf(nullptr, 0, fmt, va2);
+    va_end(va2);
+    if (len > 0)
+    {
+        size_t start = job_output->size();
+        job_output->resize(start + static_cast<size_t>(len) + 1);
+        vsnprintf(&(*job_output)[start], static_cast<size_t>(len) + 1, fmt, va);
+        job_output->resize(start + static_cast<size_t>(len));
+    }
+
+    return len;
+}
+
+// printf to stdout (or current -j job output, printed after all jobs are done)
+int outprintf(const char * fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+
+    int len = voutprintf(fmt, ap);
+
+    va_end(ap);
+
+    return len;
+}
+
+// exit immediately (or end current -j job)
+void fatal_exit(int code)
+{
+    if (job_output)
+        throw job_exit_t{code};
+
+    exit(code);
+}
+
 // output error and exit immediately
 void fatal_error(const char * msg, ...)
 {
     va_list ap;
     va_start(ap, msg);
 
-    printf(TERM_ERROR "FATAL ERROR: ");
-    vprintf(msg, ap);
-    printf(TERM_CLEAR "\n");
+    outprintf(TERM_ERROR "FATAL ERROR: ");
+    voutprintf(msg, ap);
+    outprintf(TERM_CLEAR "\n");
 
     va_end(ap);
 
-    exit(10);
+    fatal_exit(10);
 }
 
 Ixlarch::~Ixlarch()
 {
+    architectures.erase(std::remove(architectures.begin(), architectures.end(), this), architectures.end());
 }
 
-std::vector<Ixlarch *> Ixlarch::architectures;
+thread_local std::vector<Ixlarch *> Ixlarch::architectures;
 
 void Ixlarch::register_arch(Ixlarch * arch)
 {
@@ -123,6 +216,7 @@ Ixlarch * Ixlarch::find_arch(const std::string & architecture)
 xlasm::xlasm(const std::string & architecture)
         : initial_variant(architecture)
         , arch(nullptr)
+        , shared_files(nullptr)
         , total_size_generated(0)
         , last_size_generated(0)
         , bytes_optimized(0)
@@ -149,11 +243,16 @@ xlasm::xlasm(const std::string & architecture)
         , prev_virtual_line_num(0)
         , pass_count(0)
         , last_diag_line(0)
+        , expr_line_index(0)
+        , line_cycles(-1)
+        , line_cycles_sum(0)
         , line_sec_org(false)
         , suppress_line_list(false)
         , suppress_line_listsource(false)
         , force_end_file(false)
         , force_exit_assembly(false)
+        , relocating(false)
+        , label_refs_branch(false)
 {
     //	std::random_device rd;		// non-deterministic generator for seed
     random_seed = 42;        // rd();
@@ -198,6 +297,27 @@ int32_t xlasm::assemble(const std::vector<std::string> & in_files, const std::st
             listing_filename = removeExtension(in_files[0]) + ".lst";
     }
 
+    // simulation trace file name
+    if (opt.simulate_frames)
+    {
+        if (object_filename.size())
+            trace_filename = removeExtension(object_filename) + ".trace";
+        else
+            trace_filename = removeExtension(in_files[0]) + ".trace";
+    }
+
+    // skip assembly if cached output for the same input files and options is still valid
+    std::string cache_entry;
+    if (opt.cache_dir.size())
+    {
+        cache_entry = cache_entry_name(in_files);
+        if (cache_restore(cache_entry))
+        {
+            outprintf("copasm completed successfully with 0 warnings and 0 errors (using cached output)\n");
+            return EXIT_SUCCESS;
+        }
+    }
+
     if (directives.size() == 0)
     {
         for (size_t i = 0; i < NUM_ELEMENTS(directives_list) && directives_list[i].name; i++)
@@ -265,25 +385,228 @@ int32_t xlasm::assemble(const std::vector<std::string> & in_files, const std::st
 
         dprintf("File \"%s\" read into memory (" PR_DSIZET " lines, " PR_U64 " bytes).\n",
                 it->c_str(),
-                source_files[*it].orig_line.size(),
+                source_files[*it].line_count(),
                 source_files[*it].file_size);
     }
 
     do_passes();
 
-    printf("%scopasm %s%s with %d warning%s and %d error%s%s\n",
-           error_count ? "\n*** " : "",
-           ((error_count && !opt.no_error_kill) || force_exit_assembly) ? "FAILED" : "completed",
-           (error_count == 0 && !force_exit_assembly) ? " successfully" : "",
-           warning_count,
-           warning_count == 1 ? "" : "s",
-           error_count,
-           error_count == 1 ? "" : "s",
-           error_count ? " ***\n" : "");
+    if (opt.verbose > 1)
+    {
+        dprintf("Source tokens and lines stored in " PR_DSIZET " strings (" PR_DSIZET " bytes).\n",
+                strings.count(),
+                strings.arena_bytes());
+    }
+
+    if (cache_entry.size() && error_count == 0 && warning_count == 0 && !force_exit_assembly)
+        cache_save(cache_entry);
+
+    outprintf("%scopasm %s%s with %d warning%s and %d error%s%s\n",
+              error_count ? "\n*** " : "",
+              ((error_count && !opt.no_error_kill) || force_exit_assembly) ? "FAILED" : "completed",
+              (error_count == 0 && !force_exit_assembly) ? " successfully" : "",
+              warning_count,
+              warning_count == 1 ? "" : "s",
+              error_count,
+              error_count == 1 ? "" : "s",
+              error_count ? " ***\n" : "");
 
     return error_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
+// Assembly cache entries are named by a hash of the assembler build, input file names and options.  Each entry lists
+// the files read while assembling (with a hash of their contents) and the output files written, so a later assembly
+// with the same command line can just rewrite the output if none of those files have changed.
+static const char cache_magic[] = "copasm cache 1";
+
+std::string xlasm::cache_entry_name(const std::vector<std::string> & in_files)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    char cwd[4096] = {0};
+#if defined(_MSC_VER)
+    _getcwd(cwd, sizeof(cwd) - 1);
+#else
+    if (getcwd(cwd, sizeof(cwd) - 1) == nullptr)
+        cwd[0] = 0;
+#endif
+
+    hash = hash_string(hash, "copasm " __DATE__ " " __TIME__);
+    hash = hash_string(hash, cwd);        // file names can be relative
+    hash = hash_string(hash, initial_variant);
+    for (auto it = in_files.begin(); it != in_files.end(); ++it)
+        hash = hash_string(hash, *it);
+    hash = hash_string(hash, object_filename);
+    hash = hash_string(hash, listing_filename);
+    for (auto it = opt.define_sym.begin(); it != opt.define_sym.end(); ++it)
+        hash = hash_string(hash, "-d " + *it);
+    for (auto it = opt.include_path.begin(); it != opt.include_path.end(); ++it)
+        hash = hash_string(hash, "-i " + *it);
+
+    std::string flags;
+    strprintf(flags,
+              "%u " PR_X64 " %d%d%d%d%d%d%d%d%d %u",
+              opt.listing_bytes,
+              opt.load_address,
+              opt.listing,
+              opt.xref,
+              opt.no_error_kill,
+              opt.suppress_false_conditionals,
+              opt.suppress_macro_expansion,
+              opt.suppress_macro_name,
+              opt.suppress_line_numbers,
+              opt.cycle_report,
+              opt.optimize,
+              opt.simulate_frames);
+    hash = hash_string(hash, flags);
+
+    std::string entry;
+    strprintf(entry, "%s/" PR_X64_016 ".cache", opt.cache_dir.c_str(), hash);
+
+    return entry;
+}
+
+bool xlasm::cache_restore(const std::string & entry)
+{
+    FILE * fp = fopen(entry.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    std::vector<std::pair<std::string, std::string>> outputs;        // output file names and contents
+    std::string                                      data;
+    char                                             line_buff[MAX_LINE_LENGTH] = {0};
+    bool                                             complete                   = false;
+    bool valid = fgets(line_buff, sizeof(line_buff), fp) && std::string(cache_magic) + "\n" == line_buff;
+
+    while (valid && !complete && fgets(line_buff, sizeof(line_buff), fp))
+    {
+        std::string line(line_buff);
+        rtrim(line, "\r\n");
+
+        if (line.compare(0, 4, "dep ") == 0 && line.size() > 21)
+        {
+            // file read, must have same contents
+            uint64_t hash = strtoull(line.substr(4, 16).c_str(), nullptr, 16);
+            valid         = read_file_data(line.substr(21), data) &&
+                    hash_bytes(14695981039346656037ULL, data.data(), data.size()) == hash;
+        }
+        else if (line.compare(0, 5, "none ") == 0)
+        {
+            // file not found, must still not exist
+            struct stat st;
+            valid = stat(line.substr(5).c_str(), &st) != 0;
+        }
+        else if (line.compare(0, 4, "out ") == 0)
+        {
+            // output file size, name and contents
+            char * name = nullptr;
+            size_t size = static_cast<size_t>(strtoull(line.c_str() + 4, &name, 10));
+            valid       = name && *name == ' ';
+            if (valid)
+            {
+                outputs.push_back(std::make_pair(std::string(name + 1), std::string(size, '\0')));
+                valid = size == 0 || fread(&outputs.back().second[0], 1, size, fp) == size;
+            }
+        }
+        else
+        {
+            complete = line == "end";
+            valid    = complete;
+        }
+    }
+    fclose(fp);
+
+    if (!valid || !complete)
+    {
+        if (opt.verbose > 1)
+        {
+            dprintf("Cache entry \"%s\" out of date, assembling.\n", entry.c_str());
+        }
+        return false;
+    }
+
+    for (auto it = outputs.begin(); it != outputs.end(); ++it)
+    {
+        FILE * out = fopen(it->first.c_str(), "wb");
+        if (!out)
+            return false;
+
+        bool ok = fwrite(it->second.data(), 1, it->second.size(), out) == it->second.size();
+        if (fclose(out) != 0 || !ok)
+            return false;
+    }
+
+    dprintf("Input files and options unchanged, output restored from cache entry \"%s\".\n", entry.c_str());
+
+    return true;
+}
+
+void xlasm::cache_save(const std::string & entry)
+{
+    std::string           contents = std::string(cache_magic) + "\n";
+    std::string           data;
+    std::set<std::string> saved;
+
+#if defined(_MSC_VER)
+    _mkdir(opt.cache_dir.c_str());
+#else
+    mkdir(opt.cache_dir.c_str(), 0777);
+#endif
+
+    for (auto it = cache_deps.begin(); it != cache_deps.end(); ++it)
+    {
+        if (!saved.insert(it->path).second)
+            continue;
+
+        if (!it->found)
+        {
+            contents += "none " + it->path + "\n";
+        }
+        else if (read_file_data(it->path, data))
+        {
+            strprintf(contents, "dep " PR_X64_016 " ", hash_bytes(14695981039346656037ULL, data.data(), data.size()));
+            contents += it->path + "\n";
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    if (listing_file)
+        fflush(listing_file);
+
+    const std::string * output_names[] = {&object_filename, &listing_filename, &trace_filename};
+    for (size_t i = 0; i < NUM_ELEMENTS(output_names); i++)
+    {
+        if (output_names[i]->empty())
+            continue;
+
+        if (!read_file_data(*output_names[i], data))
+            return;
+
+        strprintf(contents, "out " PR_DSIZET " ", data.size());
+        contents += *output_names[i] + "\n" + data;
+    }
+    contents += "end\n";
+
+    FILE * fp = fopen(entry.c_str(), "wb");
+    if (!fp)
+    {
+        dprintf("Unable to create cache entry \"%s\" error: %s\n", entry.c_str(), strerror(errno));
+        return;
+    }
+    bool ok = fwrite(contents.data(), 1, contents.size(), fp) == contents.size();
+    if (fclose(fp) != 0 || !ok)
+    {
+        remove(entry.c_str());
+    }
+    else if (opt.verbose > 1)
+    {
+        dprintf("Saved output to cache entry \"%s\".\n", entry.c_str());
+    }
+}
+
 // iterate over all lines of files processing input
 int32_t xlasm::do_passes()
 {
@@ -351,7 +674,7 @@ int32_t xlasm::do_passes()
         {
             if (error_count)
             {
-                printf("Continuing despite errors (-k option).\n");
+                outprintf("Continuing despite errors (-k option).\n");
             }
             continue;
         }
@@ -360,6 +683,27 @@ int32_t xlasm::do_passes()
 
     } while (ctxt.pass != context_t::PASS_2);
 
+    if (opt.optimize && ctxt.pass == context_t::PASS_2 && error_count == 0)
+    {
+        arch->optimize_report(this);
+    }
+
+    if (opt.cycle_report && ctxt.pass == context_t::PASS_2 && error_count == 0)
+    {
+        arch->cycle_report(this);
+    }
+
+    if (opt.simulate_frames && ctxt.pass == context_t::PASS_2 && error_count == 0)
+    {
+        FILE * trace_file = fopen(trace_filename.c_str(), "wt");
+        if (!trace_file)
+        {
+            fatal_error("opening trace file \"%s\", error: %s", trace_filename.c_str(), strerror(errno));
+        }
+        arch->simulate(this, trace_file);
+        fclose(trace_file);
+    }
+
     if (opt.listing && opt.xref)
     {
         uint32_t oldpass = ctxt.pass;
@@ -374,7 +718,7 @@ int32_t xlasm::do_passes()
     }
     else
     {
-        printf("No output generated.\n");
+        outprintf("No output generated.\n");
     }
 
     return 0;
@@ -462,6 +806,7 @@ int32_t xlasm::pass_reset()
         else
             ++it;
     }
+    reset_expr_slots();
 
     arch->deactivate(this);
     arch = Ixlarch::find_arch(initial_variant);
@@ -485,13 +830,16 @@ int32_t xlasm::pass_reset()
 
     virtual_line_num = 0;
 
+    bool arch_optimized = opt.optimize && !relocating && arch->optimize_pass(this);
+    label_refs.clear();
+
     if (ctxt.pass == context_t::PASS_1 && prev_virtual_line_num)
         ctxt.pass = context_t::PASS_OPT;
 
-    if (ctxt.pass == context_t::PASS_OPT && last_size_generated == total_size_generated)
+    if (ctxt.pass == context_t::PASS_OPT && last_size_generated == total_size_generated && !arch_optimized)
         ctxt.pass = context_t::PASS_2;
 
-    if (pass_count >= MAX_PASSES)
+    if (pass_count >= MAX_PASSES && !relocating)
     {
         ctxt.pass = context_t::PASS_2;
         warning(
@@ -642,6 +990,127 @@ static void mem_dump(FILE * out, const uint8_t * mem, size_t num)
     }
 }
 
+// write compressed words (checked with reference decoder), returns compressed size in words
+static size_t cz_dump(FILE * out, const uint8_t * mem, size_t num, uint16_t load_addr)
+{
+    std::vector<uint16_t> words;
+    for (size_t i = 0; i < num; i += 2)
+    {
+        words.push_back(static_cast<uint16_t>((mem[i] << 8) | mem[i + 1]));
+    }
+
+    std::vector<uint16_t> cz = xlasmcz::compress(words, load_addr);
+    std::vector<uint16_t> check;
+    uint16_t              check_addr = 0;
+    if (!xlasmcz::decompress(cz.data(), cz.size(), &check_addr, check) || check != words || check_addr != load_addr)
+    {
+        fatal_error("Compressed output did not decompress correctly");
+    }
+
+    for (auto w : cz)
+    {
+        fputc(w >> 8, out);
+        fputc(w & 0xff, out);
+    }
+
+    return cz.size();
+}
+
+// Relocatable object output (.cro), big-endian 16-bit words:
+//
+// | Word             | Description                                                     |
+// |------------------|-----------------------------------------------------------------|
+// | 0x4352           | "CR" magic                                                      |
+// | origin           | XR address assembled for (e.g., 0xC000 for XR_COPPER_ADDR)      |
+// | word count       | number of program words                                         |
+// | relocation count | number of relocation offsets                                    |
+// | program words    | program assembled at origin                                     |
+// | offsets          | offsets (ascending) of words to add (load address - origin) to  |
+//
+// xosera_upload_cro in xosera_m68k_api.c uploads and relocates it to any copper memory address.
+static void cro_dump(FILE *                        out,
+                     const uint8_t *               mem,
+                     size_t                        num,
+                     uint16_t                      load_addr,
+                     const std::vector<uint16_t> & relocs)
+{
+    std::vector<uint16_t> words = {
+        0x4352, load_addr, static_cast<uint16_t>(num >> 1), static_cast<uint16_t>(relocs.size())};
+    for (size_t i = 0; i < num; i += 2)
+    {
+        words.push_back(static_cast<uint16_t>((mem[i] << 8) | mem[i + 1]));
+    }
+    words.insert(words.end(), relocs.begin(), relocs.end());
+
+    for (auto w : words)
+    {
+        fputc(w >> 8, out);
+        fputc(w & 0xff, out);
+    }
+}
+
+// Find words holding addresses for relocatable output by assembling again (with no listing or warnings) with the
+// origin moved by RELOCATE_DELTA.  Words that moved by the same amount hold an address (e.g., a branch target, copper
+// address operand or #MOVM+label immediate).  A word that changed by any other amount can't be relocated by adding
+// to it, so it is an error.  Sections are restored after (but symbols keep moved values).
+void xlasm::find_relocations(section_t & sec, std::vector<uint16_t> & relocs)
+{
+    std::vector<uint8_t> image     = sec.data;
+    int64_t              load_addr = sec.load_addr;
+    int64_t              addr      = sec.addr;
+    uint32_t             passes    = pass_count;
+
+    relocating    = true;
+    sec.load_addr = load_addr + RELOCATE_DELTA;
+    for (int32_t p = 0; p < 2; p++)        // labels are all moved on second pass
+    {
+        pass_reset();
+        ctxt.pass        = context_t::PASS_OPT;
+        ctxt.section     = &sections["text"];
+        previous_section = ctxt.section;
+
+        for (auto fit = input_names.begin(); fit != input_names.end() && !force_exit_assembly; ++fit)
+        {
+            process_file(source_files[*fit]);
+        }
+
+        ctxt.file = nullptr;
+        diag_flush();
+    }
+    relocating = false;
+    pass_count = passes;
+    ctxt.pass  = context_t::PASS_2;
+
+    if (sec.data.size() != image.size() || error_count)
+    {
+        fatal_error("Relocatable output changed size when origin moved");
+    }
+
+    bool big_endian = arch->is_big_endian();
+    for (size_t i = 0; i + 1 < image.size(); i += 2)
+    {
+        size_t   hi    = big_endian ? i : i + 1;
+        size_t   lo    = big_endian ? i + 1 : i;
+        uint16_t w     = static_cast<uint16_t>((image[hi] << 8) | image[lo]);
+        uint16_t moved = static_cast<uint16_t>((sec.data[hi] << 8) | sec.data[lo]);
+        uint16_t diff  = static_cast<uint16_t>(moved - w);
+        if (diff == RELOCATE_DELTA)
+        {
+            relocs.push_back(static_cast<uint16_t>(i >> 1));
+        }
+        else if (diff != 0)
+        {
+            fatal_error("Word 0x%04x at address 0x" PR_X64_04 " is not relocatable (only address + constant is)",
+                        w,
+                        load_addr + static_cast<int64_t>(i >> 1));
+        }
+    }
+
+    sec.data      = image;
+    sec.load_addr = load_addr;
+    sec.addr      = addr;
+}
+
 int32_t xlasm::process_output()
 {
     std::vector<section_t *> secs;
@@ -714,7 +1183,9 @@ int32_t xlasm::process_output()
         C_FILE,
         VSIM_FILE,
         MEM_FILE,
-        BIN_FILE
+        BIN_FILE,
+        CZ_FILE,
+        CRO_FILE
     } out_fmt = output_format::NONE;
 
     std::string basename  = object_filename;
@@ -754,7 +1225,8 @@ int32_t xlasm::process_output()
         fatal_error("Expected a single segment (" PR_DSIZET " were generated)", secs.size());
     }
 
-    int64_t load_addr = secs[0]->load_addr;
+    int64_t               load_addr = secs[0]->load_addr;
+    std::vector<uint16_t> relocs;        // word offsets holding addresses (.cro output)
 
     if (!object_filename.size())
     {
@@ -783,6 +1255,30 @@ int32_t xlasm::process_output()
         dprintf(
             "Writing Verilog file \"%s\" (with " PR_D64 " 16-bit words).\n", object_filename.c_str(), total_size >> 1);
     }
+    else if (extension == ".cz")
+    {
+        out_fmt = output_format::CZ_FILE;
+        dprintf("Writing compressed binary file \"%s\": " PR_D64 " 16-bit words.\n",
+                object_filename.c_str(),
+                total_size >> 1);
+        if ((total_size >> 1) > 0xFFFF)
+        {
+            fatal_error("Compressed output limited to 65535 words (" PR_D64 " were generated)", total_size >> 1);
+        }
+    }
+    else if (extension == ".cro")
+    {
+        out_fmt = output_format::CRO_FILE;
+        if ((total_size >> 1) > 0xFFFF)
+        {
+            fatal_error("Relocatable output limited to 65535 words (" PR_D64 " were generated)", total_size >> 1);
+        }
+        find_relocations(*secs[0], relocs);
+        dprintf("Writing relocatable object file \"%s\": " PR_D64 " 16-bit words with " PR_DSIZET " relocations.\n",
+                object_filename.c_str(),
+                total_size >> 1,
+                relocs.size());
+    }
     else        // otherwise, assume binary output
     {
         out_fmt = output_format::BIN_FILE;
@@ -842,7 +1338,9 @@ int32_t xlasm::process_output()
             fprintf(out, "// " PR_D64 " 16-bit words\n", total_size >> 1);
         }
         break;
-        case output_format::BIN_FILE: {
+        case output_format::BIN_FILE:
+        case output_format::CZ_FILE:
+        case output_format::CRO_FILE: {
             out = fopen(object_filename.c_str(), "wb");
             if (!out)
                 fatal_error("opening output file \"%s\", error: %s", object_filename.c_str(), strerror(errno));
@@ -928,6 +1426,27 @@ int32_t xlasm::process_output()
                                         strerror(errno));
                     }
                     break;
+                    case output_format::CZ_FILE: {
+                        size_t cz_words =
+                            cz_dump(out, it->data.data(), it->data.size(), static_cast<uint16_t>(it->load_addr));
+                        dprintf("Compressed " PR_DSIZET " words to " PR_DSIZET " words (%d%%).\n",
+                                it->data.size() >> 1,
+                                cz_words,
+                                static_cast<int>(cz_words * 100 / std::max<size_t>(it->data.size() >> 1, 1)));
+                        if (ferror(out))
+                            fatal_error("writing compressed output file \"%s\", error: %s",
+                                        object_filename.c_str(),
+                                        strerror(errno));
+                    }
+                    break;
+                    case output_format::CRO_FILE: {
+                        cro_dump(out, it->data.data(), it->data.size(), static_cast<uint16_t>(it->load_addr), relocs);
+                        if (ferror(out))
+                            fatal_error("writing relocatable output file \"%s\", error: %s",
+                                        object_filename.c_str(),
+                                        strerror(errno));
+                    }
+                    break;
                     default:
                         assert(false);
                         break;
@@ -991,6 +1510,10 @@ int32_t xlasm::process_output()
                     break;
                 case output_format::BIN_FILE:        // nothing more to do here
                     break;
+                case output_format::CZ_FILE:        // nothing more to do here
+                    break;
+                case output_format::CRO_FILE:        // nothing more to do here
+                    break;
                 default:
                     assert(false);
             }
@@ -1020,7 +1543,7 @@ int32_t xlasm::process_file(source_t & f)
     ctxt.file                = &f;
 
     // iterate over all lines in file
-    for (ctxt.line = 0; ctxt.line < f.src_line.size(); ctxt.line++)
+    for (ctxt.line = 0; ctxt.line < f.line_count(); ctxt.line++)
     {
         rc = process_line();
         if (rc)
@@ -1040,7 +1563,7 @@ int32_t xlasm::process_file(source_t & f)
     if (error_count >= MAXERROR_COUNT)
     {
         error("Exiting due to maximum error count (%d)", error_count);
-        exit(10);
+        fatal_exit(10);
     }
 
     if (func_section != nullptr)
@@ -1056,7 +1579,13 @@ int32_t xlasm::process_line()
 {
     int32_t rc = 0;
 
-    const std::vector<std::string> & tokens = ctxt.file->src_line[ctxt.line];
+    expr_line_index = 0;
+    line_cycles     = -1;
+
+    // tokens for this line (used in place from the string pool of the file)
+    const token_list_t          tokens = ctxt.file->tokens(ctxt.line);
+    const string_pool_t *       pool   = tokens.pool;
+    const string_pool_t::id_t * ids    = tokens.ids;
 
     if (opt.verbose > 3 && tokens.size())
     {
@@ -1064,7 +1593,7 @@ int32_t xlasm::process_line()
         for (auto it = tokens.begin(); it != tokens.end(); ++it)
         {
             tokdbg += "|";
-            tokdbg += *it;
+            tokdbg += (*it).c_str();
             tokdbg += "|";
             if (it + 1 != tokens.end())
                 tokdbg += " ";
@@ -1096,25 +1625,23 @@ int32_t xlasm::process_line()
     // if more tokens, look for directive/mnemonic
     for (; cur_token < tokens.size(); cur_token++)
     {
-        auto & tok = tokens[cur_token];
+        token_t tok = tokens[cur_token];
 
         // parse a label if this line defines one
         if (cur_token == 0 && tok.size() && tok.back() == ':')
         {
-            label.assign(tok.begin(), tok.end() - 1);        // remove colon
+            label.assign(tok.c_str(), tok.size() - 1);        // remove colon
             continue;
         }
 
-        if (tok[0] == '.')
-            command.assign(tok.begin() + 1, tok.end());
-        else
-            command.assign(tok.begin(), tok.end());
-
-        // make keyword uppercase for comparison and to stand out in error messages
-        std::transform(command.begin(), command.end(), command.begin(), uppercase);
+        // keyword is uppercase without '.' for comparison and to stand out in error messages (from string pool,
+        // with hash for lookups)
+        string_pool_t::id_t command_id = pool->keyword(ids[cur_token]);
+        name_key_t          key        = pool->key(command_id);
+        pool->assign(command, command_id);
 
         // check architecture directives
-        uint32_t directive_idx = arch->check_directive(command);
+        uint32_t directive_idx = arch->check_directive(key);
 
         // if arch known directive, let arch handle it
         if (directive_idx >= NUM_DIRECTIVES)
@@ -1128,7 +1655,7 @@ int32_t xlasm::process_line()
         if (directive_idx == DIR_UNKNOWN)
         {
             // check standard directives
-            auto it = directives.find(command);
+            auto it = directives.find(key);
             if (it != directives.end())
             {
                 directive_idx = it->second;
@@ -1149,7 +1676,7 @@ int32_t xlasm::process_line()
             break;
 
         // check for macro invocation
-        if (macros.count(command) == 1)
+        if (macros.count(key) == 1)
         {
             if (label.size())
             {
@@ -1184,7 +1711,7 @@ int32_t xlasm::process_line()
         }
 
         // check if it is an architecture opcode
-        int32_t opcode_idx = arch->check_opcode(command);
+        int32_t opcode_idx = arch->check_opcode(key);
         if (opcode_idx != -1)
         {
             if (label.size())
@@ -1202,7 +1729,7 @@ int32_t xlasm::process_line()
         // check if a label definition (without colon)
         if (arch->column_one_labels() && cur_token == 0)
         {
-            label.assign(tok.begin(), tok.end());
+            label.assign(tok.c_str(), tok.size());
         }
         else
         {
@@ -1427,9 +1954,17 @@ int32_t xlasm::process_line_listing()
         }
 #endif
 
+        if (opt.cycle_report)
+        {
+            if (line_cycles >= 0)
+                strprintf(outline, "%3d %4d ", line_cycles, line_cycles_sum);
+            else
+                strprintf(outline, "         ");
+        }
+
         if (!suppress_line_listsource)
         {
-            strprintf(outline, "\t%s", ctxt.file->orig_line[ctxt.line].c_str());
+            strprintf(outline, "\t%s", ctxt.file->orig_line(ctxt.line));
         }
         else
             strprintf(outline, "\t<alignment pad>");
@@ -1573,11 +2108,11 @@ int32_t xlasm::process_xref()
     return 0;
 }
 
-int32_t xlasm::process_directive(uint32_t                         idx,
-                                 const std::string &              directive,
-                                 const std::string &              label,
-                                 size_t                           cur_token,
-                                 const std::vector<std::string> & tokens)
+int32_t xlasm::process_directive(uint32_t             idx,
+                                 const std::string &  directive,
+                                 const std::string &  label,
+                                 size_t               cur_token,
+                                 const token_list_t & tokens)
 {
     // macro directives first (only processed if current conditional true)
     if (ctxt.conditional.state)
@@ -1602,8 +2137,23 @@ int32_t xlasm::process_directive(uint32_t                         idx,
     // if currently defining a macro, only save other directives/opcodes for processing when macro is invoked
     if (ctxt.macrodef_ptr != nullptr)
     {
-        ctxt.macrodef_ptr->body.src_line.push_back(tokens);
-        ctxt.macrodef_ptr->body.file_size += ctxt.file->orig_line[ctxt.line].size();
+        const source_t::line_t & line = ctxt.file->lines[ctxt.line];
+        if (ctxt.file->pool == &strings)
+        {
+            ctxt.macrodef_ptr->body.add_line(line.orig, ctxt.file->line_tokens(ctxt.line), line.token_count);
+        }
+        else
+        {
+            // file shared with parallel assemblies (-j option), store strings in this assembly's pool
+            const string_pool_t *            pool = ctxt.file->pool;
+            const string_pool_t::id_t *      toks = ctxt.file->line_tokens(ctxt.line);
+            std::vector<string_pool_t::id_t> ids;
+            for (uint32_t t = 0; t < line.token_count; t++)
+                ids.push_back(strings.intern(pool->c_str(toks[t]), pool->length(toks[t])));
+            ctxt.macrodef_ptr->body.add_line(
+                strings.store(pool->c_str(line.orig), pool->length(line.orig)), ids.data(), ids.size());
+        }
+        ctxt.macrodef_ptr->body.file_size += ctxt.file->orig_length(ctxt.line);
 
         return 0;
     }
@@ -1671,15 +2221,15 @@ int32_t xlasm::process_directive(uint32_t                         idx,
             std::string exprstr1;
             if (tokens[cur_token][0] == '\"' || tokens[cur_token][0] == '\'')
             {
-                exprstr1 = removeQuotes(tokens[cur_token]);
+                exprstr1 = removeQuotes(tokens[cur_token].str());
             }
             else
             {
-                symbol_t & sym = symbols[tokens[cur_token]];
+                symbol_t & sym = symbols[tokens.key(cur_token)];
                 if (sym.type == symbol_t::UNDEFINED)
                 {
                     if (!sym.name.size())
-                        sym.name = tokens[cur_token];
+                        sym.name = tokens[cur_token].str();
                     //					if (ctxt.pass == context_t::PASS_2)
                     //						warning("Evaluating undefined string symbol \"%s\" as \"\"",
                     // sym.name.c_str());
@@ -1700,15 +2250,15 @@ int32_t xlasm::process_directive(uint32_t                         idx,
             std::string exprstr2;
             if (tokens[cur_token + 2][0] == '\"' || tokens[cur_token + 2][0] == '\'')
             {
-                exprstr2 = removeQuotes(tokens[cur_token + 2]);
+                exprstr2 = removeQuotes(tokens[cur_token + 2].str());
             }
             else
             {
-                symbol_t & sym = symbols[tokens[cur_token + 2]];
+                symbol_t & sym = symbols[tokens.key(cur_token + 2)];
                 if (sym.type == symbol_t::UNDEFINED)
                 {
                     if (!sym.name.size())
-                        sym.name = tokens[cur_token + 2];
+                        sym.name = tokens[cur_token + 2].str();
                     //					if (ctxt.pass == context_t::PASS_2)
                     //						warning("Evaluating undefined string symbol \"%s\" as \"\"",
                     // sym.name.c_str());
@@ -1997,7 +2547,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                             MAXINCLUDE_STACK);
             }
 
-            std::string basename = removeQuotes(tokens[cur_token]);
+            std::string basename = removeQuotes(tokens[cur_token].str());
             std::string filename = basename;
 
             source_t & f = source_files[basename];
@@ -2034,7 +2584,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                 notice(2,
                        "Including file \"%s\" (" PR_DSIZET " lines, " PR_D64 " bytes)",
                        filename.c_str(),
-                       f.orig_line.size(),
+                       f.line_count(),
                        f.file_size);
             }
             context_stack.push(ctxt);
@@ -2066,7 +2616,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
             if (tokens[cur_token][0] != '\"' && tokens[cur_token][0] != '\'')
                 result = eval_tokens(directive, exprstr, cur_token, tokens, 1, 0);
             else
-                exprstr = removeQuotes(tokens[cur_token]);
+                exprstr = removeQuotes(tokens[cur_token].str());
 
             if (arch->lookup_register(label) >= 0)
             {
@@ -2207,6 +2757,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
             }
 
             symbols.erase(label);
+            reset_expr_slots();
             notice(3, "%s %s symbol \"%s\"", directive.c_str(), ntype.c_str(), label.c_str());
 
             return 0;
@@ -2220,11 +2771,25 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                 return 0;
             }
 
+            // exported addresses can be modified by host code, so never optimized (see copper::optimize_pass)
+            if (opt.optimize)
+            {
+                for (size_t t = cur_token; t < tokens.size(); t += 2)
+                {
+                    auto sit = symbols.find(tokens.key(t));
+                    if (sit != symbols.end() &&
+                        (sit->second.type == symbol_t::VARIABLE || sit->second.type == symbol_t::LABEL))
+                    {
+                        label_refs.insert(sit->second.value);
+                    }
+                }
+            }
+
             if (ctxt.pass == context_t::PASS_2)
             {
                 do
                 {
-                    std::string export_label = tokens[cur_token];
+                    std::string export_label = tokens[cur_token].str();
 
                     if (std::find(exports.begin(), exports.end(), export_label) == exports.end())
                     {
@@ -2370,11 +2935,10 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                       directive.c_str());
 
             bool moretokens = false;
-            for (auto it = ctxt.file->src_line.begin() + static_cast<ssize_t>(ctxt.line) + 1;
-                 it != ctxt.file->src_line.end();
+            for (auto it = ctxt.file->lines.begin() + static_cast<ssize_t>(ctxt.line) + 1; it != ctxt.file->lines.end();
                  ++it)
             {
-                if (it->size() != 0)
+                if (it->token_count != 0)
                 {
                     moretokens = true;
                     break;
@@ -2625,7 +3189,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
             uint64_t count = 0;
             for (; cur_token < tokens.size(); cur_token++)
             {
-                std::string exprstr = removeQuotes(tokens[cur_token]);
+                std::string exprstr = removeQuotes(tokens[cur_token].str());
                 if (exprstr.size() & 1)
                 {
                     error("%s requires an even number of contiguous hex digits", directive.c_str());
@@ -2685,7 +3249,7 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                 return 0;
             }
 
-            std::string name = removeQuotes(tokens[cur_token]);
+            std::string name = removeQuotes(tokens[cur_token].str());
 
             struct stat binstat;
 
@@ -2707,6 +3271,11 @@ int32_t xlasm::process_directive(uint32_t                         idx,
                 error("%s opening file \"%s\" error: %s", directive.c_str(), name.c_str(), strerror(errno));
                 break;
             }
+            if (ctxt.pass == context_t::PASS_1)
+            {
+                cache_dep_t dep = {name, true};
+                cache_deps.push_back(dep);
+            }
 
             if (ferror(fp))
             {
@@ -2744,10 +3313,10 @@ int32_t xlasm::process_directive(uint32_t                         idx,
     return 0;
 }
 
-int32_t xlasm::process_section(const std::string &              directive,
-                               const std::string &              label,
-                               size_t                           cur_token,
-                               const std::vector<std::string> & tokens)
+int32_t xlasm::process_section(const std::string &  directive,
+                               const std::string &  label,
+                               size_t               cur_token,
+                               const token_list_t & tokens)
 {
     if (label.size())
     {
@@ -2760,7 +3329,7 @@ int32_t xlasm::process_section(const std::string &              directive,
         return 0;
     }
 
-    std::string segname = removeQuotes(tokens[cur_token++]);
+    std::string segname = removeQuotes(tokens[cur_token++].str());
     uint32_t    flags   = 0;
 
     bool    addr_given = false;
@@ -2781,7 +3350,7 @@ int32_t xlasm::process_section(const std::string &              directive,
         cur_token++;
         if (cur_token < tokens.size())
         {
-            std::string flag_name = tokens[cur_token++];
+            std::string flag_name = tokens[cur_token++].str();
             std::transform(flag_name.begin(), flag_name.end(), flag_name.begin(), lowercase);
 
             if (flag_name == "noload")
@@ -2953,12 +3522,12 @@ int32_t xlasm::align_output(size_t pot)
     return 0;
 }
 
-int64_t xlasm::eval_tokens(const std::string &              cmd,
-                           std::string &                    exprstr,
-                           size_t &                         cur_token,
-                           const std::vector<std::string> & tokens,
-                           int32_t                          expected_args,
-                           int64_t                          defval)
+int64_t xlasm::eval_tokens(const std::string &  cmd,
+                           std::string &        exprstr,
+                           size_t &             cur_token,
+                           const token_list_t & tokens,
+                           int32_t              expected_args,
+                           int64_t              defval)
 {
     int64_t result = defval;
 
@@ -2979,17 +3548,16 @@ int64_t xlasm::eval_tokens(const std::string &              cmd,
             //			if (exprstr.size())
             //				exprstr += " ";
 
-            exprstr += *it;
+            exprstr.append((*it).c_str(), (*it).size());
         }
 
         if (expected_args > 1 && cur_token < tokens.size() && tokens[cur_token] == ",")
             cur_token++;
     }
 
-    size_t     last_offset = 0;
-    expression expr;
+    size_t last_offset = 0;
 
-    if (!exprstr.size() || !expr.evaluate(this, exprstr.c_str(), &result, &last_offset))
+    if (!exprstr.size() || !eval_expr(exprstr, &result, &last_offset))
     {
         warning("%s failed evaluating expression \"%.64s\", using default value " PR_D64,
                 cmd.c_str(),
@@ -3014,10 +3582,10 @@ int64_t xlasm::eval_tokens(const std::string &              cmd,
     return result;
 }
 
-bool xlasm::define_macro_begin(const std::string &              directive,
-                               const std::string &              label,
-                               size_t                           cur_token,
-                               const std::vector<std::string> & tokens)
+bool xlasm::define_macro_begin(const std::string &  directive,
+                               const std::string &  label,
+                               size_t               cur_token,
+                               const token_list_t & tokens)
 {
     if (ctxt.macrodef_ptr != nullptr)
     {
@@ -3031,7 +3599,7 @@ bool xlasm::define_macro_begin(const std::string &              directive,
         return 0;
     }
 
-    const std::string & name     = label.size() ? label : tokens[cur_token++];
+    const std::string   name     = label.size() ? label : tokens[cur_token++].str();
     std::string         upr_name = name;
 
     std::transform(upr_name.begin(), upr_name.end(), upr_name.begin(), uppercase);
@@ -3058,7 +3626,7 @@ bool xlasm::define_macro_begin(const std::string &              directive,
     {
         if (!isalpha((*it)[0]) && !isdigit((*it)[0]) && (*it)[0] != '_')
         {
-            error("%s \"%s\" illegal parameter name \"%s\"", directive.c_str(), name.c_str(), it->c_str());
+            error("%s \"%s\" illegal parameter name \"%s\"", directive.c_str(), name.c_str(), (*it).c_str());
             return 0;
         }
 
@@ -3074,11 +3642,11 @@ bool xlasm::define_macro_begin(const std::string &              directive,
 
         if (dupe)
         {
-            error("%s \"%s\" duplicated parameter name \"%s\"", directive.c_str(), name.c_str(), it->c_str());
+            error("%s \"%s\" duplicated parameter name \"%s\"", directive.c_str(), name.c_str(), (*it).c_str());
             continue;
         }
 
-        m.args.push_back(*it);
+        m.args.push_back((*it).str());
         ++it;
 
         std::string def;
@@ -3091,7 +3659,7 @@ bool xlasm::define_macro_begin(const std::string &              directive,
             {
                 if (def.size())
                     def += " ";
-                def += *it;
+                def += (*it).c_str();
             }
         }
 
@@ -3103,7 +3671,7 @@ bool xlasm::define_macro_begin(const std::string &              directive,
         }
         if (*it != ",")
         {
-            error("%s \"%s\" unexpected \"%s\" after parameter", directive.c_str(), name.c_str(), it->c_str());
+            error("%s \"%s\" unexpected \"%s\" after parameter", directive.c_str(), name.c_str(), (*it).c_str());
             break;
         }
     }
@@ -3128,16 +3696,17 @@ bool xlasm::define_macro_begin(const std::string &              directive,
     m.name            = name;
     m.body.line_start = ctxt.line + 2;
     m.body.name       = ctxt.file->name;
+    m.body.pool       = &strings;
 
     ctxt.macrodef_ptr = &m;
 
     return 0;
 }
 
-bool xlasm::define_macro_end(const std::string &              directive,
-                             const std::string &              label,
-                             size_t                           cur_token,
-                             const std::vector<std::string> & tokens)
+bool xlasm::define_macro_end(const std::string &  directive,
+                             const std::string &  label,
+                             size_t               cur_token,
+                             const token_list_t & tokens)
 {
     if (ctxt.macrodef_ptr == nullptr)
     {
@@ -3160,20 +3729,21 @@ bool xlasm::define_macro_end(const std::string &              directive,
            "%s for MACRO \"%s\" (" PR_DSIZET " lines)",
            directive.c_str(),
            ctxt.macrodef_ptr->name.c_str(),
-           ctxt.macrodef_ptr->body.src_line.size());
+           ctxt.macrodef_ptr->body.line_count());
 
 #if 1
     int32_t mlinenum = 1;
-    for (auto md = ctxt.macrodef_ptr->body.src_line.begin(); md != ctxt.macrodef_ptr->body.src_line.end();
-         ++md, ++mlinenum)
+    const source_t & body = ctxt.macrodef_ptr->body;
+    for (uint32_t md = 0; md < body.line_count(); ++md, ++mlinenum)
     {
-        std::string mline;
-        for (auto mt = (*md).begin(); mt != (*md).end(); ++mt)
+        std::string                 mline;
+        const string_pool_t::id_t * mt = body.line_tokens(md);
+        for (uint32_t t = 0; t < body.lines[md].token_count; t++)
         {
             if (mline.size())
                 mline += " ";
             mline += "|";
-            mline += *mt;
+            mline += strings.c_str(mt[t]);
             mline += "|";
         }
         notice(3, "%6d: %s", mlinenum, mline.c_str());
@@ -3185,11 +3755,12 @@ bool xlasm::define_macro_end(const std::string &              directive,
     return 0;
 }
 
-xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, const std::vector<std::string> & tokens)
+xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, const token_list_t & tokens)
 {
     macro_t & m = macros[name];
 
     name = m.name;        // use name defined with (not uppercase)
+
     std::vector<std::string> parms;
 
     // TODO: Fixup token parsing, e.g., {"A "B C,x} drops C
@@ -3212,11 +3783,11 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                         break;
                     }
 
-                    rawparm = *it;
+                    rawparm = (*it).c_str();
                     ++it;
                     break;
                 }
-                rawparm += *it;
+                rawparm += (*it).c_str();
                 ++it;
             }
 
@@ -3306,40 +3877,30 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
         s.name       = m.body.name;
         s.file_size  = m.body.file_size;
         s.line_start = m.body.line_start;
-
-        s.src_line = m.body.src_line;
+        s.pool       = &strings;
 
         std::string unique_str;
         strprintf(unique_str, "_%s_%d", m.name.c_str(), m.invoke_count);
         notice(3, "Invoked MACRO \"%s\" with key <%s> and unique ID %s", name.c_str(), key.c_str(), unique_str.c_str());
 
-        bool        spammed = false;
-        std::string sn;
-        std::string mn;
-        for (auto lit = s.src_line.begin(); lit != s.src_line.end(); ++lit)
+        bool                             spammed = false;
+        std::string                      sn;
+        std::string                      mn;
+        std::string                      tok;
+        std::vector<string_pool_t::id_t> line_ids;
+        for (uint32_t lit = 0; lit < m.body.line_count(); ++lit)
         {
-            // {
-            // 	std::string fake_line;
-
-            // 	if (!opt.suppress_macro_name)
-            // 		fake_line = "<" + name + ">\t";
-
-            // 	size_t idx = 0;
-            // 	for (auto tit = lit->begin(); tit != lit->end(); ++tit, idx++)
-            // 	{
-            // 		if (idx == 0 && tit->back() != ':')
-            // 			fake_line += "\t\t";
-            // 		fake_line += *tit;
-            // 		if (tit + 1 != lit->end() && idx == 0)
-            // 			fake_line += "\t\t";
-            // 	}
-            // 	s.orig_line.push_back(fake_line);
-            // 	dprintf("BEFORE: " PR_DSIZET ": %s\n", lit - s.src_line.begin(), fake_line.c_str());
-            // }
-            for (auto tit = lit->begin(); tit != lit->end(); ++tit)
+            const string_pool_t::id_t * body_ids = m.body.line_tokens(lit);
+            line_ids.assign(body_ids, body_ids + m.body.lines[lit].token_count);
+            for (auto tid = line_ids.begin(); tid != line_ids.end(); ++tid)
             {
+                // tokens without a backslash are used as-is
+                if (strchr(strings.c_str(*tid), '\\') == nullptr)
+                    continue;
+
+                strings.assign(tok, *tid);
                 size_t search_start = 0;
-                bool   hasquotes    = (tit->size() && ((*tit)[0] == '\"' || (*tit)[0] == '\''));
+                bool   hasquotes    = (tok.size() && (tok[0] == '\"' || tok[0] == '\''));
 
                 uint32_t reps;
                 for (reps = 0; reps < MAXMACROREPS_WARNING; reps++)
@@ -3348,13 +3909,13 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                     size_t replace_pos    = 0;
                     size_t replace_length = 0;
 
-                    if (search_start >= tit->size())
+                    if (search_start >= tok.size())
                         break;
 
-                    search_start = tit->find("\\", search_start);
+                    search_start = tok.find("\\", search_start);
 
                     // if no backslash or backslash at end, we are done
-                    if (search_start == std::string::npos || search_start + 1 >= tit->size())
+                    if (search_start == std::string::npos || search_start + 1 >= tok.size())
                         break;
 
                     if (reps == 0)
@@ -3362,27 +3923,27 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                                "MACRO %s<%s>:" PR_DSIZET ": replacing arguments in: %s",
                                name.c_str(),
                                key.c_str(),
-                               lit - s.src_line.begin(),
-                               tit->c_str());
+                               static_cast<size_t>(lit),
+                               tok.c_str());
 
                     // if two backslashes, search for next backslash
-                    if ((*tit)[search_start + 1] == '\\')
+                    if (tok[search_start + 1] == '\\')
                     {
                         search_start += 2;
                         continue;
                     }
 
-                    if ((*tit)[search_start + 1] == '@')        // '\@' unique-ifier?
+                    if (tok[search_start + 1] == '@')        // '\@' unique-ifier?
                     {
-                        tit->erase(search_start, 2);
-                        tit->insert(search_start, unique_str);
+                        tok.erase(search_start, 2);
+                        tok.insert(search_start, unique_str);
                         continue;
                     }
 
                     // is this a numeric parameter after backslash?
-                    if (isdigit((*tit)[search_start + 1]))
+                    if (isdigit(tok[search_start + 1]))
                     {
-                        const char * startptr = &(*tit)[search_start + 1];
+                        const char * startptr = &tok[search_start + 1];
                         char *       endptr   = nullptr;
                         parameter_idx         = strtoul(startptr, &endptr, 10);
                         replace_length        = static_cast<size_t>(endptr - startptr);
@@ -3398,13 +3959,13 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                                 sn = "\\";
                                 sn += *ait;
                                 //								dprintf("Check for '%s' in '%s'...\n", sn.c_str(),
-                                //(*tit).c_str());
-                                size_t mp = tit->find(sn, search_start);
-                                if (mp != std::string::npos && (mp == 0 || (*tit)[mp - 1] != '\\'))
+                                //tok.c_str());
+                                size_t mp = tok.find(sn, search_start);
+                                if (mp != std::string::npos && (mp == 0 || tok[mp - 1] != '\\'))
                                 {
                                     //									dprintf("Found '%s' in '%s' at pos "
                                     // PR_DSIZET
-                                    //"\n",  sn.c_str(), tit->c_str(), mp);
+                                    //"\n",  sn.c_str(), tok.c_str(), mp);
                                     mn             = sn;
                                     parameter_idx  = static_cast<size_t>((ait - m.args.begin())) + 1;
                                     replace_length = ait->size();
@@ -3426,13 +3987,13 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                     ///"...\n",
                     /// mn.c_str(), reptxt.c_str(), replace_pos, replace_length);
 
-                    tit->erase(replace_pos, replace_length + 1);
+                    tok.erase(replace_pos, replace_length + 1);
                     if (hasquotes)
-                        tit->insert(replace_pos, reQuote(reptxt));
+                        tok.insert(replace_pos, reQuote(reptxt));
                     else
-                        tit->insert(replace_pos, reptxt);
+                        tok.insert(replace_pos, reptxt);
 
-                    //					dprintf("Result '%s'...\n", tit->c_str());
+                    //					dprintf("Result '%s'...\n", tok.c_str());
                 }
 
                 if (reps >= MAXMACROREPS_WARNING && !spammed)
@@ -3442,6 +4003,8 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
                           MAXMACROREPS_WARNING);
                     spammed = true;
                 }
+
+                *tid = strings.intern(tok);
             }
 
             {
@@ -3452,16 +4015,16 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
 
                 // TODO: Not happy with this macro fake listing
                 size_t idx = 0;
-                for (auto tit = lit->begin(); tit != lit->end(); ++tit, idx++)
+                for (auto tid = line_ids.begin(); tid != line_ids.end(); ++tid, idx++)
                 {
-                    if (idx == 0 && tit->back() != ':')
+                    if (idx == 0 && strings.c_str(*tid)[strings.length(*tid) - 1] != ':')
                         fake_line += " ";
-                    fake_line += *tit;
-                    if (tit + 1 != lit->end() && idx < 2)
+                    fake_line += strings.c_str(*tid);
+                    if (tid + 1 != line_ids.end() && idx < 2)
                         fake_line += " ";
                 }
-                s.orig_line.push_back(fake_line);
-                //				dprintf("AFTER : " PR_DSIZET ": %s\n", lit - s.src_line.begin(), fake_line.c_str());
+                s.add_line(strings.store(fake_line), line_ids.data(), line_ids.size());
+                //				dprintf("AFTER : " PR_DSIZET ": %s\n", lit, fake_line.c_str());
             }
         }
     }
@@ -3476,12 +4039,86 @@ xlasm::source_t & xlasm::expand_macro(std::string & name, size_t cur_token, cons
     return s;
 }
 
+// evaluate expression (using compiled code cached for each expression on a virtual line after first use)
+bool xlasm::eval_expr(const token_t & exprstr, int64_t * result, size_t * last_offset)
+{
+    if (expr_cache.size() <= static_cast<size_t>(virtual_line_num))
+        expr_cache.resize(static_cast<size_t>(virtual_line_num) + 1);
+    std::vector<expr_code_t> & line_cache = expr_cache[static_cast<size_t>(virtual_line_num)];
+    uint32_t                   index      = expr_line_index++;
+    if (line_cache.size() <= index)
+        line_cache.resize(index + 1);
+
+    return eval_code(line_cache[index], exprstr, result, last_offset);
+}
+
+// evaluate expression with code (compiled if code is not for exprstr), uses expression::evaluate to report errors
+bool xlasm::eval_code(expr_code_t & code, const token_t & exprstr, int64_t * result, size_t * last_offset)
+{
+    expression expr;
+
+    if (!(exprstr == code.text) || code.dollar_hex != dollar_hex() || code.insns.empty())
+    {
+        if (!expr.compile(this, exprstr.str(), code))
+        {
+            code.insns.clear();
+            return expr.evaluate(this, exprstr.str(), result, last_offset);
+        }
+    }
+
+    if (!expr.run(this, code, result))
+    {
+        return expr.evaluate(this, exprstr.str(), result, last_offset);
+    }
+    if (last_offset != nullptr)
+        *last_offset = code.last_offset;
+
+    return true;
+}
+
+// index of symbol name in expr_slots (symbols used by compiled expressions)
+uint32_t xlasm::expr_symbol_slot(const char * name)
+{
+    std::string sym_name(name);
+    auto        it = expr_slot_index.find(sym_name);
+    if (it != expr_slot_index.end())
+        return it->second;
+
+    uint32_t    slot = static_cast<uint32_t>(expr_slots.size());
+    expr_slot_t s    = {sym_name, nullptr};
+    expr_slots.push_back(s);
+    expr_slot_index[sym_name] = slot;
+
+    return slot;
+}
+
+int64_t xlasm::expr_slot_value(uint32_t slot, bool * undefined)
+{
+    expr_slot_t & s = expr_slots[slot];
+    if (s.sym == nullptr)
+        s.sym = &symbols[s.name];
+
+    return symbol_value(this, *s.sym, s.name, undefined);
+}
+
+// forget symbol pointers (needed after erasing symbols)
+void xlasm::reset_expr_slots()
+{
+    for (auto & s : expr_slots)
+        s.sym = nullptr;
+}
+
 int64_t xlasm::symbol_value(xlasm * xl, const char * name, bool * undefined)
 {
-    int64_t     result = 0;
     std::string sym_name(name);
 
-    symbol_t & sym = xl->symbols[sym_name];
+    return symbol_value(xl, xl->symbols[sym_name], sym_name, undefined);
+}
+
+int64_t xlasm::symbol_value(xlasm * xl, symbol_t & sym, const std::string & sym_name, bool * undefined)
+{
+    int64_t      result = 0;
+    const char * name   = sym_name.c_str();
 
     if (!sym.file_first_referenced)
     {
@@ -3507,11 +4144,10 @@ int64_t xlasm::symbol_value(xlasm * xl, const char * name, bool * undefined)
     }
     else if (sym.type == symbol_t::STRING)
     {
-        expression expr;
-
         if (sym.str.size())
         {
-            if (!expr.evaluate(xl, sym.str.c_str(), &result))
+            token_t expr = {sym.str.c_str(), static_cast<uint32_t>(sym.str.size())};
+            if (!xl->eval_code(xl->expr_strings[sym.str], expr, &result))
             {
                 if (undefined)
                     *undefined = true;
@@ -3537,6 +4173,10 @@ int64_t xlasm::symbol_value(xlasm * xl, const char * name, bool * undefined)
             sym.section->flags |= section_t::REFERENCED_FLAG;
         }
         result = sym.value;
+        if (xl->opt.optimize && sym.type == symbol_t::LABEL && !xl->label_refs_branch)
+        {
+            xl->label_refs.insert(result);
+        }
     }
 
     return result;
@@ -3630,7 +4270,7 @@ int64_t xlasm::lookup_special_symbol(const std::string & sym_name)
     return 0;
 }
 
-std::string xlasm::token_message(size_t cur_token, const std::vector<std::string> & tokens)
+std::string xlasm::token_message(size_t cur_token, const token_list_t & tokens)
 {
     std::string msg;
 
@@ -3641,7 +4281,7 @@ std::string xlasm::token_message(size_t cur_token, const std::vector<std::string
 
         if ((*it)[0] == '\"' || (*it)[0] == '\'')
         {
-            msg += removeQuotes(*it);
+            msg += removeQuotes((*it).str());
         }
         else
         {
@@ -3649,7 +4289,7 @@ std::string xlasm::token_message(size_t cur_token, const std::vector<std::string
             expression  expr;
             std::string rstr;
 
-            if (it->size() && expr.evaluate(this, it->c_str(), &result))
+            if ((*it).size() && expr.evaluate(this, (*it).c_str(), &result))
                 strprintf(msg, "0x" PR_X64 "/" PR_D64 "", result, result);
             else
                 strprintf(msg, "<expr error>");
@@ -3797,6 +4437,116 @@ std::string xlasm::reQuote(const std::string & str)
     return newstr;
 }
 
+xlasm::string_pool_t::string_pool_t()
+        : slots(INITIAL_SLOTS)
+        , arena_next(nullptr)
+        , arena_free(0)
+        , arena_used(0)
+        , interned(0)
+{
+    store("", 0);        // EMPTY_ID
+    entries[EMPTY_ID].hash = name_hash("", 0);
+}
+
+xlasm::string_pool_t::id_t xlasm::string_pool_t::intern(const char * str, size_t len)
+{
+    if (len == 0)
+        return EMPTY_ID;
+
+    uint32_t hash = name_hash(str, len);
+
+    // linear probe for existing string or empty slot
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != EMPTY_ID)
+    {
+        const entry_t & e = entries[slots[slot]];
+        if (e.hash == hash && e.len == len && memcmp(e.str, str, len) == 0)
+            return slots[slot];
+        slot = (slot + 1) & mask;
+    }
+
+    id_t id = store(str, len);
+    entries[id].hash = hash;
+    slots[slot]      = id;
+    if (++interned * 2 > slots.size())
+        grow_slots();
+
+    // keyword form (uppercase without leading '.'), so keyword lookups need no case conversion or hashing
+    const char * kw     = str;
+    size_t       kw_len = len;
+    if (kw[0] == '.')
+    {
+        kw++;
+        kw_len--;
+    }
+    bool folded = kw != str;
+    for (size_t i = 0; i < kw_len && !folded; i++)
+        folded = kw[i] != uppercase(kw[i]);
+    if (folded)
+    {
+        std::string upr(kw, kw_len);
+        std::transform(upr.begin(), upr.end(), upr.begin(), uppercase);
+        id_t kw_id          = intern(upr);
+        entries[id].keyword = kw_id;
+    }
+
+    return id;
+}
+
+xlasm::string_pool_t::id_t xlasm::string_pool_t::store(const char * str, size_t len)
+{
+    id_t    id = static_cast<id_t>(entries.size());
+    entry_t e  = {arena_copy(str, len), static_cast<uint32_t>(len), 0, id};
+    entries.push_back(e);
+
+    return id;
+}
+
+const char * xlasm::string_pool_t::arena_copy(const char * str, size_t len)
+{
+    if (len + 1 > arena_free)
+    {
+        size_t block_size = std::max(static_cast<size_t>(ARENA_BLOCK_SIZE), len + 1);
+        blocks.emplace_back(new char[block_size]);
+        arena_next = blocks.back().get();
+        arena_free = block_size;
+    }
+
+    char * copy = arena_next;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    arena_next += len + 1;
+    arena_free -= len + 1;
+    arena_used += len + 1;
+
+    return copy;
+}
+
+void xlasm::string_pool_t::grow_slots()
+{
+    std::vector<id_t> old_slots(slots.size() * 2);
+    old_slots.swap(slots);
+
+    size_t mask = slots.size() - 1;
+    for (auto id : old_slots)
+    {
+        if (id == EMPTY_ID)
+            continue;
+        size_t slot = entries[id].hash & mask;
+        while (slots[slot] != EMPTY_ID)
+            slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+}
+
+void xlasm::source_t::add_line(string_pool_t::id_t orig, const string_pool_t::id_t * toks, size_t count)
+{
+    line_t l = {orig, static_cast<uint32_t>(token_ids.size()), static_cast<uint32_t>(count)};
+    token_ids.insert(token_ids.end(), toks, toks + count);
+    lines.push_back(l);
+}
+
 int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std::string & fn)
 {
     if (file_size)
@@ -3806,16 +4556,59 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
         return 0;
     }
 
+    if (xa->shared_files == nullptr)
+    {
+        bool found = false;
+        pool       = &xa->strings;
+        int32_t e  = load_file(xa, n, fn, &found);
+
+        cache_dep_t dep = {fn, found};
+        xa->cache_deps.push_back(dep);
+
+        return e;
+    }
+
+    // parallel assembly, copy lines and token ids of file tokenized once (strings stay in its own pool)
+    shared_files_t::file_t * sf;
+    {
+        std::lock_guard<std::mutex>               lock(xa->shared_files->mutex);
+        std::unique_ptr<shared_files_t::file_t> & entry = xa->shared_files->files[fn];
+        if (!entry)
+        {
+            entry.reset(new shared_files_t::file_t());
+            entry->source.pool = &entry->strings;
+            entry->found       = false;
+            entry->error       = entry->source.load_file(xa, n, fn, &entry->found);
+        }
+        sf = entry.get();
+    }
+
+    cache_dep_t dep = {fn, sf->found};
+    xa->cache_deps.push_back(dep);
+    if (sf->error == 0)
+    {
+        *this = sf->source;
+        name  = n;
+    }
+
+    return sf->error;
+}
+
+// read and tokenize file into lines using pool
+int32_t xlasm::source_t::load_file(xlasm * xa, const std::string & n, const std::string & fn, bool * found)
+{
     name = n;
 
     FILE * fp = fopen(fn.c_str(), "r");
+    *found    = fp != nullptr;
     if (!fp)
     {
         return errno;
     }
 
-    char        line_buff[MAX_LINE_LENGTH] = {0};
-    std::string nline;
+    char                     line_buff[MAX_LINE_LENGTH] = {0};
+    std::string              nline;
+    std::vector<std::string> orig_line;        // lines read (only until tokenized)
 
     while (!ferror(fp) && fgets(line_buff, sizeof(line_buff) - 1, fp) != nullptr)
     {
@@ -3837,9 +4630,9 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
     fclose(fp);
 
     // do preliminary processing on input file to make it more regular WRT whitespace and removing comments
-    std::vector<std::string> cooked_tokens;
-    std::string              token;
-    uint32_t                 ln = 0;
+    std::vector<string_pool_t::id_t> cooked_tokens;
+    std::string                      token;
+    uint32_t                         ln = 0;
     for (std::vector<std::string>::iterator it = orig_line.begin(); it != orig_line.end(); ++it, ln++)
     {
         char inquotes   = 0;
@@ -3848,6 +4641,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
 
         cooked_tokens.clear();
         token.clear();
+        add_line(pool->store(*it), nullptr, 0);        // tokens appended below
 
         if (it->c_str()[0] != '#')
         {
@@ -3887,7 +4681,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
                         if (c != ':')
                         {
                             if (token.size())
-                                cooked_tokens.push_back(token);
+                                cooked_tokens.push_back(pool->intern(token));
                             token.clear();
                         }
                     }
@@ -3899,7 +4693,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
                         if (prev_c && strchr("!=<>&|*", prev_c) != nullptr)
                         {
                             char s[3] = {prev_c, c, '\0'};
-                            cooked_tokens.push_back(s);
+                            cooked_tokens.push_back(pool->intern(s));
                             prev_c = 0;
 
                             continue;
@@ -3907,7 +4701,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
 
                         if (token.size())
                         {
-                            cooked_tokens.push_back(token);
+                            cooked_tokens.push_back(pool->intern(token));
                             token.clear();
                         }
 
@@ -3927,7 +4721,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
                         if (!two_char)
                         {
                             char s[2] = {c, '\0'};
-                            cooked_tokens.push_back(s);
+                            cooked_tokens.push_back(pool->intern(s));
                             prev_c = 0;
                         }
                         else
@@ -3943,8 +4737,8 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
                     {
                         char s[2] = {c, '\0'};
                         if (token.size())
-                            cooked_tokens.push_back(token);
-                        cooked_tokens.push_back(s);
+                            cooked_tokens.push_back(pool->intern(token));
+                        cooked_tokens.push_back(pool->intern(s));
                         token.clear();
 
                         continue;
@@ -3961,7 +4755,7 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
                         {
                             inquotes = 0;
                             token += c;
-                            cooked_tokens.push_back(token);
+                            cooked_tokens.push_back(pool->intern(token));
                             token.clear();
 
                             continue;
@@ -3998,18 +4792,19 @@ int32_t xlasm::source_t::read_file(xlasm * xa, const std::string & n, const std:
         }
 
         if (token.size())
-            cooked_tokens.push_back(token);
+            cooked_tokens.push_back(pool->intern(token));
 
 #if 0
 		dprintf("" PR_D64 "=", cooked_tokens.size());
 		for (auto dit = cooked_tokens.begin(); dit != cooked_tokens.end(); ++dit)
 		{
-			dprintf("[%s] ", dit->c_str());
+			dprintf("[%s] ", pool->c_str(*dit));
 		}
 		dprintf("\n");
 #endif
 
-        src_line.push_back(cooked_tokens);
+        token_ids.insert(token_ids.end(), cooked_tokens.begin(), cooked_tokens.end());
+        lines.back().token_count = static_cast<uint32_t>(cooked_tokens.size());
     }
 
     return 0;
@@ -4019,10 +4814,10 @@ void xlasm::diag_showline()
 {
     if (!last_diag_file)
         return;
-    printf("%s:%d: %s\n",
-           last_diag_file->name.c_str(),
-           last_diag_line + last_diag_file->line_start,
-           last_diag_file->orig_line[last_diag_line].c_str());
+    outprintf("%s:%d: %s\n",
+              last_diag_file->name.c_str(),
+              last_diag_line + last_diag_file->line_start,
+              last_diag_file->orig_line(last_diag_line));
     fflush(stdout);
     last_diag_file = nullptr;
 }
@@ -4047,12 +4842,12 @@ void xlasm::error(const char * msg, ...)
 
     diag_flush();
 
-    printf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
-    printf(TERM_ERROR "ERROR: ");
+    outprintf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
+    outprintf(TERM_ERROR "ERROR: ");
     if (ctxt.macroexp_ptr)
-        printf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
-    vprintf(msg, ap);
-    printf(TERM_CLEAR "\n");
+        outprintf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
+    voutprintf(msg, ap);
+    outprintf(TERM_CLEAR "\n");
 
     va_end(ap);
 
@@ -4087,12 +4882,12 @@ void xlasm::warning(const char * msg, ...)
     diag_flush();
 
     if (ctxt.file)
-        printf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
-    printf(TERM_WARN "WARNING: ");
+        outprintf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
+    outprintf(TERM_WARN "WARNING: ");
     if (ctxt.macroexp_ptr)
-        printf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
-    vprintf(msg, ap);
-    printf(TERM_CLEAR "\n");
+        outprintf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
+    voutprintf(msg, ap);
+    outprintf(TERM_CLEAR "\n");
 
     va_end(ap);
 
@@ -4130,12 +4925,12 @@ void xlasm::notice(int32_t level, const char * msg, ...)
     diag_flush();
 
     if (ctxt.file)
-        printf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
-    printf("NOTE: ");
+        outprintf("%s:%d: ", ctxt.file->name.c_str(), ctxt.line + ctxt.file->line_start);
+    outprintf("NOTE: ");
     if (ctxt.macroexp_ptr)
-        printf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
-    vprintf(msg, ap);
-    printf("\n");
+        outprintf("[in MACRO \"%s\"] ", ctxt.macroexp_ptr->name.c_str());
+    voutprintf(msg, ap);
+    outprintf("\n");
 
     va_end(ap);
 
@@ -4265,6 +5060,7 @@ void xlasm::remove_sym(const char * name)
 {
     std::string n(name);
     symbols.erase(name);
+    reset_expr_slots();
 }
 
 void vstrprintf(std::string & str, const char * fmt, va_list va)
@@ -4298,25 +5094,49 @@ static void show_help()
     printf("\n");
     printf("-b      maximum bytes hex per listing line (8-64, default 8)\n");
     printf("-c      suppress listing inside false conditional (.LISTCOND false)\n");
+    printf("-C dir  cache directory, skip assembly if input files and options unchanged\n");
     printf("-d sym  define <sym>[=expression]\n");
     printf("-i      add default include search path (tried if include fails)\n");
+    printf("-j n    assemble in parallel with n threads (0 for one per core), each -o ends an assembly\n");
     printf("-k      no error-kill, continue assembly despite errors\n");
     printf("-l      request listing file (uses output name with .lst)\n");
     printf("-m      suppress macro expansion listing (.LISTMAC false)\n");
     printf("-n      suppress macro name in listing (.MACNAME false)\n");
-    printf("-o      output file name (using extension format .c/.h or binary)\n");
+    printf("-o      output file name (using extension format .c/.h, .cz compressed, .cro relocatable or binary)\n");
+    printf("-O      optimize copper code (remove redundant instructions, merge MOVE pairs)\n");
     printf("-q      quiet operation\n");
+    printf("-t      copper cycle counts in listing and scanline timing report\n");
     printf("-v      verbose operation (repeat up to three times)\n");
     printf("-x      add symbol cross-reference to end of listing file\n");
+    printf("--simulate[=n]  simulate n copper frames (default 1), XR write trace to output name with .trace\n");
     printf("\n");
 }
 
+// input files, output file and options for one assembly (with -j option)
+struct job_t
+{
+    std::vector<std::string> source_files;
+    std::string              object_file;
+    xlasm::opts_t            opts;
+};
+
 int main(int argc, char ** argv)
 {
     std::string              archname;
     std::vector<std::string> source_files;
     std::string              object_file;
     xlasm::opts_t            opts;
+    xlasm::opts_t            common_opts;            // options before first input file (with -j option)
+    std::vector<job_t>       jobs;                   // assemblies to run in parallel (with -j option)
+    bool                     parallel    = false;    // -j option used
+    uint32_t                 num_threads = 0;        // threads for -j option (0 for one per core)
+
+    // with -j each -o ends an assembly of the input files and options since the previous one
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-' && argv[i][1] == 'j')
+            parallel = true;
+    }
 
     for (int i = 1; i < argc; i++)
     {
@@ -4359,6 +5179,21 @@ int main(int argc, char ** argv)
                     opts.suppress_false_conditionals = true;
                     break;
 
+                case 'C':
+                    if (argv[i][2] != 0)
+                    {
+                        opts.cache_dir = &argv[i][2];
+                    }
+                    else if (i + 1 < argc)
+                    {
+                        opts.cache_dir = argv[++i];
+                    }
+                    else
+                    {
+                        fatal_error("Expected directory after -C cache option");
+                    }
+                    break;
+
                 case 'd':
                     if (argv[i][2] != 0)
                     {
@@ -4394,6 +5229,23 @@ int main(int argc, char ** argv)
                     show_help();
                     exit(EXIT_SUCCESS);
                 }
+                case 'j':
+                    if (argv[i][2] != 0)
+                    {
+                        if (sscanf(&argv[i][2], "%u", &num_threads) != 1)
+                            fatal_error("Expected number after -j parallel threads option (0 for one per core)");
+                    }
+                    else if (i + 1 < argc)
+                    {
+                        if (sscanf(argv[++i], "%u", &num_threads) != 1)
+                            fatal_error("Expected number after -j parallel threads option (0 for one per core)");
+                    }
+                    else
+                    {
+                        fatal_error("Expected number after -j parallel threads option (0 for one per core)");
+                    }
+                    break;
+
                 case 'm':
                     opts.suppress_macro_expansion = true;
                     break;
@@ -4423,12 +5275,32 @@ int main(int argc, char ** argv)
                     {
                         fatal_error("Expected filename after -o output file option");
                     }
+
+                    if (parallel)
+                    {
+                        if (!source_files.size())
+                            fatal_error("No input file(s) specified for -o \"%s\"", object_file.c_str());
+
+                        job_t job = {source_files, object_file, opts};
+                        jobs.push_back(job);
+                        source_files.clear();
+                        object_file.clear();
+                        opts = common_opts;
+                    }
+                    break;
+
+                case 'O':
+                    opts.optimize = true;
                     break;
 
                 case 'q':
                     opts.verbose = 0;
                     break;
 
+                case 't':
+                    opts.cycle_report = true;
+                    break;
+
                 case 'v':
                     opts.verbose++;
                     break;
@@ -4437,6 +5309,23 @@ int main(int argc, char ** argv)
                     opts.xref = true;
                     break;
 
+                case '-':
+                    if (strcmp(argv[i], "--simulate") == 0)
+                    {
+                        opts.simulate_frames = 1;
+                    }
+                    else if (strncmp(argv[i], "--simulate=", 11) == 0)
+                    {
+                        if (sscanf(&argv[i][11], "%u", &opts.simulate_frames) != 1 || opts.simulate_frames == 0)
+                            fatal_error("Expected number of frames after --simulate= option");
+                    }
+                    else
+                    {
+                        show_help();
+                        fatal_error("Unrecognized option %s", argv[i]);
+                    }
+                    break;
+
                 default:
                     show_help();
                     fatal_error("Unrecognized option -%c", argv[i][1]);
@@ -4445,9 +5334,18 @@ int main(int argc, char ** argv)
 
             continue;
         }
+        if (parallel && !jobs.size() && !source_files.size())
+            common_opts = opts;
         source_files.push_back(std::string(argv[i]));
     }
 
+    if (parallel && source_files.size())
+    {
+        job_t job = {source_files, object_file, opts};
+        jobs.push_back(job);
+        source_files.clear();
+    }
+
     if (opts.verbose > 1)
     {
         if (opts.verbose == 2)
@@ -4475,17 +5373,87 @@ int main(int argc, char ** argv)
         fatal_error("Unrecognized architecture \"%s\".", archname.c_str());
     }
 
-    if (!source_files.size())
+    if (!source_files.size() && !jobs.size())
     {
         show_help();
         fatal_error("No input file(s) specified");
     }
 
-    xlasm xl(archname);
+    if (!parallel)
+    {
+        xlasm xl(archname);
 
-    int rc = xl.assemble(source_files, object_file, opts);
+        int rc = xl.assemble(source_files, object_file, opts);
 
-    return rc;
+        return rc;
+    }
+
+    // parallel assembly, each thread takes the next job and uses its own architecture instance
+    if (num_threads == 0)
+        num_threads = std::max(1U, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, static_cast<uint32_t>(jobs.size()));
+
+    xlasm::shared_files_t    shared_files;
+    std::vector<int>         results(jobs.size(), EXIT_FAILURE);
+    std::vector<std::string> outputs(jobs.size());
+    std::atomic<size_t>      next_job(0);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&]() {
+            size_t j;
+            while ((j = next_job++) < jobs.size())
+            {
+                job_output = &outputs[j];
+                try
+                {
+                    copper jobarch;
+                    xlasm  xl(archname);
+                    xl.shared_files = &shared_files;
+                    results[j]      = xl.assemble(jobs[j].source_files, jobs[j].object_file, jobs[j].opts);
+                }
+                catch (const job_exit_t & e)
+                {
+                    results[j] = e.code;
+                }
+                job_output = nullptr;
+            }
+        });
+    }
+    for (auto & t : threads)
+        t.join();
+
+    // print job output in job order (same as assembling them one at a time)
+    for (auto & output : outputs)
+        fputs(output.c_str(), stdout);
+
+    size_t num_files = 0;
+    for (auto it = shared_files.files.begin(); it != shared_files.files.end(); ++it)
+    {
+        if (it->second->error == 0)
+            num_files++;
+    }
+
+    int num_failed = 0;
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        if (results[j] != EXIT_SUCCESS)
+        {
+            const job_t & job = jobs[j];
+            printf("*** copasm FAILED assembling \"%s\"\n",
+                   job.object_file.size() ? job.object_file.c_str() : job.source_files[0].c_str());
+            num_failed++;
+        }
+    }
+    printf("copasm %s " PR_DSIZET " assembl%s with %u thread%s (" PR_DSIZET " files read)\n",
+           num_failed ? "FAILED" : "completed",
+           jobs.size(),
+           jobs.size() == 1 ? "y" : "ies",
+           num_threads,
+           num_threads == 1 ? "" : "s",
+           num_files);
+
+    return num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 // EOF
@@ -4,14 +4,21 @@
 
 #include <cinttypes>
 #include <cstdarg>
+#include <cstring>
+#include <deque>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <stack>
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "xlasmmap.h"
+
 // Miyu was here (virtually) -> :3
 
 #define PR_D64     "%" PRId64
@@ -39,7 +46,7 @@
 #define dprintf(x, ...)                                                                                                \
     if (opt.verbose)                                                                                                   \
     {                                                                                                                  \
-        printf(x, ##__VA_ARGS__);                                                                                      \
+        outprintf(x, ##__VA_ARGS__);                                                                                   \
         fflush(stdout);                                                                                                \
     }                                                                                                                  \
     while (0)
@@ -50,6 +57,9 @@
 #define UNICODE_SUPPORT 0
 
 [[noreturn]] void fatal_error(const char * msg, ...) ATTRIBUTE((noreturn)) ATTRIBUTE((format(printf, 1, 2)));
+[[noreturn]] void fatal_exit(int code) ATTRIBUTE((noreturn));
+int               outprintf(const char * fmt, ...) ATTRIBUTE((format(printf, 1, 2)));
+int               voutprintf(const char * fmt, va_list va) ATTRIBUTE((format(printf, 1, 0)));
 void              vstrprintf(std::string & str, const char * fmt, va_list va) ATTRIBUTE((format(printf, 2, 0)));
 void              strprintf(std::string & str, const char * fmt, ...) ATTRIBUTE((format(printf, 2, 3)));
 char              uppercase(char v);
@@ -73,6 +83,7 @@ struct xlasm
         int32_t                  verbose;        // 0, 1, 2 or 3
         std::vector<std::string> include_path;
         std::vector<std::string> define_sym;        // unmolested original line (with no newline)
+        std::string              cache_dir;         // assembly cache directory (empty for no cache)
         uint32_t                 listing_bytes;
         uint64_t                 load_address;
         bool                     listing;
@@ -82,6 +93,9 @@ struct xlasm
         bool                     suppress_macro_expansion;
         bool                     suppress_macro_name;
         bool                     suppress_line_numbers;
+        bool                     cycle_report;        // cycle column in listing and timing report (-t)
+        bool                     optimize;            // peephole optimize code between passes (-O)
+        uint32_t                 simulate_frames;     // frames to simulate with XR write trace (--simulate)
 
         opts_t() noexcept
                 : verbose(1)
@@ -94,27 +108,261 @@ struct xlasm
                 , suppress_macro_expansion(false)
                 , suppress_macro_name(false)
                 , suppress_line_numbers(false)
+                , cycle_report(false)
+                , optimize(false)
+                , simulate_frames(0)
+        {
+        }
+    };
+
+    // interned strings (source tokens and lines), each distinct string stored once in arena blocks
+    struct string_pool_t
+    {
+        typedef uint32_t id_t;
+
+        enum
+        {
+            ARENA_BLOCK_SIZE = 256 * 1024,        // arena block size (longer strings get their own block)
+            INITIAL_SLOTS    = 4096,              // initial hash slots (power of two, kept at most half full)
+            EMPTY_ID         = 0                  // id of empty string
+        };
+
+        string_pool_t();
+
+        id_t intern(const char * str, size_t len);        // id of string (same id for same string)
+        id_t intern(const char * str)
+        {
+            return intern(str, strlen(str));
+        }
+        id_t intern(const std::string & str)
+        {
+            return intern(str.data(), str.size());
+        }
+        id_t store(const char * str, size_t len);        // new id for string (not shared, e.g. source lines)
+        id_t store(const std::string & str)
+        {
+            return store(str.data(), str.size());
+        }
+
+        const char * c_str(id_t id) const
+        {
+            return entries[id].str;
+        }
+        name_key_t key(id_t id) const        // interned string with hash (for name_map_t)
+        {
+            name_key_t k = {entries[id].str, entries[id].len, entries[id].hash};
+            return k;
+        }
+        id_t keyword(id_t id) const        // uppercase without leading '.' (for directive, macro and opcode lookup)
+        {
+            return entries[id].keyword;
+        }
+        uint32_t length(id_t id) const
+        {
+            return entries[id].len;
+        }
+        void assign(std::string & dest, id_t id) const
+        {
+            dest.assign(entries[id].str, entries[id].len);
+        }
+
+        size_t count() const
+        {
+            return entries.size();
+        }
+        size_t arena_bytes() const
+        {
+            return arena_used;
+        }
+
+    private:
+        struct entry_t
+        {
+            const char * str;        // NUL terminated string in arena
+            uint32_t     len;
+            uint32_t     hash;
+            id_t         keyword;        // id of keyword form (computed when interned)
+        };
+
+        std::vector<entry_t>                 entries;        // strings by id
+        std::vector<id_t>                    slots;          // open addressing hash of interned ids (0 is empty)
+        std::vector<std::unique_ptr<char[]>> blocks;         // arena memory
+        char *                               arena_next;
+        size_t                               arena_free;
+        size_t                               arena_used;
+        size_t                               interned;
+
+        const char * arena_copy(const char * str, size_t len);
+        void         grow_slots();
+    };
+
+    // token or expression text used in place (not copied, NUL terminated), e.g. a token in a string_pool_t
+    struct token_t
+    {
+        const char * text;
+        uint32_t     len;
+
+        const char * c_str() const
+        {
+            return text;
+        }
+        size_t size() const
+        {
+            return len;
+        }
+        char operator[](size_t i) const        // text[len] is NUL
+        {
+            return text[i];
+        }
+        char back() const
+        {
+            return text[len - 1];
+        }
+        std::string str() const
+        {
+            return std::string(text, len);
+        }
+        bool operator==(const char * s) const
+        {
+            return strcmp(text, s) == 0;
+        }
+        bool operator!=(const char * s) const
+        {
+            return strcmp(text, s) != 0;
+        }
+        bool operator==(const std::string & s) const
+        {
+            return len == s.size() && memcmp(text, s.data(), len) == 0;
+        }
+    };
+
+    // tokens of a source line (string pool ids of the line, used in place each pass)
+    struct token_list_t
+    {
+        struct const_iterator
+        {
+            const string_pool_t *       pool;
+            const string_pool_t::id_t * id;
+
+            token_t operator*() const
+            {
+                token_t t = {pool->c_str(*id), pool->length(*id)};
+                return t;
+            }
+            const_iterator & operator++()
+            {
+                ++id;
+                return *this;
+            }
+            const_iterator operator+(size_t n) const
+            {
+                const_iterator it = {pool, id + n};
+                return it;
+            }
+            bool operator==(const const_iterator & o) const
+            {
+                return id == o.id;
+            }
+            bool operator!=(const const_iterator & o) const
+            {
+                return id != o.id;
+            }
+        };
+
+        const string_pool_t *       pool;
+        const string_pool_t::id_t * ids;
+        size_t                      count;
+
+        size_t size() const
+        {
+            return count;
+        }
+        token_t operator[](size_t i) const
+        {
+            token_t t = {pool->c_str(ids[i]), pool->length(ids[i])};
+            return t;
+        }
+        name_key_t key(size_t i) const        // token with hash (for name_map_t)
+        {
+            return pool->key(ids[i]);
+        }
+        const_iterator begin() const
+        {
+            const_iterator it = {pool, ids};
+            return it;
+        }
+        const_iterator end() const
         {
+            const_iterator it = {pool, ids + count};
+            return it;
         }
     };
 
     struct source_t
     {
-        std::string                           name;
-        std::vector<std::string>              orig_line;        // unmolested original line (with no newline)
-        std::vector<std::vector<std::string>> src_line;         // broken up into vector of tokens per line
-        uint64_t                              file_size;
-        uint32_t                              line_start;
+        struct line_t
+        {
+            string_pool_t::id_t orig;               // unmolested original line (with no newline)
+            uint32_t            token_start;        // index of first token in token_ids
+            uint32_t            token_count;        // number of tokens in line
+        };
+
+        std::string                      name;
+        string_pool_t *                  pool;
+        std::vector<line_t>              lines;
+        std::vector<string_pool_t::id_t> token_ids;        // tokens of all lines (line_t spans)
+        uint64_t                         file_size;
+        uint32_t                         line_start;
 
         source_t() noexcept
-                : file_size(0)
+                : pool(nullptr)
+                , file_size(0)
                 , line_start(1)
         {
         }
         int32_t read_file(xlasm *, const std::string & n, const std::string & fn);
+        int32_t load_file(xlasm *, const std::string & n, const std::string & fn, bool * found);
+
+        size_t line_count() const
+        {
+            return lines.size();
+        }
+        const char * orig_line(uint32_t l) const
+        {
+            return l < lines.size() ? pool->c_str(lines[l].orig) : "";
+        }
+        uint32_t orig_length(uint32_t l) const
+        {
+            return l < lines.size() ? pool->length(lines[l].orig) : 0;
+        }
+        const string_pool_t::id_t * line_tokens(uint32_t l) const
+        {
+            return token_ids.data() + lines[l].token_start;
+        }
+        void add_line(string_pool_t::id_t orig, const string_pool_t::id_t * toks, size_t count);
+        token_list_t tokens(uint32_t l) const        // line tokens (in place, not copied)
+        {
+            token_list_t t = {pool, token_ids.data() + lines[l].token_start, lines[l].token_count};
+            return t;
+        }
     };
     typedef std::unordered_map<std::string, source_t> source_map_t;
 
+    // source files tokenized once for all parallel assemblies (-j option), read-only once loaded
+    struct shared_files_t
+    {
+        struct file_t
+        {
+            string_pool_t strings;        // tokens and lines of this file
+            source_t      source;
+            int32_t       error;          // errno reading file (0 if read)
+            bool          found;          // file opened (for cache dependencies)
+        };
+
+        std::mutex                                               mutex;
+        std::unordered_map<std::string, std::unique_ptr<file_t>> files;        // by path read
+    };
+
     struct symbol_t;
 
     struct section_t
@@ -198,9 +446,56 @@ struct xlasm
             return symbol_t_abbrev[static_cast<size_t>(type)];
         }
     };
-    typedef std::unordered_map<std::string, symbol_t> symbol_map_t;
+    typedef name_map_t<symbol_t> symbol_map_t;
+
+    // file opened (or tried) while assembling, checked to see if cached assembly output is still valid
+    struct cache_dep_t
+    {
+        std::string path;
+        bool        found;        // false if open failed (and file must still not exist)
+    };
+    typedef std::vector<cache_dep_t> cache_dep_list_t;
     typedef std::vector<std::string>                  export_list_t;
 
+    // operand expression compiled to postfix code (see expression::compile), symbols are resolved via expr_slots
+    struct expr_code_t
+    {
+        enum op_code
+        {
+            PUSH_VALUE,         // push value
+            PUSH_SYMBOL,        // push value of symbol in expr_slots[arg]
+            APPLY_OP            // apply expression operator index arg to top of stack
+        };
+
+        struct insn_t
+        {
+            op_code  code;
+            uint32_t arg;
+            int64_t  value;
+        };
+
+        std::string         text;               // expression source text
+        std::vector<insn_t> insns;              // postfix code (constant subexpressions folded)
+        size_t              last_offset;        // characters of text used by expression
+        bool                dollar_hex;         // dollar_hex() setting when compiled
+
+        expr_code_t() noexcept
+                : last_offset(0)
+                , dollar_hex(false)
+        {
+        }
+    };
+    typedef std::vector<std::vector<expr_code_t>> expr_cache_t;
+
+    struct expr_slot_t
+    {
+        std::string name;
+        symbol_t *  sym;        // resolved symbol (reset when symbols are erased)
+    };
+    typedef std::vector<expr_slot_t>                     expr_slot_list_t;
+    typedef name_map_t<uint32_t>                         expr_slot_map_t;
+    typedef std::unordered_map<std::string, expr_code_t> expr_string_map_t;
+
     struct condition_t
     {
         uint8_t state : 1;
@@ -228,7 +523,7 @@ struct xlasm
         {
         }
     };
-    typedef std::unordered_map<std::string, macro_t> macro_map_t;
+    typedef name_map_t<macro_t> macro_map_t;
 
     struct context_t
     {
@@ -269,6 +564,7 @@ struct xlasm
         MAXMACRO_STACK       = 1024,          // nested macro depth
         MAXMACROREPS_WARNING = 255,           // max parameters replacement iterations per line
         MAXFILL_BYTES        = 0xC00L,        // max size output by space or fill directive (safety check)
+        RELOCATE_DELTA       = 0x40,          // words origin is moved to find relocations (.cro output)
         MAX_PASSES           = 10             // maximum number of assembler passes before optimization short-circuited
     };
 
@@ -316,8 +612,9 @@ struct xlasm
     };
 
     typedef std::stack<context_t>                     context_stack_t;
-    typedef std::unordered_map<std::string, uint32_t> directive_map_t;
-    typedef std::unordered_map<uint32_t, uint32_t>    hint_map_t;
+    typedef name_map_t<uint32_t>                   directive_map_t;
+    typedef std::unordered_map<uint32_t, uint32_t> hint_map_t;
+    typedef std::unordered_set<int64_t>            value_set_t;
 
     static constexpr directive_t directives_list[] = {{"INCLUDE", DIR_INCLUDE},   {"INCBIN", DIR_INCBIN},
                                                       {"ORG", DIR_ORG},           {"EQU", DIR_EQU},
@@ -348,20 +645,30 @@ struct xlasm
     context_stack_t        context_stack;          // context stack for include files and macros
     section_map_t          sections;               // output sections
     source_map_t           source_files;           // map of source files (tokenized at read time)
+    shared_files_t *       shared_files;           // files shared with parallel assemblies (-j option)
     macro_map_t            macros;                 // defined macros
     source_map_t           expanded_macros;        // source fragments from expanded macros
     symbol_map_t           symbols;                // labels and other symbols
+    string_pool_t          strings;                // interned source tokens and lines
+    expr_cache_t           expr_cache;             // compiled operand expressions per virtual line
+    expr_slot_list_t       expr_slots;             // symbols referenced by compiled expressions
+    expr_slot_map_t        expr_slot_index;        // symbol name to expr_slots index
+    expr_string_map_t      expr_strings;           // compiled string symbol expressions
     export_list_t          exports;
     condition_stack_t      condition_stack;         // stack for conditional assembly
     directive_map_t        directives;              // fast lookup of directives
     hint_map_t             line_hint;               // "hint" for this virtual-line (for squeeze pass)
+    value_set_t            label_refs;              // exported/used label values, except branch targets (-O)
     std::list<std::string> input_names;             // list of input filenames (assembled into one output)
     std::string            object_filename;         // output filename
     std::string            listing_filename;        // listing filename
+    std::string            trace_filename;          // simulation trace filename (--simulate)
+    cache_dep_list_t       cache_deps;              // files opened (or tried) while assembling
     std::list<std::string> pre_messages;
     std::list<std::string> post_messages;
     std::mt19937_64        rng;
 
+
     int64_t     total_size_generated;
     int64_t     last_size_generated;
     int64_t     bytes_optimized;
@@ -388,12 +695,17 @@ struct xlasm
     uint32_t    prev_virtual_line_num;
     uint32_t    pass_count;
     uint32_t    last_diag_line;
+    uint32_t    expr_line_index;        // next expr_cache entry for current virtual line
+    int32_t     line_cycles;            // cycles for instruction on current line (-1 if none, for -t listing)
+    int32_t     line_cycles_sum;        // cycles since last wait instruction (for -t listing)
 
     bool line_sec_org;
     bool suppress_line_list;
     bool suppress_line_listsource;
     bool force_end_file;
     bool force_exit_assembly;
+    bool relocating;               // assembling with origin moved to find relocations (.cro output)
+    bool label_refs_branch;        // evaluating branch target (not added to label_refs)
 
     std::random_device::result_type random_seed;
 
@@ -403,6 +715,11 @@ struct xlasm
     // external interface, gathers input and options
     int32_t assemble(const std::vector<std::string> & in_files, const std::string & out_file, const opts_t & opts);
 
+    // assembly cache (-C option)
+    std::string cache_entry_name(const std::vector<std::string> & in_files);        // cache file for input and options
+    bool        cache_restore(const std::string & entry);                           // write output if entry still valid
+    void        cache_save(const std::string & entry);                              // save output and files used
+
     // internal functions
     int32_t do_passes();        // read input files into memory, iterate over files for all assembler passes
     int32_t process_file(source_t & f);        // iterate over source lines in a source_t
@@ -410,36 +727,37 @@ struct xlasm
     int32_t process_line_listing();
     int32_t process_xref();
     int32_t process_output();
+    void    find_relocations(section_t & sec, std::vector<uint16_t> & relocs);        // word offsets holding addresses
     int32_t process_labeldef(std::string label);        // define a "normal" label (i.e., set to current output address)
-    int32_t process_directive(uint32_t                         idx,
-                              const std::string &              directive,
-                              const std::string &              label,
-                              size_t                           cur_token,
-                              const std::vector<std::string> & tokens);
+    int32_t process_directive(uint32_t             idx,
+                              const std::string &  directive,
+                              const std::string &  label,
+                              size_t               cur_token,
+                              const token_list_t & tokens);
 
-    int32_t process_section(const std::string &              directive,
-                            const std::string &              label,
-                            size_t                           cur_token,
-                            const std::vector<std::string> & tokens);
+    int32_t process_section(const std::string &  directive,
+                            const std::string &  label,
+                            size_t               cur_token,
+                            const token_list_t & tokens);
 
     // helper functions
     int32_t     pass_reset();
     int32_t     check_undefined();
-    bool        define_macro_begin(const std::string &              directive,
-                                   const std::string &              label,
-                                   size_t                           cur_token,
-                                   const std::vector<std::string> & tokens);
-    bool        define_macro_end(const std::string &              directive,
-                                 const std::string &              label,
-                                 size_t                           cur_token,
-                                 const std::vector<std::string> & tokens);
-    source_t &  expand_macro(std::string & name, size_t cur_token, const std::vector<std::string> & tokens);
-    int64_t     eval_tokens(const std::string &              cmd,
-                            std::string &                    exprstr,
-                            size_t &                         cur_token,
-                            const std::vector<std::string> & tokens,
-                            int32_t                          expected_args,
-                            int64_t                          defval);
+    bool        define_macro_begin(const std::string &  directive,
+                                   const std::string &  label,
+                                   size_t               cur_token,
+                                   const token_list_t & tokens);
+    bool        define_macro_end(const std::string &  directive,
+                                 const std::string &  label,
+                                 size_t               cur_token,
+                                 const token_list_t & tokens);
+    source_t &  expand_macro(std::string & name, size_t cur_token, const token_list_t & tokens);
+    int64_t     eval_tokens(const std::string &  cmd,
+                            std::string &        exprstr,
+                            size_t &             cur_token,
+                            const token_list_t & tokens,
+                            int32_t              expected_args,
+                            int64_t              defval);
     bool        check_truncation(const std::string & cmd, int64_t v, uint32_t b, int32_t errwarnflag = 1);
     bool        check_truncation_signed(const std::string & cmd, int64_t v, uint32_t b, int32_t errwarnflag = 1);
     bool        check_truncation_unsigned(const std::string & cmd, int64_t v, uint32_t b, int32_t errwarnflag = 1);
@@ -462,20 +780,34 @@ struct xlasm
     void        error(const char * msg, ...) ATTRIBUTE((format(printf, 2, 3)));
     void        warning(const char * msg, ...) ATTRIBUTE((format(printf, 2, 3)));
     void        notice(int32_t level, const char * msg, ...) ATTRIBUTE((format(printf, 3, 4)));
-    std::string token_message(size_t cur_token, const std::vector<std::string> & tokens);
+    std::string token_message(size_t cur_token, const token_list_t & tokens);
     bool        dollar_hex();
+    bool        eval_expr(const token_t & exprstr, int64_t * result, size_t * last_offset = nullptr);
+    bool        eval_expr(const std::string & exprstr, int64_t * result, size_t * last_offset = nullptr)
+    {
+        token_t expr = {exprstr.c_str(), static_cast<uint32_t>(exprstr.size())};
+        return eval_expr(expr, result, last_offset);
+    }
+    bool        eval_code(expr_code_t & code, const token_t & exprstr, int64_t * result, size_t * last_offset = nullptr);
+    uint32_t    expr_symbol_slot(const char * name);
+    int64_t     expr_slot_value(uint32_t slot, bool * undefined);
+    void        reset_expr_slots();
 
     static int64_t symbol_value(xlasm *      xl,
                                 const char * name,
                                 bool *       allow_undefined = nullptr);        // expression evaluation symbol lookup
+    static int64_t symbol_value(xlasm *             xl,
+                                symbol_t &          sym,
+                                const std::string & sym_name,
+                                bool *              allow_undefined);        // value of symbol already looked up
 };
 
 // Interface to architecture specific code
 struct Ixlarch
 {
-    static std::vector<Ixlarch *> architectures;
-    static void                   register_arch(Ixlarch *);
-    static Ixlarch *              find_arch(const std::string & architecture);
+    static thread_local std::vector<Ixlarch *> architectures;        // per thread (for parallel assembly)
+    static void                                register_arch(Ixlarch *);
+    static Ixlarch *                           find_arch(const std::string & architecture);
 
     virtual ~Ixlarch();
     virtual const char *      variant_names() = 0;        // list of possible variant names for this architecture
@@ -486,20 +818,20 @@ struct Ixlarch
     virtual void              deactivate(
                      xlasm * xl) = 0;        // clear architecture symbols (when switching to another architecture)
     virtual uint32_t check_directive(
-        const std::string & directive) = 0;        // return directive index or xlasm::DIR_UNKNOWN if not recognized
-    virtual int32_t process_directive(xlasm *                          xl,
-                                      uint32_t                         idx,
-                                      const std::string &              directive,
-                                      const std::string &              label,
-                                      size_t                           cur_token,
-                                      const std::vector<std::string> & tokens) = 0;
+        const name_key_t & directive) = 0;        // return directive index or xlasm::DIR_UNKNOWN if not recognized
+    virtual int32_t process_directive(xlasm *                     xl,
+                                      uint32_t                    idx,
+                                      const std::string &         directive,
+                                      const std::string &         label,
+                                      size_t                      cur_token,
+                                      const xlasm::token_list_t & tokens) = 0;
     virtual int32_t lookup_register(const std::string & name)                  = 0;
-    virtual int32_t check_opcode(const std::string & opcode) = 0;        // return opcode index or -1 if not recognized
-    virtual int32_t process_opcode(xlasm *                          xl,
-                                   int32_t                          idx,
-                                   std::string &                    opcode,
-                                   size_t                           cur_token,
-                                   const std::vector<std::string> & tokens) = 0;
+    virtual int32_t check_opcode(const name_key_t & opcode) = 0;        // return opcode index or -1 if not recognized
+    virtual int32_t process_opcode(xlasm *                     xl,
+                                   int32_t                     idx,
+                                   std::string &               opcode,
+                                   size_t                      cur_token,
+                                   const xlasm::token_list_t & tokens) = 0;
 
     virtual bool is_big_endian()
     {
@@ -526,6 +858,24 @@ struct Ixlarch
         (void)size;
         return 1;
     }        // byte boundary for data type size bytes (1-16, POT)
+    virtual void cycle_report(xlasm * xl)
+    {
+        (void)xl;
+    }        // report instruction timing after final pass (-t option)
+    virtual bool optimize_pass(xlasm * xl)
+    {
+        (void)xl;
+        return false;
+    }        // optimize code using previous pass (-O option), true if code changed
+    virtual void optimize_report(xlasm * xl)
+    {
+        (void)xl;
+    }        // report optimizations after final pass (-O option)
+    virtual void simulate(xlasm * xl, FILE * trace_file)
+    {
+        (void)xl;
+        (void)trace_file;
+    }        // run program and trace XR writes after final pass (--simulate option)
 };
 
 
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <map>
 
 #include "xlasm.h"
 #include "xlasmcopper.h"
@@ -14,6 +15,8 @@ copper::directive_map_t copper::directives;
 copper::opcode_map_t    copper::opcodes;
 
 copper::copper() noexcept
+        : cycles_since_wait(0)
+        , peep_merge_pending(0)
 {
     register_arch(this);
 
@@ -62,6 +65,13 @@ const std::string copper::get_variant()
 
 void copper::reset(xlasm * xl)
 {
+    program.clear();
+    cycles_since_wait = 0;
+    peep_program.clear();
+    peep_protected.clear();
+    peep_undone.clear();
+    peep_merge_word1.clear();
+
     xl->sections["text"].load_addr = 0xC000;
     xl->sections["text"].addr      = 0xC000;
 
@@ -102,7 +112,7 @@ void copper::deactivate(xlasm * xl)
 }
 
 // return directive_index or xlasm::DIR_UNKNOWN if not recognized
-uint32_t copper::check_directive(const std::string & directive)
+uint32_t copper::check_directive(const name_key_t & directive)
 {
     uint32_t index = xlasm::DIR_UNKNOWN;
     auto     it    = directives.find(directive);
@@ -115,12 +125,12 @@ uint32_t copper::check_directive(const std::string & directive)
     return index;
 }
 
-int32_t copper::process_directive(xlasm *                          xl,
-                                  uint32_t                         idx,
-                                  const std::string &              directive,
-                                  const std::string &              label,
-                                  size_t                           cur_token,
-                                  const std::vector<std::string> & tokens)
+int32_t copper::process_directive(xlasm *                     xl,
+                                  uint32_t                    idx,
+                                  const std::string &         directive,
+                                  const std::string &         label,
+                                  size_t                      cur_token,
+                                  const xlasm::token_list_t & tokens)
 {
     (void)xl;
     (void)idx;
@@ -135,7 +145,7 @@ int32_t copper::process_directive(xlasm *                          xl,
 }
 
 // return opcode index or -1 if not recognized
-int32_t copper::check_opcode(const std::string & opcode)
+int32_t copper::check_opcode(const name_key_t & opcode)
 {
     int32_t index = -1;
     auto    it    = opcodes.find(opcode);
@@ -154,15 +164,12 @@ int32_t copper::lookup_register(const std::string & n)
     return -1;
 }
 
-int32_t copper::process_opcode(xlasm *                          xl,
-                               int32_t                          idx,
-                               std::string &                    opcode,
-                               size_t                           cur_token,
-                               const std::vector<std::string> & tokens)
+int32_t copper::process_opcode(xlasm *                     xl,
+                               int32_t                     idx,
+                               std::string &               opcode,
+                               size_t                      cur_token,
+                               const xlasm::token_list_t & tokens)
 {
-    // make keyword uppercase to stand out in error messages
-    std::transform(opcode.begin(), opcode.end(), opcode.begin(), uppercase);
-
     int64_t PC = xl->ctxt.section->addr + static_cast<int64_t>(xl->ctxt.section->data.size());
 
     if (PC & 1)
@@ -170,7 +177,7 @@ int32_t copper::process_opcode(xlasm *                          xl,
         xl->error("Copper code generated at odd address " PR_X64_04 "", PC);
     }
 
-    std::string operstr;
+    std::string operstr;        // operand of several tokens
 
     // dis-ambiguate opcode based on operands
 
@@ -181,7 +188,9 @@ int32_t copper::process_opcode(xlasm *                          xl,
     int64_t  result    = 0;
     int      oper_num  = 0;        // operands (not including opcode)
     bool     move_imm  = false;
-    operstr.clear();
+    int      oper_toks = 0;        // tokens in current operand
+
+    xlasm::token_t oper = {"", 0};        // current operand (a single token is used in place)
 
     for (auto it = tokens.begin() + static_cast<int>(cur_token);
          it != tokens.end() && oper_num < 2 && ops[idx].a[oper_num] != N;
@@ -189,19 +198,31 @@ int32_t copper::process_opcode(xlasm *                          xl,
     {
         result = 0;
 
-        if (*it != ",")
+        xlasm::token_t tok = *it;
+        if (tok != ",")
         {
             //			if (operstr.size())
             //				operstr += " ";
 
-            operstr += *it;
+            if (oper_toks++ == 0)
+            {
+                oper = tok;
+            }
+            else
+            {
+                if (oper_toks == 2)
+                    operstr.assign(oper.c_str(), oper.size());
+                operstr.append(tok.c_str(), tok.size());
+                oper.text = operstr.c_str();
+                oper.len  = static_cast<uint32_t>(operstr.size());
+            }
         }
 
-        if (*it == "," || it + 1 == tokens.end())
+        if (tok == "," || it + 1 == tokens.end())
         {
             operand operand_type = ops[idx].a[oper_num];
 
-            //            dprintf("oper[%d]=%s\n", oper_num, operstr.c_str());
+            //            dprintf("oper[%d]=%s\n", oper_num, oper.c_str());
 
             switch (operand_type)
             {
@@ -210,22 +231,19 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // copper HPOS/VPOS position
                 case IM11: {
-                    expression  expr;
-                    std::string exprstr;
-
-                    if (operstr[0] != '#')
+                    if (oper[0] != '#')
                     {
                         xl->error("Immediate operand expected for opcode %s (evaluating \"%s\")",
                                   opcode.c_str(),
-                                  operstr.c_str());
+                                  oper.c_str());
                         break;
                     }
-                    exprstr.assign(operstr.begin() + 1, operstr.end());
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    xlasm::token_t exprstr = {oper.text + 1, oper.len - 1};
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error("Immediate operand expected for opcode %s (evaluating \"%s\")",
                                   opcode.c_str(),
-                                  operstr.c_str());
+                                  oper.c_str());
                         break;
                     }
 
@@ -242,22 +260,19 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // SETI 2nd operand
                 case IM16: {
-                    expression  expr;
-                    std::string exprstr;
-
-                    if (operstr[0] != '#')
+                    if (oper[0] != '#')
                     {
                         xl->error("Immediate operand expected for opcode %s (evaluating \"%s\")",
                                   opcode.c_str(),
-                                  operstr.c_str());
+                                  oper.c_str());
                         break;
                     }
-                    exprstr.assign(operstr.begin() + 1, operstr.end());
+                    xlasm::token_t exprstr = {oper.text + 1, oper.len - 1};
 
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error(
-                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
 
@@ -274,22 +289,19 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // ADDI  operand
                 case NIM16: {
-                    expression  expr;
-                    std::string exprstr;
-
-                    if (operstr[0] != '#')
+                    if (oper[0] != '#')
                     {
                         xl->error("Immediate operand expected for opcode %s (evaluating \"%s\")",
                                   opcode.c_str(),
-                                  operstr.c_str());
+                                  oper.c_str());
                         break;
                     }
-                    exprstr.assign(operstr.begin() + 1, operstr.end());
+                    xlasm::token_t exprstr = {oper.text + 1, oper.len - 1};
 
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error(
-                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
 
@@ -306,11 +318,12 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // copper address
                 case CM: {
-                    expression  expr;
-                    std::string exprstr;
+                    const xlasm::token_t & exprstr = oper;
 
-                    exprstr.assign(operstr.begin(), operstr.end());
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    xl->label_refs_branch = idx == OP_BRGE || idx == OP_BRLT;
+                    bool ok               = exprstr.size() && xl->eval_expr(exprstr, &result);
+                    xl->label_refs_branch = false;
+                    if (!ok)
                     {
                         xl->error("copper address operand expected for opcode %s (evaluating \"%s\")",
                                   opcode.c_str(),
@@ -342,14 +355,12 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // SETI 1st operand
                 case XM14: {
-                    expression  expr;
-                    std::string exprstr;
-                    exprstr.assign(operstr);
+                    const xlasm::token_t & exprstr = oper;
 
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error(
-                            "address expected for instruction %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                            "address expected for instruction %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
                     if (xl->ctxt.pass == xlasm::context_t::PASS_2)
@@ -367,14 +378,12 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // SETM 2nd operand
                 case XM16: {
-                    expression  expr;
-                    std::string exprstr;
-                    exprstr.assign(operstr);
+                    const xlasm::token_t & exprstr = oper;
 
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error(
-                            "address expected for instruction %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                            "address expected for instruction %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
 
@@ -386,22 +395,18 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // MOVE 1nd operand
                 case MS: {
-                    expression  expr;
-                    std::string exprstr;
+                    xlasm::token_t exprstr = oper;
 
-                    if (operstr[0] == '#')
+                    if (oper[0] == '#')
                     {
                         move_imm = true;
-                        exprstr.assign(operstr.begin() + 1, operstr.end());
-                    }
-                    else
-                    {
-                        exprstr.assign(operstr);
+                        exprstr.text++;
+                        exprstr.len--;
                     }
 
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
-                        xl->error("Source expected for opcode %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                        xl->error("Source expected for opcode %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
 
@@ -445,15 +450,12 @@ int32_t copper::process_opcode(xlasm *                          xl,
 
                 // MOVE 1nd operand
                 case MD: {
-                    expression  expr;
-                    std::string exprstr;
+                    const xlasm::token_t & exprstr = oper;
 
-                    exprstr.assign(operstr);
-
-                    if (!exprstr.size() || !expr.evaluate(xl, exprstr.c_str(), &result))
+                    if (!exprstr.size() || !xl->eval_expr(exprstr, &result))
                     {
                         xl->error(
-                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), operstr.c_str());
+                            "Immediate expected for opcode %s (evaluating \"%s\")", opcode.c_str(), oper.c_str());
                         break;
                     }
 
@@ -487,7 +489,8 @@ int32_t copper::process_opcode(xlasm *                          xl,
                     break;
             }
 
-            operstr.clear();
+            oper      = {"", 0};
+            oper_toks = 0;
             oper_num++;
         }
     }
@@ -524,11 +527,1008 @@ int32_t copper::process_opcode(xlasm *                          xl,
         xl->error("Unexpected additional operand(s) for instruction %s", opcode.c_str());
     }
 
-    xl->emit(static_cast<uint16_t>((opval & opmask) | (word0_val & ~opmask)));
-    if (ops[idx].len == 2)
+    uint16_t word0 = static_cast<uint16_t>((opval & opmask) | (word0_val & ~opmask));
+    uint32_t len   = static_cast<uint32_t>(ops[idx].len);
+
+    // apply peephole optimization hint from previous pass (see optimize_pass) and record instruction
+    if (xl->opt.optimize)
+    {
+        uint32_t hint = PEEP_NONE;
+        auto     hit  = xl->line_hint.find(xl->virtual_line_num);
+        if (hit != xl->line_hint.end())
+            hint = hit->second;
+
+        if (hint == PEEP_MERGE)
+        {
+            peep_merge_pending = peep_merge_word1[xl->virtual_line_num];
+            word1_val          = peep_merge_pending;
+        }
+        else if (hint == PEEP_MERGED && xl->ctxt.pass == xlasm::context_t::PASS_2 && word1_val != peep_merge_pending)
+        {
+            xl->error("Optimized %s destination changed after merge into SETM (try without -O)", opcode.c_str());
+        }
+        if (hint != PEEP_NONE && hint != PEEP_MERGE)
+            len = 0;
+
+        const xlasm::symbol_t * lsym = xl->ctxt.section->last_defined_sym;
+
+        peep_insn_t insn;
+        insn.line = xl->virtual_line_num;
+        insn.addr =
+            static_cast<uint16_t>(xl->ctxt.section->addr + static_cast<int64_t>(xl->ctxt.section->data.size() >> 1));
+        insn.word0 = word0;
+        insn.word1 = word1_val;
+        insn.len   = len;
+        insn.entry = lsym && lsym->type == xlasm::symbol_t::LABEL && lsym->section == xl->ctxt.section &&
+                     lsym->value == insn.addr;
+        strprintf(insn.where, "%s:%d", xl->ctxt.file->name.c_str(), xl->ctxt.line + xl->ctxt.file->line_start);
+        peep_program.push_back(insn);
+    }
+
+    // record instruction cycles for listing column and timing report
+    if (xl->opt.cycle_report && xl->ctxt.pass == xlasm::context_t::PASS_2 && len != 0)
+    {
+        cop_insn_t insn;
+        insn.addr =
+            static_cast<uint16_t>(xl->ctxt.section->addr + static_cast<int64_t>(xl->ctxt.section->data.size() >> 1));
+        insn.word0 = word0;
+        insn.len   = static_cast<uint32_t>(ops[idx].len);
+        insn.cyc   = ops[idx].cyc;
+        strprintf(insn.where, "%s:%d", xl->ctxt.file->name.c_str(), xl->ctxt.line + xl->ctxt.file->line_start);
+        program.push_back(insn);
+
+        if ((word0 & 0x3000) == 0x2000)        // HPOS/VPOS starts new sequence
+            cycles_since_wait = 0;
+        cycles_since_wait += static_cast<int32_t>(insn.cyc);
+        xl->line_cycles     = static_cast<int32_t>(insn.cyc);
+        xl->line_cycles_sum = cycles_since_wait;
+    }
+
+    if (len != 0)
+    {
+        xl->emit(word0);
+    }
+    if (len == 2)
     {
         xl->emit(static_cast<uint16_t>(word1_val));
     }
 
     return 0;
 }
+
+// Copper cycle timing report
+//
+// Each HPOS/VPOS wait starts a sequence of instructions that runs until the next wait.  The worst case cycles for
+// each sequence (following both paths of BRGE/BRLT) is checked against the scanline and horizontal blank of the
+// video mode (MODE_848x480 if defined non-zero, otherwise MODE_640x480).  Wait positions come from the waits in
+// address order, so they are only a guide for code that branches.  Cycles are from ops[] and assume XR writes are
+// not delayed.  A sequence that continues past the end of the line (e.g., branching back after "HPOS #799") has
+// the extra cycles counted at the start of the next line, so it is only reported when it is longer than a line or
+// the extra cycles exceed the next line's horizontal blank.
+
+namespace
+{
+struct copper_mode_t
+{
+    const char * name;
+    uint32_t     width;          // visible pixels (HPOS from total_w - width)
+    uint32_t     height;         // visible lines (VPOS 0 to height - 1)
+    uint32_t     total_w;        // pixel clocks (copper cycles) per line
+    uint32_t     total_h;        // lines per frame
+};
+
+const copper_mode_t copper_modes[] = {{"MODE_640x480", 640, 480, 800, 525}, {"MODE_848x480", 848, 480, 1088, 517}};
+
+// video mode timing (MODE_848x480 if defined non-zero, otherwise MODE_640x480)
+const copper_mode_t * video_mode(xlasm * xl)
+{
+    if (xl->symbols.find("MODE_848x480") != xl->symbols.end() &&
+        xlasm::symbol_value(xl, "MODE_848x480", nullptr) != 0)
+    {
+        return &copper_modes[1];
+    }
+
+    return &copper_modes[0];
+}
+
+const int64_t CYCLES_LOOP     = -1;        // sequence has a loop (no worst case)
+const int64_t CYCLES_UNKNOWN  = -2;        // not yet calculated
+const int64_t CYCLES_VISITING = -3;        // being calculated (loop if seen again)
+}        // namespace
+
+// worst case cycles from program[i] until after next wait (or end of program)
+int64_t copper::sequence_cycles(std::vector<int64_t> & cycles, size_t i)
+{
+    if (cycles[i] == CYCLES_VISITING)
+        return CYCLES_LOOP;
+    if (cycles[i] != CYCLES_UNKNOWN)
+        return cycles[i];
+
+    const cop_insn_t & insn = program[i];
+    int64_t            c    = insn.cyc;
+
+    if ((insn.word0 & 0x3000) != 0x2000)        // not HPOS/VPOS
+    {
+        cycles[i] = CYCLES_VISITING;
+
+        int64_t worst = 0;
+        auto    next  = program_index.find(insn.addr + insn.len);
+        if (next != program_index.end())
+            worst = sequence_cycles(cycles, next->second);
+        if (worst != CYCLES_LOOP && (insn.word0 & 0x3000) == 0x3000)        // BRGE/BRLT
+        {
+            auto target = program_index.find(0xC000U | (insn.word0 & 0x7FFU));
+            if (target != program_index.end())
+            {
+                int64_t taken = sequence_cycles(cycles, target->second);
+                worst         = taken == CYCLES_LOOP ? CYCLES_LOOP : std::max(worst, taken);
+            }
+        }
+        c = worst == CYCLES_LOOP ? CYCLES_LOOP : c + worst;
+    }
+    cycles[i] = c;
+
+    return c;
+}
+
+void copper::cycle_report(xlasm * xl)
+{
+    if (program.empty())
+        return;
+
+    const copper_mode_t * mode   = video_mode(xl);
+    uint32_t              hblank = mode->total_w - mode->width;
+
+    program_index.clear();
+    for (size_t i = 0; i < program.size(); i++)
+        program_index[program[i].addr] = i;
+
+    std::vector<int64_t> cycles(program.size(), CYCLES_UNKNOWN);
+
+    struct line_cost_t
+    {
+        uint32_t sequences;
+        int64_t  cycles;
+        int64_t  blank_cycles;
+    };
+    std::map<int64_t, line_cost_t> lines;
+
+    std::string report;
+    uint32_t    num_sequences = 0;
+    uint32_t    num_blank     = 0;
+    uint32_t    num_overrun   = 0;
+    uint32_t    num_loop      = 0;
+    int64_t     worst         = 0;
+    int64_t     v             = 0;        // current line (-1 if unknown after VPOS past end of frame)
+
+    strprintf(report,
+              "\n\nCopper cycles per wait (%s, %u cycles per line, %u cycle horizontal blank):\n\n",
+              mode->name,
+              mode->total_w,
+              hblank);
+    strprintf(report, "Addr  Wait              Line  HPos  Cycles  Notes\n");
+
+    for (size_t i = 0; i <= program.size(); i++)
+    {
+        // program start at top of frame, then after each wait
+        int64_t     h         = 0;
+        bool        blit_wait = false;
+        std::string wait;
+        if (i == 0)
+        {
+            wait = "<start>";
+        }
+        else
+        {
+            const cop_insn_t & w = program[i - 1];
+            if ((w.word0 & 0x3000) != 0x2000)
+                continue;
+
+            uint32_t pos = w.word0 & 0x7FFU;
+            if ((w.word0 & 0x0800) && pos == 0x7FF)
+            {
+                wait      = "VPOS #V_WAITBLIT";
+                blit_wait = true;
+            }
+            else if (w.word0 & 0x0800)
+            {
+                strprintf(wait, "VPOS #%u", pos);
+                v = pos < mode->total_h ? static_cast<int64_t>(pos) : -1;
+            }
+            else
+            {
+                strprintf(wait, "HPOS #%u", pos);
+                if (pos < mode->total_w)
+                    h = pos;
+                else if (v >= 0)
+                    v = v + 1 < mode->total_h ? v + 1 : -1;
+            }
+        }
+
+        int64_t c = 0;
+        if (i < program.size())
+        {
+            auto next = program_index.find(i == 0 ? 0xC000U : program[i - 1].addr + program[i - 1].len);
+            if (next != program_index.end())
+                c = sequence_cycles(cycles, next->second);
+        }
+
+        std::string notes;
+        if (v < 0)
+        {
+            notes = "(end of frame)";
+            c     = 0;
+        }
+        else if (c == CYCLES_LOOP)
+        {
+            notes = "contains loop (cycles per pass not known)";
+            num_loop++;
+        }
+        else if (blit_wait)
+        {
+            notes = "after blitter wait (position not known)";
+            worst = std::max(worst, c);
+        }
+        else
+        {
+            bool visible_line = v < mode->height;
+            if (visible_line && h < hblank && h + c > hblank)
+            {
+                strprintf(notes, "exceeds horizontal blank by " PR_D64 " cycles", h + c - hblank);
+                num_blank++;
+            }
+            int64_t carry = 0;        // cycles continuing at start of next line
+            if (h + c > mode->total_w)
+            {
+                carry = h + c - mode->total_w;
+                if (c > mode->total_w)
+                {
+                    strprintf(notes,
+                              "%sruns into next line by " PR_D64 " cycles (longer than a line)",
+                              notes.size() ? ", " : "",
+                              carry);
+                    num_overrun++;
+                }
+                else if (v + 1 < mode->height && carry > hblank)
+                {
+                    strprintf(notes,
+                              "%sexceeds next line horizontal blank by " PR_D64 " cycles",
+                              notes.size() ? ", " : "",
+                              carry - hblank);
+                    num_blank++;
+                }
+                else
+                {
+                    strprintf(notes, "%scontinues " PR_D64 " cycles into next line", notes.size() ? ", " : "", carry);
+                }
+                if (v + 1 < mode->total_h)
+                {
+                    line_cost_t & next = lines[v + 1];
+                    next.cycles += carry;
+                    if (v + 1 < mode->height)
+                        next.blank_cycles += std::min<int64_t>(carry, hblank);
+                }
+            }
+
+            line_cost_t & lc = lines[v];
+            lc.sequences++;
+            lc.cycles += c - carry;
+            if (visible_line && h < hblank)
+                lc.blank_cycles += std::min<int64_t>(c, hblank - h);
+            worst = std::max(worst, c);
+        }
+        num_sequences++;
+
+        uint32_t    addr = i ? program[i - 1].addr : 0xC000U;
+        std::string line;
+        if (v < 0)
+            strprintf(line, "%04x  %-16s     -     -       -  %s", addr, wait.c_str(), notes.c_str());
+        else if (blit_wait)
+            strprintf(line, "%04x  %-16s     -     - %7" PRId64 "  %s", addr, wait.c_str(), c, notes.c_str());
+        else if (c == CYCLES_LOOP)
+            strprintf(line,
+                      "%04x  %-16s %5" PRId64 " %5" PRId64 "       ?  %s",
+                      addr,
+                      wait.c_str(),
+                      v,
+                      h,
+                      notes.c_str());
+        else
+            strprintf(line,
+                      "%04x  %-16s %5" PRId64 " %5" PRId64 " %7" PRId64 "  %s",
+                      addr,
+                      wait.c_str(),
+                      v,
+                      h,
+                      c,
+                      notes.c_str());
+
+        line.erase(line.find_last_not_of(' ') + 1);
+        report += line + "\n";
+    }
+
+    strprintf(report, "\n\nCopper cycles per scanline:\n\n");
+    strprintf(report, " Line  Waits  Cycles  HBlank\n");
+    for (auto it = lines.begin(); it != lines.end(); ++it)
+    {
+        if (it->first < mode->height)
+            strprintf(report,
+                      "%5" PRId64 "  %5u %7" PRId64 "  %3" PRId64 "/%u%s\n",
+                      it->first,
+                      it->second.sequences,
+                      it->second.cycles,
+                      it->second.blank_cycles,
+                      hblank,
+                      it->second.cycles > mode->total_w ? "  over line" : "");
+        else
+            strprintf(report,
+                      "%5" PRId64 "  %5u %7" PRId64 "  (vertical blank)%s\n",
+                      it->first,
+                      it->second.sequences,
+                      it->second.cycles,
+                      it->second.cycles > mode->total_w ? "  over line" : "");
+    }
+
+    if (xl->listing_file)
+        fputs(report.c_str(), xl->listing_file);
+    else if (xl->opt.verbose)
+        outprintf("%s", report.c_str());
+
+    if (xl->opt.verbose)
+    {
+        outprintf("Copper timing (%s): %u sequences, worst " PR_D64 " cycles, %u exceed horizontal blank, "
+                  "%u run into next line, %u with loops.\n",
+                  mode->name,
+                  num_sequences,
+                  worst,
+                  num_blank,
+                  num_overrun,
+                  num_loop);
+    }
+}
+
+// Copper peephole optimization (-O option)
+//
+// After each pass with settled label values (same size as previous pass), the instructions recorded that pass are
+// scanned for:
+//
+//  - LDI (SETI RA) when RA and the last written value are already the same value (so B flag is also unchanged)
+//  - SETI to a register or memory with no write side effects, when the next instruction writes it again
+//  - BRGE/BRLT to the next instruction
+//  - LDM followed by STM, when RA is loaded again (or the frame ends) before RA or B is used, become one SETM
+//
+// Optimizations are stored in xl->line_hint, so they are kept in later passes (and another pass is done to settle
+// labels).  Instructions read or written by copper code (e.g., self-modified operands) are never optimized (from
+// the nearest label before the address used), and labels or branch targets mean the register values are not known.
+// Each hint is checked again with the values of every later settled pass (removing code moves labels, so e.g.
+// "LDI #label" may no longer load the value already in RA), and a hint that no longer holds is undone and that line
+// is never optimized again (so passes always settle).
+
+namespace
+{
+// VPOS that never matches in any mode (waits for start of next frame, which resets RA)
+bool end_of_frame_wait(uint16_t word0)
+{
+    uint32_t pos = word0 & 0x7FFU;
+    if ((word0 & 0x3800) != 0x2800 || pos == 0x7FF)        // not VPOS (or V_WAITBLIT)
+        return false;
+    for (const auto & m : copper_modes)
+    {
+        if (pos < m.total_h)
+            return false;
+    }
+
+    return true;
+}
+
+// XR address where a write only sets the value (so a write followed by another write has no effect)
+bool plain_xr_dest(uint16_t addr)
+{
+    return addr == copper::RA || addr == copper::RA_CMP ||
+           addr == 0x0000 ||                             // VID_CTRL
+           (addr >= 0x0004 && addr <= 0x0007) ||         // VID_LEFT, VID_RIGHT, POINTER_H, POINTER_V
+           (addr >= 0x0010 && addr <= 0x001F) ||         // playfield A and B registers
+           (addr >= 0x4000 && addr < 0x5400) ||          // tile memory
+           (addr >= 0x8000 && addr < 0x8300);            // color and pointer memory
+}
+}        // namespace
+
+// protect instructions from copper address through nearest label before it (e.g., for "label+1" operands)
+void copper::peep_protect(uint16_t addr)
+{
+    size_t i = 0;
+    while (i < peep_program.size() &&
+           !(peep_program[i].len && peep_program[i].addr <= addr && addr < peep_program[i].addr + peep_program[i].len))
+    {
+        i++;
+    }
+    if (i == peep_program.size())        // not an instruction (e.g., data)
+        return;
+
+    while (true)
+    {
+        peep_protected.insert(peep_program[i].line);
+        if (peep_program[i].entry || i == 0)
+            break;
+        i--;
+    }
+}
+
+// true if RA (and B flag) are not used after peep_program[i] before RA is loaded again or the frame ends
+bool copper::peep_ra_dead(size_t i)
+{
+    uint32_t next_addr = peep_program[i].addr + peep_program[i].len;
+
+    for (i++; i < peep_program.size(); i++)
+    {
+        const peep_insn_t & insn = peep_program[i];
+        if (!insn.len)
+            continue;
+        if (insn.addr != next_addr || peep_protected.count(insn.line))
+            return false;
+        next_addr = insn.addr + insn.len;
+
+        switch (insn.word0 & 0x3000)
+        {
+            case 0x0000:        // SETI
+                if (insn.word0 == RA)
+                    return true;
+                if (insn.word0 == RA_SUB)
+                    return false;
+                break;
+            case 0x1000:        // SETM
+                if (insn.word0 & RA)
+                    return false;
+                if (insn.word1 == RA)
+                    return true;
+                if (insn.word1 == RA_SUB)
+                    return false;
+                break;
+            case 0x2000:        // HPOS/VPOS
+                if (end_of_frame_wait(insn.word0))
+                    return true;
+                break;
+            default:        // BRGE/BRLT
+                return false;
+        }
+    }
+
+    return false;
+}
+
+// undo optimization hint for line (and its merged STM), so it is assembled as written and never optimized again
+void copper::peep_undo(xlasm * xl, uint32_t line)
+{
+    auto hit = xl->line_hint.find(line);
+    if (hit == xl->line_hint.end())
+        return;
+
+    if (hit->second == PEEP_MERGE)
+    {
+        for (size_t i = 0; i < peep_program.size(); i++)
+        {
+            if (peep_program[i].line != line)
+                continue;
+            for (i++; i < peep_program.size(); i++)
+            {
+                auto mit = xl->line_hint.find(peep_program[i].line);
+                if (mit != xl->line_hint.end() && mit->second == PEEP_MERGED)
+                {
+                    peep_undone.insert(mit->first);
+                    xl->line_hint.erase(mit);
+                    break;
+                }
+            }
+            break;
+        }
+        peep_merge_word1.erase(line);
+    }
+    xl->line_hint.erase(hit);
+    peep_undone.insert(line);
+}
+
+bool copper::optimize_pass(xlasm * xl)
+{
+    bool changed = false;
+
+    // only use a pass with settled label values
+    if (xl->ctxt.pass == xlasm::context_t::PASS_OPT && xl->total_size_generated == xl->last_size_generated)
+    {
+        bool add_hints = xl->pass_count + 3 < xlasm::MAX_PASSES;        // leave passes to settle labels
+
+        std::unordered_set<uint32_t> entries;        // copper addresses with labels
+        std::unordered_set<uint32_t> targets;        // branch target copper addresses
+        for (const auto & insn : peep_program)
+        {
+            if (insn.len && insn.entry)
+                entries.insert(insn.addr);
+        }
+
+        // protect instructions used as data and find branch targets
+        bool safe = true;
+        for (const auto & insn : peep_program)
+        {
+            if (!insn.len)
+                continue;
+
+            switch (insn.word0 & 0x3000)
+            {
+                case 0x0000:        // SETI
+                    if ((insn.word0 & 0xC000) == 0xC000)
+                        peep_protect(0xC000 | (insn.word0 & 0x7FF));
+                    if ((insn.word1 & 0xC000) == 0xC000)        // immediate could be copper address
+                        peep_protect(0xC000 | (insn.word1 & 0x7FF));
+                    break;
+                case 0x1000:        // SETM
+                    if (!(insn.word0 & RA))
+                        peep_protect(0xC000 | (insn.word0 & 0x7FF));
+                    if ((insn.word1 & 0xC000) == 0xC000)
+                        peep_protect(0xC000 | (insn.word1 & 0x7FF));
+                    break;
+                case 0x3000:        // BRGE/BRLT
+                    targets.insert(0xC000 | (insn.word0 & 0x7FF));
+                    safe = safe && entries.count(0xC000 | (insn.word0 & 0x7FF));
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // protect exported addresses and labels used other than as a branch target (e.g., modified by host code)
+        for (int64_t value : xl->label_refs)
+        {
+            if ((value & ~0xFFFF) == 0)
+                peep_protect(static_cast<uint16_t>(value));
+        }
+
+        if (!safe)
+        {
+            if (xl->opt.verbose > 1)
+                outprintf("Copper code not optimized, branch target without label.\n");
+            for (const auto & insn : peep_program)
+            {
+                auto hit = xl->line_hint.find(insn.line);
+                if (hit != xl->line_hint.end() && hit->second != PEEP_MERGED)
+                {
+                    peep_undo(xl, insn.line);
+                    changed = true;
+                }
+            }
+            peep_program.clear();
+
+            return changed;
+        }
+
+        // scan instructions tracking RA and last written value (B flag is RA < last written value), checking
+        // hints from earlier passes still hold with the values this pass (removed instructions have length 0)
+        bool     ra_known  = false;
+        bool     wd_known  = false;
+        uint16_t ra        = 0;
+        uint16_t wd        = 0;
+        uint32_t next_addr = ~0U;
+        for (size_t i = 0; i < peep_program.size(); i++)
+        {
+            const peep_insn_t & insn = peep_program[i];
+            uint32_t            hint = PEEP_NONE;
+            auto                hit  = xl->line_hint.find(insn.line);
+            if (hit != xl->line_hint.end())
+                hint = hit->second;
+            if (!insn.len && (hint == PEEP_NONE || hint == PEEP_MERGED))
+                continue;        // merged STM is checked with its LDM
+
+            if (insn.addr != next_addr || insn.entry || targets.count(insn.addr))
+            {
+                ra_known = false;
+                wd_known = false;
+            }
+            next_addr = insn.addr + insn.len;
+
+            // next instruction (if contiguous)
+            size_t n = i + 1;
+            while (n < peep_program.size() && !peep_program[n].len)
+                n++;
+            if (n < peep_program.size() &&
+                (peep_program[n].addr != next_addr || peep_protected.count(peep_program[n].line)))
+            {
+                n = peep_program.size();
+            }
+            const peep_insn_t * next = n < peep_program.size() ? &peep_program[n] : nullptr;
+
+            // STM merged into this LDM (removed, so not next)
+            size_t m = peep_program.size();
+            if (hint == PEEP_MERGE)
+            {
+                for (m = i + 1; m < peep_program.size(); m++)
+                {
+                    auto mit = xl->line_hint.find(peep_program[m].line);
+                    if (mit != xl->line_hint.end() && mit->second == PEEP_MERGED)
+                        break;
+                }
+            }
+            const peep_insn_t * merged = m < peep_program.size() ? &peep_program[m] : nullptr;
+
+            uint16_t w0   = insn.word0;
+            uint16_t w1   = insn.word1;
+            uint32_t peep = PEEP_NONE;        // optimization possible with values this pass
+            bool     prot = peep_protected.count(insn.line) != 0;
+
+            if (!prot && !peep_undone.count(insn.line))
+            {
+                switch (w0 & 0x3000)
+                {
+                    case 0x0000:        // SETI
+                        if (hint != PEEP_SET && w0 == RA && ra_known && wd_known && ra == w1 && wd == w1)
+                        {
+                            peep = PEEP_LOAD;
+                        }
+                        else if (hint != PEEP_LOAD && next && plain_xr_dest(w0) &&
+                                 (((next->word0 & 0x3000) == 0x0000 && next->word0 == w0) ||
+                                  ((next->word0 & 0x3000) == 0x1000 && next->word1 == w0 &&
+                                   !(w0 == RA && (next->word0 & RA)))))
+                        {
+                            peep = PEEP_SET;
+                        }
+                        break;
+                    case 0x1000:        // SETM
+                        if (hint == PEEP_MERGE)
+                        {
+                            if (merged && merged->addr == next_addr && !peep_protected.count(merged->line) &&
+                                merged->word1 != RA && merged->word1 != RA_SUB && merged->word1 != RA_CMP &&
+                                peep_ra_dead(m))
+                            {
+                                peep = PEEP_MERGE;
+                            }
+                        }
+                        else if (w1 == RA && !(w0 & RA) && next && (next->word0 & 0x3000) == 0x1000 &&
+                                 (next->word0 & RA) && next->word1 != RA && next->word1 != RA_SUB &&
+                                 next->word1 != RA_CMP && peep_ra_dead(n))
+                        {
+                            peep = PEEP_MERGE;
+                        }
+                        break;
+                    case 0x3000:        // BRGE/BRLT
+                        if ((w0 & 0x7FFU) == (next_addr & 0x7FFU))
+                            peep = PEEP_BRANCH;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            if (hint != PEEP_NONE && peep != hint)
+            {
+                // hint no longer holds (e.g., label value moved by optimizing), assemble line as written again
+                if (xl->opt.verbose > 1)
+                    outprintf("%s: copper optimization undone (no longer valid)\n", insn.where.c_str());
+                peep_undo(xl, insn.line);
+                changed = true;
+                if (hint == PEEP_MERGE)
+                {
+                    ra_known = false;
+                    wd_known = false;
+                    continue;
+                }
+                hint = PEEP_NONE;        // update register values as executed
+            }
+            else if (hint == PEEP_NONE && peep != PEEP_NONE && add_hints)
+            {
+                hint                     = peep;
+                xl->line_hint[insn.line] = hint;
+                changed                  = true;
+                if (hint == PEEP_MERGE)
+                {
+                    xl->line_hint[next->line]   = PEEP_MERGED;
+                    peep_merge_word1[insn.line] = next->word1;
+                    next_addr                   = next->addr + next->len;
+                    i                           = n;
+                }
+            }
+            else if (hint == PEEP_MERGE)
+            {
+                peep_merge_word1[insn.line] = merged->word1;        // keep STM dest current (label values can change)
+            }
+            if (hint != PEEP_NONE && hint != PEEP_MERGE)
+                continue;        // removed (no effect on registers)
+
+            // update known register values
+            if (prot || hint == PEEP_MERGE)
+            {
+                ra_known = false;
+                wd_known = false;
+                continue;
+            }
+            switch (w0 & 0x3000)
+            {
+                case 0x0000:        // SETI
+                    if (w0 == RA)
+                    {
+                        ra       = w1;
+                        ra_known = true;
+                    }
+                    else if (w0 == RA_SUB)
+                    {
+                        ra = static_cast<uint16_t>(ra - w1);
+                    }
+                    wd       = w1;
+                    wd_known = true;
+                    break;
+                case 0x1000: {        // SETM
+                    bool     known = (w0 & RA) && ra_known;
+                    uint16_t value = ra;
+                    if (w1 == RA)
+                    {
+                        ra_known = known;
+                    }
+                    else if (w1 == RA_SUB)
+                    {
+                        ra       = static_cast<uint16_t>(ra - value);
+                        ra_known = known;
+                    }
+                    wd       = value;
+                    wd_known = known;
+                    break;
+                }
+                case 0x2000:        // HPOS/VPOS
+                    if (end_of_frame_wait(w0))
+                    {
+                        ra_known = false;
+                        wd_known = false;
+                    }
+                    break;
+                default:        // BRGE/BRLT
+                    break;
+            }
+        }
+    }
+
+    peep_program.clear();
+
+    return changed;
+}
+
+void copper::optimize_report(xlasm * xl)
+{
+    std::string report;
+    uint32_t    num_removed = 0;
+    uint32_t    num_merged  = 0;
+    uint32_t    words_saved = 0;
+    uint32_t    cyc_saved   = 0;
+
+    strprintf(report, "\n\nCopper optimizations:\n\n");
+    strprintf(report, "Addr  Source                    Optimization\n");
+
+    for (const auto & insn : peep_program)
+    {
+        auto hit = xl->line_hint.find(insn.line);
+        if (hit == xl->line_hint.end() || hit->second == PEEP_NONE)
+            continue;
+
+        uint16_t    w0 = insn.word0;
+        uint16_t    w1 = insn.word1;
+        std::string what;
+        switch (hit->second)
+        {
+            case PEEP_LOAD:
+                strprintf(what, "removed LDI #0x%04x (already in RA)", w1);
+                break;
+            case PEEP_SET:
+                strprintf(what, "removed SETI 0x%04x,#0x%04x (written again by next instruction)", w0, w1);
+                break;
+            case PEEP_BRANCH:
+                strprintf(what, "removed %s to next instruction", (w0 & 0x0800) ? "BRLT" : "BRGE");
+                break;
+            case PEEP_MERGE:
+                strprintf(what, "merged LDM 0x%04x and STM 0x%04x into SETM", 0xC000 | (w0 & 0x7FF), w1);
+                break;
+            default:
+                break;
+        }
+
+        if (hit->second == PEEP_MERGE)
+        {
+            num_merged++;
+        }
+        else if (hit->second != PEEP_MERGED)
+        {
+            num_removed++;
+        }
+        if (hit->second != PEEP_MERGE)
+        {
+            const op_tbl & op = ops[(w0 & 0x3000) == 0x3000 ? OP_BRGE : OP_SETI];
+            words_saved += static_cast<uint32_t>(op.len);
+            cyc_saved += op.cyc;
+        }
+        if (what.size())
+            strprintf(report, "%04x  %-24s  %s\n", insn.addr, insn.where.c_str(), what.c_str());
+    }
+
+    if (xl->listing_file)
+        fputs(report.c_str(), xl->listing_file);
+    else if (xl->opt.verbose)
+        outprintf("%s", report.c_str());
+
+    if (xl->opt.verbose)
+    {
+        outprintf("Copper optimization: %u instructions removed, %u LDM/STM merged, saved %u words and %u cycles.\n",
+                  num_removed,
+                  num_merged,
+                  words_saved,
+                  cyc_saved);
+    }
+}
+
+// Copper simulation (--simulate option)
+//
+// The assembled program is loaded into a model of copper memory and run from the top of each frame with the video
+// mode timing used by the -t report.  RA, RA_SUB and the B flag (RA < last value written, so RA_CMP and any other
+// write update it) are modeled.  Instructions take the cycles in ops[], and an HPOS/VPOS wait also takes at least
+// its cycles, resuming once the position is reached (HPOS also at the start of the next line, like EN_COPP_HWAITEOL,
+// and VPOS #V_WAITBLIT assumes the blitter is not busy).  Each XR register write (including copper memory, which
+// changes the program for following instructions) and each wait is written to the trace with its frame, line and
+// HPOS.  Running past the end of the assembled program stops the copper until the next frame.
+
+namespace
+{
+const uint32_t SIM_COPPER_WORDS = 0x600;        // copper memory words (1K + 512)
+
+// copper memory index for copper address (upper 512 words mirrored)
+uint32_t sim_index(uint32_t addr)
+{
+    return (addr & 0x400) ? 0x400 | (addr & 0x1FF) : (addr & 0x3FF);
+}
+}        // namespace
+
+void copper::simulate(xlasm * xl, FILE * trace_file)
+{
+    const copper_mode_t * mode         = video_mode(xl);
+    uint32_t              frame_cycles = mode->total_w * mode->total_h;
+
+    std::vector<uint16_t> mem(SIM_COPPER_WORDS, 0);
+    std::vector<bool>     loaded(SIM_COPPER_WORDS, false);
+    uint32_t              num_outside = 0;
+    for (auto it = xl->sections.begin(); it != xl->sections.end(); ++it)
+    {
+        const xlasm::section_t & sec = it->second;
+        for (size_t i = 0; i + 1 < sec.data.size(); i += 2)
+        {
+            uint32_t addr = static_cast<uint32_t>(sec.load_addr + static_cast<int64_t>(i >> 1));
+            if (addr < 0xC000 || addr >= 0xC000 + SIM_COPPER_WORDS)
+            {
+                num_outside++;
+                continue;
+            }
+            mem[addr - 0xC000]    = static_cast<uint16_t>((sec.data[i] << 8) | sec.data[i + 1]);
+            loaded[addr - 0xC000] = true;
+        }
+    }
+
+    fprintf(trace_file,
+            "; Copper simulation of %u frame%s (%s, %u cycles per line, %u lines)\n",
+            xl->opt.simulate_frames,
+            xl->opt.simulate_frames == 1 ? "" : "s",
+            mode->name,
+            mode->total_w,
+            mode->total_h);
+    if (num_outside)
+        fprintf(trace_file, "; %u words outside copper memory 0xC000-0xC5FF not loaded\n", num_outside);
+    fprintf(trace_file, ";\n; Frame  Line  HPos  Addr  Event\n");
+
+    uint64_t num_insns  = 0;
+    uint64_t num_writes = 0;
+    uint32_t num_stops  = 0;
+    for (uint32_t frame = 0; frame < xl->opt.simulate_frames; frame++)
+    {
+        uint16_t pc    = 0;        // copper address (reset at start of frame)
+        uint16_t ra    = 0;        // RA register
+        uint16_t wdata = 0;        // last value written (B flag is RA < wdata)
+        uint32_t t     = 0;        // cycle in frame
+
+        while (t < frame_cycles)
+        {
+            uint16_t addr = pc;
+            if (!loaded[sim_index(pc)])
+            {
+                fprintf(trace_file,
+                        "%7u %5u %5u  %04x  PC past end of program (stopped until next frame)\n",
+                        frame,
+                        t / mode->total_w,
+                        t % mode->total_w,
+                        0xC000 | addr);
+                num_stops++;
+                break;
+            }
+
+            uint16_t op = mem[sim_index(pc)];
+            num_insns++;
+            if ((op & 0x3000) == 0x2000)        // HPOS/VPOS
+            {
+                uint32_t pos   = op & 0x7FFU;
+                uint32_t line  = t / mode->total_w;
+                uint32_t h     = t % mode->total_w;
+                uint32_t ready = t;
+                if (op & 0x0800)
+                {
+                    if (!(pos & 0x400) && (pos & 0x3FF) > line)        // not V_WAITBLIT and not yet reached
+                        ready = (pos & 0x3FF) < mode->total_h ? (pos & 0x3FF) * mode->total_w : frame_cycles;
+                }
+                else if (pos > h)
+                {
+                    ready = line * mode->total_w + (pos < mode->total_w ? pos : mode->total_w);
+                }
+                pc = (pc + 1) & 0x7FF;
+                t  = std::max(t + ops[OP_HPOS].cyc, ready);
+                if (t >= frame_cycles)
+                    break;
+                fprintf(trace_file,
+                        "%7u %5u %5u  %04x  %s #%u\n",
+                        frame,
+                        t / mode->total_w,
+                        t % mode->total_w,
+                        0xC000 | addr,
+                        (op & 0x0800) ? "VPOS" : "HPOS",
+                        pos);
+            }
+            else if ((op & 0x3000) == 0x3000)        // BRGE/BRLT
+            {
+                bool b_flag = ra < wdata;
+                pc          = (pc + 1) & 0x7FF;
+                if (b_flag == ((op & 0x0800) != 0))
+                    pc = op & 0x7FF;
+                t += ops[OP_BRGE].cyc;
+            }
+            else        // SETI/SETM
+            {
+                uint16_t word1 = mem[sim_index((pc + 1) & 0x7FFU)];
+                uint16_t dest  = word1;
+                uint16_t data  = word1;
+                if (op & 0x1000)
+                    data = (op & 0x0800) ? ra : mem[sim_index(op & 0x7FFU)];
+                else
+                    dest = op;
+                pc = (pc + 2) & 0x7FF;
+                t += ops[OP_SETI].cyc;
+                if (t >= frame_cycles)
+                    break;
+
+                if ((dest & 0xC000) == 0x0000 && (dest & RA))        // RA or RA_SUB
+                {
+                    ra = (dest & 0x1) ? static_cast<uint16_t>(ra - data) : data;
+                }
+                else
+                {
+                    if ((dest & 0xC000) == 0xC000)        // copper memory
+                        mem[sim_index(dest & 0x7FFU)] = data;
+                    fprintf(trace_file,
+                            "%7u %5u %5u  %04x  XR 0x%04x <= 0x%04x\n",
+                            frame,
+                            t / mode->total_w,
+                            t % mode->total_w,
+                            0xC000 | addr,
+                            dest,
+                            data);
+                    num_writes++;
+                }
+                wdata = data;
+            }
+        }
+    }
+
+    fprintf(trace_file,
+            ";\n; " PR_U64 " instructions, " PR_U64 " XR writes, %u frame%s stopped past end of program\n",
+            num_insns,
+            num_writes,
+            num_stops,
+            num_stops == 1 ? "" : "s");
+
+    if (xl->opt.verbose)
+    {
+        outprintf("Copper simulation (%s): %u frame%s, " PR_U64 " instructions, " PR_U64
+                  " XR writes traced to \"%s\".\n",
+                  mode->name,
+                  xl->opt.simulate_frames,
+                  xl->opt.simulate_frames == 1 ? "" : "s",
+                  num_insns,
+                  num_writes,
+                  xl->trace_filename.c_str());
+    }
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "xlasm.h"
@@ -17,19 +18,19 @@ struct copper : public Ixlarch
     void              activate(xlasm * xl) override;
     void              deactivate(xlasm * xl) override;
     int32_t           lookup_register(const std::string & opcode) override;
-    int32_t           check_opcode(const std::string & opcode) override;
-    int32_t           process_opcode(xlasm *                          xl,
-                                     int32_t                          idx,
-                                     std::string &                    opcode,
-                                     size_t                           cur_token,
-                                     const std::vector<std::string> & tokens) override;
-    uint32_t          check_directive(const std::string & directive) override;
-    int32_t           process_directive(xlasm *                          xl,
-                                        uint32_t                         idx,
-                                        const std::string &              directive,
-                                        const std::string &              label,
-                                        size_t                           cur_token,
-                                        const std::vector<std::string> & tokens) override;
+    int32_t           check_opcode(const name_key_t & opcode) override;
+    int32_t           process_opcode(xlasm *                     xl,
+                                     int32_t                     idx,
+                                     std::string &               opcode,
+                                     size_t                      cur_token,
+                                     const xlasm::token_list_t & tokens) override;
+    uint32_t          check_directive(const name_key_t & directive) override;
+    int32_t           process_directive(xlasm *                     xl,
+                                        uint32_t                    idx,
+                                        const std::string &         directive,
+                                        const std::string &         label,
+                                        size_t                      cur_token,
+                                        const xlasm::token_list_t & tokens) override;
 
 
     bool support_dollar_hex() override
@@ -63,6 +64,11 @@ struct copper : public Ixlarch
         return 2;
     }
 
+    void cycle_report(xlasm * xl) override;
+    bool optimize_pass(xlasm * xl) override;
+    void optimize_report(xlasm * xl) override;
+    void simulate(xlasm * xl, FILE * trace_file) override;
+
 
     copper() noexcept;
     ~copper() override
@@ -173,12 +179,59 @@ struct copper : public Ixlarch
         uint32_t     val;
     };
 
-    typedef std::unordered_map<std::string, uint32_t> opcode_map_t;
-    typedef std::unordered_map<std::string, uint32_t> directive_map_t;
+    typedef name_map_t<uint32_t> opcode_map_t;
+    typedef name_map_t<uint32_t> directive_map_t;
+
+    // instruction assembled in final pass (for cycle timing report)
+    struct cop_insn_t
+    {
+        uint16_t    addr;         // copper address
+        uint16_t    word0;        // first instruction word
+        uint32_t    len;          // length in words
+        uint32_t    cyc;          // cycles (not including wait)
+        std::string where;        // source file and line
+    };
+
+    // instruction assembled each pass (for peephole optimization with -O option)
+    struct peep_insn_t
+    {
+        uint32_t    line;         // virtual line number (key for xl->line_hint)
+        uint16_t    addr;         // copper address
+        uint16_t    word0;        // first instruction word
+        uint16_t    word1;        // second instruction word (if 2 word instruction)
+        uint32_t    len;          // length in words (0 if removed)
+        bool        entry;        // label defined at address
+        std::string where;        // source file and line
+    };
+
+    // xl->line_hint values for optimized lines
+    enum peep_hint
+    {
+        PEEP_NONE,
+        PEEP_LOAD,          // LDI removed, RA already has value
+        PEEP_SET,           // SETI removed, register written again by next instruction
+        PEEP_BRANCH,        // BRGE/BRLT to next instruction removed
+        PEEP_MERGE,         // LDM merged with following STM into SETM
+        PEEP_MERGED         // STM removed (merged into previous LDM)
+    };
 
     static directive_map_t directives;
     static opcode_map_t    opcodes;
 
+    std::vector<cop_insn_t>                program;                   // instructions assembled (with -t option)
+    std::unordered_map<uint32_t, size_t>   program_index;             // copper address to program index
+    int32_t                                cycles_since_wait;         // cycles since HPOS/VPOS (for listing)
+    std::vector<peep_insn_t>               peep_program;              // instructions assembled this pass (with -O)
+    std::unordered_set<uint32_t>           peep_protected;            // lines accessed as data (not optimized)
+    std::unordered_set<uint32_t>           peep_undone;               // lines with hint undone (never optimized again)
+    std::unordered_map<uint32_t, uint16_t> peep_merge_word1;          // STM dest for PEEP_MERGE lines
+    uint16_t                               peep_merge_pending;        // STM dest used by last PEEP_MERGE line
+
+    int64_t sequence_cycles(std::vector<int64_t> & cycles, size_t i);
+    void    peep_protect(uint16_t addr);
+    void    peep_undo(xlasm * xl, uint32_t line);
+    bool    peep_ra_dead(size_t i);
+
     static constexpr xlasm::directive_t directives_list[] = {{"WORD", xlasm::DIR_DEF_16}, {"DW", xlasm::DIR_DEF_16}};
 
     static constexpr op_tbl ops[] = {{OP_SETI, 0x0000, 0x3000, "SETI", {XM14, IM16}, 2, 0, 4},
@@ -0,0 +1,121 @@
+// xlasmcz.h - compressed copper output (.cz) encoder and reference decoder
+//
+// A .cz file is big-endian 16-bit words (like .bin output):
+//
+// | Word                | Description                                                      |
+// |---------------------|------------------------------------------------------------------|
+// | 0x435A              | "CZ" magic                                                       |
+// | load address        | XR address for first word (e.g., 0xC000 for XR_COPPER_ADDR)      |
+// | word count          | number of words after decompression                              |
+// | 0nnn nnnn nnnn nnnn | n literal words follow (1 to 0x7FFF)                             |
+// | 1lll llll dddd dddd | copy l+2 words starting d+1 words back (2 to 129 words, 256 max) |
+// | 0x0000              | end of data                                                      |
+//
+// Words are written in order, so a decoder can write each word straight to XR memory (xosera_upload_cz in
+// xosera_m68k_api.c keeps a 256 word ring buffer for matches).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace xlasmcz
+{
+enum
+{
+    MAGIC        = 0x435A,        // "CZ"
+    HEADER_WORDS = 3,             // magic, load address, word count
+    END_TOKEN    = 0x0000,        // end of data
+    MATCH_FLAG   = 0x8000,        // match token (otherwise literal count)
+    MAX_LITERAL  = 0x7FFF,        // maximum literal words per token
+    MIN_MATCH    = 2,             // minimum match words
+    MAX_MATCH    = 129,           // maximum match words
+    WINDOW       = 256            // maximum match distance
+};
+
+// compress words (up to 0xFFFF) for XR address load_addr (greedy longest match)
+inline std::vector<uint16_t> compress(const std::vector<uint16_t> & in, uint16_t load_addr)
+{
+    std::vector<uint16_t> out;
+    out.push_back(MAGIC);
+    out.push_back(load_addr);
+    out.push_back(static_cast<uint16_t>(in.size()));
+
+    size_t literal_token = 0;        // index of current literal count token (0 if none)
+    size_t pos           = 0;
+    while (pos < in.size())
+    {
+        size_t best_len  = 0;
+        size_t best_dist = 0;
+        for (size_t dist = 1; dist <= WINDOW && dist <= pos; dist++)
+        {
+            size_t len = 0;
+            while (len < MAX_MATCH && pos + len < in.size() && in[pos + len] == in[pos + len - dist])
+                len++;
+            if (len > best_len)
+            {
+                best_len  = len;
+                best_dist = dist;
+            }
+        }
+
+        if (best_len >= MIN_MATCH)
+        {
+            out.push_back(static_cast<uint16_t>(MATCH_FLAG | ((best_len - MIN_MATCH) << 8) | (best_dist - 1)));
+            literal_token = 0;
+            pos += best_len;
+        }
+        else
+        {
+            if (literal_token == 0 || out[literal_token] == MAX_LITERAL)
+            {
+                literal_token = out.size();
+                out.push_back(0);
+            }
+            out[literal_token]++;
+            out.push_back(in[pos++]);
+        }
+    }
+    out.push_back(END_TOKEN);
+
+    return out;
+}
+
+// decompress .cz words, returns false if not valid (reference for other decoders)
+inline bool decompress(const uint16_t * cz, size_t cz_words, uint16_t * load_addr, std::vector<uint16_t> & out)
+{
+    out.clear();
+    if (cz_words < HEADER_WORDS + 1 || cz[0] != MAGIC)
+        return false;
+
+    *load_addr   = cz[1];
+    size_t count = cz[2];
+    size_t pos   = HEADER_WORDS;
+    while (pos < cz_words)
+    {
+        uint16_t token = cz[pos++];
+        if (token == END_TOKEN)
+            return out.size() == count;
+
+        if (token & MATCH_FLAG)
+        {
+            size_t len  = ((token >> 8) & 0x7F) + MIN_MATCH;
+            size_t dist = (token & 0xFF) + 1U;
+            if (dist > out.size() || out.size() + len > count)
+                return false;
+            for (size_t i = 0; i < len; i++)
+                out.push_back(out[out.size() - dist]);
+        }
+        else
+        {
+            if (pos + token > cz_words || out.size() + token > count)
+                return false;
+            out.insert(out.end(), cz + pos, cz + pos + token);
+            pos += token;
+        }
+    }
+
+    return false;        // no end token
+}
+}        // namespace xlasmcz
@@ -97,13 +97,17 @@ class expression
         int64_t (*eval)(expression * exp, int64_t a1, int64_t a2);
     };
 
-    xlasm *             xl;
-    const struct op_s * opstack[MAXOPSTACK];
-    int64_t             numstack[MAXNUMSTACK];
-    int32_t             nopstack;
-    int32_t             nnumstack;
-    int32_t             brace_balance;
-    int32_t             errorcode;
+    xlasm *                xl;
+    const struct op_s *    opstack[MAXOPSTACK];
+    int64_t                numstack[MAXNUMSTACK];
+    bool                   numconst[MAXNUMSTACK];        // numstack value is constant (when compiling)
+    size_t                 numcode[MAXNUMSTACK];         // first instruction of numstack value (when compiling)
+    int32_t                nopstack;
+    int32_t                nnumstack;
+    int32_t                brace_balance;
+    int32_t                errorcode;
+    xlasm::expr_code_t *   code;         // compiling to code (instead of evaluating)
+    bool                   quiet;        // don't report errors (compile or run will be retried with evaluate)
 
 public:
     void eval_error(int error, const char * fmt, ...) ATTRIBUTE((format(printf, 3, 4)))
@@ -112,7 +116,7 @@ public:
 
         errorcode = error;
 
-        if (xl->ctxt.pass != xlasm::context_t::PASS_2 || !xl->ctxt.file)
+        if (quiet || xl->ctxt.pass != xlasm::context_t::PASS_2 || !xl->ctxt.file)
             return;
 
         va_list args;
@@ -130,7 +134,7 @@ public:
 
         errorcode = error;
 
-        if (!xl->ctxt.file)
+        if (quiet || !xl->ctxt.file)
             return;
 
         va_list args;
@@ -454,10 +458,99 @@ private:
         return numstack[--nnumstack];
     }
 
+    // push literal value (or add instruction when compiling)
+    void push_value(int64_t v)
+    {
+        push_numstack(v);
+        if (code)
+        {
+            push_code(xlasm::expr_code_t::PUSH_VALUE, 0, v);
+            numconst[nnumstack - 1] = true;
+        }
+    }
+
+    // compiling: add instruction for value on top of numstack
+    void push_code(xlasm::expr_code_t::op_code c, uint32_t arg, int64_t v)
+    {
+        xlasm::expr_code_t::insn_t insn = {c, arg, v};
+        numconst[nnumstack - 1]         = false;
+        numcode[nnumstack - 1]          = code->insns.size();
+        code->insns.push_back(insn);
+    }
+
+    // apply operator to values on numstack (or add instruction when compiling)
+    void apply_op(const struct op_s * op)
+    {
+        int64_t n1, n2, n3;
+
+        if (code && op->unary > 0)
+        {
+            int32_t args = static_cast<int32_t>(op->unary);
+            if (nnumstack < args)
+            {
+                errorcode = 0x106;        // not enough arguments (reported when evaluated)
+                return;
+            }
+
+            // fold operators with constant arguments (except those using current address or that would error)
+            int32_t first = nnumstack - args;
+            size_t  start = numcode[first];
+            bool    fold  = op->eval != eval_upcrelhi && op->eval != eval_upcrello;
+            for (int32_t i = first; i < nnumstack; i++)
+            {
+                fold = fold && numconst[i];
+            }
+            if ((op->op == OP_DIVIDE || op->op == OP_MODULO) && numstack[nnumstack - 1] == 0)
+            {
+                fold = false;
+            }
+
+            if (!fold)
+            {
+                nnumstack = first;
+                push_numstack(0);
+                push_code(xlasm::expr_code_t::APPLY_OP, static_cast<uint32_t>(op - ops), 0);
+                numcode[first] = start;
+                return;
+            }
+
+            code->insns.resize(start);        // remove constant argument instructions
+        }
+
+        if (op->unary == 1)
+        {
+            n1 = pop_numstack();
+            push_numstack(op->eval(this, n1, 0));
+        }
+        else if (op->unary == 2)
+        {
+            n1 = pop_numstack();
+            n2 = pop_numstack();
+            push_numstack(op->eval(this, n2, n1));
+        }
+        else if (op->unary == 3)
+        {
+            assert(op->op == OP_TERNARY);
+            n1 = pop_numstack();
+            n2 = pop_numstack();
+            n3 = pop_numstack();
+            push_numstack(eval_cond(this, n3, n2, n1));        // special case for ?: ternary op
+        }
+        else
+        {
+            return;
+        }
+
+        if (code)
+        {
+            push_code(xlasm::expr_code_t::PUSH_VALUE, 0, numstack[nnumstack - 1]);
+            numconst[nnumstack - 1] = true;
+        }
+    }
+
     void shunt_op(const struct op_s * op)
     {
         const struct op_s * pop;
-        int64_t             n1, n2, n3;
 
         exp_dprintf("operator %s\n", op->op_str);
 
@@ -476,24 +569,7 @@ private:
                 if (!pop)
                     return;
 
-                if (pop->unary == 1)
-                {
-                    n1 = pop_numstack();
-                    push_numstack(pop->eval(this, n1, 0));
-                }
-                else if (pop->unary == 2)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    push_numstack(pop->eval(this, n2, n1));
-                }
-                else if (pop->unary == 3)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    n3 = pop_numstack();
-                    push_numstack(eval_cond(this, n3, n2, n1));
-                }
+                apply_op(pop);
             }
 
             pop = pop_opstack();
@@ -512,24 +588,7 @@ private:
                 if (!pop)
                     return;
 
-                if (pop->unary == 1)
-                {
-                    n1 = pop_numstack();
-                    push_numstack(pop->eval(this, n1, 0));
-                }
-                else if (pop->unary == 2)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    push_numstack(pop->eval(this, n2, n1));
-                }
-                else if (pop->unary == 3)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    n3 = pop_numstack();
-                    push_numstack(eval_cond(this, n3, n2, n1));
-                }
+                apply_op(pop);
             }
         }
         else if (op->assoc == ASSOC_LEFT)
@@ -540,43 +599,19 @@ private:
                 if (!pop)
                     return;
 
-                if (pop->unary == 1)
-                {
-                    n1 = pop_numstack();
-                    push_numstack(pop->eval(this, n1, 0));
-                }
-                else if (pop->unary == 2)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    push_numstack(pop->eval(this, n2, n1));
-                }
-                else if (pop->unary == 3)
-                {
-                    n1 = pop_numstack();
-                    n2 = pop_numstack();
-                    n3 = pop_numstack();
-                    push_numstack(eval_cond(this, n3, n2, n1));
-                }
+                apply_op(pop);
             }
         }
 
         push_opstack(op);
     }
 
-public:
-    bool evaluate(xlasm *     xl_,
-                  std::string expression,
-                  int64_t *   result,
-                  size_t *    last_offset     = nullptr,
-                  bool        allow_undefined = true)
+    bool parse(const char * expression, int64_t * result, size_t * last_offset, bool allow_undefined)
     {
         struct op_s         startop = {"X", 1, OP_DUMMY, 0, ASSOC_NONE, 0, nullptr}; /* Dummy operator to mark TOS */
         const struct op_s * op      = nullptr;
-        int64_t             n1, n2, n3;
-        const struct op_s * lastop = &startop;
+        const struct op_s * lastop  = &startop;
 
-        xl            = xl_;
         errorcode     = 0;
         brace_balance = 0;
         nopstack      = 0;
@@ -585,10 +620,10 @@ public:
         memset(&numstack, 0, sizeof(numstack));
         *result = 0;        // default
 
-        //		printf("evaluate(\"%s\")\n", expression.c_str());
+        //		printf("evaluate(\"%s\")\n", expression);
 
         const char * expr;
-        for (expr = expression.c_str(); *expr && !errorcode; ++expr)
+        for (expr = expression; *expr && !errorcode; ++expr)
         {
             if (expr[0] == ' ')
                 continue;
@@ -676,7 +711,7 @@ public:
                     v = static_cast<int64_t>(strtoul(const_cast<char *>(expr), const_cast<char **>(&expr), 0));
                 }
 
-                push_numstack(v);
+                push_value(v);
                 lastop = nullptr;
 
                 // for loop will still increment, so back off one
@@ -707,17 +742,25 @@ public:
                 }
                 strncpy(symname, expr, symlen);
 
-                bool    undefined = false;
-                int64_t v         = xl->symbol_value(xl, symname, &undefined);
-                exp_dprintf("parsed sym '%s' v = 0x%llx\n", symname, v);
-
-                if (!allow_undefined && undefined)
+                if (code)
                 {
-                    eval_error(0x10C, "Use of undefined symbol: %.32s", expr);
-                    return false;
+                    push_numstack(0);
+                    push_code(xlasm::expr_code_t::PUSH_SYMBOL, xl->expr_symbol_slot(symname), 0);
                 }
+                else
+                {
+                    bool    undefined = false;
+                    int64_t v         = xl->symbol_value(xl, symname, &undefined);
+                    exp_dprintf("parsed sym '%s' v = 0x%llx\n", symname, v);
 
-                push_numstack(v);
+                    if (!allow_undefined && undefined)
+                    {
+                        eval_error(0x10C, "Use of undefined symbol: %.32s", expr);
+                        return false;
+                    }
+
+                    push_numstack(v);
+                }
                 lastop = nullptr;
 
                 expr += symlen - 1;
@@ -743,25 +786,7 @@ public:
             if (!op)
                 break;
 
-            if (op->unary == 1)
-            {
-                n1 = pop_numstack();
-                push_numstack(op->eval(this, n1, 0));
-            }
-            else if (op->unary == 2)
-            {
-                n1 = pop_numstack();
-                n2 = pop_numstack();
-                push_numstack(op->eval(this, n2, n1));
-            }
-            else if (op->unary == 3)
-            {
-                assert(op->op == OP_TERNARY);
-                n1 = pop_numstack();
-                n2 = pop_numstack();
-                n3 = pop_numstack();
-                push_numstack(eval_cond(this, n3, n2, n1));        // special case for ?: ternary op
-            }
+            apply_op(op);
         }
         if (!errorcode && nnumstack != 1)
         {
@@ -770,9 +795,97 @@ public:
         }
 
         if (last_offset != nullptr)
-            *last_offset = static_cast<size_t>((expr - expression.c_str()));
+            *last_offset = static_cast<size_t>((expr - expression));
         *result = numstack[0];
 
         return errorcode ? false : true;
     }
+
+public:
+    expression() noexcept
+            : xl(nullptr)
+            , nopstack(0)
+            , nnumstack(0)
+            , brace_balance(0)
+            , errorcode(0)
+            , code(nullptr)
+            , quiet(false)
+    {
+    }
+
+    bool evaluate(xlasm *     xl_,
+                  std::string expression,
+                  int64_t *   result,
+                  size_t *    last_offset     = nullptr,
+                  bool        allow_undefined = true)
+    {
+        xl    = xl_;
+        code  = nullptr;
+        quiet = false;
+
+        return parse(expression.c_str(), result, last_offset, allow_undefined);
+    }
+
+    // compile expression to postfix code with constant sub-expressions folded (errors are not reported, use
+    // evaluate to report them)
+    bool compile(xlasm * xl_, const std::string & expression, xlasm::expr_code_t & out)
+    {
+        int64_t result = 0;
+
+        xl    = xl_;
+        code  = &out;
+        quiet = true;
+        out.text.assign(expression);
+        out.dollar_hex = xl->dollar_hex();
+        out.insns.clear();
+        bool ok = parse(expression.c_str(), &result, &out.last_offset, true) && nnumstack == 1;
+        code    = nullptr;
+
+        return ok;
+    }
+
+    // evaluate compiled expression code (errors are not reported, use evaluate to report them)
+    bool run(xlasm * xl_, const xlasm::expr_code_t & in, int64_t * result, bool allow_undefined = true)
+    {
+        xl        = xl_;
+        code      = nullptr;
+        quiet     = true;
+        errorcode = 0;
+        nopstack  = 0;
+        nnumstack = 0;
+        *result   = 0;        // default
+
+        for (const auto & insn : in.insns)
+        {
+            switch (insn.code)
+            {
+                case xlasm::expr_code_t::PUSH_VALUE:
+                    push_numstack(insn.value);
+                    break;
+
+                case xlasm::expr_code_t::PUSH_SYMBOL: {
+                    bool    undefined = false;
+                    int64_t v         = xl->expr_slot_value(insn.arg, &undefined);
+
+                    if (!allow_undefined && undefined)
+                    {
+                        errorcode = 0x10C;
+                        return false;
+                    }
+                    push_numstack(v);
+                }
+                break;
+
+                case xlasm::expr_code_t::APPLY_OP:
+                    apply_op(&ops[insn.arg]);
+                    break;
+            }
+
+            if (errorcode)
+                return false;
+        }
+        *result = numstack[0];
+
+        return true;
+    }
 };
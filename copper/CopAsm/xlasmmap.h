@@ -0,0 +1,266 @@
+// xlasmmap.h - flat hash map for assembler names (symbols, macros, directives and opcodes)
+//
+// Open addressing (linear probing) over an index of nodes.  Nodes are never moved or freed until clear(), so
+// references stay valid as the map grows (like std::unordered_map) and an erased name keeps its node (for
+// when it is defined again next pass).  Lookups can use a name_key_t with the hash already computed (e.g. from
+// xlasm::string_pool_t, where source tokens are hashed once when read).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <deque>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// FNV-1a hash (used for name_map_t and xlasm::string_pool_t)
+inline uint32_t name_hash(const char * str, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(str[i])) * 16777619U;
+    }
+
+    return hash;
+}
+
+// name with precomputed hash
+struct name_key_t
+{
+    const char * str;
+    uint32_t     len;
+    uint32_t     hash;
+};
+
+inline name_key_t name_key(const std::string & name)
+{
+    name_key_t key = {name.data(), static_cast<uint32_t>(name.size()), name_hash(name.data(), name.size())};
+
+    return key;
+}
+
+template <typename T>
+class name_map_t
+{
+public:
+    typedef std::pair<const std::string, T> value_type;
+
+private:
+    enum
+    {
+        INITIAL_SLOTS = 64        // initial hash slots (power of two, kept at most half full)
+    };
+
+    struct node_t
+    {
+        value_type kv;
+        uint32_t   hash;
+        bool       live;        // false once erased (node kept for name)
+
+        node_t(const name_key_t & key)
+                : kv(std::piecewise_construct, std::forward_as_tuple(key.str, key.len), std::forward_as_tuple())
+                , hash(key.hash)
+                , live(true)
+        {
+        }
+    };
+
+    template <typename M, typename V>
+    class iterator_t
+    {
+    public:
+        iterator_t(M * m, size_t i)
+                : map(m)
+                , index(i)
+        {
+            skip();
+        }
+        V & operator*() const
+        {
+            return map->nodes[index].kv;
+        }
+        V * operator->() const
+        {
+            return &map->nodes[index].kv;
+        }
+        iterator_t & operator++()
+        {
+            index++;
+            skip();
+            return *this;
+        }
+        bool operator==(const iterator_t & rhs) const
+        {
+            return index == rhs.index;
+        }
+        bool operator!=(const iterator_t & rhs) const
+        {
+            return index != rhs.index;
+        }
+
+    private:
+        friend class name_map_t;
+
+        M *    map;
+        size_t index;
+
+        void skip()
+        {
+            while (index < map->nodes.size() && !map->nodes[index].live)
+                index++;
+        }
+    };
+
+public:
+    typedef iterator_t<name_map_t, value_type>             iterator;
+    typedef iterator_t<const name_map_t, const value_type> const_iterator;
+
+    name_map_t()
+            : slots(INITIAL_SLOTS)
+            , live_count(0)
+    {
+    }
+
+    size_t size() const
+    {
+        return live_count;
+    }
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+    iterator end()
+    {
+        return iterator(this, nodes.size());
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, nodes.size());
+    }
+
+    iterator find(const name_key_t & key)
+    {
+        uint32_t n = slots[probe(key)];
+        return iterator(this, n && nodes[n - 1].live ? n - 1 : nodes.size());
+    }
+    iterator find(const std::string & name)
+    {
+        return find(name_key(name));
+    }
+    const_iterator find(const name_key_t & key) const
+    {
+        uint32_t n = slots[probe(key)];
+        return const_iterator(this, n && nodes[n - 1].live ? n - 1 : nodes.size());
+    }
+    const_iterator find(const std::string & name) const
+    {
+        return find(name_key(name));
+    }
+
+    size_t count(const name_key_t & key) const
+    {
+        return find(key) != end() ? 1 : 0;
+    }
+    size_t count(const std::string & name) const
+    {
+        return count(name_key(name));
+    }
+
+    T & operator[](const name_key_t & key)
+    {
+        size_t slot = probe(key);
+        if (slots[slot] == 0)
+        {
+            nodes.emplace_back(key);
+            slots[slot] = static_cast<uint32_t>(nodes.size());
+            live_count++;
+            if (nodes.size() * 2 > slots.size())
+                grow();
+            return nodes.back().kv.second;
+        }
+
+        node_t & node = nodes[slots[slot] - 1];
+        if (!node.live)
+        {
+            node.live = true;
+            live_count++;
+        }
+        return node.kv.second;
+    }
+    T & operator[](const std::string & name)
+    {
+        return (*this)[name_key(name)];
+    }
+
+    iterator erase(iterator it)
+    {
+        node_t & node  = nodes[it.index];
+        node.live      = false;
+        node.kv.second = T();
+        live_count--;
+        ++it;
+
+        return it;
+    }
+    size_t erase(const std::string & name)
+    {
+        iterator it = find(name);
+        if (it == end())
+            return 0;
+        erase(it);
+
+        return 1;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        slots.assign(INITIAL_SLOTS, 0);
+        live_count = 0;
+    }
+
+private:
+    std::deque<node_t>    nodes;        // names in order defined (never moved)
+    std::vector<uint32_t> slots;        // open addressing hash of node index + 1 (0 is empty)
+    size_t                live_count;
+
+    // slot holding key, or empty slot for it
+    size_t probe(const name_key_t & key) const
+    {
+        size_t mask = slots.size() - 1;
+        size_t slot = key.hash & mask;
+        while (slots[slot] != 0)
+        {
+            const node_t & node = nodes[slots[slot] - 1];
+            if (node.hash == key.hash && node.kv.first.size() == key.len &&
+                memcmp(node.kv.first.data(), key.str, key.len) == 0)
+                break;
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    void grow()
+    {
+        slots.assign(slots.size() * 2, 0);
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            size_t slot = nodes[i].hash & mask;
+            while (slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = static_cast<uint32_t>(i + 1);
+        }
+    }
+};
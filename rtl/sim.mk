@@ -43,6 +43,9 @@ XOSERA_M68K_API?=../xosera_m68k_api
 # Maximum number of CPU cores to use before waiting with FMAX_TEST
 MAX_CPUS ?= 8
 
+# Number of simulation threads for multi-threaded Verilator build (vsim-mt)
+VTHREADS ?= 4
+
 # Xosera video mode selection:
 # Supported modes:                           (exact) (actual)
 #       MODE_640x400    640x400@70Hz    clock 25.175 (25.125) MHz
@@ -60,6 +63,9 @@ PF_B?=true
 
 # copper assembly
 COPASM=$(XOSERA_M68K_API)/bin/copasm
+# optional copasm assembly cache directory (e.g., COPASM_CACHE=/tmp/copasm_cache, off by default)
+COPASM_CACHE?=
+COPASM_CACHEOPT=$(if $(COPASM_CACHE),-C $(COPASM_CACHE))
 RESET_COP=default_copper.casm
 ifeq ($(findstring 640x,$(VIDEO_MODE)),)
 RESET_COPMEM=default_copper_848.mem
@@ -91,7 +97,29 @@ VERILOG_DEFS := -D$(VIDEO_MODE)
 #VRUN_TESTDATA ?=   -u ../testdata/raw/true_color_pal.raw -u ../testdata/raw/parrot_320x240_RG8B4.raw -u ../testdata/raw/ramptable.raw -u ../testdata/raw/sintable.raw
 #VRUN_TESTDATA ?=   -u ../testdata/raw/pacbox-320x240_pal.raw -u ../testdata/raw/pacbox-320x240.raw -u ../testdata/raw/moto_m_transp_4bpp.raw -u ../testdata/raw/true_color_pal.raw -u ../testdata/raw/parrot_320x240_RG8B4.raw -u ../testdata/raw/ramptable.raw -u ../testdata/raw/sintable.raw
 #VRUN_TESTDATA ?=   -u ../testdata/raw/ramptable.raw -u ../testdata/raw/sintable.raw
-VRUN_TESTDATA ?=   -u ../testdata/raw/moto_m_transp_4bpp.raw -u ../testdata/raw/xosera_r1_pal.raw -u ../testdata/raw/xosera_r1.raw ../testdata/raw/ramptable.raw -u ../testdata/raw/sintable.raw
+VRUN_TESTDATA ?=   -u ../testdata/raw/moto_m_transp_4bpp.raw -u ../testdata/raw/xosera_r1_pal.raw -u ../testdata/raw/xosera_r1.raw -u ../testdata/raw/ramptable.raw -u ../testdata/raw/sintable.raw
+
+# optional bus script (text or binary, see sim/bus_script.h) to use instead of built-in test_data
+# e.g., "make vrun VRUN_SCRIPT=mytest.xbus"
+VRUN_SCRIPT ?=
+ifneq ($(strip $(VRUN_SCRIPT)),)
+VRUN_TESTDATA += -s $(VRUN_SCRIPT)
+endif
+
+# simulation checkpoint (single-threaded vsim only, "make vcheckpoint" saves it after CHECKPOINT_FRAME)
+# e.g., "make vrun VRUN_RESTORE=sim/logs/xosera_vsim.ckpt VRUN_SCRIPT=scenario.txt"
+SAVABLE ?= 1
+CHECKPOINT_FRAME ?= 3
+CHECKPOINT_FILE ?= sim/logs/xosera_vsim.ckpt
+VRUN_RESTORE ?=
+ifneq ($(strip $(VRUN_RESTORE)),)
+VRUN_TESTDATA += --restore $(VRUN_RESTORE)
+endif
+ifeq ($(strip $(SAVABLE)),1)
+SAVABLE_ARGS := --savable -CFLAGS -DSIM_SAVABLE=1
+else
+SAVABLE_ARGS :=
+endif
 # Xosera test bed simulation target top (for Icaraus Verilog)
 TBTOP := xosera_tb
 
@@ -140,6 +168,7 @@ LOGS	:= sim/logs
 YOSYS_CONFIG := yosys-config
 TECH_LIB := $(shell $(YOSYS_CONFIG) --datdir/ice40/cells_sim.v)
 VLT_CONFIG := sim/ice40_config.vlt
+HIER_CONFIG := sim/hier_config.vlt
 
 # Icarus Verilog
 IVERILOG := iverilog
@@ -148,24 +177,58 @@ IVERILOG_ARGS := -g2012 -I$(SRCDIR) -Wall -l $(TECH_LIB)
 
 # Verilator C++ definitions and options
 SDL_RENDER := 1
+# libpng used to save frames (from background thread, SDL not required)
+SIM_LIBS := $(shell pkg-config --libs libpng) -lpthread
+SIM_CFLAGS := $(shell pkg-config --cflags libpng)
 ifeq ($(strip $(SDL_RENDER)),1)
-LDFLAGS := -LDFLAGS "$(shell sdl2-config --libs) -lSDL2_image"
-SDL_CFLAGS := $(shell sdl2-config --cflags)
+SIM_LIBS += $(shell sdl2-config --libs)
+SIM_CFLAGS += $(shell sdl2-config --cflags)
 endif
+LDFLAGS := -LDFLAGS "$(SIM_LIBS)"
 # Note: Using -Os seems to provide the fastest compile+run simulation iteration time
 # Linux gcc needs -Wno-maybe-uninitialized
-CFLAGS		:= -CFLAGS "-std=c++14 -Wall -Wextra -Werror -fomit-frame-pointer -Wno-deprecated-declarations -Wno-unused-but-set-variable -Wno-sign-compare -Wno-unused-parameter -Wno-unused-variable -Wno-bool-operation -Wno-int-in-bool-context -D$(VIDEO_MODE) -DSDL_RENDER=$(SDL_RENDER) -DBUS_INTERFACE=$(BUS_INTERFACE) $(SDL_CFLAGS)"
+CFLAGS		:= -CFLAGS "-std=c++14 -Wall -Wextra -Werror -fomit-frame-pointer -Wno-deprecated-declarations -Wno-unused-but-set-variable -Wno-sign-compare -Wno-unused-parameter -Wno-unused-variable -Wno-bool-operation -Wno-int-in-bool-context -D$(VIDEO_MODE) -DSDL_RENDER=$(SDL_RENDER) -DBUS_INTERFACE=$(BUS_INTERFACE) -DSIM_AUDIO=$(AUDIO) $(SIM_CFLAGS)"
 
 # Verilator tool (used for lint and simulation)
 VERILATOR := verilator
-VERILATOR_ARGS := --sv --language 1800-2012 --timing -I$(SRCDIR) -v $(TECH_LIB) $(VLT_CONFIG) -Mdir sim/obj_dir -Wall --trace-fst -Wno-DECLFILENAME -Wno-PINCONNECTEMPTY -Wno-STMTDLY -Wno-fatal
+VERILATOR_ARGS := --sv --language 1800-2012 --timing -I$(SRCDIR) -v $(TECH_LIB) $(VLT_CONFIG) -Wall --trace-fst -Wno-DECLFILENAME -Wno-PINCONNECTEMPTY -Wno-STMTDLY -Wno-fatal
 
 # Verillator C++ source driver
 CSRC := sim/xosera_sim.cpp
+CINC := $(filter-out %.vsim.h,$(wildcard sim/*.h))
+
+# number of frames to render with "make vbatch" (headless, PNG for each frame in $(LOGS))
+BATCH_FRAMES ?= 30
+
+# xvid_spi with "vsim" SPI transport (Verilated iCEBreaker top with SPI_INTERFACE, see ../xvid_spi/vsim_spi.cpp)
+XVID_SPI := ../xvid_spi
+XVID_SPI_SRC := $(XVID_SPI)/xvid_spi.cpp $(XVID_SPI)/spi_transport.cpp $(XVID_SPI)/vsim_spi.cpp
+XVID_SPI_INC := $(XVID_SPI)/spi_transport.h $(XVID_SPI)/buddy_font.h
+# xvid_spi screen capture renders with xosera_emu scanline renderer (see ../xosera_emu/scanline_render.h)
+XVID_SPI_EMU_LIB := ../xosera_emu/libxosera_emu.a
+SPI_DEFINES := $(filter-out -DUPDUINO,$(DEFINES)) -DICEBREAKER -DSPI_INTERFACE
+# xvid_spi arguments for "make vxvid_spi" (sync and reset, tests like "-T regs" take a long time Verilated)
+XVID_SPI_ARGS ?= -t vsim -r
+
+# number of random blits to compare with "make vblitdiff" (see sim/blit_diff.cpp)
+BLIT_TESTS ?= 100000
+BLIT_SEED ?= 0
+
+# parallel regression tests with "make vregress" (see sim/vregress.cpp)
+REGRESS_LIST ?= sim/regress.lst
+REGRESS_JOBS ?= $(MAX_CPUS)
+REGRESS_GOLDEN := sim/golden/$(VIDEO_MODE)
+REGRESS_ARGS ?=
 
 # copper asm source
 COPSRC := $(addsuffix .vsim.h,$(basename $(wildcard sim/*.casm)))
 
+# Verilator hierarchical blocks for multi-threaded simulation (verilated separately, then partitioned into threads)
+HIER_BLOCKS := video_gen blitter_slim copper_slim
+ifneq ($(strip $(AUDIO)),0)
+HIER_BLOCKS += audio_mixer_slim
+endif
+
 # default build native simulation executable
 all: $(RESET_COPMEM) $(COPASM) vsim isim
 .PHONY: all
@@ -191,6 +254,68 @@ vrun: $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim.mk
 .PHONY: vrun
 
 
+# build multi-threaded native simulation executable (no FST trace, tracing would serialize threads)
+vsim-mt: $(COPASM) $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir_mt/V$(VTOP) sim.mk
+	@echo === Verilator $(VTHREADS) thread simulation configured for: $(VIDEO_MODE) ===
+	@echo Completed building Verilator simulation, use \"make vrun-mt\" to run.
+.PHONY: vsim-mt
+
+# run multi-threaded native simulation executable headless
+vrun-mt: $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir_mt/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/obj_dir_mt/V$(VTOP) --threads $(VTHREADS) -H -f $(BATCH_FRAMES) $(VRUN_TESTDATA)
+.PHONY: vrun-mt
+
+# run single and multi-threaded simulations headless and report frames/sec speedup
+vspeed: $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim/obj_dir_mt/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/obj_dir/V$(VTOP) -H -f $(BATCH_FRAMES) $(VRUN_TESTDATA) | tee $(LOGS)/vspeed_st.txt
+	sim/obj_dir_mt/V$(VTOP) --threads $(VTHREADS) -H -f $(BATCH_FRAMES) $(VRUN_TESTDATA) | tee $(LOGS)/vspeed_mt.txt
+	ST_FPS=$$(sed -n 's/^Simulation speed: *\([0-9.]*\) frames\/sec.*/\1/p' $(LOGS)/vspeed_st.txt)
+	MT_FPS=$$(sed -n 's/^Simulation speed: *\([0-9.]*\) frames\/sec.*/\1/p' $(LOGS)/vspeed_mt.txt)
+	awk -v st=$$ST_FPS -v mt=$$MT_FPS -v n=$(VTHREADS) 'BEGIN { printf("=== %d frames: 1 thread %.3f frames/sec, %d threads %.3f frames/sec, speedup %.2fx\n", $(BATCH_FRAMES), st, n, mt, (st > 0) ? mt / st : 0) }'
+.PHONY: vspeed
+
+# run native simulation executable headless (no SDL window) saving BATCH_FRAMES frames as PNG
+vbatch: $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/obj_dir/V$(VTOP) -H -f $(BATCH_FRAMES) $(VRUN_TESTDATA)
+.PHONY: vbatch
+
+# run all tests in REGRESS_LIST headless in parallel and check frame hashes against golden hashes
+vregress: sim/vregress $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/vregress -j $(REGRESS_JOBS) -s sim/obj_dir/V$(VTOP) -o $(LOGS)/regress -g $(REGRESS_GOLDEN) $(REGRESS_ARGS) $(REGRESS_LIST)
+.PHONY: vregress
+
+# run all tests in REGRESS_LIST and save results as new golden hashes (after verifying changes are intended)
+# use REGRESS_ARGS=-i to also save golden frame images (so mismatched frames get a diff image)
+vregress-update: sim/vregress $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/vregress -u -j $(REGRESS_JOBS) -s sim/obj_dir/V$(VTOP) -o $(LOGS)/regress -g $(REGRESS_GOLDEN) $(REGRESS_ARGS) $(REGRESS_LIST)
+.PHONY: vregress-update
+
+# parallel regression test runner (and check REGRESS_LIST parses, without needing the simulator built)
+sim/vregress: sim/vregress.cpp $(REGRESS_LIST) sim.mk
+	$(CXX) -O2 -std=c++14 -Wall -Wextra -Werror -o $@ $< -lpthread
+	$@ --list $(REGRESS_LIST) >/dev/null || (rm -f $@ && false)
+
+# run randomized differential test of blitter_slim RTL vs C++ model (sim/blitter_model.h)
+vblitdiff: sim/obj_dir_blit/Vblit_diff_top sim.mk
+	sim/obj_dir_blit/Vblit_diff_top -n $(BLIT_TESTS) -s $(BLIT_SEED)
+.PHONY: vblitdiff
+
+# run xvid_spi tests over SPI on Verilated iCEBreaker top (spi_target.sv and xosera_main.sv)
+vxvid_spi: sim/obj_dir_spi/Vxosera_iceb sim.mk
+	cd $(XVID_SPI) && $(current_dir)/sim/obj_dir_spi/Vxosera_iceb $(XVID_SPI_ARGS)
+.PHONY: vxvid_spi
+
+# run native simulation executable headless until CHECKPOINT_FRAME and save checkpoint as CHECKPOINT_FILE
+vcheckpoint: $(RESET_COPMEM) $(VLT_CONFIG) sim/obj_dir/V$(VTOP) sim.mk
+	@mkdir -p $(LOGS)
+	sim/obj_dir/V$(VTOP) -H -f $$(($(CHECKPOINT_FRAME) + 1)) --checkpoint $(CHECKPOINT_FRAME) $(CHECKPOINT_FILE) $(VRUN_TESTDATA)
+.PHONY: vcheckpoint
+
 # run Verilator to build and run native simulation executable
 irun: $(RESET_COPMEM) $(VLT_CONFIG) sim/$(TBTOP) sim.mk
 	@mkdir -p $(LOGS)
@@ -206,10 +331,16 @@ $(VLT_CONFIG):
 	@echo >>$(VLT_CONFIG) lint_off -rule UNDRIVEN   -file \"$(TECH_LIB)\"
 	@echo >>$(VLT_CONFIG) lint_off -rule GENUNNAMED -file \"$(TECH_LIB)\"
 
+# mark hierarchical blocks for multi-threaded Verilator build
+$(HIER_CONFIG): sim.mk
+	@echo >$(HIER_CONFIG)
+	@echo >>$(HIER_CONFIG) \`verilator_config
+	@for m in $(HIER_BLOCKS) ; do echo >>$(HIER_CONFIG) hier_block -module \"$$m\" ; done
+
 # assemble casm into mem file
 cop_init:  $(COPASM) $(RESET_COP)
 	@mkdir -p $(@D)
-	$(COPASM) -b 4096 $(COPASMOPT) -l -i $(XOSERA_M68K_API) -o $(addsuffix .mem,$(basename $(RESET_COP))) $(RESET_COP)
+	$(COPASM) -b 4096 $(COPASMOPT) -l $(COPASM_CACHEOPT) -i $(XOSERA_M68K_API) -o $(addsuffix .mem,$(basename $(RESET_COP))) $(RESET_COP)
 
 cop_clean:
 	rm -f $(addsuffix .lst,$(basename $(RESET_COP))) $(addsuffix .mem,$(basename $(RESET_COP)))
@@ -217,23 +348,44 @@ cop_clean:
 # assembler copper file
 %.vsim.h : %.casm
 	@mkdir -p $(@D)
-	$(COPASM) $(COPASMOPT) -l -i $(XOSERA_M68K_API) -o $@ $<
+	$(COPASM) $(COPASMOPT) -l $(COPASM_CACHEOPT) -i $(XOSERA_M68K_API) -o $@ $<
 
 # use Verilator to build native simulation executable
-sim/obj_dir/V$(VTOP): $(VLT_CONFIG) $(CSRC) $(INC) $(SRC) $(RESET_COPMEM) $(COPSRC) sim.mk
+sim/obj_dir/V$(VTOP): $(VLT_CONFIG) $(CSRC) $(CINC) $(INC) $(SRC) $(RESET_COPMEM) $(COPSRC) sim.mk
 	@mkdir -p $(@D)
-	$(VERILATOR) $(VERILATOR_ARGS) -O3 --cc --exe --trace $(DEFINES) $(CFLAGS) $(LDFLAGS) --top-module $(VTOP) $(SRC) $(current_dir)/$(CSRC)
+	$(VERILATOR) $(VERILATOR_ARGS) -Mdir sim/obj_dir -O3 --cc --exe --trace $(SAVABLE_ARGS) $(DEFINES) $(CFLAGS) $(LDFLAGS) --top-module $(VTOP) $(SRC) $(current_dir)/$(CSRC)
 	cd sim/obj_dir && make -f V$(VTOP).mk
 
+# use Verilator to build multi-threaded native simulation executable (using hierarchical blocks)
+sim/obj_dir_mt/V$(VTOP): $(VLT_CONFIG) $(HIER_CONFIG) $(CSRC) $(CINC) $(INC) $(SRC) $(RESET_COPMEM) $(COPSRC) sim.mk
+	@mkdir -p $(@D)
+	$(VERILATOR) $(VERILATOR_ARGS) $(HIER_CONFIG) -Mdir sim/obj_dir_mt -O3 --cc --exe --threads $(VTHREADS) --hierarchical $(DEFINES) $(CFLAGS) -CFLAGS -DSIM_HIER_BLOCKS=1 $(LDFLAGS) --top-module $(VTOP) $(SRC) $(current_dir)/$(CSRC)
+	cd sim/obj_dir_mt && make -j$(MAX_CPUS) -f V$(VTOP).mk
+
+# use Verilator to build blitter differential test (just blitter_slim, vram_arb and vram)
+sim/obj_dir_blit/Vblit_diff_top: $(VLT_CONFIG) sim/blit_diff_top.sv blitter_slim.sv vram_arb.sv vram.sv xosera_pkg.sv sim/blit_diff.cpp sim/blitter_model.h sim.mk
+	@mkdir -p $(@D)
+	$(VERILATOR) $(VERILATOR_ARGS) -Mdir sim/obj_dir_blit -O3 --cc --exe $(DEFINES) -CFLAGS "-std=c++14 -O2 -Wall -Wextra -Werror -Wno-unused-parameter" --top-module blit_diff_top sim/blit_diff_top.sv blitter_slim.sv vram_arb.sv vram.sv $(current_dir)/sim/blit_diff.cpp
+	cd sim/obj_dir_blit && make -f Vblit_diff_top.mk
+
+# use Verilator to build xvid_spi with Verilated iCEBreaker top as "vsim" SPI transport
+sim/obj_dir_spi/Vxosera_iceb: $(VLT_CONFIG) icebreaker/xosera_iceb.sv $(INC) $(SRC) $(RESET_COPMEM) $(XVID_SPI_SRC) $(XVID_SPI_INC) $(XVID_SPI_EMU_LIB) sim.mk
+	@mkdir -p $(@D)
+	$(VERILATOR) $(VERILATOR_ARGS) -Mdir sim/obj_dir_spi -O3 --cc --exe $(SPI_DEFINES) -CFLAGS "-std=c++17 -O2 -Wall -Wextra -D$(VIDEO_MODE) -DHOST_SPI_NO_FTDI -DHOST_SPI_VSIM -I$(current_dir)/$(XVID_SPI)" -LDFLAGS "$(current_dir)/$(XVID_SPI_EMU_LIB) -lpng -lpthread" --top-module xosera_iceb icebreaker/xosera_iceb.sv $(SRC) $(addprefix $(current_dir)/,$(XVID_SPI_SRC))
+	cd sim/obj_dir_spi && make -f Vxosera_iceb.mk
+
+$(XVID_SPI_EMU_LIB): $(wildcard ../xosera_emu/*.cpp ../xosera_emu/*.h)
+	$(MAKE) -C ../xosera_emu VIDEO_MODE=$(VIDEO_MODE) libxosera_emu.a
+
 # use Icarus Verilog to build vvp simulation executable
 sim/$(TBTOP): $(INC) sim/$(TBTOP).sv $(SRC) $(RESET_COPMEM) $(COPASM) sim.mk
 	@mkdir -p $(@D)
-	$(VERILATOR) $(VERILATOR_ARGS) --lint-only $(DEFINES)  -v $(TECH_LIB) --top-module $(TBTOP) sim/$(TBTOP).sv $(SRC)
+	$(VERILATOR) $(VERILATOR_ARGS) -Mdir sim/obj_dir --lint-only $(DEFINES)  -v $(TECH_LIB) --top-module $(TBTOP) sim/$(TBTOP).sv $(SRC)
 	$(IVERILOG) $(IVERILOG_ARGS) $(DEFINES) -D$(VIDEO_MODE) -o sim/$(TBTOP) $(current_dir)/sim/$(TBTOP).sv $(SRC)
 
 # delete all targets that will be re-generated
 clean:
-	rm -rf sim/obj_dir $(VLT_CONFIG) sim/$(TBTOP) sim/*.vsim.h sim/*.lst
+	rm -rf sim/obj_dir sim/obj_dir_mt sim/obj_dir_blit sim/obj_dir_spi sim/vregress $(VLT_CONFIG) $(HIER_CONFIG) sim/$(TBTOP) sim/*.vsim.h sim/*.lst
 .PHONY: clean
 
 # prevent make from deleting any intermediate files
@@ -0,0 +1,372 @@
+// blit_diff.cpp - randomized differential test of Verilated blitter_slim vs C++ blitter model
+//
+// vim: set et ts=4 sw=4
+//
+// Runs random blits (random VRAM contents, addresses, modulos, shifts, masks,
+// transparency, ANDC/XOR and S constant, with optional VRAM contention and
+// queued blits) on both the Verilated blitter_slim (blit_diff_top.sv) and
+// BlitterModel (blitter_model.h).  After each test VRAM is compared, along with
+// done interrupts and blitter busy cycles (when uncontended).  Finally all blits
+// are replayed on the model alone to compare its speed with the RTL simulation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "verilated.h"
+
+#include "Vblit_diff_top.h"
+
+#include "Vblit_diff_top_blit_diff_top.h"
+#include "Vblit_diff_top_vram.h"
+#include "Vblit_diff_top_vram_arb.h"
+
+#include "blitter_model.h"
+
+#define VRAM_WORDS     65536
+#define RANDOMIZE_VRAM 256        // tests between VRAM randomize
+
+// blitter registers in XR_BLIT_CTRL - XR_BLIT_WORDS order
+struct BlitParams
+{
+    uint16_t reg[10];
+};
+
+vluint64_t main_time;        // current simulation time (64-bit unsigned)
+
+double sc_time_stamp()
+{
+    return main_time;
+}
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint32_t rnd()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+static uint32_t rnd(uint32_t n)
+{
+    return rnd() % n;
+}
+
+// random blit, biased toward small and interesting values
+static BlitParams random_blit()
+{
+    BlitParams bp;
+    uint16_t   ctrl = rnd(4) == 0 ? BLIT_CTRL_SCONST_F : 0;
+    if (rnd(2))
+    {
+        ctrl |= BLIT_CTRL_TRANSP_F | (rnd(2) ? BLIT_CTRL_8B_F : 0);
+        ctrl |= (rnd(2) ? 0 : rnd(256)) << BLIT_CTRL_TRANSPVAL_B;
+    }
+    bp.reg[XR_BLIT_CTRL - XR_BLIT_CTRL]  = ctrl | (rnd(8) == 0 ? (rnd(0x10000) & 0x00ce) : 0);        // unused bits
+    bp.reg[XR_BLIT_ANDC - XR_BLIT_CTRL]  = rnd(2) ? 0 : rnd(0x10000);
+    bp.reg[XR_BLIT_XOR - XR_BLIT_CTRL]   = rnd(2) ? 0 : rnd(0x10000);
+    bp.reg[XR_BLIT_MOD_S - XR_BLIT_CTRL] = rnd(4) == 0 ? rnd(0x10000) : rnd(129) - 64;
+    bp.reg[XR_BLIT_SRC_S - XR_BLIT_CTRL] = rnd(0x10000);
+    bp.reg[XR_BLIT_MOD_D - XR_BLIT_CTRL] = rnd(4) == 0 ? rnd(0x10000) : rnd(129) - 64;
+    bp.reg[XR_BLIT_DST_D - XR_BLIT_CTRL] = rnd(4) == 0 ? bp.reg[XR_BLIT_SRC_S - XR_BLIT_CTRL] + rnd(17) - 8 : rnd(0x10000);
+    bp.reg[XR_BLIT_SHIFT - XR_BLIT_CTRL] = rnd(2) ? 0xff00 | rnd(4) : rnd(0x10000);
+    bp.reg[XR_BLIT_LINES - XR_BLIT_CTRL] = rnd(8) == 0 ? rnd(256) : rnd(16);
+    bp.reg[XR_BLIT_WORDS - XR_BLIT_CTRL] = rnd(8) == 0 ? rnd(320) : rnd(32);
+
+    return bp;
+}
+
+static void print_blit(const BlitParams & bp)
+{
+    static const char * names[10] = {"CTRL", "ANDC", "XOR", "MOD_S", "SRC_S", "MOD_D", "DST_D", "SHIFT", "LINES", "WORDS"};
+    for (int r = 0; r < 10; r++)
+    {
+        printf(" %s=0x%04x", names[r], bp.reg[r]);
+    }
+    printf("\n");
+}
+
+class BlitDiff
+{
+    Vblit_diff_top * top;
+    uint16_t *       rtl_vram;
+    bool             contention;
+    uint64_t         busy_cycles;
+    uint64_t         done_intrs;
+
+public:
+    uint64_t total_cycles = 0;
+
+    explicit BlitDiff(Vblit_diff_top * _top)
+        : top(_top)
+        , contention(false)
+        , busy_cycles(0)
+        , done_intrs(0)
+    {
+        auto & vmem = top->blit_diff_top->vram_arb->vram->memory;
+        rtl_vram    = &vmem[0];
+    }
+
+    uint16_t * vram() { return rtl_vram; }
+
+    void tick()
+    {
+        top->vgen_sel_i = contention && rnd(4) == 0;
+        top->clk        = 0;
+        top->eval();
+        main_time++;
+        top->clk = 1;
+        top->eval();
+        main_time++;
+        total_cycles++;
+
+        busy_cycles += top->blit_busy_o;
+        done_intrs += top->blit_done_intr_o;
+    }
+
+    void reset()
+    {
+        top->reset_i      = 1;
+        top->xreg_wr_en_i = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            tick();
+        }
+        top->reset_i = 0;
+        tick();
+    }
+
+    void start_test(bool contend)
+    {
+        contention  = contend;
+        busy_cycles = 0;
+        done_intrs  = 0;
+    }
+
+    void write_reg(uint16_t xr_reg, uint16_t value)
+    {
+        top->xreg_wr_en_i = 1;
+        top->xreg_num_i   = xr_reg & 0xf;
+        top->xreg_data_i  = value;
+        tick();
+        top->xreg_wr_en_i = 0;
+    }
+
+    // wait until blitter can accept another blit (returns false on timeout)
+    bool wait_ready(uint64_t timeout)
+    {
+        while (top->blit_full_o)
+        {
+            if (timeout-- == 0)
+            {
+                return false;
+            }
+            tick();
+        }
+        return true;
+    }
+
+    // wait until all blits are done (returns false on timeout)
+    bool wait_done(uint64_t timeout)
+    {
+        tick();        // let queued blit start
+        while (top->blit_busy_o || top->blit_full_o)
+        {
+            if (timeout-- == 0)
+            {
+                return false;
+            }
+            tick();
+        }
+        return true;
+    }
+
+    uint64_t busy() const { return busy_cycles; }
+    uint64_t intrs() const { return done_intrs; }
+};
+
+int main(int argc, char ** argv)
+{
+    uint64_t num_tests = 100000;
+    uint64_t seed      = 0;
+    bool     verbose   = false;
+
+    int nextarg = 1;
+    while (nextarg < argc && argv[nextarg][0] == '-')
+    {
+        if (strcmp(argv[nextarg], "-n") == 0 && nextarg + 1 < argc)
+        {
+            num_tests = strtoull(argv[++nextarg], nullptr, 0);
+        }
+        else if (strcmp(argv[nextarg], "-s") == 0 && nextarg + 1 < argc)
+        {
+            seed = strtoull(argv[++nextarg], nullptr, 0);
+        }
+        else if (strcmp(argv[nextarg], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else
+        {
+            printf("Usage: %s [-n tests] [-s seed] [-v]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        nextarg++;
+    }
+    if (seed == 0)
+    {
+        seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    rng_state = seed | 1;
+    printf("Blitter differential test: %lu tests, seed 0x%lx\n", num_tests, seed);
+
+    Verilated::commandArgs(argc, argv);
+    Vblit_diff_top * top = new Vblit_diff_top;
+    BlitDiff         rtl(top);
+    rtl.reset();
+
+    static uint16_t         model_vram[VRAM_WORDS];
+    static uint16_t         start_vram[VRAM_WORDS];
+    BlitterModel            model(model_vram);
+    std::vector<BlitParams> history;        // all blits, to replay for model speed
+    uint64_t                model_cycles = 0;
+    uint64_t                failures     = 0;
+
+    auto rtl_start = std::chrono::steady_clock::now();
+    for (uint64_t test = 0; test < num_tests && failures == 0; test++)
+    {
+        if ((test % RANDOMIZE_VRAM) == 0)
+        {
+            for (int i = 0; i < VRAM_WORDS; i++)
+            {
+                model_vram[i] = rnd(0x10000);
+            }
+            memcpy(rtl.vram(), model_vram, sizeof(model_vram));
+            if (history.empty())
+            {
+                memcpy(start_vram, model_vram, sizeof(model_vram));
+            }
+        }
+
+        bool contend    = rnd(4) == 0;        // video VRAM access stalls blitter
+        bool queued     = rnd(4) == 0;        // write next blit while blitter busy
+        int  num_blits  = queued ? 2 + rnd(2) : 1;
+
+        BlitParams blits[3];
+        uint64_t   expected = 0;
+        rtl.start_test(contend);
+        for (int b = 0; b < num_blits; b++)
+        {
+            blits[b] = random_blit();
+            if (!rtl.wait_ready(1000000))
+            {
+                printf("Test %lu: TIMEOUT waiting for blitter ready\n", test);
+                failures++;
+                break;
+            }
+            for (int r = 0; r < 10; r++)
+            {
+                rtl.write_reg(XR_BLIT_CTRL + r, blits[b].reg[r]);
+                expected += model.write_reg(XR_BLIT_CTRL + r, blits[b].reg[r]);
+            }
+            if (history.size() < 2000000)
+            {
+                history.push_back(blits[b]);
+            }
+        }
+        if (failures)
+        {
+            break;
+        }
+        model_cycles += expected;
+
+        bool ok = rtl.wait_done(expected * 8 + 10000);
+        if (!ok)
+        {
+            printf("Test %lu: TIMEOUT waiting for blit done\n", test);
+        }
+        if (ok && rtl.intrs() != (uint64_t)num_blits)
+        {
+            printf("Test %lu: %lu done interrupts, expected %d\n", test, rtl.intrs(), num_blits);
+            ok = false;
+        }
+        if (ok && !contend && !queued && rtl.busy() != expected)
+        {
+            printf("Test %lu: blitter busy %lu cycles, model %lu\n", test, rtl.busy(), expected);
+            ok = false;
+        }
+        if (ok && memcmp(rtl.vram(), model_vram, sizeof(model_vram)) != 0)
+        {
+            int shown = 0;
+            for (int i = 0; i < VRAM_WORDS && shown < 16; i++)
+            {
+                if (rtl.vram()[i] != model_vram[i])
+                {
+                    printf("Test %lu: VRAM[0x%04x] RTL=0x%04x model=0x%04x\n", test, i, rtl.vram()[i], model_vram[i]);
+                    shown++;
+                }
+            }
+            ok = false;
+        }
+        if (!ok)
+        {
+            printf("Test %lu FAILED (%s%s):\n", test, contend ? "contended " : "", queued ? "queued" : "");
+            for (int b = 0; b < num_blits; b++)
+            {
+                print_blit(blits[b]);
+            }
+            failures++;
+        }
+        else if (verbose)
+        {
+            printf("Test %lu passed (%d blit%s, %lu cycles)\n", test, num_blits, num_blits == 1 ? "" : "s", expected);
+        }
+        if (((test + 1) % 100000) == 0)
+        {
+            printf("%lu tests passed...\n", test + 1);
+            fflush(stdout);
+        }
+    }
+    double rtl_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - rtl_start).count();
+
+    top->final();
+
+    // replay the same blits on the model alone
+    memcpy(model_vram, start_vram, sizeof(model_vram));
+    BlitterModel replay(model_vram);
+    auto         model_start = std::chrono::steady_clock::now();
+    for (auto & bp : history)
+    {
+        for (int r = 0; r < 10; r++)
+        {
+            replay.write_reg(XR_BLIT_CTRL + r, bp.reg[r]);
+        }
+    }
+    double model_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - model_start).count();
+
+    printf("%s: %lu blits, %lu words, %lu blitter cycles\n",
+           failures ? "FAILED" : "PASSED",
+           model.blits(),
+           model.words(),
+           model_cycles);
+    printf("RTL simulation: %0.03f sec (%lu cycles, %0.0f blits/sec)\n",
+           rtl_seconds,
+           rtl.total_cycles,
+           rtl_seconds > 0.0 ? model.blits() / rtl_seconds : 0.0);
+    printf("C++ model:      %0.03f sec (%lu blits replayed, %0.0f blits/sec, %0.1fx faster)\n",
+           model_seconds,
+           replay.blits(),
+           model_seconds > 0.0 ? replay.blits() / model_seconds : 0.0,
+           (model_seconds > 0.0 && rtl_seconds > 0.0)
+               ? (rtl_seconds / model.blits()) / (model_seconds / (replay.blits() ? replay.blits() : 1))
+               : 0.0);
+
+    delete top;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+// blit_diff_top.sv
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// Verilator top for blitter differential test (blit_diff.cpp), just blitter_slim
+// with vram_arb and VRAM (video generation VRAM access can be used to stall blitter).
+
+`default_nettype none               // mandatory for Verilog sanity
+`timescale 1ns/1ps                  // mandatory to shut up Icarus Verilog
+
+`include "xosera_pkg.sv"
+
+module blit_diff_top(
+    input  wire logic           xreg_wr_en_i,       // strobe to write blitter register
+    input  wire logic  [3:0]    xreg_num_i,         // blitter register number (XR_BLIT_CTRL - XR_BLIT_WORDS)
+    input  wire word_t          xreg_data_i,        // data for blitter register
+    input  wire logic           vgen_sel_i,         // video generation VRAM select (stalls blitter)
+    output      logic           blit_busy_o,        // blitter idle or busy status
+    output      logic           blit_full_o,        // blitter ready or queue full status
+    output      logic           blit_done_intr_o,   // interrupt signal when done
+    input  wire logic           reset_i,            // system reset in
+    input  wire logic           clk                 // clock
+);
+
+logic           blit_vram_sel;
+logic           blit_vram_ack;
+logic           blit_wr;
+logic  [3:0]    blit_wr_mask;
+addr_t          blit_vram_addr;
+word_t          blit_vram_data;
+word_t          vram_data_out;
+
+blitter_slim blitter(
+    .xreg_wr_en_i(xreg_wr_en_i),
+    .xreg_num_i(xreg_num_i),
+    .xreg_data_i(xreg_data_i),
+    .blit_busy_o(blit_busy_o),
+    .blit_full_o(blit_full_o),
+    .blit_done_intr_o(blit_done_intr_o),
+    .blit_vram_sel_o(blit_vram_sel),
+    .blit_vram_ack_i(blit_vram_ack),
+    .blit_wr_o(blit_wr),
+    .blit_wr_mask_o(blit_wr_mask),
+    .blit_addr_o(blit_vram_addr),
+    .blit_data_i(vram_data_out),
+    .blit_data_o(blit_vram_data),
+    .reset_i(reset_i),
+    .clk(clk)
+);
+
+vram_arb vram_arb(
+    .vram_data_o(vram_data_out),
+    .vgen_sel_i(vgen_sel_i),
+    .vgen_addr_i('0),
+    .regs_sel_i(1'b0),
+    .regs_ack_o(),
+    .regs_wr_i(1'b0),
+    .regs_wr_mask_i('0),
+    .regs_addr_i('0),
+    .regs_data_i('0),
+    .blit_sel_i(blit_vram_sel),
+    .blit_ack_o(blit_vram_ack),
+    .blit_wr_i(blit_wr),
+    .blit_wr_mask_i(blit_wr_mask),
+    .blit_addr_i(blit_vram_addr),
+    .blit_data_i(blit_vram_data),
+    .clk(clk)
+);
+
+endmodule
+`default_nettype wire               // restore default
@@ -0,0 +1,217 @@
+// blitter_model.h - C++ reference model of Xosera blitter_slim.sv
+//
+// vim: set et ts=4 sw=4
+//
+// Functional model of the blitter with the same results as the RTL (including
+// the nibble shift carrying the previous S word between lines and blits, first
+// and last word masks, 4-bit or 8-bit transparency and VRAM address wrap).
+// Each blit runs to completion when XR_BLIT_WORDS is written and the number of
+// clock cycles the RTL blitter is busy (with no VRAM contention) is counted.
+//
+// Can be used stand-alone as a host-side blit emulator on a 64K word VRAM
+// array, or to check the Verilated blitter_slim (see blit_diff.cpp).
+
+#if !defined(BLITTER_MODEL_H)
+#define BLITTER_MODEL_H
+
+#include <stdint.h>
+
+#include "../../xosera_m68k_api/xosera_m68k_defs.h"
+
+class BlitterModel
+{
+    uint16_t * vram;        // 64K words of VRAM (16-bit address wraps)
+
+    // blit registers (queued blit, copied when blit starts like RTL)
+    uint16_t reg_ctrl;
+    uint16_t reg_andc;
+    uint16_t reg_xor;
+    uint16_t reg_mod_s;
+    uint16_t reg_src_s;
+    uint16_t reg_mod_d;
+    uint16_t reg_dst_d;
+    uint16_t reg_shift;
+    uint16_t reg_lines;
+
+    uint16_t last_s;        // previous S word (low 12 bits shifted in), persists like RTL
+
+    uint64_t total_cycles;        // RTL blitter busy cycles for all blits
+    uint64_t total_blits;
+    uint64_t total_words;
+
+    // nibble shift right with nibbles from previous word (matches RTL shifter)
+    static uint16_t shifter(int shift_amount, uint16_t data_word, uint16_t prev_word)
+    {
+        switch (shift_amount & 3)
+        {
+            case 1:
+                return (prev_word << 12) | (data_word >> 4);        // dABC
+            case 2:
+                return (prev_word << 8) | (data_word >> 8);        // cdAB
+            case 3:
+                return (prev_word << 4) | (data_word >> 12);        // bcdA
+            default:
+                return data_word;        // ABCD
+        }
+    }
+
+    // nibble write mask for transparency (bit 3 is high nibble), 0xF if transparency disabled
+    static int transp_mask(uint16_t value, bool transp, bool transp_8b, uint8_t transp_t)
+    {
+        if (!transp)
+        {
+            return 0xF;
+        }
+        if (transp_8b)
+        {
+            int hi = (value >> 8) != transp_t ? 0xC : 0;
+            int lo = (value & 0xff) != transp_t ? 0x3 : 0;
+            return hi | lo;
+        }
+        int mask = 0;
+        for (int n = 0; n < 4; n++)
+        {
+            uint8_t t = (n & 1) ? (transp_t >> 4) : (transp_t & 0xf);
+            if (((value >> (n * 4)) & 0xf) != t)
+            {
+                mask |= 1 << n;
+            }
+        }
+        return mask;
+    }
+
+    // write word to VRAM with nibble mask (like vram.sv)
+    void write_masked(uint16_t addr, uint16_t value, int mask)
+    {
+        uint16_t bits = ((mask & 0x8) ? 0xf000 : 0) | ((mask & 0x4) ? 0x0f00 : 0) | ((mask & 0x2) ? 0x00f0 : 0) |
+                        ((mask & 0x1) ? 0x000f : 0);
+        vram[addr]    = (vram[addr] & ~bits) | (value & bits);
+    }
+
+    // perform blit with current registers and word count (returns RTL busy cycles)
+    uint32_t do_blit(uint16_t words)
+    {
+        bool     s_const   = reg_ctrl & BLIT_CTRL_SCONST_F;
+        bool     transp    = reg_ctrl & BLIT_CTRL_TRANSP_F;
+        bool     transp_8b = reg_ctrl & BLIT_CTRL_8B_F;
+        uint8_t  transp_t  = reg_ctrl >> BLIT_CTRL_TRANSPVAL_B;
+        int      shift     = reg_shift & 0x3;
+        int      f_mask    = (reg_shift >> 12) & 0xf;
+        int      l_mask    = (reg_shift >> 8) & 0xf;
+        uint16_t src       = reg_src_s;
+        uint16_t dst       = reg_dst_d;
+        uint16_t val_s     = reg_src_s;        // constant S value (if S const)
+        uint16_t lines     = reg_lines;
+        uint32_t cycles    = 1;                // SETUP
+
+        do
+        {
+            lines--;        // pre-decrement, bit 15 underflow indicates last line
+            uint32_t count = (words - 1u) & 0x1ffff;        // pre-decrement, bit 16 underflow indicates last word
+            int      mask  = f_mask;
+            bool     last_word;
+
+            cycles += 2;        // LINE_BEG + LINE_END
+            do
+            {
+                last_word = count & 0x10000;
+                if (!s_const)
+                {
+                    uint16_t data = vram[src++];
+                    val_s         = shifter(shift, data, last_s);
+                    last_s        = data & 0x0fff;
+                    cycles += 2;        // RD_S (select + ack)
+                }
+                uint16_t val_d_ca = val_s & ~reg_andc;
+                int      wr_mask  = mask & (last_word ? l_mask : 0xf);
+                wr_mask &= transp_mask(val_d_ca, transp, transp_8b, transp_t);
+                write_masked(dst++, val_d_ca ^ reg_xor, wr_mask);
+                cycles += 2;        // WR_D (select + ack)
+                total_words++;
+
+                mask  = 0xf;
+                count = (count - 1) & 0x1ffff;
+            } while (!last_word);
+
+            src += reg_mod_s;
+            dst += reg_mod_d;
+        } while (!(lines & 0x8000));
+
+        return cycles;
+    }
+
+public:
+    explicit BlitterModel(uint16_t * vram_words)
+        : vram(vram_words)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        reg_ctrl     = 0;
+        reg_andc     = 0;
+        reg_xor      = 0;
+        reg_mod_s    = 0;
+        reg_src_s    = 0;
+        reg_mod_d    = 0;
+        reg_dst_d    = 0;
+        reg_shift    = 0;
+        reg_lines    = 0;
+        last_s       = 0;
+        total_cycles = 0;
+        total_blits  = 0;
+        total_words  = 0;
+    }
+
+    // write blitter XR register (XR_BLIT_CTRL - XR_BLIT_WORDS), writing XR_BLIT_WORDS performs blit
+    // (returns RTL busy cycles for blit, or 0 if no blit started)
+    uint32_t write_reg(uint16_t xr_reg, uint16_t value)
+    {
+        switch (xr_reg)
+        {
+            case XR_BLIT_CTRL:
+                reg_ctrl = value & (BLIT_CTRL_TRANSPVAL_G | BLIT_CTRL_8B_F | BLIT_CTRL_TRANSP_F | BLIT_CTRL_SCONST_F);
+                break;
+            case XR_BLIT_ANDC:
+                reg_andc = value;
+                break;
+            case XR_BLIT_XOR:
+                reg_xor = value;
+                break;
+            case XR_BLIT_MOD_S:
+                reg_mod_s = value;
+                break;
+            case XR_BLIT_SRC_S:
+                reg_src_s = value;
+                break;
+            case XR_BLIT_MOD_D:
+                reg_mod_d = value;
+                break;
+            case XR_BLIT_DST_D:
+                reg_dst_d = value;
+                break;
+            case XR_BLIT_SHIFT:
+                reg_shift = value & 0xff03;
+                break;
+            case XR_BLIT_LINES:
+                reg_lines = value;
+                break;
+            case XR_BLIT_WORDS: {
+                uint32_t cycles = do_blit(value);
+                total_cycles += cycles;
+                total_blits++;
+                return cycles;
+            }
+            default:
+                break;
+        }
+        return 0;
+    }
+
+    uint64_t cycles() const { return total_cycles; }
+    uint64_t blits() const { return total_blits; }
+    uint64_t words() const { return total_words; }
+};
+
+#endif        // BLITTER_MODEL_H
@@ -0,0 +1,626 @@
+// bus_script.h - run-time loaded bus command scripts for Xosera Verilator simulation
+//
+// vim: set et ts=4 sw=4
+//
+// A bus script is the same list of 16-bit bus command words as the compiled-in
+// BusInterface::test_data (REG_W(), REG_WAITVSYNC() etc.), but loaded when the
+// simulation starts, so new test sequences do not need the Verilated model
+// re-built.  Scripts and upload payloads are memory-mapped, so there is no limit
+// on script length or number of uploads.
+//
+// Binary script (streamed in place from the memory-mapped file, big-endian):
+//
+//      "XBUS"                      magic
+//      0x0001                      16-bit version
+//      0x0000                      16-bit reserved
+//      <bus command words...>      same encoding as test_data (0xFFFF REG_END)
+//
+//      After each REG_UPLOAD (0xFFF0) or REG_UPLOAD_AUX (0xFFF1) word:
+//      <length high> <length low>  32-bit payload byte length (0 = use next -u file)
+//      <payload bytes...>          payload, padded to an even number of bytes
+//
+// Text script (any file without "XBUS" magic), one command per line, with
+// ";", "#" or "//" comments, and numbers in C notation (0x1234 or 4660):
+//
+//      REG_W       <xm_reg> <word>     write word to XM register (name or number)
+//      REG_BH      <xm_reg> <byte>     write byte to XM register [15:8]
+//      REG_BL      <xm_reg> <byte>     write byte to XM register [7:0]
+//      REG_RW      <xm_reg>            read word from XM register
+//      XREG_SETW   <xr_reg> <word>     write word to XR register (name or number)
+//      XMEM_SETW   <xr_addr> <word>    write word to XR memory address
+//      REG_UPLOAD  [file]              upload file (or next -u file) to XM_DATA
+//      REG_UPLOAD_AUX [file]           upload file (or next -u file) to XM_XDATA
+//      REG_WAITHSYNC, REG_WAITVSYNC, REG_WAITVTOP, REG_WAIT_BLIT_READY, REG_WAIT_BLIT_DONE, REG_END
+//      WORD        <word> ...          raw bus command words
+
+#if !defined(BUS_SCRIPT_H)
+#define BUS_SCRIPT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../xosera_m68k_api/xosera_m68k_defs.h"
+
+// bus command words (see REG_xxx macros in xosera_sim.cpp)
+enum
+{
+    BUS_CMD_UPLOAD          = 0xfff0,
+    BUS_CMD_UPLOAD_AUX      = 0xfff1,
+    BUS_CMD_WAITHSYNC       = 0xfffa,
+    BUS_CMD_WAIT_BLIT_DONE  = 0xfffb,
+    BUS_CMD_WAIT_BLIT_READY = 0xfffc,
+    BUS_CMD_WAITVTOP        = 0xfffd,
+    BUS_CMD_WAITVSYNC       = 0xfffe,
+    BUS_CMD_END             = 0xffff
+};
+
+class BusScript
+{
+public:
+    struct Upload
+    {
+        std::string     name;              // file name (or script name for inline payload)
+        const uint8_t * data;              // payload bytes
+        size_t          size;              // payload byte count
+        size_t          skip_words;        // inline payload words following upload command
+    };
+
+private:
+    static const uint16_t BINARY_VERSION = 0x0001;
+    static const size_t   HEADER_BYTES   = 8;
+
+    // read-only memory-mapped file (unmapped when destroyed)
+    class MappedFile
+    {
+    public:
+        const uint8_t * data = nullptr;
+        size_t          size = 0;
+
+        MappedFile()                   = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+        ~MappedFile()
+        {
+            if (data != nullptr && size != 0)
+            {
+                munmap(const_cast<uint8_t *>(data), size);
+            }
+        }
+
+        bool map(const char * filename, std::string & err)
+        {
+            int fd = open(filename, O_RDONLY);
+            if (fd < 0)
+            {
+                err = std::string("can't open \"") + filename + "\": " + strerror(errno);
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                err = std::string("can't stat \"") + filename + "\": " + strerror(errno);
+                close(fd);
+                return false;
+            }
+            size = static_cast<size_t>(st.st_size);
+            if (size != 0)
+            {
+                void * p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED)
+                {
+                    err  = std::string("can't mmap \"") + filename + "\": " + strerror(errno);
+                    size = 0;
+                    close(fd);
+                    return false;
+                }
+                madvise(p, size, MADV_SEQUENTIAL);
+                data = static_cast<const uint8_t *>(p);
+            }
+            close(fd);
+            return true;
+        }
+    };
+
+    std::vector<std::unique_ptr<MappedFile>> files;               // all mapped files (script and payloads)
+    std::vector<uint16_t>                    text_words;          // words parsed from text script
+    const uint16_t *                         native_words;        // host order words (built-in or text)
+    const uint8_t *                          be_words;            // big-endian words (mapped binary script)
+    size_t                                   num_words;
+    std::vector<Upload>                      uploads;             // uploads in order of REG_UPLOAD commands
+    std::vector<Upload>                      cmdline_uploads;     // -u files
+    size_t                                   next_cmdline;        // next -u file for script REG_UPLOAD
+    std::string                              script_name;
+
+    const MappedFile * map_file(const char * filename, std::string & err)
+    {
+        std::unique_ptr<MappedFile> mf(new MappedFile);
+        if (!mf->map(filename, err))
+        {
+            return nullptr;
+        }
+        files.push_back(std::move(mf));
+        return files.back().get();
+    }
+
+    Upload next_cmdline_upload()
+    {
+        if (next_cmdline < cmdline_uploads.size())
+        {
+            return cmdline_uploads[next_cmdline++];
+        }
+        return Upload{"(missing -u file)", nullptr, 0, 0};
+    }
+
+    static uint16_t be16(const uint8_t * p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    static int xm_reg_num(const char * name)
+    {
+        static const char * xm_names[16] = {"SYS_CTRL",
+                                            "INT_CTRL",
+                                            "TIMER",
+                                            "RD_XADDR",
+                                            "WR_XADDR",
+                                            "XDATA",
+                                            "RD_INCR",
+                                            "RD_ADDR",
+                                            "WR_INCR",
+                                            "WR_ADDR",
+                                            "DATA",
+                                            "DATA_2",
+                                            "PIXEL_X",
+                                            "PIXEL_Y",
+                                            "UART",
+                                            "FEATURE"};
+        if (strncasecmp(name, "XM_", 3) == 0)
+        {
+            name += 3;
+        }
+        for (int r = 0; r < 16; r++)
+        {
+            if (strcasecmp(name, xm_names[r]) == 0)
+            {
+                return r;
+            }
+        }
+        return -1;
+    }
+
+    static int xr_reg_num(const char * name)
+    {
+        static const struct
+        {
+            const char * name;
+            int          num;
+        } xr_names[] = {
+            {"VID_CTRL", XR_VID_CTRL},         {"COPP_CTRL", XR_COPP_CTRL},       {"AUD_CTRL", XR_AUD_CTRL},
+            {"SCANLINE", XR_SCANLINE},         {"VID_LEFT", XR_VID_LEFT},         {"VID_RIGHT", XR_VID_RIGHT},
+            {"POINTER_H", XR_POINTER_H},       {"POINTER_V", XR_POINTER_V},       {"PA_GFX_CTRL", XR_PA_GFX_CTRL},
+            {"PA_TILE_CTRL", XR_PA_TILE_CTRL}, {"PA_DISP_ADDR", XR_PA_DISP_ADDR}, {"PA_LINE_LEN", XR_PA_LINE_LEN},
+            {"PA_HV_FSCALE", XR_PA_HV_FSCALE}, {"PA_H_SCROLL", XR_PA_H_SCROLL},   {"PA_V_SCROLL", XR_PA_V_SCROLL},
+            {"PA_LINE_ADDR", XR_PA_LINE_ADDR}, {"PB_GFX_CTRL", XR_PB_GFX_CTRL},   {"PB_TILE_CTRL", XR_PB_TILE_CTRL},
+            {"PB_DISP_ADDR", XR_PB_DISP_ADDR}, {"PB_LINE_LEN", XR_PB_LINE_LEN},   {"PB_HV_FSCALE", XR_PB_HV_FSCALE},
+            {"PB_H_SCROLL", XR_PB_H_SCROLL},   {"PB_V_SCROLL", XR_PB_V_SCROLL},   {"PB_LINE_ADDR", XR_PB_LINE_ADDR},
+            {"AUD0_VOL", XR_AUD0_VOL},         {"AUD0_PERIOD", XR_AUD0_PERIOD},   {"AUD0_LENGTH", XR_AUD0_LENGTH},
+            {"AUD0_START", XR_AUD0_START},     {"AUD1_VOL", XR_AUD1_VOL},         {"AUD1_PERIOD", XR_AUD1_PERIOD},
+            {"AUD1_LENGTH", XR_AUD1_LENGTH},   {"AUD1_START", XR_AUD1_START},     {"AUD2_VOL", XR_AUD2_VOL},
+            {"AUD2_PERIOD", XR_AUD2_PERIOD},   {"AUD2_LENGTH", XR_AUD2_LENGTH},   {"AUD2_START", XR_AUD2_START},
+            {"AUD3_VOL", XR_AUD3_VOL},         {"AUD3_PERIOD", XR_AUD3_PERIOD},   {"AUD3_LENGTH", XR_AUD3_LENGTH},
+            {"AUD3_START", XR_AUD3_START},     {"BLIT_CTRL", XR_BLIT_CTRL},       {"BLIT_ANDC", XR_BLIT_ANDC},
+            {"BLIT_XOR", XR_BLIT_XOR},         {"BLIT_MOD_S", XR_BLIT_MOD_S},     {"BLIT_SRC_S", XR_BLIT_SRC_S},
+            {"BLIT_MOD_D", XR_BLIT_MOD_D},     {"BLIT_DST_D", XR_BLIT_DST_D},     {"BLIT_SHIFT", XR_BLIT_SHIFT},
+            {"BLIT_LINES", XR_BLIT_LINES},     {"BLIT_WORDS", XR_BLIT_WORDS},
+        };
+        if (strncasecmp(name, "XR_", 3) == 0)
+        {
+            name += 3;
+        }
+        for (const auto & xr : xr_names)
+        {
+            if (strcasecmp(name, xr.name) == 0)
+            {
+                return xr.num;
+            }
+        }
+        return -1;
+    }
+
+    static bool parse_number(const char * str, long & value)
+    {
+        char * endptr = nullptr;
+        value         = strtol(str, &endptr, 0);
+        return endptr != str && *endptr == '\0';
+    }
+
+    bool load_binary(const MappedFile * mf, std::string & err)
+    {
+        if (be16(mf->data + 4) != BINARY_VERSION)
+        {
+            err = "unsupported XBUS version";
+            return false;
+        }
+        be_words  = mf->data + HEADER_BYTES;
+        num_words = (mf->size - HEADER_BYTES) / 2;
+
+        // pre-scan for upload commands to index inline payloads (no copying)
+        for (size_t i = 0; i < num_words; i++)
+        {
+            uint16_t cmd = word(i);
+            if ((cmd & 0xfffe) != BUS_CMD_UPLOAD)
+            {
+                continue;
+            }
+            if (i + 2 >= num_words)
+            {
+                err = "truncated REG_UPLOAD length at word " + std::to_string(i);
+                return false;
+            }
+            size_t len = (static_cast<size_t>(word(i + 1)) << 16) | word(i + 2);
+            Upload up;
+            if (len == 0)
+            {
+                up = next_cmdline_upload();
+            }
+            else
+            {
+                if ((i + 3) * 2 + len > num_words * 2)
+                {
+                    err = "truncated REG_UPLOAD payload at word " + std::to_string(i);
+                    return false;
+                }
+                up.name = script_name;
+                up.data = be_words + ((i + 3) * 2);
+                up.size = len;
+            }
+            up.skip_words = 2 + ((len + 1) / 2);
+            uploads.push_back(up);
+            i += up.skip_words;
+        }
+
+        return true;
+    }
+
+    bool load_text(const MappedFile * mf, std::string & err)
+    {
+        const char * p        = reinterpret_cast<const char *>(mf->data);
+        const char * end      = p + mf->size;
+        int          line_num = 0;
+
+        while (p < end)
+        {
+            const char * eol = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (eol == nullptr)
+            {
+                eol = end;
+            }
+            std::string line(p, eol);
+            p = eol + 1;
+            line_num++;
+
+            // strip comments, split into tokens
+            size_t cpos = line.find_first_of(";#");
+            if (cpos != std::string::npos)
+            {
+                line.erase(cpos);
+            }
+            cpos = line.find("//");
+            if (cpos != std::string::npos)
+            {
+                line.erase(cpos);
+            }
+            std::vector<std::string> tok;
+            char *                   save = nullptr;
+            for (char * t = strtok_r(&line[0], " \t\r,()", &save); t != nullptr; t = strtok_r(nullptr, " \t\r,()", &save))
+            {
+                tok.push_back(t);
+            }
+            if (tok.empty())
+            {
+                continue;
+            }
+
+            if (!parse_text_command(tok, err))
+            {
+                err = script_name + ":" + std::to_string(line_num) + ": " + err;
+                return false;
+            }
+        }
+
+        native_words = text_words.data();
+        num_words    = text_words.size();
+
+        return true;
+    }
+
+    bool parse_text_command(const std::vector<std::string> & tok, std::string & err)
+    {
+        const char * cmd  = tok[0].c_str();
+        size_t       args = tok.size() - 1;
+        long         v1 = 0, v2 = 0;
+
+        static const struct
+        {
+            const char * name;
+            uint16_t     word;
+        } simple_cmds[] = {{"REG_WAITHSYNC", BUS_CMD_WAITHSYNC},
+                           {"REG_WAITVSYNC", BUS_CMD_WAITVSYNC},
+                           {"REG_WAITVTOP", BUS_CMD_WAITVTOP},
+                           {"REG_END", BUS_CMD_END}};
+        for (const auto & sc : simple_cmds)
+        {
+            if (strcasecmp(cmd, sc.name) == 0)
+            {
+                text_words.push_back(sc.word);
+                return true;
+            }
+        }
+
+        if (strcasecmp(cmd, "REG_WAIT_BLIT_READY") == 0 || strcasecmp(cmd, "REG_WAIT_BLIT_DONE") == 0)
+        {
+            // read SYS_CTRL.H then wait on last read value
+            text_words.push_back(((XM_SYS_CTRL | 0x80) << 8));
+            text_words.push_back(strcasecmp(cmd, "REG_WAIT_BLIT_READY") == 0 ? BUS_CMD_WAIT_BLIT_READY
+                                                                              : BUS_CMD_WAIT_BLIT_DONE);
+            return true;
+        }
+
+        if (strcasecmp(cmd, "REG_UPLOAD") == 0 || strcasecmp(cmd, "REG_UPLOAD_AUX") == 0)
+        {
+            Upload up;
+            if (args == 0)
+            {
+                up = next_cmdline_upload();
+            }
+            else
+            {
+                const MappedFile * mf = map_file(tok[1].c_str(), err);
+                if (mf == nullptr)
+                {
+                    return false;
+                }
+                up.name = tok[1];
+                up.data = mf->data;
+                up.size = mf->size;
+            }
+            up.skip_words = 0;
+            uploads.push_back(up);
+            text_words.push_back(strcasecmp(cmd, "REG_UPLOAD") == 0 ? BUS_CMD_UPLOAD : BUS_CMD_UPLOAD_AUX);
+            return true;
+        }
+
+        if (strcasecmp(cmd, "WORD") == 0)
+        {
+            for (size_t a = 1; a <= args; a++)
+            {
+                if (!parse_number(tok[a].c_str(), v1))
+                {
+                    err = "bad number \"" + tok[a] + "\"";
+                    return false;
+                }
+                text_words.push_back(static_cast<uint16_t>(v1));
+            }
+            return true;
+        }
+
+        if (strcasecmp(cmd, "XREG_SETW") == 0 || strcasecmp(cmd, "XMEM_SETW") == 0)
+        {
+            if (args != 2 || !parse_number(tok[2].c_str(), v2))
+            {
+                err = std::string(cmd) + " needs <xr_addr> <word>";
+                return false;
+            }
+            if (!parse_number(tok[1].c_str(), v1) && (v1 = xr_reg_num(tok[1].c_str())) < 0)
+            {
+                err = "unknown XR register \"" + tok[1] + "\"";
+                return false;
+            }
+            add_reg_w(XM_WR_XADDR, static_cast<uint16_t>(v1));
+            add_reg_w(XM_XDATA, static_cast<uint16_t>(v2));
+            return true;
+        }
+
+        bool is_w  = strcasecmp(cmd, "REG_W") == 0;
+        bool is_bh = strcasecmp(cmd, "REG_BH") == 0;
+        bool is_bl = strcasecmp(cmd, "REG_BL") == 0;
+        bool is_rw = strcasecmp(cmd, "REG_RW") == 0;
+        if (!is_w && !is_bh && !is_bl && !is_rw)
+        {
+            err = "unknown command \"" + tok[0] + "\"";
+            return false;
+        }
+        if (args != (is_rw ? 1u : 2u) || (!is_rw && !parse_number(tok[2].c_str(), v2)))
+        {
+            err = std::string(cmd) + (is_rw ? " needs <xm_reg>" : " needs <xm_reg> <value>");
+            return false;
+        }
+        int reg = xm_reg_num(tok[1].c_str());
+        if (reg < 0 && (!parse_number(tok[1].c_str(), v1) || (reg = static_cast<int>(v1)) < 0 || reg > 15))
+        {
+            err = "unknown XM register \"" + tok[1] + "\"";
+            return false;
+        }
+
+        if (is_w)
+        {
+            add_reg_w(reg, static_cast<uint16_t>(v2));
+        }
+        else if (is_bh)
+        {
+            text_words.push_back(static_cast<uint16_t>((reg << 8) | (v2 & 0xff)));
+        }
+        else if (is_bl)
+        {
+            text_words.push_back(static_cast<uint16_t>(((reg | 0x10) << 8) | (v2 & 0xff)));
+        }
+        else
+        {
+            text_words.push_back(static_cast<uint16_t>((reg | 0x80) << 8));
+            text_words.push_back(static_cast<uint16_t>((reg | 0x90) << 8));
+        }
+        return true;
+    }
+
+    void add_reg_w(int reg, uint16_t value)
+    {
+        text_words.push_back(static_cast<uint16_t>((reg << 8) | (value >> 8)));
+        text_words.push_back(static_cast<uint16_t>(((reg | 0x10) << 8) | (value & 0xff)));
+    }
+
+public:
+    BusScript()
+        : native_words(nullptr)
+        , be_words(nullptr)
+        , num_words(0)
+        , next_cmdline(0)
+    {
+    }
+
+    // add -u upload file (used by REG_UPLOAD commands without an inline or named payload)
+    bool add_upload_file(const char * filename, std::string & err)
+    {
+        const MappedFile * mf = map_file(filename, err);
+        if (mf == nullptr)
+        {
+            return false;
+        }
+        cmdline_uploads.push_back(Upload{filename, mf->data, mf->size, 0});
+        return true;
+    }
+
+    // use compiled-in (or command line) words, uploads are -u files in order
+    void set_words(const uint16_t * words, size_t count, const char * name)
+    {
+        script_name  = name;
+        native_words = words;
+        be_words     = nullptr;
+        num_words    = count;
+        uploads      = cmdline_uploads;
+    }
+
+    void set_words(std::vector<uint16_t> && words, const char * name)
+    {
+        text_words = std::move(words);
+        set_words(text_words.data(), text_words.size(), name);
+    }
+
+    // load binary (XBUS magic) or text bus script
+    bool load(const char * filename, std::string & err)
+    {
+        script_name = filename;
+        uploads.clear();
+        text_words.clear();
+        native_words = nullptr;
+        be_words     = nullptr;
+        num_words    = 0;
+        next_cmdline = 0;
+
+        const MappedFile * mf = map_file(filename, err);
+        if (mf == nullptr)
+        {
+            return false;
+        }
+        if (mf->size >= HEADER_BYTES && memcmp(mf->data, "XBUS", 4) == 0)
+        {
+            return load_binary(mf, err);
+        }
+        return load_text(mf, err);
+    }
+
+    // save active script (with all upload payloads inline) as binary script
+    bool save_binary(const char * filename, std::string & err) const
+    {
+        FILE * fp = fopen(filename, "wb");
+        if (fp == nullptr)
+        {
+            err = std::string("can't create \"") + filename + "\": " + strerror(errno);
+            return false;
+        }
+        const uint8_t header[HEADER_BYTES] = {'X', 'B', 'U', 'S', 0, BINARY_VERSION, 0, 0};
+        fwrite(header, 1, sizeof(header), fp);
+
+        size_t upload_num = 0;
+        for (size_t i = 0; i < num_words; i++)
+        {
+            uint16_t w     = word(i);
+            uint8_t  be[2] = {static_cast<uint8_t>(w >> 8), static_cast<uint8_t>(w)};
+            fwrite(be, 1, 2, fp);
+            if ((w & 0xfffe) != BUS_CMD_UPLOAD)
+            {
+                continue;
+            }
+            const Upload * up  = upload(upload_num++);
+            uint32_t       len = up ? static_cast<uint32_t>(up->size) : 0;
+            uint8_t        lenbe[4] = {static_cast<uint8_t>(len >> 24),
+                                static_cast<uint8_t>(len >> 16),
+                                static_cast<uint8_t>(len >> 8),
+                                static_cast<uint8_t>(len)};
+            fwrite(lenbe, 1, sizeof(lenbe), fp);
+            if (len)
+            {
+                fwrite(up->data, 1, len, fp);
+                if (len & 1)
+                {
+                    fputc(0, fp);
+                }
+            }
+            if (up)
+            {
+                i += up->skip_words;
+            }
+        }
+
+        bool ok = (ferror(fp) == 0);
+        if (fclose(fp) != 0 || !ok)
+        {
+            err = std::string("error writing \"") + filename + "\"";
+            return false;
+        }
+        return true;
+    }
+
+    const char * name() const
+    {
+        return script_name.c_str();
+    }
+
+    size_t length() const
+    {
+        return num_words;
+    }
+
+    size_t num_uploads() const
+    {
+        return uploads.size();
+    }
+
+    uint16_t word(size_t index) const
+    {
+        if (index >= num_words)
+        {
+            return BUS_CMD_END;
+        }
+        return be_words ? be16(be_words + (index * 2)) : native_words[index];
+    }
+
+    // return upload for n-th REG_UPLOAD command (or nullptr if none)
+    const Upload * upload(size_t n) const
+    {
+        return n < uploads.size() ? &uploads[n] : nullptr;
+    }
+};
+
+#endif        // BUS_SCRIPT_H
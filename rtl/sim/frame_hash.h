@@ -0,0 +1,133 @@
+// frame_hash.h - fast 64-bit hash of simulated video frames
+//
+// vim: set et ts=4 sw=4
+//
+// Each visible pixel (ARGB8888) is folded into a running 64-bit hash as it is
+// output, so a frame can be checked against a known-good ("golden") value
+// without saving or comparing images.
+
+#if !defined(FRAME_HASH_H)
+#define FRAME_HASH_H
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+class FrameHash
+{
+    static const uint64_t HASH_SEED  = 0x9e3779b97f4a7c15ULL;
+    static const uint64_t HASH_MUL_A = 0xc2b2ae3d27d4eb4fULL;
+    static const uint64_t HASH_MUL_B = 0x165667b19e3779f9ULL;
+
+    uint64_t hash;
+    uint32_t count;
+
+public:
+    FrameHash() { reset(); }
+
+    void reset()
+    {
+        hash  = HASH_SEED;
+        count = 0;
+    }
+
+    // fold next visible pixel into hash
+    void add(uint32_t argb)
+    {
+        hash ^= argb * HASH_MUL_A;
+        hash = ((hash << 31) | (hash >> 33)) * HASH_MUL_B;
+        count++;
+    }
+
+    // final hash value (includes pixel count so truncated frames differ)
+    uint64_t value() const
+    {
+        uint64_t h = hash ^ count;
+        h ^= h >> 33;
+        h *= HASH_MUL_A;
+        h ^= h >> 29;
+        h *= HASH_MUL_B;
+        h ^= h >> 32;
+        return h;
+    }
+
+    uint32_t pixels() const { return count; }
+};
+
+// golden frame hashes, same format as simulation hash file: "<frame> <hash> <pixels>" per line
+class GoldenManifest
+{
+public:
+    struct Entry
+    {
+        uint64_t hash;
+        uint32_t pixels;
+    };
+
+private:
+    std::map<int, Entry> frames;
+    std::string          base_name;        // manifest filename without extension (for golden images)
+
+public:
+    bool load(const char * filename, std::string & err)
+    {
+        FILE * fp = fopen(filename, "r");
+        if (fp == nullptr)
+        {
+            err = std::string("can't open golden manifest \"") + filename + "\"";
+            return false;
+        }
+
+        char line[256];
+        int  line_num = 0;
+        while (fgets(line, sizeof(line), fp) != nullptr)
+        {
+            line_num++;
+            int      frame;
+            uint64_t hash;
+            uint32_t pixels;
+            if (line[0] == '#' || line[0] == '\n')
+            {
+                continue;
+            }
+            if (sscanf(line, "%d %" SCNx64 " %" SCNu32, &frame, &hash, &pixels) != 3)
+            {
+                err = std::string(filename) + ":" + std::to_string(line_num) + ": bad golden hash line";
+                fclose(fp);
+                return false;
+            }
+            frames[frame] = {hash, pixels};
+        }
+        fclose(fp);
+
+        base_name = filename;
+        size_t dot = base_name.find_last_of('.');
+        if (dot != std::string::npos && base_name.find('/', dot) == std::string::npos)
+        {
+            base_name.resize(dot);
+        }
+
+        return true;
+    }
+
+    size_t size() const { return frames.size(); }
+
+    const Entry * find(int frame) const
+    {
+        auto it = frames.find(frame);
+        return it != frames.end() ? &it->second : nullptr;
+    }
+
+    // optional golden image for frame: "<manifest name>_f<frame>.png" (used to make diff image)
+    std::string image_name(int frame) const
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_f%02d.png", frame);
+        return base_name + suffix;
+    }
+};
+
+#endif        // FRAME_HASH_H
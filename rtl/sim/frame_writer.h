@@ -0,0 +1,225 @@
+// frame_writer.h - background PNG writer for Xosera Verilator simulation frames
+//
+// vim: set et ts=4 sw=4
+//
+// Frames are rendered by the simulation into a plain ARGB8888 framebuffer
+// (no SDL required) and queued here.  A worker thread does the (slow) PNG
+// encoding with libpng so the simulation loop only pays for a memcpy.
+// Also has helpers to load golden PNG images and make a diff image.
+
+#if !defined(FRAME_WRITER_H)
+#define FRAME_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <png.h>
+
+// write ARGB8888 pixels to PNG file as 8-bit RGB (returns false on error)
+static inline bool save_png_argb(const char * filename, const uint32_t * pixels, int width, int height)
+{
+    FILE * fp = fopen(filename, "wb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    png_structp png  = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop   info = png ? png_create_info_struct(png) : nullptr;
+    if (info == nullptr || setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png, fp);
+    png_set_compression_level(png, 1);        // favor speed, sim frames compress well anyway
+    png_set_IHDR(png,
+                 info,
+                 width,
+                 height,
+                 8,
+                 PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    std::vector<png_byte> row(width * 3);
+    for (int y = 0; y < height; y++)
+    {
+        const uint32_t * src = pixels + (y * width);
+        png_byte *       dst = row.data();
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t argb = *src++;
+            *dst++        = (argb >> 16) & 0xff;
+            *dst++        = (argb >> 8) & 0xff;
+            *dst++        = argb & 0xff;
+        }
+        png_write_row(png, row.data());
+    }
+
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+
+    return true;
+}
+
+// read PNG file as ARGB8888 pixels, must be width x height (returns false on error)
+static inline bool load_png_argb(const char * filename, std::vector<uint32_t> & pixels, int width, int height)
+{
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&image, filename))
+    {
+        return false;
+    }
+    if ((int)image.width != width || (int)image.height != height)
+    {
+        png_image_free(&image);
+        return false;
+    }
+
+    image.format = PNG_FORMAT_BGRA;
+    std::vector<uint8_t> bgra(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, nullptr, bgra.data(), 0, nullptr))
+    {
+        png_image_free(&image);
+        return false;
+    }
+
+    pixels.resize(width * height);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        const uint8_t * p = &bgra[i * 4];
+        pixels[i]         = ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+    }
+
+    return true;
+}
+
+// make diff image: changed pixels bright magenta, unchanged pixels dimmed gray (returns changed pixel count)
+static inline int diff_argb(uint32_t * diff, const uint32_t * pixels, const uint32_t * golden, int count)
+{
+    int changed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if ((pixels[i] & 0xffffff) != (golden[i] & 0xffffff))
+        {
+            diff[i] = 0xffff00ff;
+            changed++;
+        }
+        else
+        {
+            uint32_t c = pixels[i];
+            uint32_t y = ((((c >> 16) & 0xff) * 77) + (((c >> 8) & 0xff) * 150) + ((c & 0xff) * 29)) >> 10;
+            diff[i]    = 0xff000000 | (y << 16) | (y << 8) | y;
+        }
+    }
+    return changed;
+}
+
+class FrameWriter
+{
+    static const size_t MAX_QUEUED = 8;        // frames buffered before simulation waits on writer
+
+    struct Frame
+    {
+        std::string           filename;
+        std::vector<uint32_t> pixels;
+        int                   width;
+        int                   height;
+    };
+
+    std::thread             worker;
+    std::mutex              lock;
+    std::condition_variable cv_work;
+    std::condition_variable cv_space;
+    std::deque<Frame>       queue;
+    bool                    running = false;
+    int                     errors  = 0;
+
+    void worker_loop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;)
+        {
+            cv_work.wait(guard, [this] { return !queue.empty() || !running; });
+            if (queue.empty())
+            {
+                break;
+            }
+
+            Frame frame = std::move(queue.front());
+            queue.pop_front();
+            cv_space.notify_one();
+
+            guard.unlock();
+            bool ok = save_png_argb(frame.filename.c_str(), frame.pixels.data(), frame.width, frame.height);
+            guard.lock();
+
+            if (!ok)
+            {
+                fprintf(stderr, "FrameWriter: error writing \"%s\"\n", frame.filename.c_str());
+                errors++;
+            }
+        }
+    }
+
+public:
+    ~FrameWriter() { finish(); }
+
+    void start()
+    {
+        if (!running)
+        {
+            running = true;
+            worker  = std::thread(&FrameWriter::worker_loop, this);
+        }
+    }
+
+    // copy framebuffer and queue it to be written (blocks only if writer falls far behind)
+    void write(const char * filename, const uint32_t * pixels, int width, int height)
+    {
+        Frame frame;
+        frame.filename = filename;
+        frame.pixels.assign(pixels, pixels + (width * height));
+        frame.width  = width;
+        frame.height = height;
+
+        std::unique_lock<std::mutex> guard(lock);
+        cv_space.wait(guard, [this] { return queue.size() < MAX_QUEUED; });
+        queue.push_back(std::move(frame));
+        cv_work.notify_one();
+    }
+
+    // flush all queued frames and stop worker thread (returns number of write errors)
+    int finish()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+        }
+        cv_work.notify_one();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        return errors;
+    }
+};
+
+#endif        // FRAME_WRITER_H
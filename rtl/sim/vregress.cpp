@@ -0,0 +1,787 @@
+// vregress.cpp - parallel regression runner for Xosera Verilator simulation
+//
+// vim: set et ts=4 sw=4
+//
+// Runs each test in a test list as a separate headless simulator process
+// (up to -j at once), each with its own output directory so logs, stats and
+// frames do not collide.  When all tests are done the per-frame hashes written
+// by each simulation are compared against golden hashes and a table of
+// results and timing is printed.
+//
+// Test list format (one test per line, '#' outside quotes starts a comment):
+//
+//      <name>[:<prerequisite>]  <simulator arguments...>  [@expect "<log text>"...]
+//
+// A test with a prerequisite is only started after that test has finished
+// successfully (e.g., to --restore a checkpoint it saved), "{out}" in arguments
+// is replaced with the output directory and arguments in double quotes may
+// contain spaces.  Each @expect text must appear in the simulation log
+// (<outdir>/<name>/xosera_vsim.log) or the test fails.
+//
+// For test "name" the simulator is run as:
+//
+//      <sim> -H -o <outdir>/<name>/ <simulator arguments...>
+//
+// with stdout and stderr saved in <outdir>/<name>/sim_output.txt and the
+// frame hashes from <outdir>/<name>/xosera_vsim_hashes.txt compared with
+// <golden>/<name>.hashes (use -u to create or update golden hashes).
+//
+// When golden hashes exist they are also passed to the simulator with -g, so
+// frames are only saved as PNG on a mismatch.  If golden images exist
+// (<golden>/<name>_f<frame>.png, saved with -u -i) the simulator also writes a
+// diff image of the changed pixels for mismatched frames.
+// Simulations that fail to run (non-zero exit or no hashes) never update them.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HASH_FILE            "xosera_vsim_hashes.txt"        // must match xosera_sim.cpp
+#define LOG_FILE             "xosera_vsim.log"               // must match xosera_sim.cpp
+#define EXIT_GOLDEN_MISMATCH 2                               // must match xosera_sim.cpp
+
+enum test_status
+{
+    TEST_PENDING,
+    TEST_PASS,
+    TEST_FAIL,
+    TEST_NEW,
+    TEST_UPDATED,
+    TEST_ERROR
+};
+
+static const char * status_name[] = {"PENDING", "PASS", "FAIL", "NEW", "UPDATED", "ERROR"};
+
+struct Test
+{
+    std::string              name;
+    std::string              prereq;
+    std::vector<std::string> args;
+    std::vector<std::string> expect;
+    std::string              out_dir;
+    std::string              golden_name;
+    pid_t                    pid       = 0;
+    bool                     started   = false;
+    int                      exit_code = -1;
+    double                   seconds   = 0.0;
+    int                      frames    = 0;
+    test_status              status    = TEST_PENDING;
+    std::string              detail;
+
+    std::chrono::steady_clock::time_point start_time;
+};
+
+struct FrameHashEntry
+{
+    std::string hash;
+    std::string pixels;
+};
+
+typedef std::map<int, FrameHashEntry> HashMap;
+
+static const char * sim_path    = "sim/obj_dir/Vxosera_main";
+static const char * out_root    = "sim/logs/regress";
+static const char * golden_dir  = "sim/golden";
+static int          max_jobs    = 0;
+static bool         update_gold = false;
+static bool         gold_images = false;
+static bool         list_only   = false;
+
+static void usage()
+{
+    printf("Usage: vregress [options] <test list> [test names...]\n");
+    printf("  -j <n>       number of simulations to run at once (default number of CPUs)\n");
+    printf("  -s <sim>     simulator executable (default \"%s\")\n", sim_path);
+    printf("  -o <dir>     output directory for test results (default \"%s\")\n", out_root);
+    printf("  -g <dir>     golden hash directory (default \"%s\")\n", golden_dir);
+    printf("  -u           create or update golden hashes from results (for intended changes)\n");
+    printf("  -i           with -u, also save all frames as golden images (for diff images)\n");
+    printf("  --list       only read the test list and print the tests to run (no simulator needed)\n");
+    printf("If test names are given, only those tests from the list are run.\n");
+}
+
+static bool read_test_list(const char * filename, std::vector<Test> & tests)
+{
+    FILE * fp = fopen(filename, "r");
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "vregress: can't open test list \"%s\": %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    char line[4096];
+    int  line_num = 0;
+    while (fgets(line, sizeof(line), fp) != nullptr)
+    {
+        line_num++;
+
+        Test test;
+        bool expect = false;
+        for (char * p = line; *p != '\0';)
+        {
+            if (strchr(" \t\r\n", *p) != nullptr)
+            {
+                p++;
+                continue;
+            }
+            if (*p == '#')
+            {
+                break;        // comment (only at start of a token, so "text" may contain '#')
+            }
+            std::string tok;
+            if (*p == '"')
+            {
+                char * end = strchr(++p, '"');
+                if (end == nullptr)
+                {
+                    fprintf(stderr, "vregress: %s:%d: missing closing quote\n", filename, line_num);
+                    fclose(fp);
+                    return false;
+                }
+                tok.assign(p, end - p);
+                p = end + 1;
+            }
+            else
+            {
+                size_t len = strcspn(p, " \t\r\n");
+                tok.assign(p, len);
+                p += len;
+            }
+
+            if (test.name.empty())
+            {
+                size_t colon = tok.find(':');
+                test.name    = tok.substr(0, colon);
+                if (colon != std::string::npos)
+                {
+                    test.prereq = tok.substr(colon + 1);
+                }
+            }
+            else if (expect)
+            {
+                test.expect.push_back(tok);
+                expect = false;
+            }
+            else if (tok == "@expect")
+            {
+                expect = true;
+            }
+            else
+            {
+                for (size_t pos; (pos = tok.find("{out}")) != std::string::npos;)
+                {
+                    tok.replace(pos, 5, out_root);
+                }
+                test.args.push_back(tok);
+            }
+        }
+        if (test.name.empty())
+        {
+            continue;
+        }
+        if (expect)
+        {
+            fprintf(stderr, "vregress: %s:%d: @expect needs log text\n", filename, line_num);
+            fclose(fp);
+            return false;
+        }
+        bool have_prereq = test.prereq.empty();
+        for (auto & t : tests)
+        {
+            if (t.name == test.name)
+            {
+                fprintf(stderr, "vregress: %s:%d: duplicate test name \"%s\"\n", filename, line_num, test.name.c_str());
+                fclose(fp);
+                return false;
+            }
+            have_prereq |= t.name == test.prereq;
+        }
+        if (!have_prereq)
+        {
+            fprintf(stderr,
+                    "vregress: %s:%d: prerequisite \"%s\" must be listed before \"%s\"\n",
+                    filename,
+                    line_num,
+                    test.prereq.c_str(),
+                    test.name.c_str());
+            fclose(fp);
+            return false;
+        }
+        tests.push_back(test);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+static bool make_dir(const std::string & path)
+{
+    std::string partial;
+    for (size_t i = 0; i <= path.size(); i++)
+    {
+        if (i == path.size() || path[i] == '/')
+        {
+            if (!partial.empty() && mkdir(partial.c_str(), 0777) != 0 && errno != EEXIST)
+            {
+                fprintf(stderr, "vregress: can't create directory \"%s\": %s\n", partial.c_str(), strerror(errno));
+                return false;
+            }
+        }
+        if (i < path.size())
+        {
+            partial += path[i];
+        }
+    }
+    return true;
+}
+
+static bool start_test(Test & test)
+{
+    test.started = true;
+    test.out_dir = std::string(out_root) + "/" + test.name + "/";
+    if (!make_dir(test.out_dir))
+    {
+        test.status = TEST_ERROR;
+        test.detail = "can't create output directory";
+        return false;
+    }
+    remove((test.out_dir + HASH_FILE).c_str());        // don't compare stale results
+    test.golden_name = std::string(golden_dir) + "/" + test.name + ".hashes";
+
+    std::vector<const char *> argv;
+    argv.push_back(sim_path);
+    argv.push_back("-H");
+    argv.push_back("-o");
+    argv.push_back(test.out_dir.c_str());
+    if (!(update_gold && gold_images) && access(test.golden_name.c_str(), R_OK) == 0)
+    {
+        argv.push_back("-g");        // only save frames that don't match golden hashes
+        argv.push_back(test.golden_name.c_str());
+    }
+    for (auto & arg : test.args)
+    {
+        argv.push_back(arg.c_str());
+    }
+    argv.push_back(nullptr);
+
+    std::string output_name = test.out_dir + "sim_output.txt";
+
+    test.start_time = std::chrono::steady_clock::now();
+    test.pid        = fork();
+    if (test.pid == 0)
+    {
+        int fd = open(output_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd >= 0)
+        {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(sim_path, const_cast<char * const *>(argv.data()));
+        fprintf(stderr, "vregress: can't execute \"%s\": %s\n", sim_path, strerror(errno));
+        _exit(127);
+    }
+    else if (test.pid < 0)
+    {
+        test.status = TEST_ERROR;
+        test.detail = std::string("fork failed: ") + strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+// check that each @expect text appears in the simulation log (returns false with first missing text)
+static bool check_expect(const Test & test, std::string & missing)
+{
+    if (test.expect.empty())
+    {
+        return true;
+    }
+
+    std::string log;
+    FILE *      fp = fopen((test.out_dir + LOG_FILE).c_str(), "r");
+    if (fp != nullptr)
+    {
+        char   buffer[4096];
+        size_t len;
+        while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        {
+            log.append(buffer, len);
+        }
+        fclose(fp);
+    }
+
+    for (auto & text : test.expect)
+    {
+        if (log.find(text) == std::string::npos)
+        {
+            missing = text;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// read hash file lines "<frame> <hash> <pixels>" (returns false if file can't be read)
+static bool read_hashes(const std::string & filename, HashMap & hashes)
+{
+    FILE * fp = fopen(filename.c_str(), "r");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != nullptr)
+    {
+        int  frame;
+        char hash[64];
+        char pixels[64];
+        if (line[0] != '#' && sscanf(line, "%d %63s %63s", &frame, hash, pixels) == 3)
+        {
+            hashes[frame] = {hash, pixels};
+        }
+    }
+    fclose(fp);
+
+    return true;
+}
+
+static bool copy_file(const std::string & from, const std::string & to)
+{
+    FILE * ifp = fopen(from.c_str(), "rb");
+    if (ifp == nullptr)
+    {
+        return false;
+    }
+    FILE * ofp = fopen(to.c_str(), "wb");
+    if (ofp == nullptr)
+    {
+        fclose(ifp);
+        return false;
+    }
+
+    char   buffer[4096];
+    size_t len;
+    bool   ok = true;
+    while ((len = fread(buffer, 1, sizeof(buffer), ifp)) > 0)
+    {
+        ok &= fwrite(buffer, 1, len, ofp) == len;
+    }
+    fclose(ifp);
+    ok &= fclose(ofp) == 0;
+
+    return ok;
+}
+
+// copy saved frames "xosera_vsim_<w>x<h>_f<frame>.png" to golden images "<name>_f<frame>.png"
+static int copy_golden_images(const Test & test)
+{
+    DIR * dir = opendir(test.out_dir.c_str());
+    if (dir == nullptr)
+    {
+        return -1;
+    }
+
+    int             copied = 0;
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        int frame;
+        int len = 0;
+        if (sscanf(entry->d_name, "xosera_vsim_%*dx%*d_f%d%n", &frame, &len) == 1 && len > 0 &&
+            strcmp(entry->d_name + len, ".png") == 0)
+        {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "_f%02d.png", frame);
+            if (!copy_file(test.out_dir + entry->d_name, std::string(golden_dir) + "/" + test.name + suffix))
+            {
+                copied = -1;
+                break;
+            }
+            copied++;
+        }
+    }
+    closedir(dir);
+
+    return copied;
+}
+
+static void check_test(Test & test)
+{
+    if (test.status != TEST_PENDING)
+    {
+        return;
+    }
+    if (test.exit_code != 0 && test.exit_code != EXIT_GOLDEN_MISMATCH)
+    {
+        test.status = TEST_ERROR;
+        test.detail = "simulator exit code " + std::to_string(test.exit_code);
+        return;
+    }
+    std::string missing;
+    if (!check_expect(test, missing))
+    {
+        test.status = TEST_FAIL;
+        test.detail = "log missing \"" + missing + "\"";
+        return;
+    }
+
+    HashMap     result;
+    std::string result_name = test.out_dir + HASH_FILE;
+    if (!read_hashes(result_name, result) || result.empty())
+    {
+        test.status = TEST_ERROR;
+        test.detail = "no frame hashes in " + result_name;
+        return;
+    }
+    test.frames = (int)result.size();
+
+    HashMap             golden;
+    const std::string & golden_name = test.golden_name;
+    bool                have_golden = read_hashes(golden_name, golden);
+
+    if (have_golden)
+    {
+        int mismatches  = 0;
+        int first_frame = -1;
+        for (auto & g : golden)
+        {
+            auto r = result.find(g.first);
+            if (r == result.end() || r->second.hash != g.second.hash || r->second.pixels != g.second.pixels)
+            {
+                if (first_frame < 0)
+                {
+                    first_frame = g.first;
+                }
+                mismatches++;
+            }
+        }
+        if (result.size() != golden.size())
+        {
+            test.detail = std::to_string(result.size()) + " frames, golden has " + std::to_string(golden.size());
+        }
+        if (mismatches && !update_gold)
+        {
+            test.status = TEST_FAIL;
+            if (!test.detail.empty())
+            {
+                test.detail += ", ";
+            }
+            test.detail += std::to_string(mismatches) + " frame(s) differ, first frame " + std::to_string(first_frame);
+            return;
+        }
+        if (!mismatches && result.size() == golden.size())
+        {
+            test.status = TEST_PASS;
+            return;
+        }
+    }
+
+    if (update_gold)
+    {
+        if (!make_dir(golden_dir) || !copy_file(result_name, golden_name))
+        {
+            test.status = TEST_ERROR;
+            test.detail = "can't write " + golden_name;
+            return;
+        }
+        test.status = TEST_UPDATED;
+        test.detail = "saved " + golden_name;
+        if (gold_images)
+        {
+            int images = copy_golden_images(test);
+            if (images < 0)
+            {
+                test.status = TEST_ERROR;
+                test.detail = "can't save golden images";
+                return;
+            }
+            test.detail += " and " + std::to_string(images) + " images";
+        }
+    }
+    else if (!have_golden)
+    {
+        test.status = TEST_NEW;
+        test.detail = "no golden hashes (use -u)";
+    }
+    else
+    {
+        test.status = TEST_FAIL;        // more or fewer frames than golden
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int nextarg = 1;
+    while (nextarg < argc && argv[nextarg][0] == '-')
+    {
+        const char * opt = argv[nextarg] + 1;
+        if (strcmp(opt, "u") == 0)
+        {
+            update_gold = true;
+        }
+        else if (strcmp(opt, "i") == 0)
+        {
+            gold_images = true;
+        }
+        else if (strcmp(opt, "-list") == 0)
+        {
+            list_only = true;
+        }
+        else if (nextarg + 1 < argc &&
+                 (strcmp(opt, "j") == 0 || strcmp(opt, "s") == 0 || strcmp(opt, "o") == 0 || strcmp(opt, "g") == 0))
+        {
+            const char * value = argv[++nextarg];
+            switch (*opt)
+            {
+                case 'j':
+                    max_jobs = atoi(value);
+                    break;
+                case 's':
+                    sim_path = value;
+                    break;
+                case 'o':
+                    out_root = value;
+                    break;
+                case 'g':
+                    golden_dir = value;
+                    break;
+            }
+        }
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        nextarg++;
+    }
+    if (nextarg >= argc)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Test> tests;
+    const char *      list_name = argv[nextarg++];
+    if (!read_test_list(list_name, tests))
+    {
+        return EXIT_FAILURE;
+    }
+    if (nextarg < argc)
+    {
+        std::vector<bool> keep(tests.size(), false);
+        for (; nextarg < argc; nextarg++)
+        {
+            bool found = false;
+            for (size_t i = 0; i < tests.size(); i++)
+            {
+                if (tests[i].name == argv[nextarg])
+                {
+                    keep[i] = true;
+                    found   = true;
+                }
+            }
+            if (!found)
+            {
+                fprintf(stderr, "vregress: test \"%s\" not in test list\n", argv[nextarg]);
+                return EXIT_FAILURE;
+            }
+        }
+        // also run prerequisites (always listed before the tests needing them)
+        for (size_t i = tests.size(); i-- > 0;)
+        {
+            for (size_t p = 0; keep[i] && p < i; p++)
+            {
+                keep[p] = keep[p] || tests[p].name == tests[i].prereq;
+            }
+        }
+        std::vector<Test> selected;
+        for (size_t i = 0; i < tests.size(); i++)
+        {
+            if (keep[i])
+            {
+                selected.push_back(tests[i]);
+            }
+        }
+        tests = selected;
+    }
+    if (tests.empty())
+    {
+        fprintf(stderr, "vregress: no tests to run\n");
+        return EXIT_FAILURE;
+    }
+    if (list_only)
+    {
+        for (const Test & test : tests)
+        {
+            printf("%-24s", (test.prereq.empty() ? test.name : test.name + ":" + test.prereq).c_str());
+            for (const std::string & arg : test.args)
+            {
+                printf(" %s", arg.c_str());
+            }
+            for (const std::string & text : test.expect)
+            {
+                printf(" @expect \"%s\"", text.c_str());
+            }
+            printf("\n");
+        }
+        printf("%zu test%s in \"%s\"\n", tests.size(), tests.size() == 1 ? "" : "s", list_name);
+        return EXIT_SUCCESS;
+    }
+    if (access(sim_path, X_OK) != 0)
+    {
+        fprintf(stderr, "vregress: simulator \"%s\" not found (build it first)\n", sim_path);
+        return EXIT_FAILURE;
+    }
+
+    if (max_jobs < 1)
+    {
+        max_jobs = (int)std::thread::hardware_concurrency();
+        if (max_jobs < 1)
+        {
+            max_jobs = 1;
+        }
+    }
+
+    printf("Running %zu test%s with up to %d at once (results in \"%s\")\n",
+           tests.size(),
+           tests.size() == 1 ? "" : "s",
+           max_jobs,
+           out_root);
+    fflush(stdout);
+
+    auto   run_start = std::chrono::steady_clock::now();
+    size_t next_test = 0;
+    int    running   = 0;
+    size_t finished  = 0;
+
+    while (finished < tests.size())
+    {
+        for (size_t t = next_test; running < max_jobs && t < tests.size(); t++)
+        {
+            Test & test = tests[t];
+            if (test.started)
+            {
+                continue;
+            }
+            if (!test.prereq.empty())
+            {
+                const Test * prereq = nullptr;
+                for (auto & p : tests)
+                {
+                    prereq = p.name == test.prereq ? &p : prereq;
+                }
+                if (prereq->status == TEST_PENDING)
+                {
+                    continue;        // wait for prerequisite to finish
+                }
+                if (prereq->status == TEST_FAIL || prereq->status == TEST_ERROR)
+                {
+                    test.started = true;
+                    test.status  = TEST_ERROR;
+                    test.detail  = "prerequisite " + test.prereq + " failed";
+                    finished++;
+                    printf("[%zu/%zu] %-24s %s\n", finished, tests.size(), test.name.c_str(), status_name[test.status]);
+                    continue;
+                }
+            }
+            if (start_test(test))
+            {
+                running++;
+            }
+            else
+            {
+                finished++;
+            }
+        }
+        while (next_test < tests.size() && tests[next_test].started)
+        {
+            next_test++;
+        }
+        if (running == 0)
+        {
+            continue;
+        }
+
+        int   wstatus;
+        pid_t pid = wait(&wstatus);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("vregress: wait failed");
+            return EXIT_FAILURE;
+        }
+        for (auto & test : tests)
+        {
+            if (test.pid == pid && test.status == TEST_PENDING && test.exit_code < 0)
+            {
+                test.seconds =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - test.start_time).count();
+                test.exit_code = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+                check_test(test);
+                running--;
+                finished++;
+                printf("[%zu/%zu] %-24s %-7s %8.02f sec\n",
+                       finished,
+                       tests.size(),
+                       test.name.c_str(),
+                       status_name[test.status],
+                       test.seconds);
+                fflush(stdout);
+                break;
+            }
+        }
+    }
+
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    double total_sim    = 0.0;
+
+    int count[TEST_ERROR + 1] = {0};
+
+    printf("\n%-24s %-7s %6s %10s %9s  %s\n", "Test", "Result", "Frames", "Seconds", "Frames/s", "Details");
+    printf("%-24s %-7s %6s %10s %9s  %s\n", "----", "------", "------", "-------", "--------", "-------");
+    for (auto & test : tests)
+    {
+        printf("%-24s %-7s %6d %10.02f %9.03f  %s\n",
+               test.name.c_str(),
+               status_name[test.status],
+               test.frames,
+               test.seconds,
+               test.seconds > 0.0 ? test.frames / test.seconds : 0.0,
+               test.detail.c_str());
+        total_sim += test.seconds;
+        count[test.status]++;
+    }
+    printf("\n%zu tests: %d passed, %d failed, %d errors, %d new, %d updated\n",
+           tests.size(),
+           count[TEST_PASS],
+           count[TEST_FAIL],
+           count[TEST_ERROR],
+           count[TEST_NEW],
+           count[TEST_UPDATED]);
+    printf("Total simulation time %0.02f sec, wall time %0.02f sec (%0.02fx speedup with -j %d)\n",
+           total_sim,
+           wall_seconds,
+           wall_seconds > 0.0 ? total_sim / wall_seconds : 0.0,
+           max_jobs);
+
+    return (count[TEST_FAIL] || count[TEST_ERROR]) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
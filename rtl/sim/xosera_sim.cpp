@@ -9,8 +9,13 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include "../../xosera_m68k_api/xosera_m68k_defs.h"
 #include "video_mode_defs.h"
 
@@ -24,19 +29,49 @@
 #include "Vxosera_main_xosera_main.h"
 #include "Vxosera_main_xrmem_arb.h"
 
+#if !defined(SIM_HIER_BLOCKS)        // set for multi-threaded build (hierarchical block internals not accessible)
+#define SIM_HIER_BLOCKS 0
+#endif
+#if !defined(SIM_AUDIO)        // number of audio channels (AUDIO from sim.mk)
+#define SIM_AUDIO 0
+#endif
+#if !defined(SIM_SAVABLE)        // set when model verilated with --savable (checkpoint save/restore)
+#define SIM_SAVABLE 0
+#endif
+
+#if !SIM_HIER_BLOCKS
+#include "Vxosera_main_copper_slim.h"
+#include "Vxosera_main_video_gen.h"
+#endif
+
 #define USE_FST 1
 #if USE_FST
 #include "verilated_fst_c.h"        // for VM_TRACE
 #else
 #include "verilated_vcd_c.h"        // for VM_TRACE
 #endif
+#if SDL_RENDER
 #include <SDL.h>        // for SDL_RENDER
-#include <SDL_image.h>
+#endif
+#if SIM_SAVABLE
+#include "verilated_save.h"        // for SIM_SAVABLE
+#endif
+
+#include "bus_script.h"
+#include "frame_hash.h"
+#include "frame_writer.h"
 
-#define LOGDIR "sim/logs/"
+#define LOGDIR     "sim/logs/"        // default output directory (change with -o)
+#define LOG_FILE   "xosera_vsim.log"
+#define STATS_FILE "xosera_vsim_stats.json"
+#define HASH_FILE  "xosera_vsim_hashes.txt"
+
+#define EXIT_GOLDEN_MISMATCH 2        // exit code when frames don't match golden hashes (-g)
+
+#define CHECKPOINT_MAGIC 0x58534350        // "XSCP" Xosera simulation checkpoint (+ version below)
+#define CHECKPOINT_VER   1
 
 #define MAX_TRACE_FRAMES 30        // video frames to dump to VCD file (and then screen-shot and exit)
-#define MAX_UPLOADS      8         // maximum number of "payload" uploads
 
 // Current simulation time (64-bit unsigned)
 vluint64_t main_time         = 0;
@@ -44,20 +79,39 @@ vluint64_t first_frame_start = 0;
 vluint64_t frame_start_time  = 0;
 
 volatile bool done;
-bool          sim_render = SDL_RENDER;
-bool          sim_bus    = BUS_INTERFACE;
-bool          wait_close = false;
+bool          sim_render   = SDL_RENDER;           // render frames to SDL window
+bool          sim_headless = !SDL_RENDER;          // render frames to framebuffer only (no SDL window)
+bool          sim_bus      = BUS_INTERFACE;
+bool          wait_close   = false;
+int           max_frames   = MAX_TRACE_FRAMES;        // frames to simulate before exit
+int           sim_threads  = 0;                       // Verilator thread pool size (0 = as built)
+
+uint32_t    framebuffer[TOTAL_WIDTH * TOTAL_HEIGHT];        // ARGB8888 pixels of current frame
+FrameWriter frame_writer;                                  // background PNG writer
+FrameHash   frame_hash;                                    // hash of visible pixels in current frame
+
+const char *   golden_name = nullptr;        // -g golden hash manifest to check frames against
+GoldenManifest golden;                       // golden frame hashes (PNG only saved on mismatch)
+
+int          checkpoint_frame = -1;             // --checkpoint frame to save checkpoint after
+const char * checkpoint_name  = nullptr;        // --checkpoint file to save
+const char * restore_name     = nullptr;        // --restore checkpoint file to resume from
+
+std::string log_dir = LOGDIR;        // output directory for log, stats, hashes, frames and traces
+
+// return path for output file name in log_dir
+static std::string log_path(const char * name)
+{
+    return log_dir + name;
+}
 
 bool vsync_detect = false;
 bool vtop_detect  = false;
 bool hsync_detect = false;
 
-int          num_uploads;
-int          next_upload;
-const char * upload_name[MAX_UPLOADS];
-uint8_t *    upload_payload[MAX_UPLOADS];
-int          upload_size[MAX_UPLOADS];
-uint8_t      upload_buffer[128 * 1024];
+BusScript    bus_script;                   // bus commands and upload payloads for BusInterface
+const char * script_name      = nullptr;        // -s bus script file to load
+const char * save_script_name = nullptr;        // -S file to save bus script as binary
 
 uint16_t last_read_val;
 
@@ -83,6 +137,21 @@ static void logonly_printf(const char * fmt, ...)
     va_end(args);
 }
 
+#if SIM_SAVABLE
+// save or restore simulation variable in checkpoint (same code for both directions)
+template <typename T>
+static void checkpoint_var(VerilatedSerialize & os, T & var)
+{
+    os.write(&var, sizeof(var));
+}
+
+template <typename T>
+static void checkpoint_var(VerilatedDeserialize & is, T & var)
+{
+    is.read(&var, sizeof(var));
+}
+#endif
+
 class BusInterface
 {
     const int   BUS_START_TIME = 1000000;        // after init
@@ -97,36 +166,35 @@ class BusInterface
         BUS_END
     };
 
-    bool    enable;
-    int64_t last_time;
-    int     state;
-    int     index;
-    bool    wait_vsync;
-    bool    wait_hsync;
-    bool    wait_vtop;
-    bool    wait_blit;
-    bool    data_upload;
-    int     data_upload_mode;
-    int     data_upload_num;
-    int     data_upload_count;
-    int     data_upload_index;
-
-    static int      test_data_len;
-    static uint16_t test_data[32768];
+    bool            enable;
+    int64_t         last_time;
+    int             state;
+    int             index;
+    bool            wait_vsync;
+    bool            wait_hsync;
+    bool            wait_vtop;
+    bool            wait_blit;
+    bool            data_upload;
+    int             data_upload_mode;
+    int             data_upload_num;
+    size_t          data_upload_count;
+    size_t          data_upload_index;
+    const uint8_t * data_upload_data;
+
+    static uint16_t test_data[];
 
 public:
-public:
-    void set_cmdline_data(int argc, char ** argv, int & nextarg)
+    // use bus command words from command line (returns false if none)
+    bool set_cmdline_data(int argc, char ** argv, int & nextarg)
     {
-        size_t len = 0;
-        for (int i = nextarg; i < argc && len < sizeof(test_data); i++)
+        std::vector<uint16_t> words;
+        for (int i = nextarg; i < argc; i++)
         {
             char * endptr = nullptr;
             int    value  = static_cast<int>(strtoul(argv[i], &endptr, 0) & 0x1fffUL);
             if (endptr != nullptr && *endptr == '\0')
             {
-                test_data[len] = value;
-                len++;
+                words.push_back(value);
             }
             else
             {
@@ -134,12 +202,17 @@ public:
             }
         }
 
-        if (len != 0)
+        if (words.empty())
         {
-            test_data_len = len;
+            return false;
         }
+
+        bus_script.set_words(std::move(words), "command line");
+        return true;
     }
 
+    void use_builtin_script();
+
     void init(Vxosera_main * top, bool _enable)
     {
         enable            = _enable;
@@ -154,8 +227,56 @@ public:
         data_upload_num   = 0;
         data_upload_count = 0;
         data_upload_index = 0;
+        data_upload_data  = nullptr;
+        top->bus_cs_n_i   = 1;
+    }
+
+#if SIM_SAVABLE
+    // save or restore bus state with checkpoint (bus script itself is not saved)
+    template <typename S>
+    void checkpoint(S & s)
+    {
+        checkpoint_var(s, enable);
+        checkpoint_var(s, last_time);
+        checkpoint_var(s, state);
+        checkpoint_var(s, index);
+        checkpoint_var(s, wait_vsync);
+        checkpoint_var(s, wait_hsync);
+        checkpoint_var(s, wait_vtop);
+        checkpoint_var(s, wait_blit);
+        checkpoint_var(s, data_upload);
+        checkpoint_var(s, data_upload_mode);
+        checkpoint_var(s, data_upload_num);
+        checkpoint_var(s, data_upload_count);
+        checkpoint_var(s, data_upload_index);
+
+        const BusScript::Upload * upload = data_upload ? bus_script.upload(data_upload_num) : nullptr;
+        data_upload_data                 = upload ? upload->data : nullptr;
+        if (data_upload && (upload == nullptr || upload->size != data_upload_count))
+        {
+            data_upload = false;        // restored with different uploads
+        }
+    }
+
+    // start a different bus script after restoring checkpoint (checkpoint script may have ended or been disabled)
+    void restart_script(Vxosera_main * top)
+    {
+        enable            = true;
+        last_time         = main_time > BUS_START_TIME ? (main_time - BUS_START_TIME) / BUS_CLOCK_DIV : 0;
+        index             = 0;
+        state             = BUS_START;
+        wait_vsync        = false;
+        wait_hsync        = false;
+        wait_vtop         = false;
+        wait_blit         = false;
+        data_upload       = false;
+        data_upload_num   = 0;
+        data_upload_count = 0;
+        data_upload_index = 0;
+        data_upload_data  = nullptr;
         top->bus_cs_n_i   = 1;
     }
+#endif
 
     void process(Vxosera_main * top)
     {
@@ -206,11 +327,11 @@ public:
                 //                last_time,
                 //                main_time,
                 //                index,
-                //                test_data[index],
+                //                bus_script.word(index),
                 //                data_upload ? " UPLOAD" : "");
 
                 // REG_END
-                if (!data_upload && test_data[index] == 0xffff)
+                if (!data_upload && bus_script.word(index) == 0xffff)
                 {
                     logonly_printf("[@t=%8lu] REG_END hit\n", main_time);
                     done      = true;
@@ -220,7 +341,7 @@ public:
                     return;
                 }
                 // REG_WAITVSYNC
-                if (!data_upload && test_data[index] == 0xfffe)
+                if (!data_upload && bus_script.word(index) == 0xfffe)
                 {
                     logonly_printf("[@t=%8lu] Wait VSYNC...\n", main_time);
                     wait_vsync = true;
@@ -228,7 +349,7 @@ public:
                     return;
                 }
                 // REG_WAITVTOP
-                if (!data_upload && test_data[index] == 0xfffd)
+                if (!data_upload && bus_script.word(index) == 0xfffd)
                 {
                     logonly_printf("[@t=%8lu] Wait VTOP (VSYNC end)...\n", main_time);
                     //                    logonly_printf("[@t=%8lu] belayed!\n", main_time);
@@ -238,7 +359,7 @@ public:
                     return;
                 }
                 // REG_WAIT_BLIT_READY
-                if (!data_upload && test_data[index] == 0xfffc)
+                if (!data_upload && bus_script.word(index) == 0xfffc)
                 {
                     last_time = bus_time - 1;
                     if (!(last_read_val & (0x0100 << SYS_CTRL_BLIT_FULL_B)))        // blit_full bit
@@ -258,7 +379,7 @@ public:
                     return;
                 }
                 // REG_WAIT_BLIT_DONE
-                if (!data_upload && test_data[index] == 0xfffb)
+                if (!data_upload && bus_script.word(index) == 0xfffb)
                 {
                     last_time = bus_time - 1;
                     if (!(last_read_val & (0x0100 << SYS_CTRL_BLIT_BUSY_B)))        // blit_busy bit
@@ -267,8 +388,11 @@ public:
                         index++;
                         last_read_val = 0;
                         wait_blit     = false;
-                        logonly_printf(
-                            "%5d WB >= [@bt=%lu] INDEX=%9d 0x%04x\n", bus_time, main_time, index, test_data[index]);
+                        logonly_printf("%5d WB >= [@bt=%lu] INDEX=%9d 0x%04x\n",
+                                       bus_time,
+                                       main_time,
+                                       index,
+                                       bus_script.word(index));
                         return;
                     }
                     else if (!wait_blit)
@@ -280,7 +404,7 @@ public:
                     return;
                 }
                 // REG_WAITHSYNC
-                if (!data_upload && test_data[index] == 0xfffa)
+                if (!data_upload && bus_script.word(index) == 0xfffa)
                 {
                     logonly_printf("[@t=%8lu] Wait HSYNC...\n", main_time);
                     wait_hsync = true;
@@ -288,29 +412,37 @@ public:
                     return;
                 }
 
-                if (!data_upload && (test_data[index] & 0xfffe) == 0xfff0)
+                if (!data_upload && (bus_script.word(index) & 0xfffe) == 0xfff0)
                 {
-                    data_upload       = upload_size[data_upload_num] > 0;
-                    data_upload_mode  = test_data[index] & 0x1;
-                    data_upload_count = upload_size[data_upload_num];        // byte count
+                    const BusScript::Upload * upload = bus_script.upload(data_upload_num);
+
+                    data_upload_mode  = bus_script.word(index) & 0x1;
+                    data_upload_count = upload ? upload->size : 0;        // byte count
+                    data_upload_data  = upload ? upload->data : nullptr;
+                    data_upload       = data_upload_count > 0;
                     data_upload_index = 0;
-                    logonly_printf("[Upload #%d started, %d bytes, mode %s]\n",
+                    logonly_printf("[Upload #%d started, \"%s\" %zu bytes, mode %s]\n",
                                    data_upload_num + 1,
+                                   upload ? upload->name.c_str() : "(none)",
                                    data_upload_count,
                                    data_upload_mode ? "XR_DATA" : "VRAM_DATA");
 
-                    index++;
+                    index += 1 + (upload ? upload->skip_words : 0);        // skip inline payload
+                    if (!data_upload)
+                    {
+                        data_upload_num++;
+                    }
                 }
-                int rd_wr   = (test_data[index] & 0xC000) == 0x8000 ? 1 : 0;
-                int bytesel = (test_data[index] & 0x1000) ? 1 : 0;
-                int reg_num = (test_data[index] >> 8) & 0xf;
-                int data    = test_data[index] & 0xff;
+                int rd_wr   = (bus_script.word(index) & 0xC000) == 0x8000 ? 1 : 0;
+                int bytesel = (bus_script.word(index) & 0x1000) ? 1 : 0;
+                int reg_num = (bus_script.word(index) >> 8) & 0xf;
+                int data    = bus_script.word(index) & 0xff;
 
                 if (data_upload && state == BUS_START)
                 {
                     bytesel = data_upload_index & 1;
                     reg_num = data_upload_mode ? XM_XDATA : XM_DATA;
-                    data    = upload_payload[data_upload_num][data_upload_index++];
+                    data    = data_upload_data[data_upload_index++];
                 }
 
                 switch (state)
@@ -396,9 +528,9 @@ public:
                                 data_upload_num++;
                             }
                         }
-                        else if (++index >= test_data_len)
+                        else if (++index >= (int)bus_script.length())
                         {
-                            logonly_printf("*** END of test_data_len ***\n");
+                            logonly_printf("*** END of bus script \"%s\" ***\n", bus_script.name());
                             enable = false;
                         }
                         break;
@@ -462,8 +594,7 @@ const char * BusInterface::reg_name[] = {"XM_SYS_CTRL ",
 #define H_LOGO (16)
 
 BusInterface bus;
-int          BusInterface::test_data_len    = 32767;
-uint16_t     BusInterface::test_data[32768] = {
+uint16_t     BusInterface::test_data[] = {
     // test data
 
     REG_WAITHSYNC(),
@@ -9686,6 +9817,12 @@ uint16_t     BusInterface::test_data[32768] = {
     // end test data
 };
 
+// use compiled-in test_data (when no -s script or command line data)
+void BusInterface::use_builtin_script()
+{
+    bus_script.set_words(test_data, sizeof(test_data) / sizeof(test_data[0]), "built-in test_data");
+}
+
 #if 0
 uint16_t     BusInterface::test_stfont[1024] = {REG_W(WR_ADDR, 0x3),
                                           REG_W(WR_INC, 0x1),
@@ -9732,6 +9869,215 @@ uint16_t     BusInterface::test_stfont[1024] = {REG_W(WR_ADDR, 0x3),
                                           REG_END()};
 #endif
 
+// simulation throughput and per-frame activity counters (printed at exit and saved as JSON)
+class SimStats
+{
+    const int COPP_ST_DECODE = 1;        // copper_slim cop_ex_state ST_DECODE (once per instruction)
+
+    struct FrameCounts
+    {
+        int        frame;
+        vluint64_t cycles;
+        vluint64_t vram_regs;         // VRAM grants to register interface
+        vluint64_t vram_blit;         // VRAM grants to blitter
+        vluint64_t vram_video;        // VRAM grants to video generation (playfield fetch)
+        vluint64_t vram_audio;        // VRAM grants to audio DMA
+        vluint64_t copp_instr;        // copper instructions executed
+        vluint64_t blit_busy;         // cycles blitter busy
+    };
+
+    std::vector<FrameCounts> frames;
+    FrameCounts              cur;
+    FrameCounts              total;
+    int                      copp_last_state;
+
+    static double percent(vluint64_t count, vluint64_t cycles)
+    {
+        return cycles ? (100.0 * count) / cycles : 0.0;
+    }
+
+    static double average(vluint64_t count, size_t num)
+    {
+        return num ? static_cast<double>(count) / num : 0.0;
+    }
+
+public:
+    void init()
+    {
+        frames.clear();
+        memset(&cur, 0, sizeof(cur));
+        memset(&total, 0, sizeof(total));
+        copp_last_state = 0;
+    }
+
+    // sample activity signals (called once per pixel clock after rising edge)
+    void sample(Vxosera_main * top)
+    {
+        auto xm = top->xosera_main;
+
+        cur.cycles++;
+        if (xm->vram_arb->regs_ack_o)
+        {
+            cur.vram_regs++;
+        }
+        if (xm->vram_arb->blit_ack_o)
+        {
+            cur.vram_blit++;
+        }
+        if (xm->vram_arb->vgen_sel_i)
+        {
+#if SIM_AUDIO && !SIM_HIER_BLOCKS
+            if (xm->video_gen->audio_dma_cycle && xm->video_gen->audio_dma_vram_req)
+            {
+                cur.vram_audio++;
+            }
+            else
+#endif
+            {
+                cur.vram_video++;
+            }
+        }
+#if !SIM_HIER_BLOCKS
+        int copp_state = xm->copper->cop_ex_state;
+        if (copp_state == COPP_ST_DECODE && copp_last_state != COPP_ST_DECODE)
+        {
+            cur.copp_instr++;
+        }
+        copp_last_state = copp_state;
+#endif
+        if (xm->blit_busy)
+        {
+            cur.blit_busy++;
+        }
+    }
+
+    // finish counts for frame_num (at end of vsync)
+    void end_frame(int frame_num)
+    {
+        cur.frame = frame_num;
+        frames.push_back(cur);
+        total.cycles += cur.cycles;
+        total.vram_regs += cur.vram_regs;
+        total.vram_blit += cur.vram_blit;
+        total.vram_video += cur.vram_video;
+        total.vram_audio += cur.vram_audio;
+        total.copp_instr += cur.copp_instr;
+        total.blit_busy += cur.blit_busy;
+        memset(&cur, 0, sizeof(cur));
+    }
+
+    void report(int frame_count, double seconds, unsigned threads)
+    {
+        if (cur.cycles)
+        {
+            end_frame(frame_count + 1);        // partial last frame
+        }
+
+        size_t nf          = frames.size();
+        double cycles_sec  = seconds > 0.0 ? total.cycles / seconds : 0.0;
+        double frames_sec  = (seconds > 0.0 && frame_count > 0) ? frame_count / seconds : 0.0;
+        bool   have_copper = !SIM_HIER_BLOCKS;
+        bool   have_audio  = SIM_AUDIO && !SIM_HIER_BLOCKS;
+
+        log_printf("Simulation stats: %lu cycles in %0.03f sec, %0.0f cycles/sec, %0.03f frames/sec\n",
+                   total.cycles,
+                   seconds,
+                   cycles_sec,
+                   frames_sec);
+        log_printf("  VRAM grants/frame: regs %0.1f (%0.2f%%), blit %0.1f (%0.2f%%), video %0.1f (%0.2f%%), ",
+                   average(total.vram_regs, nf),
+                   percent(total.vram_regs, total.cycles),
+                   average(total.vram_blit, nf),
+                   percent(total.vram_blit, total.cycles),
+                   average(total.vram_video, nf),
+                   percent(total.vram_video, total.cycles));
+        if (have_audio)
+        {
+            log_printf("audio %0.1f (%0.2f%%)\n",
+                       average(total.vram_audio, nf),
+                       percent(total.vram_audio, total.cycles));
+        }
+        else
+        {
+            log_printf("audio n/a\n");
+        }
+        if (have_copper)
+        {
+            log_printf("  Copper instructions: %lu (%0.1f/frame)", total.copp_instr, average(total.copp_instr, nf));
+        }
+        else
+        {
+            log_printf("  Copper instructions: n/a");
+        }
+        log_printf(", blitter busy cycles: %lu (%0.2f%%)\n", total.blit_busy, percent(total.blit_busy, total.cycles));
+
+        std::string stats_path = log_path(STATS_FILE);
+        FILE *      jfp        = fopen(stats_path.c_str(), "w");
+        if (jfp == nullptr)
+        {
+            log_printf("Can't write stats to \"%s\"\n", stats_path.c_str());
+            return;
+        }
+
+        fprintf(jfp, "{\n");
+        fprintf(jfp, "  \"video_mode\": \"%dx%d\",\n", VISIBLE_WIDTH, VISIBLE_HEIGHT);
+        fprintf(jfp, "  \"threads\": %u,\n", threads);
+        fprintf(jfp, "  \"frames\": %d,\n", frame_count > 0 ? frame_count : 0);
+        fprintf(jfp, "  \"cycles\": %lu,\n", total.cycles);
+        fprintf(jfp, "  \"wall_seconds\": %0.06f,\n", seconds);
+        fprintf(jfp, "  \"cycles_per_sec\": %0.1f,\n", cycles_sec);
+        fprintf(jfp, "  \"frames_per_sec\": %0.06f,\n", frames_sec);
+        fprintf(jfp, "  \"totals\": ");
+        write_json_counts(jfp, total, have_copper, have_audio, false);
+        fprintf(jfp, ",\n  \"per_frame\": [\n");
+        for (size_t f = 0; f < nf; f++)
+        {
+            fprintf(jfp, "    ");
+            write_json_counts(jfp, frames[f], have_copper, have_audio, true);
+            fprintf(jfp, "%s\n", (f + 1 < nf) ? "," : "");
+        }
+        fprintf(jfp, "  ]\n}\n");
+        fclose(jfp);
+
+        log_printf("Simulation stats saved to \"%s\"\n", stats_path.c_str());
+    }
+
+private:
+    static void write_json_counts(FILE * jfp, const FrameCounts & c, bool have_copper, bool have_audio, bool frame)
+    {
+        fprintf(jfp, "{ ");
+        if (frame)
+        {
+            fprintf(jfp, "\"frame\": %d, ", c.frame);
+        }
+        fprintf(jfp,
+                "\"cycles\": %lu, \"vram_regs\": %lu, \"vram_blit\": %lu, \"vram_video\": %lu, ",
+                c.cycles,
+                c.vram_regs,
+                c.vram_blit,
+                c.vram_video);
+        if (have_audio)
+        {
+            fprintf(jfp, "\"vram_audio\": %lu, ", c.vram_audio);
+        }
+        else
+        {
+            fprintf(jfp, "\"vram_audio\": null, ");
+        }
+        if (have_copper)
+        {
+            fprintf(jfp, "\"copper_instructions\": %lu, ", c.copp_instr);
+        }
+        else
+        {
+            fprintf(jfp, "\"copper_instructions\": null, ");
+        }
+        fprintf(jfp, "\"blit_busy_cycles\": %lu }", c.blit_busy);
+    }
+};
+
+SimStats sim_stats;
+
 void ctrl_c(int s)
 {
     (void)s;
@@ -9754,11 +10100,25 @@ int main(int argc, char ** argv)
 
     sigaction(SIGINT, &sigIntHandler, NULL);
 
-    if ((logfile = fopen("sim/logs/xosera_vsim.log", "w")) == NULL)
+    // output directory needs to be known before log file is opened
+    for (int a = 1; a < argc - 1; a++)
+    {
+        if (strcmp(argv[a], "-o") == 0)
+        {
+            log_dir = argv[a + 1];
+            if (!log_dir.empty() && log_dir.back() != '/')
+            {
+                log_dir += '/';
+            }
+            mkdir(log_dir.c_str(), 0777);        // ignore error (may already exist)
+        }
+    }
+
+    if ((logfile = fopen(log_path(LOG_FILE).c_str(), "w")) == NULL)
     {
-        if ((logfile = fopen("xosera_vsim.log", "w")) == NULL)
+        if (log_dir != LOGDIR || (logfile = fopen(LOG_FILE, "w")) == NULL)
         {
-            printf("can't create xosera_vsim.log (in \"sim/logs/\" or current directory)\n");
+            printf("can't create %s (in \"%s\" or current directory)\n", LOG_FILE, log_dir.c_str());
             exit(EXIT_FAILURE);
         }
     }
@@ -9776,7 +10136,73 @@ int main(int argc, char ** argv)
     {
         if (strcmp(argv[nextarg] + 1, "n") == 0)
         {
-            sim_render = false;
+            sim_render   = false;
+            sim_headless = false;
+        }
+        else if (strcmp(argv[nextarg] + 1, "H") == 0)
+        {
+            sim_render   = false;
+            sim_headless = true;
+        }
+        else if (strcmp(argv[nextarg] + 1, "f") == 0)
+        {
+            nextarg += 1;
+            if (nextarg >= argc || atoi(argv[nextarg]) < 1)
+            {
+                printf("-f needs number of frames\n");
+                exit(EXIT_FAILURE);
+            }
+            max_frames = atoi(argv[nextarg]);
+        }
+        else if (strcmp(argv[nextarg], "--checkpoint") == 0)
+        {
+            nextarg += 2;
+            if (nextarg >= argc || atoi(argv[nextarg - 1]) < 1)
+            {
+                printf("--checkpoint needs frame number and checkpoint filename\n");
+                exit(EXIT_FAILURE);
+            }
+            checkpoint_frame = atoi(argv[nextarg - 1]);
+            checkpoint_name  = argv[nextarg];
+        }
+        else if (strcmp(argv[nextarg], "--restore") == 0)
+        {
+            nextarg += 1;
+            if (nextarg >= argc)
+            {
+                printf("--restore needs checkpoint filename\n");
+                exit(EXIT_FAILURE);
+            }
+            restore_name = argv[nextarg];
+        }
+        else if (strcmp(argv[nextarg], "--threads") == 0)
+        {
+            nextarg += 1;
+            if (nextarg >= argc || atoi(argv[nextarg]) < 1)
+            {
+                printf("--threads needs number of threads\n");
+                exit(EXIT_FAILURE);
+            }
+            sim_threads = atoi(argv[nextarg]);
+        }
+        else if (strcmp(argv[nextarg] + 1, "g") == 0)
+        {
+            nextarg += 1;
+            if (nextarg >= argc)
+            {
+                printf("-g needs golden hash manifest filename\n");
+                exit(EXIT_FAILURE);
+            }
+            golden_name = argv[nextarg];
+        }
+        else if (strcmp(argv[nextarg] + 1, "o") == 0)
+        {
+            nextarg += 1;        // already handled above
+            if (nextarg >= argc)
+            {
+                printf("-o needs output directory\n");
+                exit(EXIT_FAILURE);
+            }
         }
         else if (strcmp(argv[nextarg] + 1, "b") == 0)
         {
@@ -9786,72 +10212,123 @@ int main(int argc, char ** argv)
         {
             wait_close = true;
         }
-        if (strcmp(argv[nextarg] + 1, "u") == 0)
+        else if (strcmp(argv[nextarg] + 1, "s") == 0 || strcmp(argv[nextarg] + 1, "S") == 0)
         {
+            bool save = argv[nextarg][1] == 'S';
             nextarg += 1;
             if (nextarg >= argc)
             {
-                printf("-u needs filename\n");
+                printf("-%c needs bus script filename\n", save ? 'S' : 's');
                 exit(EXIT_FAILURE);
             }
-            // upload_data = true;
-            upload_name[num_uploads] = argv[nextarg];
-            num_uploads++;
+            if (save)
+            {
+                save_script_name = argv[nextarg];
+            }
+            else
+            {
+                script_name = argv[nextarg];
+            }
         }
-        nextarg += 1;
-    }
-
-    if (num_uploads)
-    {
-        for (int u = 0; u < num_uploads; u++)
+        else if (strcmp(argv[nextarg] + 1, "u") == 0)
         {
-            logonly_printf("Reading upload data #%d: \"%s\"...", u + 1, upload_name[u]);
-            FILE * bfp = fopen(upload_name[u], "r");
-            if (bfp != nullptr)
+            nextarg += 1;
+            if (nextarg >= argc)
             {
-                int read_size = fread(upload_buffer, 1, sizeof(upload_buffer), bfp);
-                fclose(bfp);
-
-                if (read_size > 0)
-                {
-                    logonly_printf("read %d bytes.\n", read_size);
-                    upload_size[u]    = read_size;
-                    upload_payload[u] = (uint8_t *)malloc(read_size);
-                    memcpy(upload_payload[u], upload_buffer, read_size);
-                }
-                else
-                {
-                    fprintf(stderr, "Reading upload data \"%s\" error ", upload_name[u]);
-                    perror("fread failed");
-                    exit(EXIT_FAILURE);
-                }
+                printf("-u needs filename\n");
+                exit(EXIT_FAILURE);
             }
-            else
+            std::string err;
+            if (!bus_script.add_upload_file(argv[nextarg], err))
             {
-                fprintf(stderr, "Reading upload data \"%s\" error ", upload_name[u]);
-                perror("fopen failed");
+                fprintf(stderr, "Reading upload data error: %s\n", err.c_str());
                 exit(EXIT_FAILURE);
             }
+            logonly_printf("Upload data: \"%s\"\n", argv[nextarg]);
         }
+        nextarg += 1;
     }
 
+#if !SIM_SAVABLE
+    if (checkpoint_name != nullptr || restore_name != nullptr)
+    {
+        printf("--checkpoint and --restore need model verilated with --savable (single-threaded vsim)\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (checkpoint_name != nullptr && checkpoint_frame >= max_frames)
+    {
+        printf("--checkpoint frame must be less than -f frames (%d)\n", max_frames);
+        exit(EXIT_FAILURE);
+    }
+
+    if (golden_name != nullptr)
+    {
+        std::string err;
+        if (!golden.load(golden_name, err))
+        {
+            fprintf(stderr, "Golden hash error: %s\n", err.c_str());
+            exit(EXIT_FAILURE);
+        }
+        log_printf("Checking frames against %zu golden hashes in \"%s\"\n", golden.size(), golden_name);
+    }
 
+    bool new_script = true;        // bus script given (restart script when restoring checkpoint)
 #if BUS_INTERFACE
     // bus test data init
-    bus.set_cmdline_data(argc, argv, nextarg);
+    if (script_name != nullptr)
+    {
+        std::string err;
+        if (!bus_script.load(script_name, err))
+        {
+            fprintf(stderr, "Bus script error: %s\n", err.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (!bus.set_cmdline_data(argc, argv, nextarg))
+    {
+        bus.use_builtin_script();
+        new_script = false;
+    }
+    log_printf("Bus script \"%s\": %zu words, %zu uploads\n",
+               bus_script.name(),
+               bus_script.length(),
+               bus_script.num_uploads());
+
+    if (save_script_name != nullptr)
+    {
+        std::string err;
+        if (!bus_script.save_binary(save_script_name, err))
+        {
+            fprintf(stderr, "Bus script error: %s\n", err.c_str());
+            exit(EXIT_FAILURE);
+        }
+        log_printf("Bus script saved as \"%s\"\n", save_script_name);
+    }
 #endif
 
     Verilated::commandArgs(argc, argv);
 
+    // NOTE: must be set before model is created (and at least --threads used to verilate model)
+    if (sim_threads > 0)
+    {
+        Verilated::defaultContextp()->threads(sim_threads);
+    }
+
 #if VM_TRACE
     Verilated::traceEverOn(true);
 #endif
 
     Vxosera_main * top = new Vxosera_main;
 
+    log_printf("Verilator model using %d thread%s\n",
+               Verilated::defaultContextp()->threads(),
+               Verilated::defaultContextp()->threads() == 1 ? "" : "s");
+
 #if SDL_RENDER
     SDL_Renderer * renderer = nullptr;
     SDL_Window *   window   = nullptr;
+    SDL_Texture *  texture  = nullptr;
     if (sim_render)
     {
         if (SDL_Init(SDL_INIT_VIDEO) != 0)
@@ -9859,25 +10336,40 @@ int main(int argc, char ** argv)
             fprintf(stderr, "SDL_Init() failed: %s\n", SDL_GetError());
             return EXIT_FAILURE;
         }
-        if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0)
-        {
-            fprintf(stderr, "IMG_Init() failed: %s\n", SDL_GetError());
-            return EXIT_FAILURE;
-        }
 
         window = SDL_CreateWindow(
             "Xosera-sim", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, TOTAL_WIDTH, TOTAL_HEIGHT, SDL_WINDOW_SHOWN);
 
         renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+        texture  = SDL_CreateTexture(
+            renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, TOTAL_WIDTH, TOTAL_HEIGHT);
         SDL_RenderSetScale(renderer, 1, 1);
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
     }
+#else
+    sim_render = false;
+#endif        // SDL_RENDER
 
-    bool shot_all  = true;        // screenshot all frames
-    bool take_shot = false;
+    bool sim_frames = sim_render || sim_headless;        // rendering frames to framebuffer
+    bool shot_all   = golden_name == nullptr;            // screenshot all frames (unless checking golden hashes)
+    bool take_shot  = false;
 
-#endif        // SDL_RENDER
+    int golden_matched    = 0;        // frames matching golden hash
+    int golden_mismatched = 0;        // frames with different hash than golden
+    int golden_missing    = 0;        // frames with no golden hash
+
+    if (golden_name != nullptr && !sim_frames)
+    {
+        log_printf("WARNING: -g golden hash check needs frame rendering (ignored)\n");
+    }
+
+    if (sim_frames)
+    {
+        memset(framebuffer, 0, sizeof(framebuffer));
+        frame_writer.start();
+        log_printf("Rendering %d frames %s\n", max_frames, sim_render ? "to SDL window" : "headless (no window)");
+    }
     int  current_x          = 0;
     int  current_y          = 0;
     bool vga_hsync_previous = false;
@@ -9892,25 +10384,126 @@ int main(int argc, char ** argv)
 
 #if VM_TRACE
 #if USE_FST
-    const auto trace_path = LOGDIR "xosera_vsim.fst";
-    logonly_printf("Writing FST waveform file to \"%s\"...\n", trace_path);
+    const auto trace_path = log_path("xosera_vsim.fst");
+    logonly_printf("Writing FST waveform file to \"%s\"...\n", trace_path.c_str());
     VerilatedFstC * tfp = new VerilatedFstC;
 #else
-    const auto trace_path = LOGDIR "xosera_vsim.vcd";
-    logonly_printf("Writing VCD waveform file to \"%s\"...\n", trace_path);
+    const auto trace_path = log_path("xosera_vsim.vcd");
+    logonly_printf("Writing VCD waveform file to \"%s\"...\n", trace_path.c_str());
     VerilatedVcdC * tfp = new VerilatedVcdC;
 #endif
 
     top->trace(tfp, 99);        // trace to heirarchal depth of 99
-    tfp->open(trace_path);
+    tfp->open(trace_path.c_str());
 #endif
 
+    std::string hash_path = log_path(HASH_FILE);
+    FILE *      hash_fp   = sim_frames ? fopen(hash_path.c_str(), "w") : nullptr;
+    if (hash_fp != nullptr)
+    {
+        fprintf(hash_fp, "# frame hash pixels (%dx%d)\n", VISIBLE_WIDTH, VISIBLE_HEIGHT);
+    }
+
     top->reset_i = 1;        // start in reset
 
     bus.init(top, sim_bus);
 
+    sim_stats.init();
+
+#if SIM_SAVABLE
+    // save or restore simulation state along with Verilated model (file header, then model, then this)
+    auto checkpoint_state = [&](auto & s) {
+        checkpoint_var(s, main_time);
+        checkpoint_var(s, first_frame_start);
+        checkpoint_var(s, frame_start_time);
+        checkpoint_var(s, vsync_detect);
+        checkpoint_var(s, vtop_detect);
+        checkpoint_var(s, hsync_detect);
+        checkpoint_var(s, last_read_val);
+        checkpoint_var(s, current_x);
+        checkpoint_var(s, current_y);
+        checkpoint_var(s, vga_hsync_previous);
+        checkpoint_var(s, vga_vsync_previous);
+        checkpoint_var(s, vga_dv_previous);
+        checkpoint_var(s, frame_num);
+        checkpoint_var(s, x_max);
+        checkpoint_var(s, y_max);
+        checkpoint_var(s, hsync_count);
+        checkpoint_var(s, hsync_min);
+        checkpoint_var(s, hsync_max);
+        checkpoint_var(s, vsync_count);
+        bus.checkpoint(s);
+    };
+    bool     checkpoint_pending   = false;
+    uint32_t checkpoint_header[4] = {CHECKPOINT_MAGIC, CHECKPOINT_VER, VISIBLE_WIDTH, VISIBLE_HEIGHT};
+
+    if (restore_name != nullptr)
+    {
+        VerilatedRestore is;
+        is.open(restore_name);
+        if (!is.isOpen())
+        {
+            log_printf("ERROR: can't open checkpoint \"%s\"\n", restore_name);
+            exit(EXIT_FAILURE);
+        }
+        uint32_t header[4] = {0};
+        checkpoint_var(is, header);
+        if (memcmp(header, checkpoint_header, sizeof(header)) != 0)
+        {
+            log_printf("ERROR: \"%s\" is not a checkpoint for this simulation (video mode %dx%d)\n",
+                       restore_name,
+                       VISIBLE_WIDTH,
+                       VISIBLE_HEIGHT);
+            exit(EXIT_FAILURE);
+        }
+        is >> *top;
+        checkpoint_state(is);
+        is.close();
+
+        if (new_script)
+        {
+            bus.restart_script(top);
+        }
+        log_printf("Restored checkpoint \"%s\" at frame %d (@t=%lu), %s bus script\n",
+                   restore_name,
+                   frame_num,
+                   main_time,
+                   new_script ? "starting" : "continuing");
+        if (frame_num >= max_frames)
+        {
+            log_printf("ERROR: -f frames must be more than checkpoint frame %d\n", frame_num);
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
+
+    auto sim_start_time = std::chrono::steady_clock::now();
+
     while (!done && !Verilated::gotFinish())
     {
+#if SIM_SAVABLE
+        if (checkpoint_pending)
+        {
+            checkpoint_pending = false;
+
+            VerilatedSave os;
+            os.open(checkpoint_name);
+            if (!os.isOpen())
+            {
+                log_printf("ERROR: can't create checkpoint \"%s\"\n", checkpoint_name);
+                exit(EXIT_FAILURE);
+            }
+            checkpoint_var(os, checkpoint_header);
+            os << *top;
+            checkpoint_state(os);
+            os.close();
+            log_printf("[@t=%8lu] Checkpoint after frame %d saved as \"%s\"\n",
+                       main_time,
+                       frame_num - 1,
+                       checkpoint_name);
+        }
+#endif
+
         if (main_time == 4)
         {
             top->reset_i = 0;        // tale out of reset after 2 cycles
@@ -9924,6 +10517,8 @@ int main(int argc, char ** argv)
         top->clk = 1;        // clock rising
         top->eval();
 
+        sim_stats.sample(top);
+
 #if VM_TRACE
         if (frame_num <= MAX_TRACE_FRAMES)
             tfp->dump(main_time);
@@ -9986,17 +10581,15 @@ int main(int argc, char ** argv)
         bool hsync = H_SYNC_POLARITY ? top->hsync_o : !top->hsync_o;
         bool vsync = V_SYNC_POLARITY ? top->vsync_o : !top->vsync_o;
 
-#if SDL_RENDER
-        if (sim_render)
+        if (sim_frames)
         {
+            uint32_t argb;
             if (top->dv_de_o)
             {
                 // sim_render current VGA output pixel (4 bits per gun)
-                SDL_SetRenderDrawColor(renderer,
-                                       (top->red_o << 4) | top->red_o,
-                                       (top->green_o << 4) | top->green_o,
-                                       (top->blue_o << 4) | top->blue_o,
-                                       255);
+                argb = 0xff000000 | (((top->red_o << 4) | top->red_o) << 16) |
+                       (((top->green_o << 4) | top->green_o) << 8) | ((top->blue_o << 4) | top->blue_o);
+                frame_hash.add(argb);
             }
             else
             {
@@ -10018,21 +10611,20 @@ int main(int argc, char ** argv)
                     //                    auto       vmem    = top->xosera_main->xrmem_arb->colormem->bram;
                     //                    uint16_t * color0p = &vmem[0];
                     uint16_t color0 = 0;        //*color0p;
-                    SDL_SetRenderDrawColor(
-                        renderer, ((color0 & 0x0f00) >> 5), ((color0 & 0x00f0) >> 1), ((color0 & 0x000f) << 7), 255);
+                    argb            = 0xff000000 | (((color0 & 0x0f00) >> 5) << 16) |
+                           (((color0 & 0x00f0) >> 1) << 8) | ((color0 & 0x000f) << 7);
                 }
                 else
                 {
-                    SDL_SetRenderDrawColor(renderer, 0x21, vsync ? 0x41 : 0x21, hsync ? 0x41 : 0x21, 0xff);
+                    argb = 0xff210000 | ((vsync ? 0x41 : 0x21) << 8) | (hsync ? 0x41 : 0x21);
                 }
             }
 
-            if (frame_num > 0)
+            if (frame_num > 0 && current_x < TOTAL_WIDTH && current_y < TOTAL_HEIGHT)
             {
-                SDL_RenderDrawPoint(renderer, current_x, current_y);
+                framebuffer[(current_y * TOTAL_WIDTH) + current_x] = argb;
             }
         }
-#endif
         current_x++;
 
         if (hsync)
@@ -10074,6 +10666,8 @@ int main(int argc, char ** argv)
             if (current_y - 1 > y_max)
                 y_max = current_y - 1;
 
+            sim_stats.end_frame(frame_num);
+
             if (frame_num > 0)
             {
                 if (frame_num == 1)
@@ -10092,55 +10686,135 @@ int main(int argc, char ** argv)
                     hsync_max,
                     vsync_count);
 
-#if SDL_RENDER
-
-                if (sim_render)
+                if (sim_frames)
                 {
-                    if (shot_all || take_shot || frame_num == MAX_TRACE_FRAMES)
+                    logonly_printf("[@t=%8lu] Frame %3d hash %016lx (%u pixels)\n",
+                                   main_time,
+                                   frame_num,
+                                   frame_hash.value(),
+                                   frame_hash.pixels());
+                    if (hash_fp != nullptr)
+                    {
+                        fprintf(hash_fp, "%d %016lx %u\n", frame_num, frame_hash.value(), frame_hash.pixels());
+                    }
+
+                    bool mismatch = false;
+                    if (golden_name != nullptr)
+                    {
+                        const GoldenManifest::Entry * gold = golden.find(frame_num);
+                        if (gold == nullptr)
+                        {
+                            logonly_printf("[@t=%8lu] Frame %3d has no golden hash\n", main_time, frame_num);
+                            golden_missing++;
+                        }
+                        else if (gold->hash != frame_hash.value() || gold->pixels != frame_hash.pixels())
+                        {
+                            log_printf("[@t=%8lu] Frame %3d MISMATCH hash %016lx (%u pixels), golden %016lx (%u)\n",
+                                       main_time,
+                                       frame_num,
+                                       frame_hash.value(),
+                                       frame_hash.pixels(),
+                                       gold->hash,
+                                       gold->pixels);
+                            golden_mismatched++;
+                            mismatch = true;
+                        }
+                        else
+                        {
+                            golden_matched++;
+                        }
+                    }
+
+                    if (mismatch)
+                    {
+                        std::string           gold_image = golden.image_name(frame_num);
+                        std::vector<uint32_t> gold_pixels;
+                        if (load_png_argb(gold_image.c_str(), gold_pixels, TOTAL_WIDTH, TOTAL_HEIGHT))
+                        {
+                            std::vector<uint32_t> diff_pixels(TOTAL_WIDTH * TOTAL_HEIGHT);
+                            int                   changed     = diff_argb(
+                                diff_pixels.data(), framebuffer, gold_pixels.data(), TOTAL_WIDTH * TOTAL_HEIGHT);
+
+                            char diff_name[256] = {0};
+                            snprintf(diff_name,
+                                     sizeof(diff_name),
+                                     "%sxosera_vsim_%dx%d_f%02d_diff.png",
+                                     log_dir.c_str(),
+                                     VISIBLE_WIDTH,
+                                     VISIBLE_HEIGHT,
+                                     frame_num);
+                            frame_writer.write(diff_name, diff_pixels.data(), TOTAL_WIDTH, TOTAL_HEIGHT);
+                            log_printf("[@t=%8lu] Frame %3d has %d changed pixels vs \"%s\", diff saved as \"%s\"\n",
+                                       main_time,
+                                       frame_num,
+                                       changed,
+                                       gold_image.c_str(),
+                                       diff_name);
+                        }
+                        else
+                        {
+                            logonly_printf("[@t=%8lu] Frame %3d no golden image \"%s\" for diff\n",
+                                           main_time,
+                                           frame_num,
+                                           gold_image.c_str());
+                        }
+                    }
+
+                    if (shot_all || take_shot || mismatch || (frame_num == max_frames && golden_name == nullptr))
                     {
-                        int  w = 0, h = 0;
                         char save_name[256] = {0};
-                        SDL_GetRendererOutputSize(renderer, &w, &h);
-                        SDL_Surface * screen_shot =
-                            SDL_CreateRGBSurface(0, w, h, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
-                        SDL_RenderReadPixels(
-                            renderer, NULL, SDL_PIXELFORMAT_ARGB8888, screen_shot->pixels, screen_shot->pitch);
                         snprintf(save_name,
                                  sizeof(save_name),
-                                 LOGDIR "xosera_vsim_%dx%d_f%02d.png",
+                                 "%sxosera_vsim_%dx%d_f%02d.png",
+                                 log_dir.c_str(),
                                  VISIBLE_WIDTH,
                                  VISIBLE_HEIGHT,
                                  frame_num);
-                        IMG_SavePNG(screen_shot, save_name);
-                        SDL_FreeSurface(screen_shot);
+                        frame_writer.write(save_name, framebuffer, TOTAL_WIDTH, TOTAL_HEIGHT);
                         float fnum = ((1.0 / PIXEL_CLOCK_MHZ) * ((main_time - first_frame_start) / 2)) / 1000.0;
                         log_printf("[@t=%8lu] %8.03f ms frame #%3u saved as \"%s\" (%dx%d)\n",
                                    main_time,
                                    fnum,
                                    frame_num,
                                    save_name,
-                                   w,
-                                   h);
+                                   TOTAL_WIDTH,
+                                   TOTAL_HEIGHT);
                         take_shot = false;
                     }
 
-                    SDL_RenderPresent(renderer);
-                    SDL_SetRenderDrawColor(renderer, 0x20, 0x20, 0x20, 0xff);
-                    SDL_RenderClear(renderer);
-                }
+#if SDL_RENDER
+                    if (sim_render)
+                    {
+                        SDL_UpdateTexture(texture, NULL, framebuffer, TOTAL_WIDTH * sizeof(uint32_t));
+                        SDL_RenderCopy(renderer, texture, NULL, NULL);
+                        SDL_RenderPresent(renderer);
+                    }
 #endif
+                    for (auto & pixel : framebuffer)
+                    {
+                        pixel = 0xff202020;
+                    }
+                }
             }
+            frame_hash.reset();
             frame_start_time = main_time;
             hsync_min        = 0;
             hsync_max        = 0;
             vsync_count      = 0;
             current_y        = 0;
 
-            if (frame_num == MAX_TRACE_FRAMES)
+            if (frame_num == max_frames)
             {
                 break;
             }
 
+#if SIM_SAVABLE
+            if (checkpoint_name != nullptr && frame_num == checkpoint_frame)
+            {
+                checkpoint_pending = true;        // save at start of next cycle
+            }
+#endif
+
             if (TOTAL_HEIGHT == y_max + 1)
             {
                 frame_num += 1;
@@ -10180,7 +10854,7 @@ int main(int argc, char ** argv)
     }
 
 #if 0
-    FILE * mfp = fopen(LOGDIR "xosera_vsim_text.txt", "w");
+    FILE * mfp = fopen(log_path("xosera_vsim_text.txt").c_str(), "w");
     if (mfp != nullptr)
     {
         auto       vmem = top->xosera_main->vram_arb->vram->memory;
@@ -10210,7 +10884,7 @@ int main(int argc, char ** argv)
     }
 
     {
-        FILE * bfp = fopen(LOGDIR "xosera_vsim_vram.bin", "w");
+        FILE * bfp = fopen(log_path("xosera_vsim_vram.bin").c_str(), "w");
         if (bfp != nullptr)
         {
             auto       vmem = top->xosera_main->vram_arb->vram->memory;
@@ -10221,7 +10895,7 @@ int main(int argc, char ** argv)
     }
 
     {
-        FILE * tfp = fopen(LOGDIR "xosera_vsim_vram_hex.txt", "w");
+        FILE * tfp = fopen(log_path("xosera_vsim_vram_hex.txt").c_str(), "w");
         if (tfp != nullptr)
         {
             auto       vmem = top->xosera_main->vram_arb->vram->memory;
@@ -10240,6 +10914,9 @@ int main(int argc, char ** argv)
     }
 #endif
 
+    double sim_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - sim_start_time).count();
+
     top->final();
 
 #if VM_TRACE
@@ -10259,16 +10936,50 @@ int main(int argc, char ** argv)
             fgetc(stdin);
         }
 
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
-        IMG_Quit();
         SDL_Quit();
     }
 #endif
 
+    if (sim_frames && frame_writer.finish() != 0)
+    {
+        log_printf("ERROR: not all frames could be saved to \"%s\"\n", log_dir.c_str());
+    }
+
+    if (hash_fp != nullptr)
+    {
+        fclose(hash_fp);
+        log_printf("Frame hashes saved to \"%s\"\n", hash_path.c_str());
+    }
+
     log_printf("Simulation ended after %d frames, %lu pixel clock ticks (%.04f milliseconds)\n",
                frame_num,
                (main_time / 2),
                ((1.0 / (PIXEL_CLOCK_MHZ * 1000000)) * (main_time / 2)) * 1000.0);
+    log_printf("Simulation speed: %0.03f frames/sec, %0.0f cycles/sec (%0.03f seconds, %d thread%s)\n",
+               frame_num > 0 ? frame_num / sim_seconds : 0.0,
+               (main_time / 2) / sim_seconds,
+               sim_seconds,
+               Verilated::defaultContextp()->threads(),
+               Verilated::defaultContextp()->threads() == 1 ? "" : "s");
+    sim_stats.report(frame_num, sim_seconds, Verilated::defaultContextp()->threads());
+
+    if (golden_name != nullptr && sim_frames)
+    {
+        int unchecked = (int)golden.size() - golden_matched - golden_mismatched;
+        log_printf("Golden hash check %s: %d matched, %d mismatched, %d with no golden hash, %d golden not reached\n",
+                   golden_mismatched ? "FAILED" : "passed",
+                   golden_matched,
+                   golden_mismatched,
+                   golden_missing,
+                   unchecked > 0 ? unchecked : 0);
+        if (golden_mismatched)
+        {
+            return EXIT_GOLDEN_MISMATCH;
+        }
+    }
 
     return EXIT_SUCCESS;
 }
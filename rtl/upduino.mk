@@ -69,6 +69,9 @@ VIDEO_OUTPUT ?= PMOD_DIGILENT_VGA
 
 # copper assembly
 COPASM=$(XOSERA_M68K_API)/bin/copasm
+# optional copasm assembly cache directory (e.g., COPASM_CACHE=/tmp/copasm_cache, off by default)
+COPASM_CACHE?=
+COPASM_CACHEOPT=$(if $(COPASM_CACHE),-C $(COPASM_CACHE))
 RESET_COP=default_copper.casm
 ifeq ($(findstring 640x,$(VIDEO_MODE)),)
 RESET_COPMEM=default_copper_848.mem
@@ -306,7 +309,7 @@ $(COPASM):
 # assemble casm into mem file
 cop_init:  $(COPASM) $(RESET_COP)
 	@mkdir -p $(@D)
-	$(COPASM) -b 4096 $(COPASMOPT) -l -i $(XOSERA_M68K_API) $(RESET_COP)
+	$(COPASM) -b 4096 $(COPASMOPT) -l $(COPASM_CACHEOPT) -i $(XOSERA_M68K_API) $(RESET_COP)
 	mv -f $(addsuffix .lst,$(basename $(RESET_COP))) $(RESET_COPMEM)
 
 cop_clean:
@@ -195,11 +195,11 @@ video_timing video_timing
 `ifdef EN_AUDIO
 // audio
 logic                                   audio_enable;           // all channel enable
-logic                                   audio_dma_vram_req;     // audio DMA request signal
+logic                                   audio_dma_vram_req /*verilator public*/;     // audio DMA request signal
 logic                                   audio_dma_tile_req;     // audio DMA request signal
 addr_t                                  audio_dma_addr;         // audio DMA address
 logic                                   audio_dma_ack;          // audio DMA ack signal
-logic                                   audio_dma_cycle;        // audio DMA request signal
+logic                                   audio_dma_cycle /*verilator public*/;        // audio DMA request signal
 logic                                   audio_reg_wr;           // audio reg write enable
 logic [7*xv::AUDIO_NCHAN-1:0]           audio_vol_l_nchan;      // channel L volume/pan
 logic [7*xv::AUDIO_NCHAN-1:0]           audio_vol_r_nchan;      // channel R volume/pan
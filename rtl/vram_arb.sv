@@ -14,7 +14,7 @@
 
 module vram_arb(
     // video generation access (read-only)
-    input  wire logic           vgen_sel_i,
+    input  wire logic           vgen_sel_i  /*verilator public*/,
     input  wire addr_t          vgen_addr_i,
 
     // register interface access (read/write)
@@ -28,7 +28,7 @@ module vram_arb(
 `ifdef EN_BLIT
     // blit access (read/write)
     input  wire logic           blit_sel_i,
-    output      logic           blit_ack_o,
+    output      logic           blit_ack_o  /*verilator public*/,
     input  wire logic           blit_wr_i,
     input  wire logic  [3:0]    blit_wr_mask_i,
     input  wire addr_t          blit_addr_i,
@@ -109,7 +109,7 @@ logic                   blit_wr;
 logic  [3:0]            blit_wr_mask;
 addr_t                  blit_vram_addr;
 word_t                  blit_vram_data;
-logic                   blit_busy;
+logic                   blit_busy /*verilator public*/;
 logic                   blit_full;
 `endif
 
@@ -0,0 +1,161 @@
+// playfield_fetch.h - Xosera playfield pixel fetch and expansion
+//
+// vim: set et ts=4 sw=4
+//
+// Fetches the display words for the next 8 pixels of a playfield (bitmap or
+// tiled, 1/4/8 bpp) and expands them to color indices the same way as the
+// fetch FSM in video_playfield.sv.  Shared by the functional emulator
+// (xosera_emu.cpp) and the memory dump scanline renderer (scanline_render.cpp)
+// so both decode the display modes identically.
+
+#if !defined(PLAYFIELD_FETCH_H)
+#define PLAYFIELD_FETCH_H
+
+#include <stdint.h>
+
+// playfield display mode (GFX_CTRL and TILE_CTRL fields used by fetch)
+struct PlayfieldMode
+{
+    bool    bitmap;
+    uint8_t bpp;        // GFX_CTRL_BPP (0 = 1-bpp + attribute, 1 = 4-bpp, 2 = 8-bpp, 3 = 8-bpp XX)
+    uint8_t tile_bank;
+    bool    disp_in_tile;
+    bool    tile_in_vram;
+    uint8_t tile_height;        // tile height - 1 (0-15)
+};
+
+// tile attribute bits (see xosera_pkg.sv)
+enum
+{
+    TILE_ATTR_BACK = 12,
+    TILE_ATTR_FORE = 8,
+    TILE_ATTR_HREV = 11,
+    TILE_ATTR_VREV = 10
+};
+
+// GFX_CTRL_BPP values
+enum
+{
+    PF_BPP_1_ATTR = 0,
+    PF_BPP_4      = 1,
+    PF_BPP_8      = 2,
+    PF_BPP_XX     = 3
+};
+
+// TILE memory word index for XR/tile address (4K words + 1K words)
+static inline int tile_mem_index(uint16_t addr)
+{
+    return (addr & 0x1000) ? 0x1000 | (addr & 0x3FF) : (addr & 0xFFF);
+}
+
+// fetch words at addr (for tile_y line of tiles) and expand to 8 pixel color indices (without colorbase),
+// returns address of next display word
+static inline uint16_t playfield_fetch(const PlayfieldMode & m,
+                                       const uint16_t *      vram,
+                                       const uint16_t *      tile_mem,
+                                       int                   tile_y,
+                                       uint16_t              addr,
+                                       uint8_t *             pixels)
+{
+    uint16_t attr;
+    uint16_t word[4] = {0, 0, 0, 0};
+    bool     hrev    = false;
+
+    if (m.bitmap)
+    {
+        word[0] = vram[addr++];
+        attr    = word[0];
+        if (m.bpp != PF_BPP_1_ATTR)
+        {
+            word[1] = vram[addr++];
+            attr &= 0x07FF;        // no color or hrev attributes
+            if (m.bpp != PF_BPP_4)
+            {
+                word[2] = vram[addr++];
+                word[3] = vram[addr++];
+            }
+        }
+    }
+    else
+    {
+        attr = m.disp_in_tile ? tile_mem[tile_mem_index(addr)] : vram[addr];
+        addr++;
+
+        uint16_t tile_char = attr & 0x3FF;
+        uint16_t bank      = (uint16_t)(m.tile_bank << 10);
+        int      line      = (attr & (1 << TILE_ATTR_VREV)) ? (~tile_y & 0x7) : (tile_y & 0x7);
+        uint16_t tile_addr;
+        switch (m.bpp)
+        {
+            case PF_BPP_1_ATTR:
+                if (!(m.tile_height & 0x8))
+                {
+                    tile_addr = (uint16_t)(bank | ((tile_char & 0xFF) << 2) | ((tile_y >> 1) & 0x3));
+                }
+                else
+                {
+                    tile_addr = (uint16_t)(bank | ((tile_char & 0xFF) << 3) | ((tile_y >> 1) & 0x7));
+                }
+                break;
+            case PF_BPP_4:
+                tile_addr = (uint16_t)(bank | (tile_char << 4) | (line << 1));
+                break;
+            default:
+                tile_addr = (uint16_t)(bank | (tile_char << 5) | (line << 2));
+                break;
+        }
+
+        int words = m.bpp == PF_BPP_1_ATTR ? 1 : (m.bpp == PF_BPP_4 ? 2 : 4);
+        for (int w = 0; w < words; w++)
+        {
+            uint16_t a = (uint16_t)(tile_addr | w);
+            word[w]    = m.tile_in_vram ? vram[a] : tile_mem[tile_mem_index(a)];
+        }
+        if (m.bpp == PF_BPP_1_ATTR)
+        {
+            if (!(tile_y & 1))
+            {
+                word[0] >>= 8;        // even tile line in high byte
+            }
+        }
+        else
+        {
+            hrev = (attr & (1 << TILE_ATTR_HREV)) != 0;
+        }
+    }
+
+    uint8_t back = (attr >> TILE_ATTR_BACK) & 0xF;
+    uint8_t expanded[8];
+    switch (m.bpp)
+    {
+        case PF_BPP_1_ATTR: {
+            uint8_t fore = (attr >> TILE_ATTR_FORE) & 0xF;
+            for (int i = 0; i < 8; i++)
+            {
+                expanded[i] = (word[0] & (0x80 >> i)) ? fore : back;
+            }
+            break;
+        }
+        case PF_BPP_4:
+            for (int i = 0; i < 8; i++)
+            {
+                expanded[i] = (uint8_t)((back << 4) | ((word[i >> 2] >> (12 - ((i & 3) * 4))) & 0xF));
+            }
+            break;
+        default:
+            for (int i = 0; i < 8; i++)
+            {
+                expanded[i] = (uint8_t)(((word[i >> 1] >> ((i & 1) ? 0 : 8)) & 0xFF) ^ (back << 4));
+            }
+            break;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        pixels[i] = hrev ? expanded[7 - i] : expanded[i];
+    }
+
+    return addr;
+}
+
+#endif        // PLAYFIELD_FETCH_H
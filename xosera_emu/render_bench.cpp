@@ -0,0 +1,187 @@
+// render_bench.cpp - scanline renderer kernel microbenchmark
+//
+// vim: set et ts=4 sw=4
+//
+// Renders a random memory dump in each playfield mode (both playfields
+// enabled) with every supported scanline_render.h kernel, reports ns per
+// scanline and checks that the SIMD kernels give the same pixels as the scalar
+// kernel (exits with failure if not).
+//
+// Usage: render_bench [-f frames] [-2]
+//
+//      -f <frames>     frames rendered per mode and kernel (default 50)
+//      -2              use 2-bit alpha blending (video_blend_2bit.sv)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../rtl/sim/video_mode_defs.h"
+#include "../xosera_m68k_api/xosera_m68k_defs.h"
+#include "scanline_render.h"
+
+namespace
+{
+
+struct BenchMode
+{
+    const char * name;
+    uint16_t     gfx_ctrl;
+    uint16_t     tile_ctrl;
+    uint16_t     hv_fscale;
+    int          pixels_per_word;
+};
+
+const BenchMode bench_modes[] = {
+    {"1-bpp tile 8x16", 0x0000, 0x000F, 0x0000, 8},
+    {"4-bpp tile 8x8", 0x0010, 0x0007, 0x0000, 8},
+    {"8-bpp tile 8x8", 0x0020, 0x0007, 0x0000, 8},
+    {"1-bpp bitmap", 0x0040, 0x0000, 0x0000, 8},
+    {"4-bpp bitmap", 0x0050, 0x0000, 0x0000, 4},
+    {"8-bpp bitmap", 0x0060, 0x0000, 0x0000, 2},
+    {"4-bpp bitmap H2xV2", 0x0055, 0x0000, 0x0000, 4},
+    {"8-bpp bitmap H2xV2", 0x0065, 0x0000, 0x0000, 2},
+    {"4-bpp bitmap fscale", 0x0050, 0x0000, 0x0033, 4},
+};
+
+void set_mode(XoseraDump & dump, const BenchMode & mode)
+{
+    int repeat   = ((mode.gfx_ctrl >> GFX_CTRL_H_REPEAT_B) & 0x3) + 1;
+    int line_len = (VISIBLE_WIDTH / repeat + mode.pixels_per_word - 1) / mode.pixels_per_word;
+    for (int pf = 0; pf < 2; pf++)
+    {
+        int base                                           = pf ? XR_PB_GFX_CTRL : XR_PA_GFX_CTRL;
+        dump.xr_regs[base + (XR_PA_GFX_CTRL - XR_PA_GFX_CTRL)]  = (uint16_t)(mode.gfx_ctrl | (pf ? 0x1000 : 0));
+        dump.xr_regs[base + (XR_PA_TILE_CTRL - XR_PA_GFX_CTRL)] = mode.tile_ctrl;
+        dump.xr_regs[base + (XR_PA_DISP_ADDR - XR_PA_GFX_CTRL)] = (uint16_t)(pf ? 0x8000 : 0x0000);
+        dump.xr_regs[base + (XR_PA_LINE_LEN - XR_PA_GFX_CTRL)]  = (uint16_t)line_len;
+        dump.xr_regs[base + (XR_PA_HV_FSCALE - XR_PA_GFX_CTRL)] = mode.hv_fscale;
+        dump.xr_regs[base + (XR_PA_H_SCROLL - XR_PA_GFX_CTRL)]  = 0;
+        dump.xr_regs[base + (XR_PA_V_SCROLL - XR_PA_GFX_CTRL)]  = 0;
+    }
+}
+
+}        // namespace
+
+int main(int argc, char ** argv)
+{
+    int                   frames = 50;
+    ScanlineRender::Blend blend  = ScanlineRender::BLEND_4BIT;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-f") == 0 && a + 1 < argc)
+        {
+            frames = atoi(argv[++a]);
+        }
+        else if (strcmp(argv[a], "-2") == 0)
+        {
+            blend = ScanlineRender::BLEND_2BIT;
+        }
+        else
+        {
+            printf("Usage: render_bench [-f frames] [-2]\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (frames < 1)
+    {
+        frames = 1;
+    }
+
+    // random memory contents (fixed seed so runs are comparable)
+    XoseraDump   dump;
+    std::mt19937    rng(0x5EED);
+    dump.width  = VISIBLE_WIDTH;
+    dump.height = VISIBLE_HEIGHT;
+    for (auto & w : dump.vram)
+    {
+        w = (uint16_t)rng();
+    }
+    for (auto & w : dump.tile)
+    {
+        w = (uint16_t)rng();
+    }
+    for (int i = 0; i < XoseraDump::COLOR_WORDS; i++)
+    {
+        dump.colorA[i] = (uint16_t)rng();
+        dump.colorB[i] = (uint16_t)rng();
+    }
+    dump.xr_regs[XR_VID_CTRL]  = 0x0008;
+    dump.xr_regs[XR_VID_LEFT]  = 0;
+    dump.xr_regs[XR_VID_RIGHT] = VISIBLE_WIDTH;
+
+    printf("Xosera scanline render benchmark: %dx%d, %s blend, %d frames per mode\n\n",
+           VISIBLE_WIDTH,
+           VISIBLE_HEIGHT,
+           blend == ScanlineRender::BLEND_2BIT ? "2-bit" : "4-bit",
+           frames);
+    printf("%-22s", "mode (ns/scanline)");
+    for (int k = 0; k < ScanlineRender::KERNEL_COUNT; k++)
+    {
+        printf(" %10s", ScanlineRender::kernel_name((ScanlineRender::Kernel)k));
+    }
+    printf("    speedup\n");
+
+    std::vector<uint32_t> reference(VISIBLE_WIDTH * VISIBLE_HEIGHT);
+    std::vector<uint32_t> pixels(VISIBLE_WIDTH * VISIBLE_HEIGHT);
+    int                   failures = 0;
+
+    for (const auto & mode : bench_modes)
+    {
+        set_mode(dump, mode);
+
+        double scalar_ns = 0.0;
+        double best_ns   = 0.0;
+        printf("%-22s", mode.name);
+        for (int k = 0; k < ScanlineRender::KERNEL_COUNT; k++)
+        {
+            ScanlineRender::Kernel kernel = (ScanlineRender::Kernel)k;
+            if (!ScanlineRender::kernel_supported(kernel))
+            {
+                printf(" %10s", "n/a");
+                continue;
+            }
+
+            ScanlineRender render(dump, VISIBLE_WIDTH, VISIBLE_HEIGHT);
+            render.set_kernel(kernel);
+            render.set_blend(blend);
+            render.render_frame(pixels.data());        // warm up
+
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; f++)
+            {
+                render.render_frame(pixels.data());
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                        ((double)frames * VISIBLE_HEIGHT);
+            printf(" %10.1f", ns);
+
+            if (kernel == ScanlineRender::KERNEL_SCALAR)
+            {
+                reference = pixels;
+                scalar_ns = ns;
+            }
+            else if (pixels != reference)
+            {
+                printf(" MISMATCH");
+                failures++;
+            }
+            best_ns = ns;
+        }
+        printf("    %6.2fx\n", scalar_ns / best_ns);
+    }
+
+    if (failures)
+    {
+        printf("\n%d kernel results did not match scalar kernel\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("\nAll kernel results match scalar kernel\n");
+
+    return EXIT_SUCCESS;
+}
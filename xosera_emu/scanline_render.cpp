@@ -0,0 +1,661 @@
+// scanline_render.cpp - render Xosera display from a VRAM/XR memory dump
+//
+// vim: set et ts=4 sw=4
+//
+// See scanline_render.h.  The SIMD kernels are compiled with per-function
+// target attributes (no -mavx2 needed) and only called when the CPU supports
+// them, so one binary runs everywhere.
+
+#include "scanline_render.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "../xosera_m68k_api/xosera_m68k_defs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RENDER_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RENDER_X86 0
+#endif
+
+namespace
+{
+
+const int LINE_PAD = 64;        // extra pixels so SIMD kernels can write whole vectors past line end
+
+// (c4 * 0x11) * (a4 * 0x11) >> 9, matching EN_BLEND_FULL video_blend_4bit.sv
+struct BlendTable
+{
+    uint8_t t[16][16];
+
+    BlendTable()
+    {
+        for (int c = 0; c < 16; c++)
+        {
+            for (int a = 0; a < 16; a++)
+            {
+                t[c][a] = (uint8_t)(((c * 0x11) * (a * 0x11)) >> 9);
+            }
+        }
+    }
+};
+
+const BlendTable blend_table;
+
+// video_blend_4bit.sv
+inline uint32_t blend4_pixel(uint16_t colorA, uint16_t colorB)
+{
+    int alphaB  = colorB >> 12;
+    int alpha_a = (colorA & 0x8000) ? 0xF : (~alphaB & 0xF);
+    int alpha_b = (colorA & 0x4000) ? 0 : alphaB;
+
+    uint32_t argb = 0xff000000;
+    for (int shift = 8; shift >= 0; shift -= 4)
+    {
+        int sum = blend_table.t[(colorA >> shift) & 0xF][alpha_a] + blend_table.t[(colorB >> shift) & 0xF][alpha_b];
+        uint32_t nibble = (sum & 0x80) ? 0xF : ((sum >> 3) & 0xF);
+        argb |= (nibble * 0x11) << (shift * 2);
+    }
+    return argb;
+}
+
+// video_blend_2bit.sv (alpha 0, 25%, 50% or 100%)
+inline uint32_t blend2_pixel(uint16_t colorA, uint16_t colorB)
+{
+    int alphaB  = colorB >> 14;
+    int alpha_a = (colorA & 0x8000) ? 0x3 : (~alphaB & 0x3);
+    int alpha_b = (colorA & 0x4000) ? 0 : alphaB;
+    int mul_a   = alpha_a + (alpha_a & (alpha_a >> 1));        // 0, 1, 2, 4
+    int mul_b   = alpha_b + (alpha_b & (alpha_b >> 1));
+
+    uint32_t argb = 0xff000000;
+    for (int shift = 8; shift >= 0; shift -= 4)
+    {
+        int      result = ((((colorA >> shift) & 0xF) * mul_a) + (((colorB >> shift) & 0xF) * mul_b)) >> 2;
+        uint32_t nibble = (result & 0x10) ? 0xF : (result & 0xF);
+        argb |= (nibble * 0x11) << (shift * 2);
+    }
+    return argb;
+}
+
+template <bool BLEND2>
+void blend_scalar(const uint16_t * colorA,
+                  const uint16_t * colorB,
+                  const uint8_t *  idx_a,
+                  const uint8_t *  idx_b,
+                  uint32_t *       out,
+                  int              count)
+{
+    uint32_t last_key  = 0xFFFFFFFF;
+    uint32_t last_argb = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t ca  = colorA[idx_a[i]];
+        uint16_t cb  = colorB[idx_b[i]];
+        uint32_t key = ((uint32_t)ca << 16) | cb;
+        if (key != last_key)
+        {
+            last_key  = key;
+            last_argb = BLEND2 ? blend2_pixel(ca, cb) : blend4_pixel(ca, cb);
+        }
+        out[i] = last_argb;
+    }
+}
+
+// 8 pixels 4-bit nibbles per 16-bit word
+void expand4_scalar(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t w = words[i];
+        *out++     = (uint8_t)(((w >> 12) & 0xF) ^ colorbase);
+        *out++     = (uint8_t)(((w >> 8) & 0xF) ^ colorbase);
+        *out++     = (uint8_t)(((w >> 4) & 0xF) ^ colorbase);
+        *out++     = (uint8_t)((w & 0xF) ^ colorbase);
+    }
+}
+
+void expand8_scalar(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t w = words[i];
+        *out++     = (uint8_t)((w >> 8) ^ colorbase);
+        *out++     = (uint8_t)((w & 0xFF) ^ colorbase);
+    }
+}
+
+#if RENDER_X86
+
+// blend 8 pixels of 16-bit colors (in 16-bit lanes) to 8 ARGB pixels
+template <bool BLEND2>
+TARGET_SSE2 inline void blend8_sse2(__m128i ca, __m128i cb, uint32_t * out)
+{
+    const __m128i nib_mask = _mm_set1_epi16(0xF);
+    __m128i       sel_a    = _mm_srai_epi16(ca, 15);                         // colorA[15] alpha A = 1
+    __m128i       zero_b   = _mm_srai_epi16(_mm_slli_epi16(ca, 1), 15);        // colorA[14] alpha B = 0
+    __m128i       alpha_a;
+    __m128i       alpha_b;
+    __m128i       rgb[3];
+
+    if (BLEND2)
+    {
+        const __m128i three = _mm_set1_epi16(0x3);
+        __m128i       aB    = _mm_srli_epi16(cb, 14);
+        alpha_a = _mm_or_si128(_mm_and_si128(sel_a, three), _mm_andnot_si128(sel_a, _mm_xor_si128(aB, three)));
+        alpha_b = _mm_andnot_si128(zero_b, aB);
+        alpha_a = _mm_add_epi16(alpha_a, _mm_and_si128(alpha_a, _mm_srli_epi16(alpha_a, 1)));        // 0, 1, 2, 4
+        alpha_b = _mm_add_epi16(alpha_b, _mm_and_si128(alpha_b, _mm_srli_epi16(alpha_b, 1)));
+        for (int c = 0; c < 3; c++)
+        {
+            int     shift  = 8 - (c * 4);
+            __m128i a      = _mm_and_si128(_mm_srli_epi16(ca, shift), nib_mask);
+            __m128i b      = _mm_and_si128(_mm_srli_epi16(cb, shift), nib_mask);
+            __m128i result = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, alpha_a), _mm_mullo_epi16(b, alpha_b)), 2);
+            __m128i ovf    = _mm_cmpgt_epi16(result, nib_mask);
+            rgb[c]         = _mm_or_si128(_mm_and_si128(ovf, nib_mask), _mm_andnot_si128(ovf, result));
+        }
+    }
+    else
+    {
+        const __m128i x11 = _mm_set1_epi16(0x11);
+        __m128i       aB  = _mm_srli_epi16(cb, 12);
+        alpha_a = _mm_or_si128(_mm_and_si128(sel_a, nib_mask), _mm_andnot_si128(sel_a, _mm_xor_si128(aB, nib_mask)));
+        alpha_b = _mm_andnot_si128(zero_b, aB);
+        alpha_a = _mm_mullo_epi16(alpha_a, x11);
+        alpha_b = _mm_mullo_epi16(alpha_b, x11);
+        for (int c = 0; c < 3; c++)
+        {
+            int     shift = 8 - (c * 4);
+            __m128i a     = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(ca, shift), nib_mask), x11);
+            __m128i b     = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(cb, shift), nib_mask), x11);
+            __m128i sum   = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(a, alpha_a), 9),
+                                        _mm_srli_epi16(_mm_mullo_epi16(b, alpha_b), 9));
+            __m128i ovf   = _mm_cmpgt_epi16(sum, _mm_set1_epi16(0x7F));
+            rgb[c] = _mm_or_si128(_mm_and_si128(ovf, nib_mask), _mm_andnot_si128(ovf, _mm_srli_epi16(sum, 3)));
+        }
+    }
+
+    // nibble * 0x11 to 8-bit, then { 0xFF, R } and { G, B } 16-bit halves of ARGB
+    const __m128i x11 = _mm_set1_epi16(0x11);
+    __m128i       hi  = _mm_or_si128(_mm_mullo_epi16(rgb[0], x11), _mm_set1_epi16((short)0xFF00));
+    __m128i lo = _mm_or_si128(_mm_slli_epi16(_mm_mullo_epi16(rgb[1], x11), 8), _mm_mullo_epi16(rgb[2], x11));
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i *)(out + 4), _mm_unpackhi_epi16(lo, hi));
+}
+
+template <bool BLEND2>
+TARGET_SSE2 void blend_sse2(const uint16_t * colorA,
+                            const uint16_t * colorB,
+                            const uint8_t *  idx_a,
+                            const uint8_t *  idx_b,
+                            uint32_t *       out,
+                            int              count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // no gather in SSE2, so lookups are scalar loads into lanes
+        __m128i ca = _mm_setr_epi16(colorA[idx_a[i + 0]],
+                                    colorA[idx_a[i + 1]],
+                                    colorA[idx_a[i + 2]],
+                                    colorA[idx_a[i + 3]],
+                                    colorA[idx_a[i + 4]],
+                                    colorA[idx_a[i + 5]],
+                                    colorA[idx_a[i + 6]],
+                                    colorA[idx_a[i + 7]]);
+        __m128i cb = _mm_setr_epi16(colorB[idx_b[i + 0]],
+                                    colorB[idx_b[i + 1]],
+                                    colorB[idx_b[i + 2]],
+                                    colorB[idx_b[i + 3]],
+                                    colorB[idx_b[i + 4]],
+                                    colorB[idx_b[i + 5]],
+                                    colorB[idx_b[i + 6]],
+                                    colorB[idx_b[i + 7]]);
+        blend8_sse2<BLEND2>(ca, cb, out + i);
+    }
+    blend_scalar<BLEND2>(colorA, colorB, idx_a + i, idx_b + i, out + i, count - i);
+}
+
+TARGET_SSE2 void expand4_sse2(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    const __m128i low_nib = _mm_set1_epi8(0x0F);
+    const __m128i base    = _mm_set1_epi8((char)colorbase);
+    int           i       = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i w  = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i be = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));        // bytes in display order
+        __m128i hn = _mm_and_si128(_mm_srli_epi16(be, 4), low_nib);
+        __m128i ln = _mm_and_si128(be, low_nib);
+        _mm_storeu_si128((__m128i *)(out + (i * 4)), _mm_xor_si128(_mm_unpacklo_epi8(hn, ln), base));
+        _mm_storeu_si128((__m128i *)(out + (i * 4) + 16), _mm_xor_si128(_mm_unpackhi_epi8(hn, ln), base));
+    }
+    expand4_scalar(words + i, count - i, colorbase, out + (i * 4));
+}
+
+TARGET_SSE2 void expand8_sse2(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    const __m128i base = _mm_set1_epi8((char)colorbase);
+    int           i    = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i w  = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i be = _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8));
+        _mm_storeu_si128((__m128i *)(out + (i * 2)), _mm_xor_si128(be, base));
+    }
+    expand8_scalar(words + i, count - i, colorbase, out + (i * 2));
+}
+
+template <bool BLEND2>
+TARGET_AVX2 void blend_avx2(const uint16_t * colorA,
+                            const uint16_t * colorB,
+                            const uint8_t *  idx_a,
+                            const uint8_t *  idx_b,
+                            uint32_t *       out,
+                            int              count)
+{
+    const __m256i nib_mask  = _mm256_set1_epi16(0xF);
+    const __m256i x11       = _mm256_set1_epi16(0x11);
+    const __m256i low_word  = _mm256_set1_epi32(0xFFFF);
+    const int *   colorA_32 = (const int *)colorA;        // tables padded by a word for 32-bit gather
+    const int *   colorB_32 = (const int *)colorB;
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i ia = _mm_loadu_si128((const __m128i *)(idx_a + i));
+        __m128i ib = _mm_loadu_si128((const __m128i *)(idx_b + i));
+        __m256i a0 = _mm256_and_si256(_mm256_i32gather_epi32(colorA_32, _mm256_cvtepu8_epi32(ia), 2), low_word);
+        __m256i a1 = _mm256_and_si256(
+            _mm256_i32gather_epi32(colorA_32, _mm256_cvtepu8_epi32(_mm_srli_si128(ia, 8)), 2), low_word);
+        __m256i b0 = _mm256_and_si256(_mm256_i32gather_epi32(colorB_32, _mm256_cvtepu8_epi32(ib), 2), low_word);
+        __m256i b1 = _mm256_and_si256(
+            _mm256_i32gather_epi32(colorB_32, _mm256_cvtepu8_epi32(_mm_srli_si128(ib, 8)), 2), low_word);
+        // pack is per 128-bit lane, permute back to pixel order
+        __m256i ca = _mm256_permute4x64_epi64(_mm256_packus_epi32(a0, a1), 0xD8);
+        __m256i cb = _mm256_permute4x64_epi64(_mm256_packus_epi32(b0, b1), 0xD8);
+
+        __m256i sel_a  = _mm256_srai_epi16(ca, 15);
+        __m256i zero_b = _mm256_srai_epi16(_mm256_slli_epi16(ca, 1), 15);
+        __m256i rgb[3];
+        if (BLEND2)
+        {
+            const __m256i three   = _mm256_set1_epi16(0x3);
+            __m256i       aB      = _mm256_srli_epi16(cb, 14);
+            __m256i       alpha_a = _mm256_or_si256(_mm256_and_si256(sel_a, three),
+                                              _mm256_andnot_si256(sel_a, _mm256_xor_si256(aB, three)));
+            __m256i       alpha_b = _mm256_andnot_si256(zero_b, aB);
+            alpha_a = _mm256_add_epi16(alpha_a, _mm256_and_si256(alpha_a, _mm256_srli_epi16(alpha_a, 1)));
+            alpha_b = _mm256_add_epi16(alpha_b, _mm256_and_si256(alpha_b, _mm256_srli_epi16(alpha_b, 1)));
+            for (int c = 0; c < 3; c++)
+            {
+                int     shift  = 8 - (c * 4);
+                __m256i a      = _mm256_and_si256(_mm256_srli_epi16(ca, shift), nib_mask);
+                __m256i b      = _mm256_and_si256(_mm256_srli_epi16(cb, shift), nib_mask);
+                __m256i result = _mm256_srli_epi16(
+                    _mm256_add_epi16(_mm256_mullo_epi16(a, alpha_a), _mm256_mullo_epi16(b, alpha_b)), 2);
+                rgb[c] = _mm256_min_epu16(result, nib_mask);        // result < 32, so >= 16 clamps to 15
+            }
+        }
+        else
+        {
+            __m256i aB      = _mm256_srli_epi16(cb, 12);
+            __m256i alpha_a = _mm256_or_si256(_mm256_and_si256(sel_a, nib_mask),
+                                              _mm256_andnot_si256(sel_a, _mm256_xor_si256(aB, nib_mask)));
+            __m256i alpha_b = _mm256_andnot_si256(zero_b, aB);
+            alpha_a         = _mm256_mullo_epi16(alpha_a, x11);
+            alpha_b         = _mm256_mullo_epi16(alpha_b, x11);
+            for (int c = 0; c < 3; c++)
+            {
+                int     shift = 8 - (c * 4);
+                __m256i a     = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(ca, shift), nib_mask), x11);
+                __m256i b     = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(cb, shift), nib_mask), x11);
+                __m256i sum   = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(a, alpha_a), 9),
+                                               _mm256_srli_epi16(_mm256_mullo_epi16(b, alpha_b), 9));
+                __m256i ovf   = _mm256_cmpgt_epi16(sum, _mm256_set1_epi16(0x7F));
+                rgb[c]        = _mm256_or_si256(_mm256_and_si256(ovf, nib_mask),
+                                         _mm256_andnot_si256(ovf, _mm256_srli_epi16(sum, 3)));
+            }
+        }
+
+        __m256i hi = _mm256_or_si256(_mm256_mullo_epi16(rgb[0], x11), _mm256_set1_epi16((short)0xFF00));
+        __m256i lo =
+            _mm256_or_si256(_mm256_slli_epi16(_mm256_mullo_epi16(rgb[1], x11), 8), _mm256_mullo_epi16(rgb[2], x11));
+        __m256i p_lo = _mm256_unpacklo_epi16(lo, hi);        // pixels 0-3, 8-11
+        __m256i p_hi = _mm256_unpackhi_epi16(lo, hi);        // pixels 4-7, 12-15
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute2x128_si256(p_lo, p_hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_permute2x128_si256(p_lo, p_hi, 0x31));
+    }
+    blend_scalar<BLEND2>(colorA, colorB, idx_a + i, idx_b + i, out + i, count - i);
+}
+
+TARGET_AVX2 void expand4_avx2(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    const __m256i low_nib = _mm256_set1_epi8(0x0F);
+    const __m256i base    = _mm256_set1_epi8((char)colorbase);
+    int           i       = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i w  = _mm256_loadu_si256((const __m256i *)(words + i));
+        __m256i be = _mm256_or_si256(_mm256_slli_epi16(w, 8), _mm256_srli_epi16(w, 8));
+        __m256i hn = _mm256_and_si256(_mm256_srli_epi16(be, 4), low_nib);
+        __m256i ln = _mm256_and_si256(be, low_nib);
+        __m256i p0 = _mm256_xor_si256(_mm256_unpacklo_epi8(hn, ln), base);        // bytes 0-7, 16-23
+        __m256i p1 = _mm256_xor_si256(_mm256_unpackhi_epi8(hn, ln), base);        // bytes 8-15, 24-31
+        _mm256_storeu_si256((__m256i *)(out + (i * 4)), _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + (i * 4) + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+    }
+    expand4_sse2(words + i, count - i, colorbase, out + (i * 4));
+}
+
+TARGET_AVX2 void expand8_avx2(const uint16_t * words, int count, uint8_t colorbase, uint8_t * out)
+{
+    const __m256i base = _mm256_set1_epi8((char)colorbase);
+    int           i    = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i w  = _mm256_loadu_si256((const __m256i *)(words + i));
+        __m256i be = _mm256_or_si256(_mm256_slli_epi16(w, 8), _mm256_srli_epi16(w, 8));
+        _mm256_storeu_si256((__m256i *)(out + (i * 2)), _mm256_xor_si256(be, base));
+    }
+    expand8_sse2(words + i, count - i, colorbase, out + (i * 2));
+}
+
+#endif        // RENDER_X86
+
+typedef void (*BlendFunc)(const uint16_t *, const uint16_t *, const uint8_t *, const uint8_t *, uint32_t *, int);
+typedef void (*ExpandFunc)(const uint16_t *, int, uint8_t, uint8_t *);
+
+struct KernelFuncs
+{
+    const char * name;
+    BlendFunc    blend4;
+    BlendFunc    blend2;
+    ExpandFunc   expand4;
+    ExpandFunc   expand8;
+};
+
+const KernelFuncs kernel_funcs[ScanlineRender::KERNEL_COUNT] = {
+    {"scalar", blend_scalar<false>, blend_scalar<true>, expand4_scalar, expand8_scalar},
+#if RENDER_X86
+    {"sse2", blend_sse2<false>, blend_sse2<true>, expand4_sse2, expand8_sse2},
+    {"avx2", blend_avx2<false>, blend_avx2<true>, expand4_avx2, expand8_avx2},
+#else
+    {"sse2", blend_scalar<false>, blend_scalar<true>, expand4_scalar, expand8_scalar},
+    {"avx2", blend_scalar<false>, blend_scalar<true>, expand4_scalar, expand8_scalar},
+#endif
+};
+
+}        // namespace
+
+bool ScanlineRender::kernel_supported(Kernel k)
+{
+    switch (k)
+    {
+        case KERNEL_SCALAR:
+            return true;
+#if RENDER_X86
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+ScanlineRender::Kernel ScanlineRender::best_kernel()
+{
+    return kernel_supported(KERNEL_AVX2) ? KERNEL_AVX2
+                                         : (kernel_supported(KERNEL_SSE2) ? KERNEL_SSE2 : KERNEL_SCALAR);
+}
+
+const char * ScanlineRender::kernel_name(Kernel k)
+{
+    return (k >= 0 && k < KERNEL_COUNT) ? kernel_funcs[k].name : "?";
+}
+
+void ScanlineRender::blend_pixels(Kernel           k,
+                                  Blend            b,
+                                  const uint16_t * colorA,
+                                  const uint16_t * colorB,
+                                  const uint8_t *  idx_a,
+                                  const uint8_t *  idx_b,
+                                  uint32_t *       argb,
+                                  int              count)
+{
+    const KernelFuncs & kf = kernel_funcs[k];
+    (b == BLEND_2BIT ? kf.blend2 : kf.blend4)(colorA, colorB, idx_a, idx_b, argb, count);
+}
+
+ScanlineRender::ScanlineRender(const XoseraDump & dump, int w, int h)
+    : mem(dump)
+    , width(w)
+    , height(h)
+    , kernel(best_kernel())
+    , blend_mode(BLEND_4BIT)
+{
+    line_idx[0].resize(width + LINE_PAD);
+    line_idx[1].resize(width + LINE_PAD);
+    stream.resize(width + LINE_PAD);
+    start_frame();
+}
+
+void ScanlineRender::decode_pf(Playfield & p, int reg_base)
+{
+    uint16_t gfx_ctrl  = mem.xr_regs[reg_base + (XR_PA_GFX_CTRL - XR_PA_GFX_CTRL)];
+    uint16_t tile_ctrl = mem.xr_regs[reg_base + (XR_PA_TILE_CTRL - XR_PA_GFX_CTRL)];
+    uint16_t hv_fscale = mem.xr_regs[reg_base + (XR_PA_HV_FSCALE - XR_PA_GFX_CTRL)];
+    uint16_t v_scroll  = mem.xr_regs[reg_base + (XR_PA_V_SCROLL - XR_PA_GFX_CTRL)];
+
+    p.colorbase     = (uint8_t)(gfx_ctrl >> 8);
+    p.blank         = (gfx_ctrl & GFX_CTRL_BLANK_F) != 0;
+    p.bitmap        = (gfx_ctrl & GFX_CTRL_BITMAP_F) != 0;
+    p.bpp           = (gfx_ctrl >> GFX_CTRL_BPP_B) & 0x3;
+    p.h_repeat      = (gfx_ctrl >> GFX_CTRL_H_REPEAT_B) & 0x3;
+    p.v_repeat      = (gfx_ctrl >> GFX_CTRL_V_REPEAT_B) & 0x3;
+    p.tile_bank     = (uint8_t)(tile_ctrl >> TILE_CTRL_TILEBASE_B);
+    p.disp_in_tile  = (tile_ctrl & TILE_CTRL_DISP_TILEMEM_F) != 0;
+    p.tile_in_vram  = (tile_ctrl & TILE_CTRL_TILE_VRAM_F) != 0;
+    p.tile_height   = tile_ctrl & TILE_CTRL_TILE_H_F;
+    p.start_addr    = mem.xr_regs[reg_base + (XR_PA_DISP_ADDR - XR_PA_GFX_CTRL)];
+    p.line_len      = mem.xr_regs[reg_base + (XR_PA_LINE_LEN - XR_PA_GFX_CTRL)];
+    p.h_frac_repeat = (hv_fscale >> 4) & 0x7;
+    p.v_frac_repeat = hv_fscale & 0x7;
+    p.fine_hscroll  = mem.xr_regs[reg_base + (XR_PA_H_SCROLL - XR_PA_GFX_CTRL)] & H_SCROLL_FINE_F;
+    p.fine_vscroll  = (uint8_t)(((v_scroll & V_SCROLL_TILE_F) << 2) | ((v_scroll & V_SCROLL_FINE_F) >> V_SCROLL_FINE_B));
+
+    // blank reset (start of frame)
+    p.line_start   = p.start_addr;
+    p.v_count      = (uint8_t)((p.v_repeat - (p.fine_vscroll & 0x3)) & 0x3);
+    p.tile_y       = p.fine_vscroll >> 2;
+    p.v_frac_count = 0;
+}
+
+void ScanlineRender::start_frame()
+{
+    uint16_t vid_ctrl = mem.xr_regs[XR_VID_CTRL];
+    colorswap         = (vid_ctrl & VID_CTRL_SWAP_AB_F) != 0;
+    border_color      = (uint8_t)vid_ctrl;
+    vid_left          = mem.xr_regs[XR_VID_LEFT];
+    vid_right         = mem.xr_regs[XR_VID_RIGHT];
+    decode_pf(pf[0], XR_PA_GFX_CTRL);
+    decode_pf(pf[1], XR_PB_GFX_CTRL);
+}
+
+// decode playfield line to color indices
+void ScanlineRender::pf_line(Playfield & p, uint8_t border, uint8_t * out)
+{
+    memset(out, border, width);
+
+    int x0    = vid_left - p.fine_hscroll;
+    int x_end = std::min(vid_right, width);
+    if (p.blank || x0 >= x_end)
+    {
+        return;
+    }
+
+    if (p.h_frac_repeat != 0)
+    {
+        pf_line_scaled(p, x0, x_end, out);
+        return;
+    }
+
+    // each stream pixel repeated h_repeat+1 times
+    int repeat = p.h_repeat + 1;
+    int skip   = std::max(0, -x0);
+    int count  = x_end - x0;
+    int groups = (((count + repeat - 1) / repeat) + 7) / 8;
+
+    if ((int)stream.size() < groups * 8 + LINE_PAD)
+    {
+        stream.resize(groups * 8 + LINE_PAD);
+    }
+
+    const KernelFuncs & kf    = kernel_funcs[kernel];
+    int                 words = groups * (p.bpp == PF_BPP_4 ? 2 : 4);
+    if (p.bitmap && p.bpp != PF_BPP_1_ATTR && p.line_start + words <= XoseraDump::VRAM_WORDS)
+    {
+        // bitmap 4/8 bpp has no attributes, so a whole line is expanded at once
+        const uint16_t * src = mem.vram.data() + p.line_start;
+        if (p.bpp == PF_BPP_4)
+        {
+            kf.expand4(src, words, p.colorbase, stream.data());
+        }
+        else
+        {
+            kf.expand8(src, words, p.colorbase, stream.data());
+        }
+    }
+    else
+    {
+        uint16_t addr = p.line_start;
+        for (int g = 0; g < groups; g++)
+        {
+            uint8_t * pix = stream.data() + (g * 8);
+            addr          = playfield_fetch(p, mem.vram.data(), mem.tile.data(), p.tile_y, addr, pix);
+            for (int i = 0; i < 8; i++)
+            {
+                pix[i] ^= p.colorbase;
+            }
+        }
+    }
+
+    uint8_t * dst = out + x0;
+    if (repeat == 1)
+    {
+        memcpy(dst + skip, stream.data() + skip, count - skip);
+    }
+    else
+    {
+        const uint8_t * src = stream.data() + (skip / repeat);
+        int             rep = repeat - (skip % repeat);        // remaining repeats of first pixel
+        for (int i = skip; i < count; src++, rep = repeat)
+        {
+            uint8_t c = *src;
+            for (; rep && i < count; rep--)
+            {
+                dst[i++] = c;
+            }
+        }
+    }
+}
+
+// decode playfield line with fractional horizontal scale (pixel by pixel like video_playfield.sv)
+void ScanlineRender::pf_line_scaled(Playfield & p, int x0, int x_end, uint8_t * out)
+{
+    uint8_t  pixels[8];
+    uint16_t addr    = playfield_fetch(p, mem.vram.data(), mem.tile.data(), p.tile_y, p.line_start, pixels);
+    int      pix_num = 0;
+    uint8_t  h_count = p.h_repeat;
+    uint8_t  h_frac  = 0;
+
+    for (int x = x0; x < x_end; x++)
+    {
+        if (x >= 0)
+        {
+            out[x] = pixels[pix_num] ^ p.colorbase;
+        }
+        uint8_t frac = h_frac;
+        h_frac       = (frac - 1) & 0x7;
+        if (frac == 0)
+        {
+            h_frac = p.h_frac_repeat;        // repeat pixel
+        }
+        else if (h_count != 0)
+        {
+            h_count--;
+        }
+        else
+        {
+            h_count = p.h_repeat;
+            if (++pix_num == 8)
+            {
+                pix_num = 0;
+                addr    = playfield_fetch(p, mem.vram.data(), mem.tile.data(), p.tile_y, addr, pixels);
+            }
+        }
+    }
+}
+
+// advance playfield to next line (see pf_end_of_line in xosera_emu.cpp)
+void ScanlineRender::pf_next_line(Playfield & p)
+{
+    uint8_t v_frac = p.v_frac_count;
+    p.v_frac_count = (v_frac - 1) & 0x7;
+    if (p.v_frac_repeat != 0 && v_frac == 0)
+    {
+        p.v_frac_count = p.v_frac_repeat;        // repeat line
+    }
+    else if (p.v_count != 0)
+    {
+        p.v_count--;
+    }
+    else
+    {
+        p.v_count = p.v_repeat;
+        if (p.bitmap || p.tile_y >= p.tile_height)
+        {
+            p.tile_y = 0;
+            p.line_start += p.line_len;
+        }
+        else
+        {
+            p.tile_y = (p.tile_y + 1) & 0xF;
+        }
+    }
+}
+
+void ScanlineRender::render_line(uint32_t * argb)
+{
+    pf_line(pf[0], border_color, line_idx[0].data());
+    pf_line(pf[1], 0, line_idx[1].data());
+
+    blend_pixels(kernel,
+                 blend_mode,
+                 mem.colorA.data(),
+                 mem.colorB.data(),
+                 line_idx[colorswap ? 1 : 0].data(),
+                 line_idx[colorswap ? 0 : 1].data(),
+                 argb,
+                 width);
+
+    pf_next_line(pf[0]);
+    pf_next_line(pf[1]);
+}
+
+void ScanlineRender::render_frame(uint32_t * argb)
+{
+    start_frame();
+    for (int v = 0; v < height; v++)
+    {
+        render_line(argb + (v * width));
+    }
+}
@@ -0,0 +1,114 @@
+// scanline_render.h - render Xosera display from a VRAM/XR memory dump
+//
+// vim: set et ts=4 sw=4
+//
+// Reconstructs the frame Xosera should display for a memory dump (see
+// xosera_dump.h) with no copper changes during the frame: playfield A/B in
+// all GFX_CTRL modes (1/4/8 bpp bitmap and tiled, H/V repeat, HV_FSCALE,
+// H_SCROLL/V_SCROLL, colorbase, tile hrev/vrev), COLOR_A/COLOR_B lookup and
+// the blending of video_blend_4bit.sv (EN_BLEND_FULL) or video_blend_2bit.sv.
+// The pointer sprite is not drawn.
+//
+// Each scanline is decoded to playfield color indices (with SIMD expansion of
+// unscaled 4/8 bpp bitmaps), then color lookup and blending run over the whole
+// line in a scalar, SSE2 or AVX2 kernel (selected at run-time, all give the
+// same result).
+
+#if !defined(SCANLINE_RENDER_H)
+#define SCANLINE_RENDER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "playfield_fetch.h"
+#include "xosera_dump.h"
+
+class ScanlineRender
+{
+public:
+    enum Kernel
+    {
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+        KERNEL_COUNT
+    };
+
+    enum Blend
+    {
+        BLEND_4BIT,        // video_blend_4bit.sv
+        BLEND_2BIT         // video_blend_2bit.sv
+    };
+
+    static bool         kernel_supported(Kernel k);
+    static Kernel       best_kernel();
+    static const char * kernel_name(Kernel k);
+
+    // color lookup and blend count pixels (colorA/colorB need one word of padding past index 255)
+    static void blend_pixels(Kernel           k,
+                             Blend            b,
+                             const uint16_t * colorA,
+                             const uint16_t * colorB,
+                             const uint8_t *  idx_a,
+                             const uint8_t *  idx_b,
+                             uint32_t *       argb,
+                             int              count);
+
+    // mem must stay valid while rendering (register changes need start_frame())
+    ScanlineRender(const XoseraDump & mem, int width, int height);
+
+    void set_kernel(Kernel k) { kernel = kernel_supported(k) ? k : KERNEL_SCALAR; }
+    void set_blend(Blend b) { blend_mode = b; }
+
+    Kernel kernel_used() const { return kernel; }
+
+    // decode registers and reset playfields to the top of the frame
+    void start_frame();
+    // render next scanline (width ARGB8888 pixels), lines are rendered in order after start_frame()
+    void render_line(uint32_t * argb);
+    // render whole frame (width * height ARGB8888 pixels)
+    void render_frame(uint32_t * argb);
+
+private:
+    struct Playfield : PlayfieldMode
+    {
+        uint8_t  colorbase;
+        bool     blank;
+        uint8_t  h_repeat;
+        uint8_t  v_repeat;
+        uint16_t start_addr;
+        uint16_t line_len;
+        uint8_t  h_frac_repeat;
+        uint8_t  v_frac_repeat;
+        uint8_t  fine_hscroll;
+        uint8_t  fine_vscroll;        // { tile_line[3:0], repeat[1:0] }
+
+        uint16_t line_start;
+        uint8_t  v_count;
+        uint8_t  v_frac_count;
+        uint8_t  tile_y;
+    };
+
+    const XoseraDump & mem;
+    int                width;
+    int                height;
+    Kernel             kernel;
+    Blend              blend_mode;
+
+    bool      colorswap;
+    uint8_t   border_color;
+    int       vid_left;
+    int       vid_right;
+    Playfield pf[2];
+
+    std::vector<uint8_t> line_idx[2];        // playfield A/B color index per pixel
+    std::vector<uint8_t> stream;             // unscaled playfield pixels for line
+
+    void decode_pf(Playfield & p, int reg_base);
+    void pf_line(Playfield & p, uint8_t border, uint8_t * out);
+    void pf_line_scaled(Playfield & p, int x0, int x_end, uint8_t * out);
+    void pf_next_line(Playfield & p);
+};
+
+#endif        // SCANLINE_RENDER_H
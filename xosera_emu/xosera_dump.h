@@ -0,0 +1,177 @@
+// xosera_dump.h - Xosera VRAM and XR memory dump file
+//
+// vim: set et ts=4 sw=4
+//
+// Snapshot of Xosera memory and video registers, enough to reconstruct the
+// displayed frame (see scanline_render.h).  Written by the functional emulator
+// (xosera_emu_run -d) and read by xosera_render.
+//
+// Dump file (little-endian 16-bit words):
+//
+//      "XMEM"                      magic
+//      0x0001                      version
+//      <width> <height>            visible video mode size
+//      0x0000                      reserved
+//      64 words                    XR registers 0x00-0x3F (as read, plus POINTER_H/V as written)
+//      65536 words                 VRAM
+//      5120 words                  TILE memory
+//      256 words                   COLOR_A memory
+//      256 words                   COLOR_B memory
+//      256 words                   POINTER memory
+//      1536 words                  COPPER memory
+//
+// A bare 128KB file (VRAM only, like xosera_vsim_vram.bin from xosera_sim.cpp)
+// can also be loaded; the other memories and registers are then left as they
+// were (so defaults can be set before load).
+
+#if !defined(XOSERA_DUMP_H)
+#define XOSERA_DUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+struct XoseraDump
+{
+    static const uint16_t VERSION       = 0x0001;
+    static const int      XR_REGS       = 0x40;
+    static const int      VRAM_WORDS    = 0x10000;
+    static const int      TILE_WORDS    = 0x1400;
+    static const int      COLOR_WORDS   = 0x100;
+    static const int      POINTER_WORDS = 0x100;
+    static const int      COPPER_WORDS  = 0x600;
+
+    int                   width  = 0;
+    int                   height = 0;
+    std::vector<uint16_t> xr_regs;
+    std::vector<uint16_t> vram;
+    std::vector<uint16_t> tile;
+    std::vector<uint16_t> colorA;        // padded with one extra word (for 32-bit gather loads)
+    std::vector<uint16_t> colorB;        // padded with one extra word (for 32-bit gather loads)
+    std::vector<uint16_t> pointer;
+    std::vector<uint16_t> copper;
+
+    XoseraDump()
+        : xr_regs(XR_REGS)
+        , vram(VRAM_WORDS)
+        , tile(TILE_WORDS)
+        , colorA(COLOR_WORDS + 1)
+        , colorB(COLOR_WORDS + 1)
+        , pointer(POINTER_WORDS)
+        , copper(COPPER_WORDS)
+    {
+    }
+
+    bool save(const char * filename, std::string & err) const
+    {
+        FILE * fp = fopen(filename, "wb");
+        if (fp == nullptr)
+        {
+            err = std::string("can't create \"") + filename + "\"";
+            return false;
+        }
+
+        const uint8_t header[12] = {'X',
+                                    'M',
+                                    'E',
+                                    'M',
+                                    VERSION & 0xFF,
+                                    VERSION >> 8,
+                                    (uint8_t)width,
+                                    (uint8_t)(width >> 8),
+                                    (uint8_t)height,
+                                    (uint8_t)(height >> 8),
+                                    0,
+                                    0};
+        fwrite(header, 1, sizeof(header), fp);
+        write_words(fp, xr_regs.data(), XR_REGS);
+        write_words(fp, vram.data(), VRAM_WORDS);
+        write_words(fp, tile.data(), TILE_WORDS);
+        write_words(fp, colorA.data(), COLOR_WORDS);
+        write_words(fp, colorB.data(), COLOR_WORDS);
+        write_words(fp, pointer.data(), POINTER_WORDS);
+        write_words(fp, copper.data(), COPPER_WORDS);
+
+        bool ok = ferror(fp) == 0;
+        if (fclose(fp) != 0 || !ok)
+        {
+            err = std::string("error writing \"") + filename + "\"";
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const char * filename, std::string & err)
+    {
+        FILE * fp = fopen(filename, "rb");
+        if (fp == nullptr)
+        {
+            err = std::string("can't open \"") + filename + "\"";
+            return false;
+        }
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        bool ok;
+        if (size == VRAM_WORDS * 2)
+        {
+            ok = read_words(fp, vram.data(), VRAM_WORDS);
+        }
+        else
+        {
+            uint8_t header[12];
+            ok = fread(header, 1, sizeof(header), fp) == sizeof(header) && memcmp(header, "XMEM", 4) == 0 &&
+                 (header[4] | (header[5] << 8)) == VERSION;
+            if (!ok)
+            {
+                err = std::string("\"") + filename + "\" is not a Xosera memory dump";
+                fclose(fp);
+                return false;
+            }
+            width  = header[6] | (header[7] << 8);
+            height = header[8] | (header[9] << 8);
+            ok     = read_words(fp, xr_regs.data(), XR_REGS) && read_words(fp, vram.data(), VRAM_WORDS) &&
+                 read_words(fp, tile.data(), TILE_WORDS) && read_words(fp, colorA.data(), COLOR_WORDS) &&
+                 read_words(fp, colorB.data(), COLOR_WORDS) && read_words(fp, pointer.data(), POINTER_WORDS) &&
+                 read_words(fp, copper.data(), COPPER_WORDS);
+        }
+        fclose(fp);
+
+        if (!ok)
+        {
+            err = std::string("\"") + filename + "\" is truncated";
+        }
+        return ok;
+    }
+
+private:
+    static void write_words(FILE * fp, const uint16_t * words, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            fputc(words[i] & 0xFF, fp);
+            fputc(words[i] >> 8, fp);
+        }
+    }
+
+    static bool read_words(FILE * fp, uint16_t * words, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int lo = fgetc(fp);
+            int hi = fgetc(fp);
+            if (hi == EOF)
+            {
+                return false;
+            }
+            words[i] = (uint16_t)(lo | (hi << 8));
+        }
+        return true;
+    }
+};
+
+#endif        // XOSERA_DUMP_H
@@ -0,0 +1,1389 @@
+// xosera_emu.cpp - fast functional (non-RTL) Xosera emulator
+//
+// vim: set et ts=4 sw=4
+//
+// See xosera_emu.h.  Time advances in spans of pixel clocks that end at the
+// next "event" (end of line, display fetch start, copper instruction or copper
+// wait condition), so whole runs of pixels are rendered between register
+// changes instead of evaluating every module every clock like the RTL.
+
+#include "xosera_emu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+
+// RTL constants (see video_gen.sv, video_playfield.sv and copper_slim.sv)
+const int H_MEM_BEGIN     = OFFSCREEN_WIDTH - 48;        // line display fetch start
+const int H_MEM_END       = TOTAL_WIDTH - 8;             // line display fetch end
+const int PF_OUT_DELAY    = 2;                           // scanout start/end h_count before output pixel
+const int POINTER_DELAY   = 6;                           // pointer pixel 0 output h_count after POINTER_H
+const int COP_CYCLES      = 4;                           // clocks per copper instruction
+const int COP_WAKE_CYCLES = 2;                           // clocks after HPOS/VPOS condition to next instruction
+
+#if defined(MODE_640x480)
+const int VIDEO_MODE_NUM = 0;
+#elif defined(MODE_848x480)
+const int VIDEO_MODE_NUM = 1;
+#elif defined(MODE_640x400)
+const int VIDEO_MODE_NUM = 2;
+#elif defined(MODE_640x400_85)
+const int VIDEO_MODE_NUM = 3;
+#elif defined(MODE_640x480_75)
+const int VIDEO_MODE_NUM = 4;
+#elif defined(MODE_640x480_85)
+const int VIDEO_MODE_NUM = 5;
+#elif defined(MODE_720x400)
+const int VIDEO_MODE_NUM = 6;
+#elif defined(MODE_800x600)
+const int VIDEO_MODE_NUM = 7;
+#elif defined(MODE_1024x768)
+const int VIDEO_MODE_NUM = 8;
+#else
+const int VIDEO_MODE_NUM = 0;
+#endif
+
+const uint16_t XOSERA_VERSION = 0x040;        // BCD version (see VERSION in xosera_pkg.sv)
+const char     XOSERA_INFO[]  = "Xosera v0.40 functional emulator";
+
+int clog2(int value)
+{
+    int bits = 0;
+    while ((1 << bits) < value)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+const int HRES_MASK = (1 << clog2(TOTAL_WIDTH)) - 1;         // hres_t bits
+const int VRES_MASK = (1 << clog2(TOTAL_HEIGHT)) - 1;        // vres_t bits
+
+// read Verilog $readmemh/$readmemb style file (with // comments and @addr) into mem at start
+bool read_mem_file(const std::string & filename,
+                   bool                binary,
+                   uint16_t *          mem,
+                   int                 size,
+                   int                 start,
+                   std::string &       err)
+{
+    FILE * fp = fopen(filename.c_str(), "r");
+    if (fp == nullptr)
+    {
+        err = "can't open \"" + filename + "\"";
+        return false;
+    }
+
+    int  addr = start;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != nullptr)
+    {
+        char * comment = strstr(line, "//");
+        if (comment != nullptr)
+        {
+            *comment = '\0';
+        }
+        char * p = line;
+        while (*p)
+        {
+            if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+            {
+                p++;
+                continue;
+            }
+            if (*p == '@')
+            {
+                addr = (int)strtol(p + 1, &p, 16);
+                continue;
+            }
+            uint32_t value  = 0;
+            bool     digits = false;
+            for (; *p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'; p++)
+            {
+                int d;
+                if (*p == '_')
+                {
+                    continue;
+                }
+                else if (*p >= '0' && *p <= '9')
+                {
+                    d = *p - '0';
+                }
+                else if (*p >= 'a' && *p <= 'f')
+                {
+                    d = *p - 'a' + 10;
+                }
+                else if (*p >= 'A' && *p <= 'F')
+                {
+                    d = *p - 'A' + 10;
+                }
+                else
+                {
+                    d = binary ? 2 : 16;        // x, z etc. (invalid)
+                }
+                if (d >= (binary ? 2 : 16))
+                {
+                    err = "invalid digit in \"" + filename + "\"";
+                    fclose(fp);
+                    return false;
+                }
+                value  = (value << (binary ? 1 : 4)) | d;
+                digits = true;
+            }
+            if (digits)
+            {
+                if (addr >= 0 && addr < size)
+                {
+                    mem[addr] = (uint16_t)value;
+                }
+                addr++;
+            }
+        }
+    }
+    fclose(fp);
+
+    return true;
+}
+
+}        // namespace
+
+XoseraEmu::XoseraEmu()
+    : vram_mem(VRAM_WORDS)
+    , tile_mem(TILE_WORDS)
+    , colorA_mem(COLOR_WORDS + 1)        // padded for SIMD blend gather
+    , colorB_mem(COLOR_WORDS + 1)
+    , pointer_mem(POINTER_WORDS)
+    , copper_mem(COPPER_WORDS)
+    , blitter(vram_mem.data())
+    , frame_buf(VISIBLE_WIDTH * VISIBLE_HEIGHT)
+    , blend_kernel(ScanlineRender::best_kernel())
+{
+    reset();
+}
+
+bool XoseraEmu::load_defaults(const char * rtl_dir, std::string & err)
+{
+    std::string dir = rtl_dir ? rtl_dir : ".";
+    if (!dir.empty() && dir.back() != '/')
+    {
+        dir += '/';
+    }
+
+    // VRAM test pattern (see vram.sv)
+    static const char hex_str[] = "0123456789ABCDEF";
+    for (int i = 0; i < VRAM_WORDS; i++)
+    {
+        switch (i & 0xF)
+        {
+            case 1:
+                vram_mem[i] = 0x0200 | hex_str[(i >> 12) & 0xF];
+                break;
+            case 2:
+                vram_mem[i] = 0x0200 | hex_str[(i >> 8) & 0xF];
+                break;
+            case 3:
+                vram_mem[i] = 0x0200 | hex_str[(i >> 4) & 0xF];
+                break;
+            default:
+                vram_mem[i] = (uint16_t)(((((i >> 4) & 0xF) ^ 0xF) << 12) | (((i >> 4) & 0xF) << 8) | (i & 0xFF));
+                break;
+        }
+    }
+
+    // copper memory (see coppermem.sv), COPP2 is "wait EOF" followed by xosera_info
+    std::fill(copper_mem.begin(), copper_mem.end(), 0);
+    for (int i = 0x400; i < COPPER_WORDS - XV_INFO_WORDS; i++)
+    {
+        copper_mem[i] = 0x2BFF;
+    }
+    for (int i = 0; i < XV_INFO_WORDS - 4; i++)
+    {
+        uint8_t hi = (2 * i) < (int)sizeof(XOSERA_INFO) - 1 ? XOSERA_INFO[2 * i] : 0;
+        uint8_t lo = (2 * i + 1) < (int)sizeof(XOSERA_INFO) - 1 ? XOSERA_INFO[2 * i + 1] : 0;
+
+        copper_mem[COPPER_WORDS - XV_INFO_WORDS + i] = (uint16_t)((hi << 8) | lo);
+    }
+    copper_mem[COPPER_WORDS - 4] = XOSERA_VERSION;
+
+#if defined(MODE_640x480)
+    const char * copper_file = "default_copper_640.mem";
+#else
+    const char * copper_file = "default_copper_848.mem";
+#endif
+
+    std::fill(tile_mem.begin(), tile_mem.end(), 0);
+
+    bool ok = read_mem_file(dir + "tilesets/font_ST_8x16w.mem", true, vram_mem.data(), VRAM_WORDS, 0xF000, err) &&
+              read_mem_file(dir + "tilesets/font_ST_8x8w.mem", true, vram_mem.data(), VRAM_WORDS, 0xF800, err) &&
+              read_mem_file(dir + "tilesets/ANSI_PC_8x8w.mem", true, vram_mem.data(), VRAM_WORDS, 0xFC00, err) &&
+              read_mem_file(dir + "tilesets/font_ST_8x16w.mem", true, tile_mem.data(), 0x1000, 0, err) &&
+              read_mem_file(dir + "tilesets/hexfont_8x8w.mem", true, tile_mem.data() + 0x1000, 0x400, 0, err) &&
+              read_mem_file(dir + "default_colorsA.mem", false, colorA_mem.data(), COLOR_WORDS, 0, err) &&
+              read_mem_file(dir + "default_colorsB.mem", false, colorB_mem.data(), COLOR_WORDS, 0, err) &&
+              read_mem_file(dir + "default_pointer.mem", false, pointer_mem.data(), POINTER_WORDS, 0, err) &&
+              read_mem_file(dir + copper_file, false, copper_mem.data(), 0x400, 0, err);
+
+    return ok;
+}
+
+void XoseraEmu::reset()
+{
+    clock       = 0;
+    line_clock  = 0;
+    h_pos       = 0;
+    v_pos       = 0;
+    frame_count = 0;
+
+    rd_xaddr        = 0;
+    wr_xaddr        = 0;
+    rd_incr         = 0;
+    rd_addr         = 0;
+    wr_incr         = 0;
+    wr_addr         = 0;
+    reg_data        = 0;
+    reg_xdata       = 0;
+    data_even       = 0;
+    xdata_even      = 0;
+    wr_mask         = 0xF;
+    intr_mask       = 0;
+    intr_status     = 0;
+    pixel_x         = 0;
+    pixel_y         = 0;
+    pixel_base      = 0;
+    pixel_width     = 0;
+    pixel_bpp       = 0;
+    timer_latch     = 0;
+    timer_interval  = 0;
+    timer_countdown = 0;
+    timer_ticks     = 0;
+
+    // EN_COPPER_INIT reset values (copper init program sets up video mode)
+    vid_colorswap = false;
+    border_color  = 0;
+    vid_left      = 0;
+    vid_right     = 0;
+    pointer_h     = 0;
+    pointer_v     = 0;
+    pointer_col   = 0;
+    audio_enable  = false;
+    for (auto & p : pf)
+    {
+        memset(&p, 0, sizeof(p));
+        pf_blank_reset(p);
+    }
+
+    // copper starts running at reset (EN_COPPER_INIT)
+    cop_en  = true;
+    cop_run = true;
+    cop_reset();
+
+    blitter.reset();
+    blit_busy_until = 0;
+    blit_full_until = 0;
+    blit_done.clear();
+
+    memset(aud, 0, sizeof(aud));
+    for (auto & ch : aud)
+    {
+        ch.restart = true;
+    }
+    audio_clock = 0;
+    audio_intr  = 0;
+    audio_buf.clear();
+
+    memset(line_idx, 0, sizeof(line_idx));
+}
+
+// XM registers
+
+void XoseraEmu::bus_write(int reg_num, int bytesel, uint8_t data)
+{
+    switch (reg_num & 0xF)
+    {
+        case XM_SYS_CTRL:
+            if (!bytesel)
+            {
+                pixel_bpp   = data & 0x3;
+                pixel_base  = pixel_x;
+                pixel_width = pixel_y;
+            }
+            else
+            {
+                wr_mask = data & 0xF;
+            }
+            break;
+        case XM_INT_CTRL:
+            if (!bytesel)
+            {
+                intr_mask = data & 0x7F;        // NOTE: reconfig bit ignored
+            }
+            else
+            {
+                blit_update();
+                timer_update();
+                audio_update();
+                intr_clear(data & 0x7F);
+            }
+            break;
+        case XM_TIMER:
+            timer_update();
+            timer_interval = data;
+            break;
+        case XM_RD_XADDR:
+            if (!bytesel)
+            {
+                rd_xaddr = (uint16_t)((rd_xaddr & 0x00FF) | (data << 8));
+            }
+            else
+            {
+                rd_xaddr  = (uint16_t)((rd_xaddr & 0xFF00) | data);
+                reg_xdata = xr_read(rd_xaddr++);        // pre-read
+            }
+            break;
+        case XM_WR_XADDR:
+            if (!bytesel)
+            {
+                wr_xaddr = (uint16_t)((wr_xaddr & 0x00FF) | (data << 8));
+            }
+            else
+            {
+                wr_xaddr = (uint16_t)((wr_xaddr & 0xFF00) | data);
+            }
+            break;
+        case XM_XDATA:
+            if (!bytesel)
+            {
+                xdata_even = data;
+            }
+            else
+            {
+                xr_write(wr_xaddr++, (uint16_t)((xdata_even << 8) | data));
+            }
+            break;
+        case XM_RD_INCR:
+            rd_incr = !bytesel ? (uint16_t)((rd_incr & 0x00FF) | (data << 8)) : (uint16_t)((rd_incr & 0xFF00) | data);
+            break;
+        case XM_RD_ADDR:
+            if (!bytesel)
+            {
+                rd_addr = (uint16_t)((rd_addr & 0x00FF) | (data << 8));
+            }
+            else
+            {
+                rd_addr  = (uint16_t)((rd_addr & 0xFF00) | data);
+                reg_data = vram_mem[rd_addr];        // pre-read
+                rd_addr += rd_incr;
+            }
+            break;
+        case XM_WR_INCR:
+            wr_incr = !bytesel ? (uint16_t)((wr_incr & 0x00FF) | (data << 8)) : (uint16_t)((wr_incr & 0xFF00) | data);
+            break;
+        case XM_WR_ADDR:
+            wr_addr = !bytesel ? (uint16_t)((wr_addr & 0x00FF) | (data << 8)) : (uint16_t)((wr_addr & 0xFF00) | data);
+            break;
+        case XM_DATA:
+        case XM_DATA_2:
+            if (!bytesel)
+            {
+                data_even = data;
+            }
+            else
+            {
+                static const uint16_t nibble_mask[16] = {0x0000,
+                                                         0x000F,
+                                                         0x00F0,
+                                                         0x00FF,
+                                                         0x0F00,
+                                                         0x0F0F,
+                                                         0x0FF0,
+                                                         0x0FFF,
+                                                         0xF000,
+                                                         0xF00F,
+                                                         0xF0F0,
+                                                         0xF0FF,
+                                                         0xFF00,
+                                                         0xFF0F,
+                                                         0xFFF0,
+                                                         0xFFFF};
+                uint16_t              mask          = nibble_mask[wr_mask];
+                uint16_t              value         = (uint16_t)((data_even << 8) | data);
+
+                vram_mem[wr_addr] = (uint16_t)((vram_mem[wr_addr] & ~mask) | (value & mask));
+                wr_addr += wr_incr;
+            }
+            break;
+        case XM_PIXEL_X:
+        case XM_PIXEL_Y: {
+            uint16_t & reg = (reg_num & 0xF) == XM_PIXEL_X ? pixel_x : pixel_y;
+            if (!bytesel)
+            {
+                reg = (uint16_t)((reg & 0x00FF) | (data << 8));
+            }
+            else
+            {
+                reg = (uint16_t)((reg & 0xFF00) | data);
+
+                // see EN_PIXEL_ADDR in reg_interface.sv
+                uint16_t xw = (uint16_t)((int16_t)pixel_x >> 2);
+                wr_addr     = (uint16_t)(pixel_base + xw + pixel_y * pixel_width);
+                if (!(pixel_bpp & 0x2))
+                {
+                    int b0 = pixel_bpp & 0x1;
+                    switch (pixel_x & 0x3)
+                    {
+                        case 0:
+                            wr_mask = (uint8_t)(0x8 | (b0 << 2));
+                            break;
+                        case 1:
+                            wr_mask = (uint8_t)(0x4 | (b0 << 1));
+                            break;
+                        case 2:
+                            wr_mask = (uint8_t)(0x2 | b0);
+                            break;
+                        default:
+                            wr_mask = 0x1;
+                            break;
+                    }
+                }
+            }
+            break;
+        }
+        default:        // XM_UART, XM_FEATURE
+            break;
+    }
+}
+
+uint8_t XoseraEmu::bus_read(int reg_num, int bytesel)
+{
+    uint16_t value = 0;
+
+    reg_num &= 0xF;
+    switch (reg_num)
+    {
+        case XM_SYS_CTRL:
+            value = (uint16_t)(((clock < blit_full_until ? 1 : 0) << (8 + SYS_CTRL_BLIT_FULL_B)) |
+                               ((clock < blit_busy_until ? 1 : 0) << (8 + SYS_CTRL_BLIT_BUSY_B)) |
+                               ((h_pos < OFFSCREEN_WIDTH ? 1 : 0) << (8 + SYS_CTRL_HBLANK_B)) |
+                               ((v_pos >= VISIBLE_HEIGHT ? 1 : 0) << (8 + SYS_CTRL_VBLANK_B)) | (pixel_bpp << 8) |
+                               wr_mask);
+            break;
+        case XM_INT_CTRL:
+            blit_update();
+            timer_update();
+            audio_update();
+            value = (uint16_t)((intr_mask << 8) | intr_status);
+            break;
+        case XM_TIMER:
+            timer_update();
+            value = (uint16_t)((timer_ticks & 0xFF00) | timer_latch);
+            break;
+        case XM_RD_XADDR:
+            value = rd_xaddr;
+            break;
+        case XM_WR_XADDR:
+            value = wr_xaddr;
+            break;
+        case XM_XDATA:
+            value = reg_xdata;
+            break;
+        case XM_RD_INCR:
+            value = rd_incr;
+            break;
+        case XM_RD_ADDR:
+            value = rd_addr;
+            break;
+        case XM_WR_INCR:
+            value = wr_incr;
+            break;
+        case XM_WR_ADDR:
+            value = wr_addr;
+            break;
+        case XM_DATA:
+        case XM_DATA_2:
+            value = reg_data;
+            break;
+        case XM_FEATURE:
+            value = (uint16_t)((AUDIO_CHANNELS << FEATURE_AUDCHAN_B) | FEATURE_PF_B_F | FEATURE_BLIT_F |
+                               FEATURE_COPP_F | VIDEO_MODE_NUM);
+            break;
+        default:        // XM_PIXEL_X, XM_PIXEL_Y, XM_UART
+            break;
+    }
+
+    if (!bytesel)
+    {
+        // latch low byte of timer when upper byte read
+        timer_update();
+        timer_latch = (uint8_t)timer_ticks;
+        return (uint8_t)(value >> 8);
+    }
+
+    // low byte data read starts next pre-read
+    if (reg_num == XM_XDATA)
+    {
+        reg_xdata = xr_read(rd_xaddr++);
+    }
+    else if (reg_num == XM_DATA || reg_num == XM_DATA_2)
+    {
+        reg_data = vram_mem[rd_addr];
+        rd_addr += rd_incr;
+    }
+
+    return (uint8_t)value;
+}
+
+void XoseraEmu::xm_setw(int reg_num, uint16_t value)
+{
+    bus_write(reg_num, 0, (uint8_t)(value >> 8));
+    bus_write(reg_num, 1, (uint8_t)value);
+}
+
+uint16_t XoseraEmu::xm_getw(int reg_num)
+{
+    uint16_t hi = bus_read(reg_num, 0);
+    return (uint16_t)((hi << 8) | bus_read(reg_num, 1));
+}
+
+void XoseraEmu::xr_setw(uint16_t xr_addr, uint16_t value)
+{
+    xm_setw(XM_WR_XADDR, xr_addr);
+    xm_setw(XM_XDATA, value);
+}
+
+uint16_t XoseraEmu::xr_getw(uint16_t xr_addr)
+{
+    xm_setw(XM_RD_XADDR, xr_addr);
+    return xm_getw(XM_XDATA);
+}
+
+// XR registers and memory (see xrmem_arb.sv)
+
+void XoseraEmu::xr_write(uint16_t addr, uint16_t data)
+{
+    switch (addr >> 14)
+    {
+        case 0:
+            if (addr & 0x40)
+            {
+                blit_update();
+                uint16_t reg    = (uint16_t)(XR_BLIT_CTRL | (addr & 0xF));
+                uint32_t cycles = blitter.write_reg(reg, data);
+                if (reg == XR_BLIT_WORDS)
+                {
+                    // one blit can be queued while another is busy (blit_full)
+                    uint64_t start  = std::max(clock, blit_busy_until);
+                    blit_full_until = start;
+                    blit_busy_until = start + cycles;
+                    blit_done.push_back(blit_busy_until);
+                }
+            }
+            else
+            {
+                xreg_write(addr & 0x3F, data);
+            }
+            break;
+        case 1:
+            tile_mem[tile_index(addr)] = data;
+            break;
+        case 2:
+            if (addr & 0x200)
+            {
+                pointer_mem[addr & 0xFF] = data;
+            }
+            else if (addr & 0x100)
+            {
+                colorB_mem[addr & 0xFF] = data;
+            }
+            else
+            {
+                colorA_mem[addr & 0xFF] = data;
+            }
+            break;
+        default:
+            copper_mem[copper_index(addr)] = data;
+            break;
+    }
+}
+
+uint16_t XoseraEmu::xr_read(uint16_t addr)
+{
+    switch (addr >> 14)
+    {
+        case 0:
+            return (addr & 0x40) ? 0 : xreg_read(addr & 0x3F);
+        case 1:
+            return tile_mem[tile_index(addr)];
+        case 2:
+            return (addr & 0x100) ? colorB_mem[addr & 0xFF] : colorA_mem[addr & 0xFF];
+        default:
+            return copper_mem[copper_index(addr)];
+    }
+}
+
+void XoseraEmu::save_dump(XoseraDump & dump) const
+{
+    dump.width  = VISIBLE_WIDTH;
+    dump.height = VISIBLE_HEIGHT;
+    for (int r = 0; r < XoseraDump::XR_REGS; r++)
+    {
+        dump.xr_regs[r] = xreg_read(r);
+    }
+    // write-only registers
+    dump.xr_regs[XR_POINTER_H] = (uint16_t)pointer_h;
+    dump.xr_regs[XR_POINTER_V] = (uint16_t)((pointer_col << 12) | pointer_v);
+
+    std::copy(vram_mem.begin(), vram_mem.end(), dump.vram.begin());
+    std::copy(tile_mem.begin(), tile_mem.end(), dump.tile.begin());
+    std::copy(colorA_mem.begin(), colorA_mem.begin() + COLOR_WORDS, dump.colorA.begin());
+    std::copy(colorB_mem.begin(), colorB_mem.begin() + COLOR_WORDS, dump.colorB.begin());
+    std::copy(pointer_mem.begin(), pointer_mem.end(), dump.pointer.begin());
+    std::copy(copper_mem.begin(), copper_mem.end(), dump.copper.begin());
+}
+
+void XoseraEmu::xreg_write(int reg, uint16_t data)
+{
+    if (reg >= XR_PA_GFX_CTRL && reg <= XR_PB_LINE_ADDR)
+    {
+        pf_reg_write(pf[(reg >> 3) & 1], reg & 0x7, data);
+        return;
+    }
+    if (reg >= XR_AUD0_VOL && reg <= XR_AUD3_START)
+    {
+        audio_update();
+        AudioChan & ch = aud[(reg >> 2) & 0x3];
+        switch (reg & 0x3)
+        {
+            case 0:
+                ch.vol = data;
+                break;
+            case 1:
+                ch.period = data & 0x7FFF;
+                if (data & AUD_PERIOD_RESTART_F)
+                {
+                    ch.restart      = true;
+                    ch.word_ok      = false;
+                    ch.odd          = false;
+                    ch.period_count = 0xFFFF;
+                }
+                break;
+            case 2:
+                ch.length = data;
+                break;
+            default:
+                ch.start = data;
+                audio_intr &= ~(1 << ((reg >> 2) & 0x3));
+                break;
+        }
+        return;
+    }
+
+    switch (reg)
+    {
+        case XR_VID_CTRL:
+            vid_colorswap = (data & VID_CTRL_SWAP_AB_F) != 0;
+            border_color  = (uint8_t)data;
+            break;
+        case XR_COPP_CTRL:
+            cop_en = (data & COPP_CTRL_COPP_EN_F) != 0;
+            if (!cop_en)
+            {
+                cop_run = false;
+                cop_reset();
+            }
+            break;
+        case XR_AUD_CTRL:
+            audio_update();
+            audio_enable = (data & AUD_CTRL_AUD_EN_F) != 0;
+            break;
+        case XR_VID_LEFT:
+            vid_left = data & HRES_MASK;
+            break;
+        case XR_VID_RIGHT:
+            vid_right = data & HRES_MASK;
+            break;
+        case XR_POINTER_H:
+            pointer_h = data & HRES_MASK;
+            break;
+        case XR_POINTER_V:
+            pointer_v   = data & VRES_MASK;
+            pointer_col = (uint8_t)(data >> 12);
+            break;
+        default:        // XR_SCANLINE and unused
+            break;
+    }
+}
+
+uint16_t XoseraEmu::xreg_read(int reg) const
+{
+    if (reg & 0x10)
+    {
+        return pf_reg_read(pf[(reg >> 3) & 1], reg & 0x7);
+    }
+
+    switch (reg & 0x7)
+    {
+        case XR_VID_CTRL:
+            return (uint16_t)((vid_colorswap ? VID_CTRL_SWAP_AB_F : 0) | border_color);
+        case XR_COPP_CTRL:
+            return cop_en ? COPP_CTRL_COPP_EN_F : 0;
+        case XR_AUD_CTRL:
+            return audio_enable ? AUD_CTRL_AUD_EN_F : 0;
+        case XR_SCANLINE:
+            return (uint16_t)v_pos;
+        case XR_VID_LEFT:
+            return (uint16_t)vid_left;
+        case XR_VID_RIGHT:
+            return (uint16_t)vid_right;
+        default:
+            return 0;
+    }
+}
+
+void XoseraEmu::pf_reg_write(Playfield & p, int reg, uint16_t data)
+{
+    switch (reg)
+    {
+        case XR_PA_GFX_CTRL & 0x7:
+            p.colorbase = (uint8_t)(data >> 8);
+            p.blank     = (data & GFX_CTRL_BLANK_F) != 0;
+            p.bitmap    = (data & GFX_CTRL_BITMAP_F) != 0;
+            p.bpp       = (data >> GFX_CTRL_BPP_B) & 0x3;
+            p.h_repeat  = (data >> GFX_CTRL_H_REPEAT_B) & 0x3;
+            p.v_repeat  = (data >> GFX_CTRL_V_REPEAT_B) & 0x3;
+            p.v_count   = p.v_repeat;        // new v repeat used immediately
+            break;
+        case XR_PA_TILE_CTRL & 0x7:
+            p.tile_bank    = (uint8_t)(data >> TILE_CTRL_TILEBASE_B);
+            p.disp_in_tile = (data & TILE_CTRL_DISP_TILEMEM_F) != 0;
+            p.tile_in_vram = (data & TILE_CTRL_TILE_VRAM_F) != 0;
+            p.tile_height  = data & TILE_CTRL_TILE_H_F;
+            break;
+        case XR_PA_DISP_ADDR & 0x7:
+            p.start_addr = data;
+            break;
+        case XR_PA_LINE_LEN & 0x7:
+            p.line_len = data;
+            break;
+        case XR_PA_HV_FSCALE & 0x7:
+            p.h_frac_repeat = (data >> 4) & 0x7;
+            p.v_frac_repeat = data & 0x7;
+            break;
+        case XR_PA_H_SCROLL & 0x7:
+            p.fine_hscroll = data & H_SCROLL_FINE_F;
+            break;
+        case XR_PA_V_SCROLL & 0x7:
+            p.fine_vscroll = (uint8_t)(((data & V_SCROLL_TILE_F) << 2) | ((data & V_SCROLL_FINE_F) >> V_SCROLL_FINE_B));
+            break;
+        default:        // XR_Px_LINE_ADDR
+            p.line_start = data;        // new line start used immediately
+            break;
+    }
+
+    // blanked playfield is continuously held at start of frame
+    if (p.blank)
+    {
+        pf_blank_reset(p);
+    }
+}
+
+uint16_t XoseraEmu::pf_reg_read(const Playfield & p, int reg) const
+{
+    switch (reg)
+    {
+        case XR_PA_GFX_CTRL & 0x7:
+            return (uint16_t)((p.colorbase << 8) | (p.blank ? GFX_CTRL_BLANK_F : 0) |
+                              (p.bitmap ? GFX_CTRL_BITMAP_F : 0) | (p.bpp << GFX_CTRL_BPP_B) |
+                              (p.h_repeat << GFX_CTRL_H_REPEAT_B) | (p.v_repeat << GFX_CTRL_V_REPEAT_B));
+        case XR_PA_TILE_CTRL & 0x7:
+            return (uint16_t)((p.tile_bank << TILE_CTRL_TILEBASE_B) | (p.disp_in_tile ? TILE_CTRL_DISP_TILEMEM_F : 0) |
+                              (p.tile_in_vram ? TILE_CTRL_TILE_VRAM_F : 0) | p.tile_height);
+        case XR_PA_DISP_ADDR & 0x7:
+            return p.start_addr;
+        case XR_PA_LINE_LEN & 0x7:
+            return p.line_len;
+        case XR_PA_HV_FSCALE & 0x7:
+            return (uint16_t)((p.h_frac_repeat << 4) | p.v_frac_repeat);
+        case XR_PA_H_SCROLL & 0x7:
+            return p.fine_hscroll;
+        case XR_PA_V_SCROLL & 0x7:
+            return (uint16_t)(((p.fine_vscroll & 0x3) << V_SCROLL_FINE_B) | (p.fine_vscroll >> 2));
+        default:
+            return 0;
+    }
+}
+
+// playfield display
+
+void XoseraEmu::pf_blank_reset(Playfield & p)
+{
+    p.addr         = p.start_addr;
+    p.line_start   = p.start_addr;
+    p.v_count      = (uint8_t)((p.v_repeat - (p.fine_vscroll & 0x3)) & 0x3);
+    p.tile_y       = p.fine_vscroll >> 2;
+    p.v_frac_count = 0;
+}
+
+void XoseraEmu::pf_end_of_line(Playfield & p)
+{
+    p.scanout       = false;
+    p.start_pending = false;
+    p.addr          = p.line_start;
+    p.h_frac_count  = 0;
+
+    uint8_t v_frac  = p.v_frac_count;
+    p.v_frac_count  = (v_frac - 1) & 0x7;
+    if (p.v_frac_repeat != 0 && v_frac == 0)
+    {
+        p.v_frac_count = p.v_frac_repeat;        // repeat line
+    }
+    else if (p.v_count != 0)
+    {
+        p.v_count--;
+    }
+    else
+    {
+        p.v_count = p.v_repeat;
+        if (p.bitmap || p.tile_y >= p.tile_height)
+        {
+            p.tile_y = 0;
+            p.line_start += p.line_len;
+        }
+        else
+        {
+            p.tile_y = (p.tile_y + 1) & 0xF;
+        }
+    }
+}
+
+void XoseraEmu::pf_fetch_start(Playfield & p)
+{
+    int start_h = (OFFSCREEN_WIDTH - PF_OUT_DELAY + vid_left - p.fine_hscroll) & HRES_MASK;
+    int end_h   = (OFFSCREEN_WIDTH - PF_OUT_DELAY + vid_right) & HRES_MASK;
+
+    p.addr          = p.line_start;
+    p.scanout       = false;
+    p.start_pending = start_h > H_MEM_BEGIN && start_h < H_MEM_END;
+    p.start_h       = start_h + PF_OUT_DELAY;
+    p.end_h         = end_h + PF_OUT_DELAY;
+}
+
+// fetch and expand next 8 pixels (see fetch FSM in video_playfield.sv)
+void XoseraEmu::pf_fetch(Playfield & p)
+{
+    p.addr = playfield_fetch(p, vram_mem.data(), tile_mem.data(), p.tile_y, p.addr, p.pixels);
+}
+
+// render playfield color indices for h_count h0 to h1-1 of current (visible) line
+void XoseraEmu::pf_render(Playfield & p, int pf_num, int h0, int h1)
+{
+    uint8_t * out    = line_idx[pf_num];
+    uint8_t   border = pf_num == 0 ? border_color : 0;        // PB border is colorbase ^ colorbase
+    int       h      = h0;
+
+    while (h < h1)
+    {
+        if (!p.scanout || p.blank)
+        {
+            int stop = h1;
+            if (p.start_pending && !p.blank && p.start_h >= h && p.start_h < stop)
+            {
+                stop = p.start_h;
+            }
+            int x = std::max(h, OFFSCREEN_WIDTH);
+            if (x < stop)
+            {
+                memset(out + x, border, stop - x);
+            }
+            h = stop;
+            if (h == h1)
+            {
+                break;
+            }
+
+            // scanout start
+            p.start_pending = false;
+            if (h < p.end_h)
+            {
+                p.scanout = true;
+                p.pix_num = 0;
+                p.h_count = p.h_repeat;
+                pf_fetch(p);
+            }
+            continue;
+        }
+
+        int stop = std::min(h1, p.end_h);
+        if (p.h_frac_repeat == 0)
+        {
+            // runs of repeated pixels
+            while (h < stop)
+            {
+                int     run   = std::min(stop - h, p.h_count + 1);
+                uint8_t color = p.pixels[p.pix_num] ^ p.colorbase;
+                int     x     = std::max(h, OFFSCREEN_WIDTH);
+                if (x < h + run)
+                {
+                    memset(out + x, color, h + run - x);
+                }
+                h += run;
+                p.h_frac_count = (uint8_t)((p.h_frac_count - run) & 0x7);
+                if (run == p.h_count + 1)
+                {
+                    p.h_count = p.h_repeat;
+                    if (++p.pix_num == 8)
+                    {
+                        p.pix_num = 0;
+                        pf_fetch(p);
+                    }
+                }
+                else
+                {
+                    p.h_count = (uint8_t)(p.h_count - run);
+                }
+            }
+        }
+        else
+        {
+            for (; h < stop; h++)
+            {
+                if (h >= OFFSCREEN_WIDTH)
+                {
+                    out[h] = p.pixels[p.pix_num] ^ p.colorbase;
+                }
+                uint8_t h_frac = p.h_frac_count;
+                p.h_frac_count = (h_frac - 1) & 0x7;
+                if (h_frac == 0)
+                {
+                    p.h_frac_count = p.h_frac_repeat;        // repeat pixel
+                }
+                else if (p.h_count != 0)
+                {
+                    p.h_count--;
+                }
+                else
+                {
+                    p.h_count = p.h_repeat;
+                    if (++p.pix_num == 8)
+                    {
+                        p.pix_num = 0;
+                        pf_fetch(p);
+                    }
+                }
+            }
+        }
+
+        if (h >= p.end_h)
+        {
+            p.scanout = false;
+        }
+    }
+}
+
+// pointer, color lookup and blend for h_count h0 to h1-1 of current (visible) line
+void XoseraEmu::output_pixels(int h0, int h1)
+{
+    int x0 = std::max(h0, OFFSCREEN_WIDTH);
+    if (x0 >= h1)
+    {
+        return;
+    }
+
+    uint8_t * idx_a = line_idx[vid_colorswap ? 1 : 0];
+    uint8_t * idx_b = line_idx[vid_colorswap ? 0 : 1];
+
+    // pointer replaces non-zero pixels of A color index (line_idx is only output once, so modify in place)
+    int row   = (v_pos - pointer_v + TOTAL_HEIGHT) % TOTAL_HEIGHT;
+    int ptr_h = pointer_h + POINTER_DELAY;
+    if (row < 32)
+    {
+        const uint16_t * ptr_row = &pointer_mem[row * 8];
+        int              px_end  = std::min(h1, ptr_h + 32);
+        for (int h = std::max(x0, ptr_h); h < px_end; h++)
+        {
+            int     px     = h - ptr_h;
+            uint8_t nibble = (ptr_row[px >> 2] >> (12 - ((px & 3) * 4))) & 0xF;
+            if (nibble)
+            {
+                idx_a[h] = (uint8_t)((pointer_col << 4) | nibble);
+            }
+        }
+    }
+
+    ScanlineRender::blend_pixels(blend_kernel,
+                                 ScanlineRender::BLEND_4BIT,
+                                 colorA_mem.data(),
+                                 colorB_mem.data(),
+                                 idx_a + x0,
+                                 idx_b + x0,
+                                 &frame_buf[(v_pos * VISIBLE_WIDTH) + (x0 - OFFSCREEN_WIDTH)],
+                                 h1 - x0);
+}
+
+// start of new line (end_of_line strobe in RTL)
+void XoseraEmu::start_line()
+{
+    h_pos      = 0;
+    line_clock = clock;
+    if (++v_pos >= TOTAL_HEIGHT)
+    {
+        v_pos = 0;
+    }
+
+    for (auto & p : pf)
+    {
+        pf_end_of_line(p);
+        if (p.blank || v_pos == 0)
+        {
+            pf_blank_reset(p);
+        }
+    }
+
+    if (v_pos == 0)
+    {
+        cop_run = cop_en;        // copper restarts at start of frame (if enabled)
+        cop_reset();
+    }
+    else if (cop_run && cop_wait == COP_WAIT_H)
+    {
+        cop_wait = COP_RUN;        // EN_COPP_HWAITEOL
+        cop_next = clock + COP_WAKE_CYCLES;
+    }
+
+    if (v_pos == VISIBLE_HEIGHT)
+    {
+        intr_status |= INT_CTRL_VIDEO_INTR_F;
+    }
+
+    if (v_pos == VISIBLE_HEIGHT + V_FRONT_PORCH + V_SYNC_PULSE)
+    {
+        if (frame_cb)
+        {
+            frame_cb(frame_buf.data(), VISIBLE_WIDTH, VISIBLE_HEIGHT, frame_count);
+        }
+        frame_count++;
+    }
+
+    blit_update();
+    timer_update();
+    audio_line();
+}
+
+// copper
+
+void XoseraEmu::cop_reset()
+{
+    cop_pc    = 0;
+    cop_ra    = 0;
+    cop_wdata = 0;
+    cop_wait  = COP_RUN;
+    cop_next  = clock + 1;
+}
+
+// clock of next copper instruction or wait check (UINT64_MAX if only start of line can wake it)
+uint64_t XoseraEmu::cop_event() const
+{
+    if (!cop_run)
+    {
+        return UINT64_MAX;
+    }
+
+    switch (cop_wait)
+    {
+        case COP_RUN:
+            return cop_next;
+        case COP_WAIT_H: {
+            int h = cop_wait_op & HRES_MASK;
+            if (h <= h_pos)
+            {
+                return clock;
+            }
+            return h < TOTAL_WIDTH ? line_clock + h : UINT64_MAX;
+        }
+        default:
+            if ((cop_wait_op & VRES_MASK) <= v_pos)
+            {
+                return clock;
+            }
+            if (cop_wait_op & 0x400)
+            {
+                return std::max(clock, blit_busy_until);        // EN_COPP_VBLITWAIT
+            }
+            return UINT64_MAX;
+    }
+}
+
+void XoseraEmu::cop_write(uint16_t addr, uint16_t data)
+{
+    if ((addr & 0xC000) == XR_CONFIG_REGS && (addr & 0x0800))
+    {
+        // RA pseudo register
+        cop_ra = (addr & 0x1) ? (uint16_t)(cop_ra - data) : data;
+    }
+    else
+    {
+        xr_write(addr, data);
+    }
+    cop_wdata = data;
+}
+
+void XoseraEmu::cop_step()
+{
+    if (cop_wait != COP_RUN)
+    {
+        cop_wait = COP_RUN;        // cop_event() only returns when wait is over
+        cop_next = clock + COP_WAKE_CYCLES;
+        return;
+    }
+
+    uint16_t op = copper_mem[copper_index(cop_pc)];
+    cop_next    = clock + COP_CYCLES;
+    switch ((op >> 12) & 0x3)
+    {
+        case 0: {        // SETI
+            uint16_t data = copper_mem[copper_index((cop_pc + 1) & 0x7FF)];
+            cop_pc        = (cop_pc + 2) & 0x7FF;
+            cop_write(op, data);
+            break;
+        }
+        case 1: {        // SETM
+            uint16_t dest = copper_mem[copper_index((cop_pc + 1) & 0x7FF)];
+            uint16_t data = (op & 0x0800) ? cop_ra : copper_mem[copper_index(op & 0x7FF)];
+            cop_pc        = (cop_pc + 2) & 0x7FF;
+            cop_write(dest, data);
+            break;
+        }
+        case 2:        // HPOS/VPOS
+            cop_pc      = (cop_pc + 1) & 0x7FF;
+            cop_wait    = (op & 0x0800) ? COP_WAIT_V : COP_WAIT_H;
+            cop_wait_op = op;
+            break;
+        default: {        // BRGE/BRLT
+            bool b_flag = cop_ra < cop_wdata;
+            cop_pc      = (cop_pc + 1) & 0x7FF;
+            if (b_flag == ((op & 0x0800) != 0))
+            {
+                cop_pc = op & 0x7FF;
+            }
+            break;
+        }
+    }
+}
+
+// blitter completion interrupts
+
+void XoseraEmu::blit_update()
+{
+    if (blit_done.empty())
+    {
+        return;
+    }
+    size_t n = 0;
+    while (n < blit_done.size() && blit_done[n] <= clock)
+    {
+        n++;
+    }
+    if (n)
+    {
+        intr_status |= INT_CTRL_BLIT_INTR_F;
+        blit_done.erase(blit_done.begin(), blit_done.begin() + n);
+    }
+}
+
+// timer (1/10 ms ticks, see reg_interface.sv)
+
+void XoseraEmu::timer_update()
+{
+    uint64_t ticks = clock * 10000 / pclk_hz();
+    while (timer_ticks < ticks)
+    {
+        timer_ticks++;
+        if (timer_countdown == 0)
+        {
+            intr_status |= INT_CTRL_TIMER_INTR_F;
+            timer_countdown = timer_interval;
+        }
+        else
+        {
+            timer_countdown--;
+        }
+    }
+}
+
+void XoseraEmu::intr_clear(uint8_t bits)
+{
+    intr_status &= ~bits;
+    intr_status |= audio_intr;        // audio interrupts are levels until AUDn_START written
+}
+
+// audio (see audio_mixer_slim.sv)
+
+// load next sample word (reloading START and LENGTH at end of sample or on restart)
+void XoseraEmu::audio_fetch(int chan)
+{
+    AudioChan & ch   = aud[chan];
+    uint16_t    len1 = (uint16_t)((ch.len_count & 0x7FFF) - 1);
+    if ((len1 & 0x8000) || ch.restart)
+    {
+        ch.len_count = ch.length;
+        ch.ptr       = ch.start;
+        audio_intr |= (uint8_t)(1 << chan);
+        intr_status |= (uint8_t)(1 << chan);
+    }
+    else
+    {
+        ch.len_count = (uint16_t)((ch.len_count & 0x8000) | len1);
+    }
+    ch.restart = false;
+    ch.word    = (ch.len_count & AUD_LENGTH_TILEMEM_F) ? tile_mem[tile_index(ch.ptr)] : vram_mem[ch.ptr];
+    ch.ptr++;
+    ch.word_ok = true;
+}
+
+// advance audio channels to current clock
+void XoseraEmu::audio_update()
+{
+    uint64_t clocks = clock - audio_clock;
+    audio_clock     = clock;
+    if (!audio_enable)
+    {
+        for (auto & ch : aud)
+        {
+            ch.restart      = true;        // channels held in restart
+            ch.word_ok      = false;
+            ch.odd          = false;
+            ch.period_count = 0xFFFF;
+        }
+        return;
+    }
+
+    for (int chan = 0; chan < AUDIO_CHANNELS; chan++)
+    {
+        AudioChan & ch = aud[chan];
+        uint64_t    n  = clocks;
+        while (n)
+        {
+            if (ch.period_count & 0x8000)
+            {
+                // output next sample byte
+                if (!ch.word_ok || ch.restart)
+                {
+                    audio_fetch(chan);
+                }
+                ch.value = (int8_t)(ch.odd ? (ch.word & 0xFF) : (ch.word >> 8));
+                if (ch.odd)
+                {
+                    ch.word_ok = false;
+                }
+                ch.odd          = !ch.odd;
+                ch.period_count = ch.period;
+                n--;
+            }
+            else
+            {
+                uint64_t underflow = (uint64_t)ch.period_count + 1;
+                if (underflow > n)
+                {
+                    ch.period_count = (uint16_t)(ch.period_count - n);
+                    n               = 0;
+                }
+                else
+                {
+                    ch.period_count = 0xFFFF;
+                    n -= underflow;
+                }
+            }
+        }
+    }
+}
+
+// mix one stereo sample per line
+void XoseraEmu::audio_line()
+{
+    audio_update();
+
+    int16_t acc_l = 0;
+    int16_t acc_r = 0;
+    for (auto & ch : aud)
+    {
+        // 16-bit FMAC accumulator, 7-bit volume
+        acc_l = (int16_t)(acc_l + ch.value * ((ch.vol >> 9) & 0x7F));
+        acc_r = (int16_t)(acc_r + ch.value * ((ch.vol >> 1) & 0x7F));
+    }
+    int mix_l = std::min(std::max(acc_l >> 6, -128), 127);
+    int mix_r = std::min(std::max(acc_r >> 6, -128), 127);
+
+    if (audio_buf.size() < (size_t)audio_rate() * 2 * 2)        // keep at most ~1 second
+    {
+        audio_buf.push_back((int16_t)(mix_l * 256));
+        audio_buf.push_back((int16_t)(mix_r * 256));
+    }
+}
+
+size_t XoseraEmu::read_audio(int16_t * out, size_t max_pairs)
+{
+    size_t pairs = std::min(max_pairs, audio_buf.size() / 2);
+    std::copy(audio_buf.begin(), audio_buf.begin() + pairs * 2, out);
+    audio_buf.erase(audio_buf.begin(), audio_buf.begin() + pairs * 2);
+    return pairs;
+}
+
+// run
+
+void XoseraEmu::run(uint64_t clocks)
+{
+    uint64_t until = clock + clocks;
+    while (clock < until)
+    {
+        uint64_t limit = std::min(until, line_clock + TOTAL_WIDTH);
+        if (h_pos < H_MEM_BEGIN)
+        {
+            limit = std::min(limit, line_clock + H_MEM_BEGIN);
+        }
+        uint64_t cop_clock = cop_event();
+        limit              = std::min(limit, std::max(cop_clock, clock));
+
+        if (limit > clock)
+        {
+            int h0 = h_pos;
+            int h1 = h_pos + (int)(limit - clock);
+            if (v_pos < VISIBLE_HEIGHT && h1 > H_MEM_BEGIN)
+            {
+                pf_render(pf[0], 0, h0, h1);
+                pf_render(pf[1], 1, h0, h1);
+                output_pixels(h0, h1);
+            }
+            h_pos = h1;
+            clock = limit;
+
+            if (h0 < H_MEM_BEGIN && h1 == H_MEM_BEGIN && v_pos < VISIBLE_HEIGHT)
+            {
+                pf_fetch_start(pf[0]);
+                pf_fetch_start(pf[1]);
+            }
+        }
+
+        if (cop_run && clock >= cop_clock)
+        {
+            cop_step();
+        }
+
+        if (h_pos >= TOTAL_WIDTH)
+        {
+            start_line();
+        }
+    }
+}
+
+void XoseraEmu::run_to(int v, int h)
+{
+    int64_t total  = (int64_t)TOTAL_WIDTH * TOTAL_HEIGHT;
+    int64_t cur    = (int64_t)v_pos * TOTAL_WIDTH + h_pos;
+    int64_t target = (int64_t)v * TOTAL_WIDTH + h;
+    int64_t delta  = ((target - cur) % total + total) % total;
+
+    run(delta ? (uint64_t)delta : (uint64_t)total);
+}
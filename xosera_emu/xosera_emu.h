@@ -0,0 +1,268 @@
+// xosera_emu.h - fast functional (non-RTL) Xosera emulator
+//
+// vim: set et ts=4 sw=4
+//
+// Emulates Xosera at the register level using xosera_m68k_defs.h (the same
+// definitions used by the m68k API and the Verilator simulation), so bus
+// scripts and host programs can run without Verilator well above 60 fps.
+//
+// Emulated: 64K words VRAM, XR TILE/COLOR/POINTER/COPPER memories, XM and XR
+// registers, playfield A/B (bitmap and tiled 1/4/8 bpp, repeat, fractional
+// scale, fine scroll, colorbase, tile hrev/vrev), 4-bit alpha blending,
+// pointer sprite, copper, blitter (rtl/sim/blitter_model.h), 4 channel audio
+// mixer, timer and interrupts.
+//
+// This is a functional model, not cycle exact: the video fetch prefetch, the
+// video pipeline delay, memory contention (SYS_CTRL mem_wait always reads 0)
+// and XR bus arbitration are not modelled.  Register writes (from the bus or
+// the copper) take effect at the pixel being output at that time.
+
+#if !defined(XOSERA_EMU_H)
+#define XOSERA_EMU_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../rtl/sim/blitter_model.h"
+#include "../rtl/sim/video_mode_defs.h"
+#include "../xosera_m68k_api/xosera_m68k_defs.h"
+#include "playfield_fetch.h"
+#include "scanline_render.h"
+#include "xosera_dump.h"
+
+class XoseraEmu
+{
+public:
+    static const int VRAM_WORDS     = 0x10000;        // 64K words VRAM
+    static const int TILE_WORDS     = 0x1400;         // 4K + 1K words tile memory
+    static const int COLOR_WORDS    = 0x100;          // 256 words per color table (A and B)
+    static const int POINTER_WORDS  = 0x100;          // 32x32 4-bpp pointer image
+    static const int COPPER_WORDS   = 0x600;          // 1K + 512 words copper memory
+    static const int AUDIO_CHANNELS = 4;              // audio channels
+
+    // called with visible pixels (VISIBLE_WIDTH x VISIBLE_HEIGHT ARGB8888) at the end of vsync for each video
+    // frame (frame 0 is the frame starting at reset)
+    typedef std::function<void(const uint32_t * argb, int width, int height, uint32_t frame)> FrameCallback;
+
+    XoseraEmu();
+
+    static uint32_t pclk_hz() { return (uint32_t)(PIXEL_CLOCK_MHZ * 1000000.0 + 0.5); }
+    static int      audio_rate() { return (int)(pclk_hz() / TOTAL_WIDTH); }        // one sample per scanline
+
+    // load initial memory contents like RTL $readmem (fonts, colors, pointer, default copper program,
+    // VRAM test pattern) from rtl_dir (e.g. "../rtl"), returns false with err set on error
+    bool load_defaults(const char * rtl_dir, std::string & err);
+
+    // reset registers and video timing (memory contents are kept)
+    void reset();
+
+    // host bus interface, same signals as xosera_main bus_reg_num_i/bus_bytesel_i/bus_data_i
+    // (bytesel 0 = even/high byte, 1 = odd/low byte)
+    void    bus_write(int reg_num, int bytesel, uint8_t data);
+    uint8_t bus_read(int reg_num, int bytesel);
+
+    // 16-bit register access (high byte then low byte, like xm_setw/xm_getw)
+    void     xm_setw(int reg_num, uint16_t value);
+    uint16_t xm_getw(int reg_num);
+    void     xr_setw(uint16_t xr_addr, uint16_t value);
+    uint16_t xr_getw(uint16_t xr_addr);
+
+    // advance emulated time by pixel clocks
+    void run(uint64_t clocks);
+    // advance until video beam next reaches position (at most one frame)
+    void run_to(int v, int h);
+
+    // beam position and time
+    int      h_count() const { return h_pos; }
+    int      v_count() const { return v_pos; }
+    uint64_t clocks() const { return clock; }
+    uint32_t frames() const { return frame_count; }
+
+    // interrupt line (true while any enabled interrupt is pending)
+    bool intr() const { return (intr_status & intr_mask) != 0; }
+
+    void set_frame_callback(FrameCallback cb) { frame_cb = cb; }
+
+    // stereo signed 16-bit audio at audio_rate() (interleaved L,R), returns sample pairs copied
+    size_t read_audio(int16_t * out, size_t max_pairs);
+    size_t audio_pending() const { return audio_buf.size() / 2; }
+
+    // copy memories and video registers to dump (for scanline_render.h)
+    void save_dump(XoseraDump & dump) const;
+
+    // direct memory access (for tools and debugging)
+    uint16_t *       vram() { return vram_mem.data(); }
+    const uint32_t * framebuffer() const { return frame_buf.data(); }
+
+private:
+    // playfield registers and scan state (see video_playfield.sv)
+    struct Playfield : PlayfieldMode
+    {
+        // registers (and PlayfieldMode)
+        uint8_t  colorbase;
+        bool     blank;
+        uint8_t  h_repeat;
+        uint8_t  v_repeat;
+        uint16_t start_addr;
+        uint16_t line_len;
+        uint8_t  h_frac_repeat;
+        uint8_t  v_frac_repeat;
+        uint8_t  fine_hscroll;
+        uint8_t  fine_vscroll;        // { tile_line[3:0], repeat[1:0] }
+
+        // line state
+        uint16_t line_start;
+        uint16_t addr;
+        uint8_t  v_count;
+        uint8_t  v_frac_count;
+        uint8_t  tile_y;
+
+        // scan state
+        bool    start_pending;        // scanout will start at start_h
+        bool    scanout;
+        int     start_h;
+        int     end_h;
+        uint8_t h_count;
+        uint8_t h_frac_count;
+        uint8_t pix_num;
+        uint8_t pixels[8];
+    };
+
+    // audio channel (see audio_mixer_slim.sv)
+    struct AudioChan
+    {
+        uint16_t vol;
+        uint16_t period;
+        uint16_t length;
+        uint16_t start;
+        uint16_t period_count;        // bit 15 set when underflowed
+        uint16_t len_count;
+        uint16_t ptr;
+        uint16_t word;
+        bool     word_ok;
+        bool     odd;
+        bool     restart;
+        int8_t   value;
+    };
+
+    // memories
+    std::vector<uint16_t> vram_mem;
+    std::vector<uint16_t> tile_mem;
+    std::vector<uint16_t> colorA_mem;
+    std::vector<uint16_t> colorB_mem;
+    std::vector<uint16_t> pointer_mem;
+    std::vector<uint16_t> copper_mem;
+
+    // time
+    uint64_t clock;
+    uint64_t line_clock;        // clock at h_count 0 of current line
+    int      h_pos;
+    int      v_pos;
+    uint32_t frame_count;
+
+    // XM registers (see reg_interface.sv)
+    uint16_t rd_xaddr;
+    uint16_t wr_xaddr;
+    uint16_t rd_incr;
+    uint16_t rd_addr;
+    uint16_t wr_incr;
+    uint16_t wr_addr;
+    uint16_t reg_data;
+    uint16_t reg_xdata;
+    uint8_t  data_even;
+    uint8_t  xdata_even;
+    uint8_t  wr_mask;
+    uint8_t  intr_mask;
+    uint8_t  intr_status;
+    uint16_t pixel_x;
+    uint16_t pixel_y;
+    uint16_t pixel_base;
+    uint16_t pixel_width;
+    uint8_t  pixel_bpp;
+    uint8_t  timer_latch;
+    uint8_t  timer_interval;
+    uint8_t  timer_countdown;
+    uint64_t timer_ticks;        // 1/10 ms ticks since reset
+
+    // video registers
+    bool      vid_colorswap;
+    uint8_t   border_color;
+    int       vid_left;
+    int       vid_right;
+    int       pointer_h;
+    int       pointer_v;
+    uint8_t   pointer_col;
+    bool      audio_enable;
+    Playfield pf[2];
+
+    // copper (see copper_slim.sv)
+    enum CopWait
+    {
+        COP_RUN,
+        COP_WAIT_H,
+        COP_WAIT_V
+    };
+    bool     cop_en;
+    bool     cop_run;
+    uint16_t cop_pc;
+    uint16_t cop_ra;
+    uint16_t cop_wdata;        // last data written (B flag is RA < last written data)
+    CopWait  cop_wait;
+    uint16_t cop_wait_op;
+    uint64_t cop_next;        // clock when next instruction executes
+
+    // blitter
+    BlitterModel          blitter;
+    uint64_t              blit_busy_until;
+    uint64_t              blit_full_until;
+    std::vector<uint64_t> blit_done;        // pending blit completion times (for BLIT_INTR)
+
+    // audio
+    AudioChan            aud[AUDIO_CHANNELS];
+    uint64_t             audio_clock;
+    uint8_t              audio_intr;        // AUDn_INTR levels (cleared by AUDn_START write)
+    std::vector<int16_t> audio_buf;
+
+    // video output
+    std::vector<uint32_t>  frame_buf;
+    FrameCallback          frame_cb;
+    uint8_t                line_idx[2][TOTAL_WIDTH];        // playfield A/B color index for current line
+    ScanlineRender::Kernel blend_kernel;                    // color lookup and blend kernel
+
+    // XR access
+    void     xr_write(uint16_t addr, uint16_t data);
+    uint16_t xr_read(uint16_t addr);
+    void     xreg_write(int reg, uint16_t data);
+    uint16_t xreg_read(int reg) const;
+    void     pf_reg_write(Playfield & p, int reg, uint16_t data);
+    uint16_t pf_reg_read(const Playfield & p, int reg) const;
+
+    static int tile_index(uint16_t addr) { return tile_mem_index(addr); }
+    static int copper_index(uint16_t addr) { return (addr & 0x400) ? 0x400 | (addr & 0x1FF) : (addr & 0x3FF); }
+
+    // video
+    void     pf_blank_reset(Playfield & p);
+    void     pf_end_of_line(Playfield & p);
+    void     pf_fetch_start(Playfield & p);
+    void     pf_fetch(Playfield & p);
+    void     pf_render(Playfield & p, int pf_num, int h0, int h1);
+    void     output_pixels(int h0, int h1);
+    void     start_line();
+
+    // copper, blitter, audio, timer
+    void     cop_reset();
+    uint64_t cop_event() const;
+    void     cop_step();
+    void     cop_write(uint16_t addr, uint16_t data);
+    void     blit_update();
+    void     audio_update();
+    void     audio_fetch(int chan);
+    void     audio_line();
+    void     timer_update();
+    void     intr_clear(uint8_t bits);
+};
+
+#endif        // XOSERA_EMU_H
@@ -0,0 +1,470 @@
+// xosera_emu_run.cpp - run bus scripts on the functional Xosera emulator
+//
+// vim: set et ts=4 sw=4
+//
+// Headless runner for XoseraEmu that replays the same bus scripts and upload
+// files as the Verilator simulation (see rtl/sim/bus_script.h), writes a hash
+// of every frame (and optionally PNG frames and a WAV of the audio output) and
+// reports the emulation speed.  Frame numbers match the simulation (frame 1 is
+// the first full frame after the bus script starts).
+//
+// Usage: xosera_emu_run [options]
+//
+//      -f <frames>     number of frames to run (default 10)
+//      -s <script>     bus script to replay (text or binary, see bus_script.h)
+//      -u <file>       upload file for next REG_UPLOAD with no file (repeatable)
+//      -r <rtl_dir>    directory with RTL .mem files (default "../rtl")
+//      -o <dir>        output directory for hashes, frames and audio (default "logs")
+//      -g <golden>     golden hash manifest, only save frames that don't match
+//      -i              save every frame as PNG
+//      -a              save audio output as WAV
+//      -d              save memory dump at end (see xosera_dump.h, render with xosera_render)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../rtl/sim/bus_script.h"
+#include "../rtl/sim/frame_hash.h"
+#include "../rtl/sim/frame_writer.h"
+#include "xosera_emu.h"
+
+#define HASH_FILE  "xosera_emu_hashes.txt"
+#define AUDIO_FILE "xosera_emu_audio.wav"
+#define DUMP_FILE  "xosera_emu_mem.xmem"
+
+#define EXIT_GOLDEN_MISMATCH 2        // exit code when frames don't match golden hashes (-g), same as vsim
+
+namespace
+{
+
+const uint64_t BUS_START_CLOCK = 500000;        // same as simulation BUS_START_TIME (in pixel clocks)
+const uint64_t BUS_CYCLE       = 10;            // pixel clocks per bus byte access
+
+// frames numbered like the simulation (first complete frame after reset is -1)
+const int FRAME_OFFSET = 2;
+
+// replay a BusScript on the emulator (mirrors BusInterface::process in xosera_sim.cpp)
+class BusPlayer
+{
+    XoseraEmu &       emu;
+    const BusScript & script;
+    size_t            index         = 0;
+    size_t            upload_num    = 0;
+    uint16_t          last_read_val = 0;
+    bool              done          = false;
+
+    void access(uint16_t word)
+    {
+        int rd_wr   = (word & 0xC000) == 0x8000;
+        int bytesel = (word & 0x1000) ? 1 : 0;
+        int reg_num = (word >> 8) & 0xF;
+        if (rd_wr)
+        {
+            uint8_t data  = emu.bus_read(reg_num, bytesel);
+            last_read_val = bytesel ? (uint16_t)((last_read_val & 0xFF00) | data)
+                                    : (uint16_t)((last_read_val & 0x00FF) | (data << 8));
+        }
+        else
+        {
+            emu.bus_write(reg_num, bytesel, (uint8_t)word);
+        }
+        emu.run(BUS_CYCLE);
+    }
+
+public:
+    BusPlayer(XoseraEmu & e, const BusScript & s)
+        : emu(e)
+        , script(s)
+    {
+    }
+
+    bool finished() const { return done; }
+
+    // run script commands until one waits past end_clock (or script ends)
+    void run_until(uint64_t end_clock)
+    {
+        while (!done && emu.clocks() < end_clock)
+        {
+            uint16_t word = script.word(index);
+            switch (word)
+            {
+                case BUS_CMD_END:
+                    done = true;
+                    break;
+                case BUS_CMD_WAITVSYNC:
+                    emu.run_to(VISIBLE_HEIGHT + V_FRONT_PORCH, 0);
+                    index++;
+                    break;
+                case BUS_CMD_WAITVTOP:
+                    emu.run_to(VISIBLE_HEIGHT + V_FRONT_PORCH + V_SYNC_PULSE, 0);
+                    index++;
+                    break;
+                case BUS_CMD_WAITHSYNC: {
+                    int hsync_end = H_FRONT_PORCH + H_SYNC_PULSE;
+                    int v         = emu.h_count() < hsync_end ? emu.v_count() : (emu.v_count() + 1) % TOTAL_HEIGHT;
+                    emu.run_to(v, hsync_end);
+                    index++;
+                    break;
+                }
+                case BUS_CMD_WAIT_BLIT_READY:
+                case BUS_CMD_WAIT_BLIT_DONE: {
+                    int busy_bit = word == BUS_CMD_WAIT_BLIT_READY ? SYS_CTRL_BLIT_FULL_B : SYS_CTRL_BLIT_BUSY_B;
+                    if (last_read_val & (0x0100 << busy_bit))
+                    {
+                        index--;        // re-read SYS_CTRL
+                    }
+                    else
+                    {
+                        index++;
+                        last_read_val = 0;
+                    }
+                    emu.run(BUS_CYCLE);
+                    break;
+                }
+                case BUS_CMD_UPLOAD:
+                case BUS_CMD_UPLOAD_AUX: {
+                    const BusScript::Upload * upload = script.upload(upload_num++);
+                    int                       reg    = word == BUS_CMD_UPLOAD_AUX ? XM_XDATA : XM_DATA;
+                    index += 1 + (upload ? upload->skip_words : 0);
+                    if (upload)
+                    {
+                        for (size_t i = 0; i < upload->size; i++)
+                        {
+                            emu.bus_write(reg, i & 1, upload->data[i]);
+                            emu.run(BUS_CYCLE);
+                        }
+                    }
+                    break;
+                }
+                default:
+                    access(word);
+                    index++;
+                    break;
+            }
+        }
+    }
+};
+
+void write_le(FILE * fp, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        fputc((value >> (i * 8)) & 0xFF, fp);
+    }
+}
+
+bool save_wav(const char * filename, const std::vector<int16_t> & samples, int rate)
+{
+    FILE * fp = fopen(filename, "wb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    uint32_t data_bytes = (uint32_t)(samples.size() * sizeof(int16_t));
+    fwrite("RIFF", 1, 4, fp);
+    write_le(fp, 36 + data_bytes, 4);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    write_le(fp, 16, 4);                   // fmt chunk size
+    write_le(fp, 1, 2);                    // PCM
+    write_le(fp, 2, 2);                    // stereo
+    write_le(fp, rate, 4);                 // sample rate
+    write_le(fp, rate * 2 * 2, 4);         // byte rate
+    write_le(fp, 2 * 2, 2);                // block align
+    write_le(fp, 16, 2);                   // bits per sample
+    fwrite("data", 1, 4, fp);
+    write_le(fp, data_bytes, 4);
+    for (int16_t s : samples)
+    {
+        write_le(fp, (uint16_t)s, 2);
+    }
+    bool ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+void usage()
+{
+    printf("Usage: xosera_emu_run [-f frames] [-s script] [-u upload]... [-r rtl_dir] [-o outdir] [-g golden] "
+           "[-i] [-a] [-d]\n");
+}
+
+}        // namespace
+
+int main(int argc, char ** argv)
+{
+    int          max_frames  = 10;
+    const char * script_name = nullptr;
+    const char * rtl_dir     = "../rtl";
+    const char * golden_name = nullptr;
+    std::string  out_dir     = "logs";
+    bool         save_all    = false;
+    bool         save_audio  = false;
+    bool         save_dump   = false;
+    BusScript    bus_script;
+    std::string  err;
+
+    for (int a = 1; a < argc; a++)
+    {
+        const char * opt     = argv[a];
+        bool         has_arg = a + 1 < argc;
+        if (strcmp(opt, "-f") == 0 && has_arg)
+        {
+            max_frames = atoi(argv[++a]);
+            if (max_frames < 1)
+            {
+                printf("-f needs frame count > 0\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(opt, "-s") == 0 && has_arg)
+        {
+            script_name = argv[++a];
+        }
+        else if (strcmp(opt, "-u") == 0 && has_arg)
+        {
+            if (!bus_script.add_upload_file(argv[++a], err))
+            {
+                fprintf(stderr, "Upload error: %s\n", err.c_str());
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(opt, "-r") == 0 && has_arg)
+        {
+            rtl_dir = argv[++a];
+        }
+        else if (strcmp(opt, "-o") == 0 && has_arg)
+        {
+            out_dir = argv[++a];
+        }
+        else if (strcmp(opt, "-g") == 0 && has_arg)
+        {
+            golden_name = argv[++a];
+        }
+        else if (strcmp(opt, "-i") == 0)
+        {
+            save_all = true;
+        }
+        else if (strcmp(opt, "-a") == 0)
+        {
+            save_audio = true;
+        }
+        else if (strcmp(opt, "-d") == 0)
+        {
+            save_dump = true;
+        }
+        else
+        {
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!out_dir.empty() && out_dir.back() != '/')
+    {
+        out_dir += '/';
+    }
+    mkdir(out_dir.c_str(), 0777);        // ignore error (may already exist)
+
+    GoldenManifest golden;
+    if (golden_name != nullptr && !golden.load(golden_name, err))
+    {
+        fprintf(stderr, "Golden hash error: %s\n", err.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    if (script_name != nullptr)
+    {
+        if (!bus_script.load(script_name, err))
+        {
+            fprintf(stderr, "Bus script error: %s\n", err.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        static const uint16_t no_script[] = {BUS_CMD_END};
+        bus_script.set_words(no_script, 1, "(none)");
+    }
+
+    static XoseraEmu emu;
+    if (!emu.load_defaults(rtl_dir, err))
+    {
+        fprintf(stderr, "Emulator init error: %s\n", err.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    double hz = (double)XoseraEmu::pclk_hz() / (TOTAL_WIDTH * TOTAL_HEIGHT);
+    printf("Xosera functional emulator. Video Mode: %dx%d @%0.02fHz clock %0.03fMhz\n",
+           VISIBLE_WIDTH,
+           VISIBLE_HEIGHT,
+           hz,
+           PIXEL_CLOCK_MHZ);
+    printf("Bus script \"%s\": %zu words, %zu uploads\n",
+           bus_script.name(),
+           bus_script.length(),
+           bus_script.num_uploads());
+
+    std::string hash_path = out_dir + HASH_FILE;
+    FILE *      hash_fp   = fopen(hash_path.c_str(), "w");
+    if (hash_fp == nullptr)
+    {
+        fprintf(stderr, "can't create \"%s\"\n", hash_path.c_str());
+        exit(EXIT_FAILURE);
+    }
+    fprintf(hash_fp, "# frame hash pixels (%dx%d)\n", VISIBLE_WIDTH, VISIBLE_HEIGHT);
+
+    FrameWriter frame_writer;
+    frame_writer.start();
+
+    int                  last_frame = 0;
+    int                  mismatched = 0;
+    std::vector<int16_t> audio;
+    std::vector<int16_t> audio_chunk(4096 * 2);
+
+    emu.set_frame_callback(
+        [&](const uint32_t * argb, int width, int height, uint32_t video_frame)
+        {
+            int frame_num = (int)video_frame - FRAME_OFFSET;
+            if (frame_num <= 0)
+            {
+                return;
+            }
+            last_frame = frame_num;
+
+            FrameHash hash;
+            for (int i = 0; i < width * height; i++)
+            {
+                hash.add(argb[i]);
+            }
+            fprintf(hash_fp, "%d %016lx %u\n", frame_num, hash.value(), hash.pixels());
+
+            bool mismatch = false;
+            if (golden_name != nullptr)
+            {
+                const GoldenManifest::Entry * gold = golden.find(frame_num);
+                if (gold != nullptr && (gold->hash != hash.value() || gold->pixels != hash.pixels()))
+                {
+                    printf("Frame %3d MISMATCH hash %016lx, golden %016lx\n", frame_num, hash.value(), gold->hash);
+                    mismatch = true;
+                    mismatched++;
+
+                    std::vector<uint32_t> gold_pixels;
+                    std::string           gold_image = golden.image_name(frame_num);
+                    if (load_png_argb(gold_image.c_str(), gold_pixels, width, height))
+                    {
+                        std::vector<uint32_t> diff(width * height);
+                        diff_argb(diff.data(), argb, gold_pixels.data(), width * height);
+
+                        char diff_name[256];
+                        snprintf(diff_name,
+                                 sizeof(diff_name),
+                                 "%sxosera_emu_%dx%d_f%02d_diff.png",
+                                 out_dir.c_str(),
+                                 width,
+                                 height,
+                                 frame_num);
+                        frame_writer.write(diff_name, diff.data(), width, height);
+                    }
+                }
+            }
+
+            if (save_all || mismatch || (frame_num == max_frames && golden_name == nullptr))
+            {
+                char save_name[256];
+                snprintf(save_name,
+                         sizeof(save_name),
+                         "%sxosera_emu_%dx%d_f%02d.png",
+                         out_dir.c_str(),
+                         width,
+                         height,
+                         frame_num);
+                frame_writer.write(save_name, argb, width, height);
+                printf("Frame %3d saved as \"%s\"\n", frame_num, save_name);
+            }
+        });
+
+    BusPlayer bus(emu, bus_script);
+    auto      start_time = std::chrono::steady_clock::now();
+
+    emu.run(BUS_START_CLOCK);
+    while (last_frame < max_frames)
+    {
+        uint64_t step = (uint64_t)TOTAL_WIDTH * 8;
+        if (!bus.finished())
+        {
+            bus.run_until(emu.clocks() + step);
+        }
+        if (emu.clocks() < BUS_START_CLOCK || bus.finished())
+        {
+            emu.run(step);
+        }
+        size_t n;
+        while (save_audio && (n = emu.read_audio(audio_chunk.data(), audio_chunk.size() / 2)) != 0)
+        {
+            audio.insert(audio.end(), audio_chunk.begin(), audio_chunk.begin() + n * 2);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    fclose(hash_fp);
+    int errors = frame_writer.finish();
+
+    printf("Frame hashes saved to \"%s\"\n", hash_path.c_str());
+    // speed includes the reset frames before frame 1 (they take just as long to emulate)
+    printf("Emulated %d frames (plus %u reset frames) in %0.03f seconds (%0.01f fps, %0.02fx real-time)\n",
+           last_frame,
+           emu.frames() - last_frame,
+           elapsed,
+           emu.frames() / elapsed,
+           (emu.frames() / elapsed) / hz);
+
+    if (save_audio)
+    {
+        std::string wav_path = out_dir + AUDIO_FILE;
+        if (!save_wav(wav_path.c_str(), audio, XoseraEmu::audio_rate()))
+        {
+            fprintf(stderr, "error writing \"%s\"\n", wav_path.c_str());
+            errors++;
+        }
+        else
+        {
+            printf("Audio saved to \"%s\" (%zu samples at %d Hz)\n",
+                   wav_path.c_str(),
+                   audio.size() / 2,
+                   XoseraEmu::audio_rate());
+        }
+    }
+
+    if (save_dump)
+    {
+        XoseraDump  dump;
+        std::string dump_path = out_dir + DUMP_FILE;
+        emu.save_dump(dump);
+        if (!dump.save(dump_path.c_str(), err))
+        {
+            fprintf(stderr, "%s\n", err.c_str());
+            errors++;
+        }
+        else
+        {
+            printf("Memory dump saved to \"%s\"\n", dump_path.c_str());
+        }
+    }
+
+    if (golden_name != nullptr)
+    {
+        printf("Golden hash check %s: %d mismatched\n", mismatched ? "FAILED" : "passed", mismatched);
+    }
+
+    if (errors)
+    {
+        return EXIT_FAILURE;
+    }
+    return mismatched ? EXIT_GOLDEN_MISMATCH : EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+// xosera_render.cpp - render a Xosera VRAM/XR memory dump to PNG
+//
+// vim: set et ts=4 sw=4
+//
+// Shows what the playfield registers and memory in a dump should display
+// (e.g. to check a suspicious simulation frame).  Input is either a dump from
+// "xosera_emu_run -d" (see xosera_dump.h) or a bare 128KB VRAM image like
+// xosera_vsim_vram.bin, which uses the default memories and registers set by
+// the default copper program (change registers with -x).
+//
+// Usage: xosera_render [options] <dump> <output.png>
+//
+//      -k <kernel>     scalar, sse2 or avx2 (default best supported)
+//      -2              use 2-bit alpha blending (video_blend_2bit.sv)
+//      -r <rtl_dir>    directory with RTL .mem files for defaults (default "../rtl")
+//      -x <reg>=<val>  set XR register 0x00-0x3F (name like PA_GFX_CTRL or number)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+#include <vector>
+
+#include "../rtl/sim/frame_writer.h"
+#include "scanline_render.h"
+#include "xosera_emu.h"
+
+namespace
+{
+
+// XR register names (without "XR_" prefix)
+const struct
+{
+    const char * name;
+    int          num;
+} xr_names[] = {{"VID_CTRL", XR_VID_CTRL},         {"COPP_CTRL", XR_COPP_CTRL},     {"AUD_CTRL", XR_AUD_CTRL},
+                {"SCANLINE", XR_SCANLINE},         {"VID_LEFT", XR_VID_LEFT},       {"VID_RIGHT", XR_VID_RIGHT},
+                {"POINTER_H", XR_POINTER_H},       {"POINTER_V", XR_POINTER_V},     {"PA_GFX_CTRL", XR_PA_GFX_CTRL},
+                {"PA_TILE_CTRL", XR_PA_TILE_CTRL}, {"PA_DISP_ADDR", XR_PA_DISP_ADDR}, {"PA_LINE_LEN", XR_PA_LINE_LEN},
+                {"PA_HV_FSCALE", XR_PA_HV_FSCALE}, {"PA_H_SCROLL", XR_PA_H_SCROLL}, {"PA_V_SCROLL", XR_PA_V_SCROLL},
+                {"PB_GFX_CTRL", XR_PB_GFX_CTRL},   {"PB_TILE_CTRL", XR_PB_TILE_CTRL}, {"PB_DISP_ADDR", XR_PB_DISP_ADDR},
+                {"PB_LINE_LEN", XR_PB_LINE_LEN},   {"PB_HV_FSCALE", XR_PB_HV_FSCALE}, {"PB_H_SCROLL", XR_PB_H_SCROLL},
+                {"PB_V_SCROLL", XR_PB_V_SCROLL}};
+
+bool set_reg(XoseraDump & dump, const char * arg)
+{
+    const char * eq = strchr(arg, '=');
+    if (eq == nullptr)
+    {
+        return false;
+    }
+    std::string name(arg, eq - arg);
+    if (strncasecmp(name.c_str(), "XR_", 3) == 0)
+    {
+        name.erase(0, 3);
+    }
+
+    char * end;
+    long   reg = strtol(name.c_str(), &end, 0);
+    if (*end != '\0' || name.empty())
+    {
+        reg = -1;
+        for (const auto & xr : xr_names)
+        {
+            if (strcasecmp(name.c_str(), xr.name) == 0)
+            {
+                reg = xr.num;
+            }
+        }
+    }
+    long value = strtol(eq + 1, &end, 0);
+    if (reg < 0 || reg >= XoseraDump::XR_REGS || *end != '\0')
+    {
+        return false;
+    }
+    dump.xr_regs[reg] = (uint16_t)value;
+
+    return true;
+}
+
+void usage()
+{
+    printf("Usage: xosera_render [-k scalar|sse2|avx2] [-2] [-r rtl_dir] [-x reg=value]... <dump> <output.png>\n");
+}
+
+}        // namespace
+
+int main(int argc, char ** argv)
+{
+    ScanlineRender::Kernel    kernel  = ScanlineRender::best_kernel();
+    ScanlineRender::Blend     blend   = ScanlineRender::BLEND_4BIT;
+    const char *              rtl_dir = "../rtl";
+    std::vector<const char *> reg_sets;
+    std::vector<const char *> files;
+    std::string               err;
+
+    for (int a = 1; a < argc; a++)
+    {
+        const char * opt     = argv[a];
+        bool         has_arg = a + 1 < argc;
+        if (strcmp(opt, "-k") == 0 && has_arg)
+        {
+            const char * name = argv[++a];
+            int          k    = 0;
+            while (k < ScanlineRender::KERNEL_COUNT && strcmp(name, ScanlineRender::kernel_name((ScanlineRender::Kernel)k)))
+            {
+                k++;
+            }
+            if (k == ScanlineRender::KERNEL_COUNT || !ScanlineRender::kernel_supported((ScanlineRender::Kernel)k))
+            {
+                printf("kernel \"%s\" not supported\n", name);
+                exit(EXIT_FAILURE);
+            }
+            kernel = (ScanlineRender::Kernel)k;
+        }
+        else if (strcmp(opt, "-2") == 0)
+        {
+            blend = ScanlineRender::BLEND_2BIT;
+        }
+        else if (strcmp(opt, "-r") == 0 && has_arg)
+        {
+            rtl_dir = argv[++a];
+        }
+        else if (strcmp(opt, "-x") == 0 && has_arg)
+        {
+            reg_sets.push_back(argv[++a]);
+        }
+        else if (opt[0] != '-')
+        {
+            files.push_back(opt);
+        }
+        else
+        {
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (files.size() != 2)
+    {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    // defaults from emulator after default copper program has run (for bare VRAM images)
+    static XoseraEmu emu;
+    XoseraDump       dump;
+    if (!emu.load_defaults(rtl_dir, err))
+    {
+        fprintf(stderr, "Emulator init error: %s\n", err.c_str());
+        exit(EXIT_FAILURE);
+    }
+    emu.run_to(VISIBLE_HEIGHT, 0);
+    emu.save_dump(dump);
+
+    if (!dump.load(files[0], err))
+    {
+        fprintf(stderr, "%s\n", err.c_str());
+        exit(EXIT_FAILURE);
+    }
+    for (const char * r : reg_sets)
+    {
+        if (!set_reg(dump, r))
+        {
+            fprintf(stderr, "bad register setting \"%s\"\n", r);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ScanlineRender render(dump, dump.width, dump.height);
+    render.set_kernel(kernel);
+    render.set_blend(blend);
+
+    std::vector<uint32_t> pixels(dump.width * dump.height);
+    render.render_frame(pixels.data());
+
+    if (!save_png_argb(files[1], pixels.data(), dump.width, dump.height))
+    {
+        fprintf(stderr, "error writing \"%s\"\n", files[1]);
+        exit(EXIT_FAILURE);
+    }
+    printf("Rendered \"%s\" (%dx%d, %s kernel) to \"%s\"\n",
+           files[0],
+           dump.width,
+           dump.height,
+           ScanlineRender::kernel_name(render.kernel_used()),
+           files[1]);
+
+    return EXIT_SUCCESS;
+}
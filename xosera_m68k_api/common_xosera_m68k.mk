@@ -101,6 +101,9 @@ SERIAL?=/dev/modem
 BAUD?=115200
 
 COPASM=$(XOSERA_M68K_API)/bin/copasm
+# optional copasm assembly cache directory (e.g., COPASM_CACHE=/tmp/copasm_cache, off by default)
+COPASM_CACHE?=
+COPASM_CACHEOPT=$(if $(COPASM_CACHE),-C $(COPASM_CACHE))
 
 # GCC-version-specific settings
 ifneq ($(findstring GCC,$(shell $(CC) --version 2>/dev/null)),)
@@ -198,13 +201,13 @@ $(OBJECTS): $(CASMOUTPUT) $(MAKEFILE_LIST)
 # CopAsm copper source
 %.h : %.casm
 	@$(MKDIR) -p $(@D)
-	$(COPASM) -v -l -i $(XOSERA_M68K_API) -o $@ $<
+	$(COPASM) -v -l $(COPASM_CACHEOPT) -i $(XOSERA_M68K_API) -o $@ $<
 
 # preprocessed CopAsm copper source
 %.h : %.cpasm
 	@$(MKDIR) -p $(@D)
 	$(CC) -E -xc -D__COPASM__=1 -I$(XOSERA_M68K_API) $< -o $(basename $<).casm.ii
-	$(COPASM) -v -l -i $(XOSERA_M68K_API) -o $@ $(basename $<).casm.ii
+	$(COPASM) -v -l $(COPASM_CACHEOPT) -i $(XOSERA_M68K_API) -o $@ $(basename $<).casm.ii
 
 # link raw binary file into executable (with symbols _binary_<name>_raw_start/*_end/*_size)
 %.o: %.raw
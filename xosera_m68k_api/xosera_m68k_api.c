@@ -335,3 +335,113 @@ bool xosera_get_info(xosera_info_t * info)
 
     return valid;
 }
+
+#if !defined(XOSERA_API_MINIMAL)
+// upload compressed XR memory data (copasm .cz output, see copper/CopAsm/xlasmcz.h) to its XR load address
+// (e.g., XR_COPPER_ADDR), returns number of words written or 0 if data not valid (some may have been written)
+uint16_t xosera_upload_cz(const void * cz_data, uint32_t cz_bytes)
+{
+    const uint16_t * cz     = (const uint16_t *)cz_data;
+    const uint16_t * cz_end = cz + (cz_bytes >> 1);
+
+    // "CZ" magic, load address, word count (and at least an end token)
+    if (cz_bytes < 8 || cz[0] != 0x435A)
+    {
+        return 0;
+    }
+
+    xv_prep();
+
+    uint16_t hist[256];        // last 256 words written (for matches)
+    uint8_t  hist_pos = 0;
+    uint16_t count    = cz[2];
+    uint16_t written  = 0;
+
+    xmem_setw_next_addr(cz[1]);
+    cz += 3;
+    while (cz < cz_end)
+    {
+        uint16_t token = *cz++;
+        if (token == 0x0000)        // end
+        {
+            return written == count ? written : 0;
+        }
+
+        if (token & 0x8000)        // copy ((token >> 8) & 0x7F) + 2 words from (token & 0xFF) + 1 words back
+        {
+            uint16_t len  = ((token >> 8) & 0x7F) + 2;
+            uint16_t dist = (token & 0xFF) + 1;
+            if (dist > written || len > count - written)
+            {
+                return 0;
+            }
+            uint8_t src = (uint8_t)(hist_pos - dist);
+            written += len;
+            while (len--)
+            {
+                uint16_t w       = hist[src++];
+                hist[hist_pos++] = w;
+                xmem_setw_next(w);
+            }
+        }
+        else        // token literal words
+        {
+            if (token > (uint16_t)(cz_end - cz) || token > count - written)
+            {
+                return 0;
+            }
+            written += token;
+            while (token--)
+            {
+                uint16_t w       = *cz++;
+                hist[hist_pos++] = w;
+                xmem_setw_next(w);
+            }
+        }
+    }
+
+    return 0;        // no end token
+}
+
+// upload relocatable copper program (copasm .cro output, see copper/CopAsm/xlasm.cpp) to copper memory at
+// cop_addr (e.g., XR_COPPER_ADDR + 0x100), returns number of words written or 0 if data not valid
+uint16_t xosera_upload_cro(const void * cro_data, uint32_t cro_bytes, uint16_t cop_addr)
+{
+    const uint16_t * cro = (const uint16_t *)cro_data;
+
+    // "CR" magic, origin, word count, relocation count
+    if (cro_bytes < 8 || cro[0] != 0x4352)
+    {
+        return 0;
+    }
+
+    uint16_t count = cro[2];
+    uint16_t nrel  = cro[3];
+    if (4UL + count + nrel > (cro_bytes >> 1) || cop_addr < XR_COPPER_ADDR ||
+        (uint32_t)cop_addr + count > XR_COPPER_ADDR + XR_COPPER_SIZE)
+    {
+        return 0;
+    }
+
+    const uint16_t * words = cro + 4;
+    const uint16_t * reloc = words + count;        // ascending word offsets of addresses to relocate
+    uint16_t         delta = cop_addr - cro[1];
+    uint16_t         r     = 0;
+
+    xv_prep();
+
+    xmem_setw_next_addr(cop_addr);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint16_t w = words[i];
+        if (r < nrel && reloc[r] == i)
+        {
+            w += delta;
+            r++;
+        }
+        xmem_setw_next(w);
+    }
+
+    return count;
+}
+#endif
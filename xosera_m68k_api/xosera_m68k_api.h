@@ -154,6 +154,11 @@ void xosera_memclear(void * ptr, unsigned int n);        // memory zero (mostly
 void xosera_set_pointer(int16_t  x_pos,                  // native pixel X for pointer upper left
                         int16_t  y_pos,                  // native pixel Y for pointer upper left
                         uint16_t colormap_index);        // colormap_index = 0xi000 (upper 4-bits of pointer colorA)
+uint16_t xosera_upload_cz(const void * cz_data,        // upload copasm .cz compressed data (16-bit aligned)
+                          uint32_t     cz_bytes);        // returns words written to XR memory (0 if not valid)
+uint16_t xosera_upload_cro(const void * cro_data,         // upload copasm .cro relocatable copper program
+                           uint32_t     cro_bytes,        // (16-bit aligned)
+                           uint16_t     cop_addr);        // returns words written at cop_addr (0 if not valid)
 
 #include "xosera_m68k_defs.h"
 
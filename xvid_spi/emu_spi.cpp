@@ -0,0 +1,189 @@
+// emu_spi.cpp - software Xosera SPI target transport (see spi_transport.h)
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// Decodes the xvid_spi SPI command/data byte pairs the same way as the iCEBreaker SPI_INTERFACE (see
+// rtl/icebreaker/xosera_iceb.sv) and does the bus accesses on the functional emulator in xosera_emu, so xvid_spi
+// tests can run without hardware (or Verilator).  Emulated time advances by the time each byte would take at
+// EMU_SPI_HZ (and by host_spi_delay_ms), so status bits like SYS_CTRL vblank change as on hardware.
+//
+// Like the RTL the reply to the data byte is the register byte read when the command byte was received.  Only
+// read commands are replied to here, the "would be" read value for writes is always 0x00.
+//
+// The SPI clock can be set (for calibration tests).  With fewer than EMU_SPI_MAX_DIV pixel clocks per SPI clock,
+// CIPO is modeled as sampled one bit late (as when the spi_target input synchronizer can't keep up), so replies are
+// shifted by one bit and host_spi_calibrate sees read-back errors.  This fault model is made up (not measured from
+// hardware), it only gives calibration something to find (see emu_spi_test.cpp).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "../xosera_emu/xosera_emu.h"
+#include "spi_transport.h"
+
+#define EMU_SPI_HZ      2000000         // SPI clock (same as "ftdi" transport default)
+#define EMU_SPI_MAX_DIV 4               // minimum pixel clocks per SPI clock for correct replies
+#define EMU_CS_CLOCKS   4               // pixel clocks for CS change (spi_target input synchronizer)
+#define EMU_RTL_DIR     "../rtl"        // RTL directory with .mem files for emulator initial memory contents
+#define SPI_CMD_REPLY   0xCB            // reply to SPI command byte
+#define SPI_CMD_CS      0x80
+#define SPI_CMD_WR      0x40
+#define SPI_CMD_RS      0x20
+#define SPI_CMD_BS      0x10
+#define SPI_CMD_REGNUM  0x0F
+
+static XoseraEmu * emu;
+static uint32_t    spi_hz;              // SPI clock
+static uint64_t    byte_clocks;         // pixel clocks per SPI byte
+static bool        late_cipo;           // SPI clock too fast, replies shifted one bit
+static uint8_t     cipo_bit;            // last reply bit (shifted into next reply when late_cipo)
+static bool        selected;            // CS asserted
+static bool        payload_byte;        // next byte is data byte
+static uint8_t     cmd_byte;            // last command byte
+static uint8_t     reply_byte;          // reply for data byte
+
+// set SPI clock to hz (0 returns clock without setting it)
+static uint32_t emu_spi_set_speed(uint32_t hz)
+{
+    if (hz != 0)
+    {
+        spi_hz      = hz;
+        byte_clocks = (static_cast<uint64_t>(XoseraEmu::pclk_hz()) * 8 + hz / 2) / hz;
+        late_cipo   = static_cast<uint64_t>(hz) * EMU_SPI_MAX_DIV > XoseraEmu::pclk_hz();
+    }
+
+    return spi_hz;
+}
+
+static const char * emu_spi_device_id()
+{
+    return "xosera_emu";
+}
+
+static int emu_spi_open()
+{
+    emu = new XoseraEmu();
+    std::string err;
+    if (!emu->load_defaults(EMU_RTL_DIR, err))
+    {
+        fprintf(stderr, "emu_spi_open: %s\n", err.c_str());
+        delete emu;
+        emu = nullptr;
+        return -1;
+    }
+    emu->reset();
+
+    emu_spi_set_speed(EMU_SPI_HZ);
+    selected     = false;
+    payload_byte = false;
+
+    printf("Opened Xosera emulator (%.3f MHz SPI clock)...\n", spi_hz / 1000000.0);
+
+    return 0;
+}
+
+static int emu_spi_close()
+{
+    delete emu;
+    emu = nullptr;
+
+    return 0;
+}
+
+static void emu_spi_cs(bool cs)
+{
+    selected = !cs;
+    if (!selected)
+    {
+        payload_byte = false;        // next byte is command byte
+    }
+    emu->run(EMU_CS_CLOCKS);
+}
+
+// one SPI byte, returns reply
+static uint8_t emu_spi_byte(uint8_t data)
+{
+    emu->run(byte_clocks);
+    if (!selected)
+    {
+        return 0xFF;
+    }
+
+    if (!payload_byte)        // command byte
+    {
+        cmd_byte     = data;
+        payload_byte = true;
+        reply_byte   = 0x00;
+        if (cmd_byte & SPI_CMD_RS)
+        {
+            emu->reset();
+        }
+        else if ((cmd_byte & (SPI_CMD_CS | SPI_CMD_WR)) == SPI_CMD_CS)
+        {
+            reply_byte = emu->bus_read(cmd_byte & SPI_CMD_REGNUM, (cmd_byte & SPI_CMD_BS) ? 1 : 0);
+        }
+        return SPI_CMD_REPLY;
+    }
+
+    payload_byte = false;        // data byte
+    if ((cmd_byte & (SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_RS)) == (SPI_CMD_CS | SPI_CMD_WR))
+    {
+        emu->bus_write(cmd_byte & SPI_CMD_REGNUM, (cmd_byte & SPI_CMD_BS) ? 1 : 0, data);
+    }
+    return reply_byte;
+}
+
+static int emu_spi_xfer_bytes(size_t num, uint8_t * inout)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        uint8_t reply = emu_spi_byte(inout[i]);
+        if (late_cipo)
+        {
+            uint8_t bit = reply & 1;
+            reply       = static_cast<uint8_t>((cipo_bit << 7) | (reply >> 1));
+            cipo_bit    = bit;
+        }
+        inout[i] = reply;
+    }
+
+    return 0;
+}
+
+static void emu_spi_delay_ms(int ms)
+{
+    emu->run(static_cast<uint64_t>(XoseraEmu::pclk_hz()) * ms / 1000);
+}
+
+// copy emulator memories and video registers to dump (reference for xvid_spi capture check)
+bool emu_spi_save_dump(XoseraDump & dump)
+{
+    if (emu == nullptr)
+    {
+        return false;
+    }
+    emu->save_dump(dump);
+
+    return true;
+}
+
+const host_spi_transport_t emu_spi_transport = {"emu",
+                                                "software Xosera SPI target (xosera_emu functional emulator)",
+                                                emu_spi_open,
+                                                emu_spi_close,
+                                                emu_spi_cs,
+                                                emu_spi_xfer_bytes,
+                                                nullptr,
+                                                nullptr,
+                                                nullptr,
+                                                emu_spi_delay_ms,
+                                                emu_spi_set_speed,
+                                                emu_spi_device_id};
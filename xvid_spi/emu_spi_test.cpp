@@ -0,0 +1,194 @@
+// emu_spi_test.cpp - test SPI clock calibration, clock cache and lowering clock on link errors with "emu" transport
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// NOTE: The "emu" transport fault model (replies sampled one bit late when there are fewer than EMU_SPI_MAX_DIV
+// pixel clocks per SPI clock, see emu_spi.cpp) is made up, it is not measured from hardware.  It only gives
+// host_spi_calibrate read-back errors to find, so the clock found here says nothing about a real board.  These tests
+// check the calibration logic: the clock cache file contents, using the cached clock (without a sweep) and lowering
+// the clock (and updating the cache) after HOST_SPI_ERROR_LIMIT link errors.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "../xosera_emu/xosera_emu.h"
+#include "spi_transport.h"
+
+#define EMU_SPI_MAX_DIV 4                     // must match emu_spi.cpp
+#define CACHE_FILE      "emu_clock.test"        // clock cache file used (removed when done)
+#define REG_RD_INCR     0x06                    // XM_RD_INCR register number
+#define SPI_CMD_CS      0x80
+#define SPI_CMD_WR      0x40
+#define SPI_CMD_BS      0x10
+
+static const uint16_t data_pat[8] = {0xA5A5, 0x5A5A, 0xFFFF, 0x0123, 0x4567, 0x89AB, 0xCDEF, 0x0220};
+
+static int failures;
+static int verify_calls;
+
+static void check(bool ok, const char * what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+// write and read back data_pat with XM_RD_INCR (like xvid_spi spi_verify_link), returns errors
+static int verify()
+{
+    uint8_t buf[8 * 8];
+    verify_calls++;
+    for (int i = 0; i < 8; i++)
+    {
+        uint8_t * b = buf + i * 8;
+        b[0]        = SPI_CMD_CS | SPI_CMD_WR | REG_RD_INCR;
+        b[1]        = data_pat[i] >> 8;
+        b[2]        = SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_BS | REG_RD_INCR;
+        b[3]        = data_pat[i] & 0xff;
+        b[4]        = SPI_CMD_CS | REG_RD_INCR;
+        b[5]        = 0xff;
+        b[6]        = SPI_CMD_CS | SPI_CMD_BS | REG_RD_INCR;
+        b[7]        = 0xff;
+    }
+    host_spi_xfer_select(sizeof(buf), buf);
+
+    int errors = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        const uint8_t * b = buf + i * 8;
+        errors += (b[0] != 0xcb) + (b[2] != 0xcb) + (b[4] != 0xcb) + (b[6] != 0xcb);
+        errors += (((b[5] << 8) | b[7]) != data_pat[i]);
+    }
+
+    return errors;
+}
+
+static std::string read_cache()
+{
+    std::string text;
+    FILE *      file = fopen(CACHE_FILE, "r");
+    if (file)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), file))
+        {
+            text += line;
+        }
+        fclose(file);
+    }
+
+    return text;
+}
+
+static void write_cache(const char * text)
+{
+    FILE * file = fopen(CACHE_FILE, "w");
+    if (file)
+    {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+static std::string cache_line(const char * key, uint32_t hz)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%s %lu\n", key, static_cast<unsigned long>(hz));
+
+    return line;
+}
+
+int main()
+{
+    setenv("XVID_SPI_CLOCK_CACHE", CACHE_FILE, 1);
+    remove(CACHE_FILE);
+
+    // fastest clock with at least EMU_SPI_MAX_DIV pixel clocks per SPI clock, and the next slower one
+    int fast = 0;
+    while (host_spi_speeds[fast + 1] != 0 &&
+           static_cast<uint64_t>(host_spi_speeds[fast]) * EMU_SPI_MAX_DIV > XoseraEmu::pclk_hz())
+    {
+        fast++;
+    }
+    uint32_t expect_hz = host_spi_speeds[fast];
+    uint32_t slower_hz = host_spi_speeds[fast + 1];
+    printf("Expected emu SPI clock %.3f MHz (pixel clock %.3f MHz).\n",
+           expect_hz / 1000000.0,
+           XoseraEmu::pclk_hz() / 1000000.0);
+
+    if (host_spi_open("emu") < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // no cache file
+    check(host_spi_calibrate(verify, false) == 0, "no cached clock without cache file");
+
+    // sweep finds fastest clock without errors, and adds it to cache (keeping other devices)
+    write_cache("ftdi:TEST1234 3000000\n");
+    check(verify() == 0, "default clock has no read-back errors");
+    check(host_spi_calibrate(verify, true) == expect_hz && host_spi_speed() == expect_hz, "sweep finds fastest clock");
+    check(read_cache() == "ftdi:TEST1234 3000000\n" + cache_line("emu:xosera_emu", expect_hz),
+          "cache file has sweep clock (and other devices kept)");
+
+    // cached clock used after one check on next open
+    host_spi_close();
+    host_spi_open("emu");
+    verify_calls = 0;
+    check(host_spi_calibrate(verify, false) == expect_hz && host_spi_speed() == expect_hz, "cached clock used");
+    check(verify_calls == 1, "cached clock checked once (no sweep)");
+
+    // cached clock that fails check is replaced by sweep
+    host_spi_close();
+    host_spi_open("emu");
+    write_cache(cache_line("emu:xosera_emu", host_spi_speeds[0]).c_str());
+    verify_calls = 0;
+    check(host_spi_calibrate(verify, false) == expect_hz && verify_calls > 1, "failing cached clock sweeps again");
+    check(read_cache() == cache_line("emu:xosera_emu", expect_hz), "cache file updated after failed cached clock");
+
+    // link errors at too fast a clock: clock lowered after HOST_SPI_ERROR_LIMIT (and cache updated)
+    host_spi_set_speed(host_spi_speeds[0]);
+    check(verify() != 0, "read-back errors above emu clock limit");
+    host_spi_stats_t stats = host_spi_stats;
+    for (int i = 0; i < HOST_SPI_ERROR_LIMIT - 1; i++)
+    {
+        uint8_t buf[2] = {SPI_CMD_CS | REG_RD_INCR, 0xff};
+        host_spi_xfer_select(sizeof(buf), buf);
+        host_spi_link_errors(buf[0] != 0xcb);
+    }
+    check(host_spi_stats.link_errors - stats.link_errors == HOST_SPI_ERROR_LIMIT - 1 &&
+              host_spi_stats.speed_drops == stats.speed_drops && host_spi_speed() == host_spi_speeds[0],
+          "link errors under limit keep clock");
+    host_spi_link_errors(1);
+    check(host_spi_stats.speed_drops - stats.speed_drops == 1 && host_spi_speed() == host_spi_speeds[1],
+          "link errors at limit lower clock to next slower");
+    check(read_cache() == cache_line("emu:xosera_emu", host_spi_speeds[1]), "cache file has lowered clock");
+
+    // no drop at a clock without errors
+    host_spi_set_speed(slower_hz);
+    stats = host_spi_stats;
+    for (int i = 0; i < HOST_SPI_ERROR_LIMIT * 2; i++)
+    {
+        host_spi_link_errors(verify() != 0);
+    }
+    check(host_spi_stats.link_errors == stats.link_errors && host_spi_stats.speed_drops == stats.speed_drops &&
+              host_spi_speed() == slower_hz,
+          "no link errors or clock drops below emu clock limit");
+
+    host_spi_close();
+    remove(CACHE_FILE);
+
+    printf("%s\n", failures ? "FAILED!" : "All tests passed.");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
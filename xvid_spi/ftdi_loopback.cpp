@@ -0,0 +1,318 @@
+// ftdi_loopback.cpp - libftdi stand-in for testing FTDI SPI routines without hardware
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftdi_spi.h"
+
+ftdi_loopback_stats_t ftdi_loopback_stats;
+
+// queue byte to be read back
+static void loopback_rx(struct ftdi_context * ftdi, uint8_t data)
+{
+    if (ftdi->rx_tail >= sizeof(ftdi->rx))
+    {
+        fprintf(stderr, "ftdi_loopback: read buffer overflow.\n");
+        exit(EXIT_FAILURE);
+    }
+    ftdi->rx[ftdi->rx_tail++] = data;
+}
+
+// length of MPSSE command (including opcode) or 0 if not recognized
+static size_t loopback_command_length(uint8_t op)
+{
+    if (op < 0x80)        // data shifting command
+    {
+        return (op & MPSSE_BITMODE) ? 2 : 3;
+    }
+    switch (op)
+    {
+        case SET_BITS_LOW:
+        case SET_BITS_HIGH:
+        case TCK_DIVISOR:
+            return 3;
+        case GET_BITS_LOW:
+        case GET_BITS_HIGH:
+        case SEND_IMMEDIATE:
+        case DIS_DIV_5:
+        case EN_DIV_5:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// process MPSSE command (with header complete)
+static void loopback_command(struct ftdi_context * ftdi, const uint8_t * cmd)
+{
+    uint8_t op = cmd[0];
+    if (op < 0x80)
+    {
+        size_t len = (op & MPSSE_BITMODE) ? 1 : static_cast<size_t>(cmd[1] | (cmd[2] << 8)) + 1;
+        if (op & MPSSE_DO_WRITE)
+        {
+            ftdi->command   = op;
+            ftdi->data_left = len;
+        }
+        else if (op & MPSSE_DO_READ)        // read only (nothing written, so CIPO reads 1s)
+        {
+            while (len--)
+                loopback_rx(ftdi, 0xff);
+        }
+        return;
+    }
+
+    switch (op)
+    {
+        case SET_BITS_LOW:
+            if ((ftdi->gpio & SPI_CS) && !(cmd[1] & SPI_CS))
+            {
+                ftdi_loopback_stats.selects++;
+            }
+            ftdi->gpio = cmd[1];
+            break;
+        case GET_BITS_LOW:
+            loopback_rx(ftdi, ftdi->gpio);
+            break;
+        case GET_BITS_HIGH:
+            loopback_rx(ftdi, 0x00);
+            break;
+        case TCK_DIVISOR:
+            ftdi->divisor               = static_cast<uint16_t>(cmd[1] | (cmd[2] << 8));
+            ftdi_loopback_stats.divisor = ftdi->divisor;
+            break;
+        case DIS_DIV_5:
+            ftdi_loopback_stats.div_5 = false;
+            break;
+        case EN_DIV_5:
+            ftdi_loopback_stats.div_5 = true;
+            break;
+        default:
+            break;
+    }
+}
+
+// parse MPSSE command stream (commands can be split between writes)
+static void loopback_write(struct ftdi_context * ftdi, const uint8_t * buf, size_t size)
+{
+    ftdi_loopback_stats.usb_writes++;
+    ftdi_loopback_stats.usb_bytes += size;
+
+    while (size)
+    {
+        if (ftdi->data_left)        // data bytes for write command
+        {
+            size_t n = ftdi->data_left < size ? ftdi->data_left : size;
+            ftdi_loopback_stats.spi_bytes += n;
+            if (ftdi->gpio & SPI_CS)
+            {
+                ftdi_loopback_stats.spi_deselected += n;
+            }
+            if (ftdi->command & MPSSE_DO_READ)
+            {
+                for (size_t i = 0; i < n; i++)
+                    loopback_rx(ftdi, buf[i]);
+            }
+            ftdi->data_left -= n;
+            buf += n;
+            size -= n;
+            continue;
+        }
+
+        ftdi->pending[ftdi->pending_len++] = *buf++;
+        size--;
+        size_t len = loopback_command_length(ftdi->pending[0]);
+        if (len == 0)        // bad command, MPSSE replies 0xFA and opcode
+        {
+            ftdi_loopback_stats.bad_commands++;
+            loopback_rx(ftdi, 0xfa);
+            loopback_rx(ftdi, ftdi->pending[0]);
+            ftdi->pending_len = 0;
+        }
+        else if (ftdi->pending_len == len)
+        {
+            loopback_command(ftdi, ftdi->pending);
+            ftdi->pending_len = 0;
+        }
+    }
+}
+
+int ftdi_init(struct ftdi_context * ftdi)
+{
+    memset(ftdi, 0, sizeof(*ftdi));
+    return 0;
+}
+
+void ftdi_deinit(struct ftdi_context * ftdi)
+{
+    (void)ftdi;
+}
+
+int ftdi_set_interface(struct ftdi_context * ftdi, enum ftdi_interface interface)
+{
+    (void)ftdi;
+    (void)interface;
+    return 0;
+}
+
+int ftdi_usb_open(struct ftdi_context * ftdi, int vendor, int product)
+{
+    (void)vendor;
+    if (product != FTDI_FT2232H)        // pretend to be iCEBreaker
+    {
+        return -3;
+    }
+    memset(&ftdi_loopback_stats, 0, sizeof(ftdi_loopback_stats));
+    ftdi->opened = true;
+    ftdi->gpio   = SPI_CS;
+    return 0;
+}
+
+int ftdi_usb_close(struct ftdi_context * ftdi)
+{
+    ftdi->opened = false;
+    return 0;
+}
+
+int ftdi_usb_reset(struct ftdi_context * ftdi)
+{
+    ftdi->pending_len = 0;
+    ftdi->data_left   = 0;
+    ftdi->rx_head     = 0;
+    ftdi->rx_tail     = 0;
+    return 0;
+}
+
+int ftdi_usb_get_strings2(struct ftdi_context * ftdi,
+                          struct libusb_device * dev,
+                          char *                 manufacturer,
+                          int                    mnf_len,
+                          char *                 description,
+                          int                    desc_len,
+                          char *                 serial,
+                          int                    serial_len)
+{
+    (void)ftdi;
+    (void)dev;
+    if (manufacturer && mnf_len > 0)
+    {
+        snprintf(manufacturer, mnf_len, "FTDI");
+    }
+    if (description && desc_len > 0)
+    {
+        snprintf(description, desc_len, "Loopback");
+    }
+    if (serial && serial_len > 0)
+    {
+        snprintf(serial, serial_len, "LOOPBACK");
+    }
+    return 0;
+}
+
+struct libusb_device * libusb_get_device(struct libusb_device_handle * dev_handle)
+{
+    (void)dev_handle;
+    return nullptr;
+}
+
+int ftdi_get_latency_timer(struct ftdi_context * ftdi, unsigned char * latency)
+{
+    (void)ftdi;
+    *latency = 16;
+    return 0;
+}
+
+int ftdi_set_latency_timer(struct ftdi_context * ftdi, unsigned char latency)
+{
+    (void)ftdi;
+    (void)latency;
+    return 0;
+}
+
+int ftdi_set_bitmode(struct ftdi_context * ftdi, unsigned char bitmask, unsigned char mode)
+{
+    (void)ftdi;
+    (void)bitmask;
+    (void)mode;
+    return 0;
+}
+
+int ftdi_disable_bitbang(struct ftdi_context * ftdi)
+{
+    (void)ftdi;
+    return 0;
+}
+
+const char * ftdi_get_error_string(struct ftdi_context * ftdi)
+{
+    (void)ftdi;
+    return "loopback error";
+}
+
+int ftdi_write_data(struct ftdi_context * ftdi, const unsigned char * buf, int size)
+{
+    if (!ftdi->opened || size < 0)
+    {
+        return -666;
+    }
+    loopback_write(ftdi, buf, static_cast<size_t>(size));
+    return size;
+}
+
+int ftdi_read_data(struct ftdi_context * ftdi, unsigned char * buf, int size)
+{
+    if (!ftdi->opened || size < 0)
+    {
+        return -666;
+    }
+    size_t n = ftdi->rx_tail - ftdi->rx_head;
+    if (n > static_cast<size_t>(size))
+    {
+        n = static_cast<size_t>(size);
+    }
+    memcpy(buf, ftdi->rx + ftdi->rx_head, n);
+    ftdi->rx_head += n;
+    if (ftdi->rx_head == ftdi->rx_tail)
+    {
+        ftdi->rx_head = 0;
+        ftdi->rx_tail = 0;
+    }
+    return static_cast<int>(n);
+}
+
+// "transfer" happens on submit (in order), done only checks it was submitted once
+struct ftdi_transfer_control * ftdi_write_data_submit(struct ftdi_context * ftdi, unsigned char * buf, int size)
+{
+    if (!ftdi->opened || size < 0)
+    {
+        return nullptr;
+    }
+    struct ftdi_transfer_control * tc = static_cast<struct ftdi_transfer_control *>(malloc(sizeof(*tc)));
+    if (tc == nullptr)
+    {
+        return nullptr;
+    }
+    loopback_write(ftdi, buf, static_cast<size_t>(size));
+    tc->size = size;
+    if (++ftdi_loopback_stats.in_flight > ftdi_loopback_stats.max_in_flight)
+    {
+        ftdi_loopback_stats.max_in_flight = ftdi_loopback_stats.in_flight;
+    }
+    return tc;
+}
+
+int ftdi_transfer_data_done(struct ftdi_transfer_control * tc)
+{
+    int size = tc->size;
+    ftdi_loopback_stats.in_flight--;
+    free(tc);
+    return size;
+}
@@ -0,0 +1,112 @@
+// ftdi_loopback.h - libftdi stand-in for testing FTDI SPI routines without hardware
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// Declares the part of libftdi used by ftdi_spi.cpp (when built with -DFTDI_LOOPBACK).  The "device" parses the
+// MPSSE command stream written to it and loops SPI COPI back to CIPO, so data read is the data written.  It also
+// counts USB writes, SPI bytes and chip selects so a test can check how transfers were batched.
+#if !defined(FTDI_LOOPBACK_H)
+#define FTDI_LOOPBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MPSSE command bits and opcodes (same values as libftdi ftdi.h)
+#define MPSSE_WRITE_NEG 0x01
+#define MPSSE_BITMODE   0x02
+#define MPSSE_READ_NEG  0x04
+#define MPSSE_LSB       0x08
+#define MPSSE_DO_WRITE  0x10
+#define MPSSE_DO_READ   0x20
+#define MPSSE_WRITE_TMS 0x40
+
+#define SET_BITS_LOW   0x80
+#define GET_BITS_LOW   0x81
+#define SET_BITS_HIGH  0x82
+#define GET_BITS_HIGH  0x83
+#define TCK_DIVISOR    0x86
+#define SEND_IMMEDIATE 0x87
+#define DIS_DIV_5      0x8a
+#define EN_DIV_5       0x8b
+
+enum ftdi_interface
+{
+    INTERFACE_ANY = 0,
+    INTERFACE_A   = 1
+};
+
+enum ftdi_mpsse_mode
+{
+    BITMODE_RESET = 0x00,
+    BITMODE_MPSSE = 0x02
+};
+
+struct libusb_device;
+struct libusb_device_handle;
+
+struct ftdi_context
+{
+    struct libusb_device_handle * usb_dev;            // (always nullptr, no libusb)
+    bool                          opened;
+    uint8_t                       pending[8];         // partial MPSSE command header (split between writes)
+    size_t                        pending_len;
+    uint8_t                       command;            // current data command
+    size_t                        data_left;          // data bytes left for current data command
+    uint8_t                       gpio;               // low GPIO bits (SET_BITS_LOW)
+    uint8_t                       rx[1 << 20];        // bytes for ftdi_read_data
+    size_t                        rx_head;
+    size_t                        rx_tail;
+    uint16_t                      divisor;            // TCK_DIVISOR value
+};
+
+struct ftdi_transfer_control
+{
+    int size;
+};
+
+// counts for tests (since last ftdi_usb_open)
+struct ftdi_loopback_stats_t
+{
+    uint64_t usb_writes;            // ftdi_write_data calls plus submitted transfers
+    uint64_t usb_bytes;             // bytes written to device
+    uint64_t spi_bytes;             // data bytes clocked out on SPI
+    uint64_t spi_deselected;        // data bytes clocked out with CS not selected (should be zero)
+    uint64_t selects;               // CS high to low transitions
+    uint64_t bad_commands;          // unrecognized MPSSE commands
+    int      in_flight;             // submitted transfers not yet done
+    int      max_in_flight;         // most transfers submitted at once
+    uint16_t divisor;               // last TCK_DIVISOR value
+    bool     div_5;                 // clock divide by 5 on (EN_DIV_5, DIS_DIV_5)
+};
+extern ftdi_loopback_stats_t ftdi_loopback_stats;
+
+int                            ftdi_init(struct ftdi_context * ftdi);
+void                           ftdi_deinit(struct ftdi_context * ftdi);
+int                            ftdi_set_interface(struct ftdi_context * ftdi, enum ftdi_interface interface);
+int                            ftdi_usb_open(struct ftdi_context * ftdi, int vendor, int product);
+int                            ftdi_usb_close(struct ftdi_context * ftdi);
+int                            ftdi_usb_reset(struct ftdi_context * ftdi);
+int                            ftdi_usb_get_strings2(struct ftdi_context * ftdi,
+                                                     struct libusb_device * dev,
+                                                     char *                 manufacturer,
+                                                     int                    mnf_len,
+                                                     char *                 description,
+                                                     int                    desc_len,
+                                                     char *                 serial,
+                                                     int                    serial_len);
+struct libusb_device *         libusb_get_device(struct libusb_device_handle * dev_handle);
+int                            ftdi_get_latency_timer(struct ftdi_context * ftdi, unsigned char * latency);
+int                            ftdi_set_latency_timer(struct ftdi_context * ftdi, unsigned char latency);
+int                            ftdi_set_bitmode(struct ftdi_context * ftdi, unsigned char bitmask, unsigned char mode);
+int                            ftdi_disable_bitbang(struct ftdi_context * ftdi);
+const char *                   ftdi_get_error_string(struct ftdi_context * ftdi);
+int                            ftdi_write_data(struct ftdi_context * ftdi, const unsigned char * buf, int size);
+int                            ftdi_read_data(struct ftdi_context * ftdi, unsigned char * buf, int size);
+struct ftdi_transfer_control * ftdi_write_data_submit(struct ftdi_context * ftdi, unsigned char * buf, int size);
+int                            ftdi_transfer_data_done(struct ftdi_transfer_control * tc);
+
+#endif        // FTDI_LOOPBACK_H
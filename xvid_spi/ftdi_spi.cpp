@@ -17,132 +17,287 @@
 
 #include "ftdi_spi.h"
 
+#define CMD_BUFFER_SIZE   4096             // MPSSE commands collected before USB write
+#define ASYNC_BUFFER_SIZE (64 * 1024)        // size of each asynchronous write buffer (two used)
+#define MPSSE_MAX_XFER    65536              // maximum bytes per MPSSE data command
+#define MPSSE_CLOCK_HZ    30000000           // MPSSE SCK with divide by 5 off is 60 MHz / ((1 + TCK_DIVISOR) * 2)
+#define FTDI_SPI_HZ       2000000            // default SPI clock (6 MHz is too fast without calibration)
+#define FTDI_SLOW_HZ      50000              // SPI clock for slow_clock (debug)
+
 unsigned int         chunksize;                 // set on open to the maximum size that can be sent/received per call
 static bool          ftdi_device_opened;        // true if device was opened (and should be closed at exit)
 static bool          ftdi_set_device_latency;        // true if latency was set (and should be restored at exit)
 static unsigned char ftdi_original_latency;          // saved original FTDI latency value
 static bool          slow_clock = false;
+static uint32_t      ftdi_spi_hz;                    // SPI clock set
+static char          ftdi_serial[64];                // USB serial number (or device name if none)
 
 static struct ftdi_context ftdi_ctx;        // context for libftdi
 
-static void ftdi_put_byte(uint8_t data);
-static void ftdi_put_word(uint16_t data);
-static void host_spi_cleanup();
+static uint8_t cmd_buffer[CMD_BUFFER_SIZE];        // MPSSE commands not yet written
+static size_t  cmd_len;
 
-// Toggle FTDI ADBUS3 (aka CTS) line used as FPGA SS on iCEBreaker (and UPduino 3.x via TP11)
-// NOTE: cs = false to select (active low)
-void host_spi_cs(bool cs)
+// asynchronous write buffer (submitted to libftdi, then filled again once transfer is done)
+struct async_buffer_t
+{
+    uint8_t                        data[ASYNC_BUFFER_SIZE];
+    size_t                         len;
+    struct ftdi_transfer_control * tc;        // in flight if not nullptr
+};
+static async_buffer_t async_buffers[2];
+static int            async_cur;        // buffer being filled
+
+static void     ftdi_put_byte(uint8_t data);
+static void     ftdi_put_word(uint16_t data);
+static void     ftdi_flush_cmds();
+static int      ftdi_spi_flush();
+static void     ftdi_spi_cleanup();
+static uint32_t ftdi_spi_set_speed(uint32_t hz);
+
+// queue FTDI ADBUS3 (aka CTS) line used as FPGA SS on iCEBreaker (and UPduino 3.x via TP11)
+static void queue_cs(bool cs)
 {
-    uint8_t gpio_pins = 0;
-
-    if (cs)
-    {
-        gpio_pins |= SPI_CS;
-    }
-
     ftdi_put_byte(SET_BITS_LOW);
-    ftdi_put_byte(gpio_pins);
+    ftdi_put_byte(cs ? SPI_CS : 0);
     ftdi_put_byte(SPI_OUTPUTS);
 }
 
+// Toggle FTDI ADBUS3 (aka CTS) line used as FPGA SS on iCEBreaker (and UPduino 3.x via TP11)
+// NOTE: cs = false to select (active low)
+static void ftdi_spi_cs(bool cs)
+{
+    ftdi_spi_flush();
+    queue_cs(cs);
+    ftdi_flush_cmds();
+}
+
 [[noreturn]] static void fatal()
 {
-    host_spi_cs(true);
-    host_spi_cleanup();
+    ftdi_spi_cleanup();
     printf("EXITING!\n");
     exit(EXIT_FAILURE);
 }
 
-// send byte to FTDI device
-static void ftdi_put_byte(uint8_t data)
+// write queued MPSSE commands to FTDI device
+static void ftdi_flush_cmds()
 {
-    int rc = ftdi_write_data(&ftdi_ctx, &data, 1);
-    if (rc != 1)
+    if (cmd_len == 0)
+    {
+        return;
+    }
+    int rc = ftdi_write_data(&ftdi_ctx, cmd_buffer, static_cast<int>(cmd_len));
+    if (rc != static_cast<int>(cmd_len))
     {
-        fprintf(stderr, "ftdi_put_byte: ftdi_write_data failed (rc=%d).\n", rc);
+        fprintf(stderr, "ftdi_flush_cmds: ftdi_write_data failed (rc=%d, expected %zu).\n", rc, cmd_len);
+        cmd_len = 0;
         fatal();
     }
+    cmd_len = 0;
 }
 
-static void ftdi_put_word(uint16_t data)
+// queue byte for FTDI device
+static void ftdi_put_byte(uint8_t data)
 {
-    uint8_t d[2] = {static_cast<uint8_t>(data), static_cast<uint8_t>(data >> 8)};
-    int     rc   = ftdi_write_data(&ftdi_ctx, &d[0], 2);
-    if (rc != 2)
+    if (cmd_len >= sizeof(cmd_buffer))
     {
-        fprintf(stderr, "ftdi_put_word: ftdi_put_word failed (rc=%d).\n", rc);
-        fatal();
+        ftdi_flush_cmds();
     }
+    cmd_buffer[cmd_len++] = data;
 }
 
+static void ftdi_put_word(uint16_t data)
+{
+    ftdi_put_byte(static_cast<uint8_t>(data));
+    ftdi_put_byte(static_cast<uint8_t>(data >> 8));
+}
 
-// receive byte from FTDI device
-static uint8_t ftdi_get_byte()
+// queue bytes for FTDI device (large data written directly)
+static void ftdi_put_bytes(size_t num, const uint8_t * data)
 {
-    uint8_t data = 0x00;
-    while (1)
+    if (cmd_len + num > sizeof(cmd_buffer))
     {
-        int rc = ftdi_read_data(&ftdi_ctx, &data, 1);
+        ftdi_flush_cmds();
+        if (num > sizeof(cmd_buffer))
+        {
+            int rc = ftdi_write_data(&ftdi_ctx, data, static_cast<int>(num));
+            if (rc != static_cast<int>(num))
+            {
+                fprintf(stderr, "ftdi_put_bytes: ftdi_write_data failed (rc=%d, expected %zu).\n", rc, num);
+                fatal();
+            }
+            return;
+        }
+    }
+    memcpy(cmd_buffer + cmd_len, data, num);
+    cmd_len += num;
+}
+
+// receive num bytes from FTDI device
+static void ftdi_get_bytes(size_t num, uint8_t * data)
+{
+    size_t got = 0;
+    while (got < num)
+    {
+        int rc = ftdi_read_data(&ftdi_ctx, data + got, static_cast<int>(num - got));
         if (rc < 0)
         {
-            fprintf(stderr, "ftdi_get_byte: ftdi_read_data failed (rc=%d).\n", rc);
+            fprintf(stderr, "ftdi_get_bytes: ftdi_read_data failed (rc=%d).\n", rc);
             fatal();
         }
-        if (rc == 1)
+        if (rc == 0)
         {
-            break;
+            usleep(100);
         }
-        usleep(100);
+        got += static_cast<size_t>(rc);
     }
-
-    return data;
 }
 
-
-// SPI transfer, reading and writing num bytes from/into inout
-int host_spi_xfer_bytes(size_t num, uint8_t * inout)
+// queue MPSSE read/write commands for num bytes (in MPSSE_MAX_XFER pieces)
+static void queue_xfer(size_t num, const uint8_t * data)
 {
-    if (num < 1)
+    while (num)
     {
-        return -1;
+        size_t len = num < MPSSE_MAX_XFER ? num : MPSSE_MAX_XFER;
+        // read CIPO, write COPI, MSB first, update data on negative clock edge
+        ftdi_put_byte(MPSSE_DO_READ | MPSSE_DO_WRITE /* | MPSSE_LSB */ | MPSSE_WRITE_NEG);
+        ftdi_put_word(static_cast<uint16_t>(len - 1));
+        ftdi_put_bytes(len, data);
+        data += len;
+        num -= len;
     }
+}
 
-    //    host_spi_cs(false);
+// SPI transfer, reading and writing num bytes from/into inout
+static int ftdi_spi_xfer_bytes(size_t num, uint8_t * inout)
+{
+    ftdi_spi_flush();
+    queue_xfer(num, inout);
+    ftdi_put_byte(SEND_IMMEDIATE);
+    ftdi_flush_cmds();
+    ftdi_get_bytes(num, inout);
+
+    return 0;
+}
 
-    // read CIPO, write COPI, LSB first, update data on negative clock edge
-    ftdi_put_byte(MPSSE_DO_READ | MPSSE_DO_WRITE /* | MPSSE_LSB */ | MPSSE_WRITE_NEG);
-    ftdi_put_word(static_cast<uint16_t>(num - 1));
+// SPI transfer with FPGA selected, reading and writing num bytes from/into inout (with one USB write)
+static int ftdi_spi_xfer_select(size_t num, uint8_t * inout)
+{
+    ftdi_spi_flush();
+    queue_cs(false);
+    queue_xfer(num, inout);
+    queue_cs(true);
+    ftdi_put_byte(SEND_IMMEDIATE);
+    ftdi_flush_cmds();
+    ftdi_get_bytes(num, inout);
 
-    int rc = ftdi_write_data(&ftdi_ctx, inout, static_cast<int>(num));
-    if (rc != static_cast<int>(num))
+    return 0;
+}
+
+// wait for asynchronous write buffer to be sent
+static void async_wait(async_buffer_t & ab)
+{
+    if (ab.tc)
     {
-        fprintf(stderr, "host_spi_xfer_bytes: ftdi_write_data failed (c=%d, expected %zu).\n", rc, num);
+        int rc = ftdi_transfer_data_done(ab.tc);
+        ab.tc  = nullptr;
+        if (rc != static_cast<int>(ab.len))
+        {
+            fprintf(stderr, "async_wait: ftdi_transfer_data_done failed (rc=%d, expected %zu).\n", rc, ab.len);
+            fatal();
+        }
+    }
+    ab.len = 0;
+}
+
+// submit current asynchronous write buffer and switch to other buffer (waiting until it has been sent)
+static void async_submit()
+{
+    async_buffer_t & ab = async_buffers[async_cur];
+    if (ab.len == 0)
+    {
+        return;
+    }
+    ab.tc = ftdi_write_data_submit(&ftdi_ctx, ab.data, static_cast<int>(ab.len));
+    if (ab.tc == nullptr)
+    {
+        fprintf(stderr, "async_submit: ftdi_write_data_submit failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
         fatal();
     }
+    async_cur ^= 1;
+    async_wait(async_buffers[async_cur]);
+}
 
-    for (size_t i = 0; i < num; i++)
+// add bytes to asynchronous write buffer (submitting full buffers)
+static void async_put(size_t num, const uint8_t * data)
+{
+    while (num)
     {
-        inout[i] = ftdi_get_byte();
+        async_buffer_t & ab  = async_buffers[async_cur];
+        size_t           len = sizeof(ab.data) - ab.len;
+        if (len > num)
+        {
+            len = num;
+        }
+        memcpy(ab.data + ab.len, data, len);
+        ab.len += len;
+        data += len;
+        num -= len;
+        if (ab.len == sizeof(ab.data))
+        {
+            async_submit();
+        }
     }
+}
+
+// queue SPI write of num bytes with FPGA selected (reply ignored), sent when a buffer fills or on ftdi_spi_flush
+static int ftdi_spi_write_async(size_t num, const uint8_t * data)
+{
+    // MPSSE commands queued with host_spi_cs etc. go first
+    ftdi_flush_cmds();
+
+    static const uint8_t select[3]   = {SET_BITS_LOW, 0, SPI_OUTPUTS};
+    static const uint8_t deselect[3] = {SET_BITS_LOW, SPI_CS, SPI_OUTPUTS};
+    async_put(sizeof(select), select);
+    while (num)
+    {
+        size_t len = num < MPSSE_MAX_XFER ? num : MPSSE_MAX_XFER;
+        // write COPI, MSB first, update data on negative clock edge
+        uint8_t cmd[3] = {MPSSE_DO_WRITE | MPSSE_WRITE_NEG,
+                          static_cast<uint8_t>(len - 1),
+                          static_cast<uint8_t>((len - 1) >> 8)};
+        async_put(sizeof(cmd), cmd);
+        async_put(len, data);
+        data += len;
+        num -= len;
+    }
+    async_put(sizeof(deselect), deselect);
+
+    return 0;
+}
 
-    //    host_spi_cs(true);
+// send any queued asynchronous writes and wait for all to finish
+static int ftdi_spi_flush()
+{
+    async_submit();
+    async_wait(async_buffers[0]);
+    async_wait(async_buffers[1]);
 
     return 0;
 }
 
-int host_spi_open()
+static int ftdi_spi_open()
 {
     int rc = ftdi_init(&ftdi_ctx);
     if (rc != 0)
     {
-        fprintf(stderr, "host_spi_open: ftdi_init failed (rc=%d)\n", rc);
+        fprintf(stderr, "ftdi_spi_open: ftdi_init failed (rc=%d)\n", rc);
         return -1;
     }
 
     rc = ftdi_set_interface(&ftdi_ctx, INTERFACE_A);
     if (rc != 0)
     {
-        fprintf(stderr, "host_spi_open: ftdi_set_interface failed (rc=%d)\n", rc);
+        fprintf(stderr, "ftdi_spi_open: ftdi_set_interface failed (rc=%d)\n", rc);
         return -1;
     }
 
@@ -162,71 +317,70 @@ int host_spi_open()
 
     if (id_num >= 3)
     {
-        fprintf(stderr, "host_spi_open: No FTDI FTx232H USB device found.\n");
+        fprintf(stderr, "ftdi_spi_open: No FTDI FTx232H USB device found.\n");
         return -1;
     }
 
     ftdi_device_opened = true;
 
-    printf("Opened FTDI %s...\n", device_name[id_num]);
+    // USB serial number to tell boards apart (for SPI clock cache)
+    if (ftdi_usb_get_strings2(&ftdi_ctx,
+                              libusb_get_device(ftdi_ctx.usb_dev),
+                              nullptr,
+                              0,
+                              nullptr,
+                              0,
+                              ftdi_serial,
+                              sizeof(ftdi_serial)) < 0 ||
+        ftdi_serial[0] == '\0')
+    {
+        snprintf(ftdi_serial, sizeof(ftdi_serial), "%s", device_name[id_num]);
+    }
+
+    printf("Opened FTDI %s (serial \"%s\")...\n", device_name[id_num], ftdi_serial);
 
     chunksize = device_chunk[id_num];
 
     if (ftdi_usb_reset(&ftdi_ctx))
     {
-        fprintf(stderr, "host_spi_open: ftdi_usb_reset failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
+        fprintf(stderr, "ftdi_spi_open: ftdi_usb_reset failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
         return -1;
     }
 
 #if 0
     if (ftdi_usb_purge_buffers(&ftdi_ctx))
     {
-        fprintf(stderr, "host_spi_open: ftdi_usb_purge_buffers failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
+        fprintf(stderr, "ftdi_spi_open: ftdi_usb_purge_buffers failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
         return -1;
     }
 #endif
 
     if (ftdi_get_latency_timer(&ftdi_ctx, &ftdi_original_latency) < 0)
     {
-        fprintf(stderr, "host_spi_open: ftdi_get_latency_timer failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
+        fprintf(stderr, "ftdi_spi_open: ftdi_get_latency_timer failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
         return -1;
     }
 
     // set 1kHz latency
     if (ftdi_set_latency_timer(&ftdi_ctx, 1) < 0)
     {
-        fprintf(stderr, "host_spi_open: ftdi_set_latency_timer failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
+        fprintf(stderr, "ftdi_spi_open: ftdi_set_latency_timer failed (%s).\n", ftdi_get_error_string(&ftdi_ctx));
         return -1;
     }
 
     ftdi_set_device_latency = true;
 
-    atexit(host_spi_cleanup);
+    atexit(ftdi_spi_cleanup);
 
     // enter MPSSE, mask ignored
     if (ftdi_set_bitmode(&ftdi_ctx, 0x00, BITMODE_MPSSE) < 0)
     {
         fprintf(
-            stderr, "host_spi_open: ftdi_set_bitmode BITMODE_MPSSE failed (%s)\n", ftdi_get_error_string(&ftdi_ctx));
+            stderr, "ftdi_spi_open: ftdi_set_bitmode BITMODE_MPSSE failed (%s)\n", ftdi_get_error_string(&ftdi_ctx));
         fatal();
     }
 
-    if (slow_clock)
-    {
-        // 12 Mhz / (119 + 1 * 2) = 50 kHz (debug)
-        ftdi_put_byte(EN_DIV_5);
-        ftdi_put_byte(TCK_DIVISOR);
-        ftdi_put_word(119);
-    }
-    else        // normal
-    {
-
-
-        ftdi_put_byte(EN_DIV_5);
-        ftdi_put_byte(TCK_DIVISOR);
-        // ftdi_put_word(0x0);        // 12 Mhz / (0 + 1 * 2) = 6 MHz (too fast!)
-        ftdi_put_word(0x2);        // 12 Mhz / (2 + 1 * 2) = 2 MHz
-    }
+    ftdi_spi_set_speed(slow_clock ? FTDI_SLOW_HZ : FTDI_SPI_HZ);
 
     sleep(1);
 
@@ -237,24 +391,62 @@ int host_spi_open()
         rc = ftdi_read_data(&ftdi_ctx, &dummy_data, 1);
     } while (rc == 1);
 
-    printf("Success.\n");
+    printf("Success (%.3f MHz SPI clock).\n", ftdi_spi_hz / 1000000.0);
 
     return 0;
 }
 
-int host_spi_close()
+// set SPI clock to hz or next slower MPSSE clock (0 returns clock without setting it)
+static uint32_t ftdi_spi_set_speed(uint32_t hz)
 {
-    host_spi_cs(true);
-    host_spi_cleanup();
+    if (hz == 0)
+    {
+        return ftdi_spi_hz;
+    }
+    uint32_t divisor = (MPSSE_CLOCK_HZ + hz - 1) / hz - 1;
+    if (divisor > 0xffff)
+    {
+        divisor = 0xffff;
+    }
+    ftdi_spi_flush();
+    ftdi_put_byte(DIS_DIV_5);
+    ftdi_put_byte(TCK_DIVISOR);
+    ftdi_put_word(static_cast<uint16_t>(divisor));
+    ftdi_flush_cmds();
+    ftdi_spi_hz = MPSSE_CLOCK_HZ / (divisor + 1);
+
+    return ftdi_spi_hz;
+}
+
+static const char * ftdi_spi_device_id()
+{
+    return ftdi_serial;
+}
+
+static int ftdi_spi_close()
+{
+    ftdi_spi_cs(true);
+    ftdi_spi_cleanup();
 
     return 0;
 }
 
-static void host_spi_cleanup()
+static void ftdi_spi_cleanup()
 {
     if (ftdi_device_opened)
     {
-        host_spi_cs(true);
+        // finish any writes in flight and de-select (ignoring errors, this may be after a fatal error)
+        for (auto & ab : async_buffers)
+        {
+            if (ab.tc)
+            {
+                ftdi_transfer_data_done(ab.tc);
+                ab.tc = nullptr;
+            }
+            ab.len = 0;
+        }
+        static const uint8_t deselect[3] = {SET_BITS_LOW, SPI_CS, SPI_OUTPUTS};
+        ftdi_write_data(&ftdi_ctx, deselect, sizeof(deselect));
 
         if (ftdi_set_device_latency)
         {
@@ -267,3 +459,16 @@ static void host_spi_cleanup()
         ftdi_device_opened = false;
     }
 }
+
+const host_spi_transport_t ftdi_spi_transport = {"ftdi",
+                                                 "FTDI FT2232H/FT232H MPSSE SPI (iCEBreaker or UPduino)",
+                                                 ftdi_spi_open,
+                                                 ftdi_spi_close,
+                                                 ftdi_spi_cs,
+                                                 ftdi_spi_xfer_bytes,
+                                                 ftdi_spi_xfer_select,
+                                                 ftdi_spi_write_async,
+                                                 ftdi_spi_flush,
+                                                 nullptr,
+                                                 ftdi_spi_set_speed,
+                                                 ftdi_spi_device_id};
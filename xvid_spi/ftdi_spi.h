@@ -5,12 +5,19 @@
 // Copyright (c) 2020 Xark - https://hackaday.io/Xark
 //
 // See top-level LICENSE file for license information. (Hint: MIT)
-#if !defined(HOST_SPI_H)
-#define HOST_SPI_H
+#if !defined(FTDI_SPI_H)
+#define FTDI_SPI_H
 
+#if defined(FTDI_LOOPBACK)
+#include "ftdi_loopback.h"        // libftdi stand-in (for testing without hardware)
+#else
 #include <ftdi.h>
+#endif
+#include <stddef.h>
 #include <stdint.h>
 
+#include "spi_transport.h"
+
 // Thanks to https://github.com/YosysHQ/icestorm/tree/master/iceprog
 // for a great example of FPGA FTDI code.
 
@@ -47,10 +54,10 @@
 #define FTDI_FT2232H 0x6010        // FT2232H Hi-Speed Dual USB UART/FIFO
 #define FTDI_FT4232H 0x6011        // FT4232H Hi-Speed Quad USB UART
 
-extern unsigned int chunksize;                   // set on open to the maximum size that can be sent/received per call
-int                 host_spi_open();             // open FTDI device for FPGA SPI I/O
-int                 host_spi_close();            // close FTDI device
-void                host_spi_cs(bool cs);        // cs = false to select FPGA peripheral
-int                 host_spi_xfer_bytes(size_t num, uint8_t * buffer);        // send and receive num bytes over SPI
+// NOTE: MPSSE commands are collected and sent with as few USB writes as possible.  Transfers that need the reply
+//       are sent and read back before returning.  host_spi_write_async transfers are queued in two buffers that
+//       are submitted to libftdi asynchronously, so one buffer is filled while the other is sent over USB.
+
+extern unsigned int chunksize;        // set on open to the maximum size that can be sent/received per call
 
-#endif        // HOST_SPI_H
+#endif        // FTDI_SPI_H
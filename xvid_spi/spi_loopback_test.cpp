@@ -0,0 +1,97 @@
+// spi_loopback_test.cpp - test FTDI SPI routines with loopback stand-in for FTDI device (see ftdi_loopback.h)
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// Checks replies read back, that select/transfer/de-select is one USB write, that queued writes keep two buffers
+// in flight with every byte sent while selected, and reports the sustained write rate (of the host side only,
+// since the loopback "device" is as fast as memory).  Also checks SPI clock divisors and lowering clock on errors.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftdi_spi.h"
+
+static uint8_t buffer[256 * 1024];
+static uint8_t pattern[256 * 1024];
+static int     failures;
+
+static void check(bool ok, const char * what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+int main()
+{
+    if (host_spi_open() < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < sizeof(pattern); i++)
+    {
+        pattern[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+    }
+
+    // transfer with reply (including more than one MPSSE command)
+    ftdi_loopback_stats_t before = ftdi_loopback_stats;
+    memcpy(buffer, pattern, 1024);
+    host_spi_xfer_select(1024, buffer);
+    check(memcmp(buffer, pattern, 1024) == 0, "host_spi_xfer_select 1024 bytes read back");
+    check(ftdi_loopback_stats.usb_writes - before.usb_writes == 1, "host_spi_xfer_select is one USB write");
+    check(ftdi_loopback_stats.selects - before.selects == 1, "host_spi_xfer_select selects once");
+
+    memcpy(buffer, pattern, sizeof(buffer));
+    host_spi_xfer_select(sizeof(buffer), buffer);
+    check(memcmp(buffer, pattern, sizeof(buffer)) == 0, "host_spi_xfer_select 256KB read back");
+
+    // queued writes (like 2 byte xvid_spi commands queued into 1024 byte transfers)
+    const size_t total = 64 * 1024 * 1024;
+    before             = ftdi_loopback_stats;
+    for (size_t sent = 0; sent < total; sent += 1024)
+    {
+        host_spi_write_async(1024, pattern + (sent & (sizeof(pattern) - 1)));
+    }
+    uint64_t bytes = 0;
+    double   rate  = host_spi_write_rate(&bytes);
+    check(bytes == total && ftdi_loopback_stats.spi_bytes - before.spi_bytes == total, "queued writes all sent");
+    check(ftdi_loopback_stats.selects - before.selects == total / 1024, "queued writes each selected");
+    check(ftdi_loopback_stats.spi_deselected == 0, "no SPI data sent while de-selected");
+    check(ftdi_loopback_stats.max_in_flight == 2 && ftdi_loopback_stats.in_flight == 0, "two buffers in flight");
+    check(ftdi_loopback_stats.bad_commands == 0, "no bad MPSSE commands");
+    printf("Queued writes: %llu bytes in %llu USB writes, %.2f MB/s sustained (loopback)\n",
+           static_cast<unsigned long long>(bytes),
+           static_cast<unsigned long long>(ftdi_loopback_stats.usb_writes - before.usb_writes),
+           rate);
+
+    // reply after queued writes is read in order
+    host_spi_write_async(16, pattern);
+    memcpy(buffer, pattern + 100, 64);
+    host_spi_xfer_select(64, buffer);
+    check(memcmp(buffer, pattern + 100, 64) == 0, "reply after queued writes read back");
+
+    // SPI clock setting and lowering clock after link errors
+    check(host_spi_speed() == 2000000 && ftdi_loopback_stats.divisor == 14 && !ftdi_loopback_stats.div_5,
+          "default 2 MHz SPI clock");
+    check(host_spi_set_speed(4000000) == 3750000 && ftdi_loopback_stats.divisor == 7, "4 MHz rounds down to 3.75 MHz");
+    check(strcmp(host_spi_transport()->device_id(), "LOOPBACK") == 0, "device_id is USB serial");
+    host_spi_link_errors(HOST_SPI_ERROR_LIMIT - 1);
+    check(host_spi_speed() == 3750000, "link errors under limit keep clock");
+    host_spi_link_errors(1);
+    check(host_spi_speed() == 3000000 && host_spi_stats.speed_drops == 1, "link errors at limit lower clock");
+
+    host_spi_close();
+
+    printf("%s\n", failures ? "FAILED!" : "All tests passed.");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
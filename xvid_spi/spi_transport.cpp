@@ -0,0 +1,506 @@
+// spi_transport.cpp - host SPI routines calling selected transport (see spi_transport.h)
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "spi_transport.h"
+
+const host_spi_transport_t * const host_spi_transports[] = {
+#if !defined(HOST_SPI_NO_FTDI)
+    &ftdi_spi_transport,
+#endif
+#if defined(HOST_SPI_EMU)
+    &emu_spi_transport,
+#endif
+#if defined(HOST_SPI_VSIM)
+    &vsim_spi_transport,
+#endif
+    nullptr};
+
+// SPI clocks tried by host_spi_calibrate and used when lowering clock after link errors (fastest first)
+const uint32_t host_spi_speeds[] = {15000000,
+                                    10000000,
+                                    7500000,
+                                    6000000,
+                                    5000000,
+                                    4000000,
+                                    3000000,
+                                    2500000,
+                                    2000000,
+                                    1500000,
+                                    1000000,
+                                    0};
+
+#define CALIBRATE_PASSES   8                        // read-back checks with no errors needed to use a clock
+#define CLOCK_CACHE_FILE   ".xvid_spi_clock"        // in $HOME (unless $XVID_SPI_CLOCK_CACHE set)
+#define CLOCK_CACHE_MAX    32                       // devices remembered in clock cache file
+#define CLOCK_CACHE_ID_LEN 96                       // max length of "<transport>:<device_id>" key
+
+host_spi_stats_t host_spi_stats;
+
+static const host_spi_transport_t * spi;                         // opened transport
+static uint64_t                     write_rate_bytes;            // bytes queued since last host_spi_write_rate
+static double                       write_start_time = -1.0;        // time of first queued write since then
+static unsigned int                 speed_errors;                // link errors at current SPI clock
+static bool                         calibrating;                 // true during host_spi_calibrate (no clock drops)
+static bool                         calibrated;                  // true if clock is cached (update on clock drop)
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int host_spi_open(const char * name)
+{
+    const host_spi_transport_t * t = nullptr;
+    for (int i = 0; host_spi_transports[i] != nullptr; i++)
+    {
+        if (name == nullptr || strcmp(name, host_spi_transports[i]->name) == 0)
+        {
+            t = host_spi_transports[i];
+            break;
+        }
+    }
+    if (t == nullptr)
+    {
+        fprintf(stderr, "host_spi_open: No SPI transport \"%s\" (have:", name ? name : "");
+        for (int i = 0; host_spi_transports[i] != nullptr; i++)
+        {
+            fprintf(stderr, " %s", host_spi_transports[i]->name);
+        }
+        fprintf(stderr, ").\n");
+        return -1;
+    }
+
+    memset(&host_spi_stats, 0, sizeof(host_spi_stats));
+    write_rate_bytes = 0;
+    write_start_time = -1.0;
+    speed_errors     = 0;
+    calibrating      = false;
+    calibrated       = false;
+
+    if (t->open() < 0)
+    {
+        return -1;
+    }
+    spi = t;
+
+    return 0;
+}
+
+int host_spi_close()
+{
+    if (spi == nullptr)
+    {
+        return -1;
+    }
+    int rc = spi->close();
+    spi    = nullptr;
+
+    return rc;
+}
+
+const host_spi_transport_t * host_spi_transport()
+{
+    return spi;
+}
+
+// NOTE: cs = false to select (active low)
+void host_spi_cs(bool cs)
+{
+    if (!cs)
+    {
+        host_spi_stats.selects++;
+    }
+    spi->cs(cs);
+}
+
+// SPI transfer, reading and writing num bytes from/into inout
+int host_spi_xfer_bytes(size_t num, uint8_t * inout)
+{
+    if (num < 1)
+    {
+        return -1;
+    }
+    host_spi_stats.xfers++;
+    host_spi_stats.xfer_bytes += num;
+
+    return spi->xfer_bytes(num, inout);
+}
+
+// SPI transfer with FPGA selected, reading and writing num bytes from/into inout
+int host_spi_xfer_select(size_t num, uint8_t * inout)
+{
+    if (num < 1)
+    {
+        return -1;
+    }
+    host_spi_stats.xfers++;
+    host_spi_stats.xfer_bytes += num;
+    host_spi_stats.selects++;
+
+    if (spi->xfer_select)
+    {
+        return spi->xfer_select(num, inout);
+    }
+    host_spi_flush();
+    spi->cs(false);
+    int rc = spi->xfer_bytes(num, inout);
+    spi->cs(true);
+
+    return rc;
+}
+
+// queue SPI write of num bytes with FPGA selected (reply ignored)
+int host_spi_write_async(size_t num, const uint8_t * data)
+{
+    if (num < 1)
+    {
+        return -1;
+    }
+    host_spi_stats.writes++;
+    host_spi_stats.write_bytes += num;
+    host_spi_stats.selects++;
+    if (write_start_time < 0.0)
+    {
+        write_start_time = now_seconds();
+    }
+    write_rate_bytes += num;
+
+    if (spi->write_async)
+    {
+        return spi->write_async(num, data);
+    }
+
+    // no queue, so send now (reply discarded)
+    static uint8_t discard[4096];
+    spi->cs(false);
+    while (num)
+    {
+        size_t len = num < sizeof(discard) ? num : sizeof(discard);
+        memcpy(discard, data, len);
+        spi->xfer_bytes(len, discard);
+        data += len;
+        num -= len;
+    }
+    spi->cs(true);
+
+    return 0;
+}
+
+// wait for any queued writes to finish
+int host_spi_flush()
+{
+    return spi->flush ? spi->flush() : 0;
+}
+
+// sustained MB/s of queued writes since last call (from first write until all have been sent)
+double host_spi_write_rate(uint64_t * bytes)
+{
+    host_spi_flush();
+
+    double rate = 0.0;
+    double now  = now_seconds();
+    if (write_start_time >= 0.0 && now > write_start_time)
+    {
+        rate = (write_rate_bytes / (1024.0 * 1024.0)) / (now - write_start_time);
+    }
+    if (bytes)
+    {
+        *bytes = write_rate_bytes;
+    }
+    write_rate_bytes = 0;
+    write_start_time = -1.0;
+
+    return rate;
+}
+
+// delay ms milliseconds (simulated transports advance simulated time instead)
+void host_spi_delay_ms(int ms)
+{
+    if (spi && spi->delay_ms)
+    {
+        spi->delay_ms(ms);
+    }
+    else
+    {
+        usleep(ms * 1000);
+    }
+}
+
+// current SPI clock (0 if transport has no clock setting)
+uint32_t host_spi_speed()
+{
+    return (spi && spi->set_speed) ? spi->set_speed(0) : 0;
+}
+
+// set SPI clock to hz (or next slower the transport can do), returns clock set
+uint32_t host_spi_set_speed(uint32_t hz)
+{
+    if (spi == nullptr || spi->set_speed == nullptr || hz == 0)
+    {
+        return host_spi_speed();
+    }
+    host_spi_flush();
+    speed_errors = 0;
+
+    return spi->set_speed(hz);
+}
+
+// clock cache file name ($XVID_SPI_CLOCK_CACHE or $HOME/.xvid_spi_clock)
+static bool clock_cache_name(char * name, size_t len)
+{
+    const char * env = getenv("XVID_SPI_CLOCK_CACHE");
+    if (env && *env)
+    {
+        snprintf(name, len, "%s", env);
+        return true;
+    }
+    const char * home = getenv("HOME");
+    if (home == nullptr || *home == '\0')
+    {
+        return false;
+    }
+    snprintf(name, len, "%s/%s", home, CLOCK_CACHE_FILE);
+
+    return true;
+}
+
+// cache key for opened transport device (false if transport has no device_id)
+static bool clock_cache_key(char * key, size_t len)
+{
+    if (spi == nullptr || spi->device_id == nullptr)
+    {
+        return false;
+    }
+    const char * id = spi->device_id();
+    if (id == nullptr || *id == '\0')
+    {
+        return false;
+    }
+    snprintf(key, len, "%s:%s", spi->name, id);
+    for (char * c = key; *c; c++)        // keep one word per line
+    {
+        if (*c == ' ' || *c == '\t' || *c == '\n')
+        {
+            *c = '_';
+        }
+    }
+
+    return true;
+}
+
+// read clock cache file lines "<key> <hz>", returns number of entries
+static int clock_cache_read(char (*keys)[CLOCK_CACHE_ID_LEN], uint32_t * speeds)
+{
+    char name[1024];
+    if (!clock_cache_name(name, sizeof(name)))
+    {
+        return 0;
+    }
+    FILE * file = fopen(name, "r");
+    if (file == nullptr)
+    {
+        return 0;
+    }
+    int           num = 0;
+    char          line[256];
+    char          key[CLOCK_CACHE_ID_LEN];
+    unsigned long hz;
+    while (num < CLOCK_CACHE_MAX && fgets(line, sizeof(line), file))
+    {
+        if (sscanf(line, "%95s %lu", key, &hz) == 2 && hz != 0)
+        {
+            snprintf(keys[num], CLOCK_CACHE_ID_LEN, "%s", key);
+            speeds[num++] = static_cast<uint32_t>(hz);
+        }
+    }
+    fclose(file);
+
+    return num;
+}
+
+// cached SPI clock for opened transport device (0 if none)
+static uint32_t clock_cache_lookup()
+{
+    char     keys[CLOCK_CACHE_MAX][CLOCK_CACHE_ID_LEN];
+    uint32_t speeds[CLOCK_CACHE_MAX];
+    char     key[CLOCK_CACHE_ID_LEN];
+    if (!clock_cache_key(key, sizeof(key)))
+    {
+        return 0;
+    }
+    int num = clock_cache_read(keys, speeds);
+    for (int i = 0; i < num; i++)
+    {
+        if (strcmp(keys[i], key) == 0)
+        {
+            return speeds[i];
+        }
+    }
+
+    return 0;
+}
+
+// remember SPI clock for opened transport device (replacing any previous entry)
+static void clock_cache_save(uint32_t hz)
+{
+    char     keys[CLOCK_CACHE_MAX][CLOCK_CACHE_ID_LEN];
+    uint32_t speeds[CLOCK_CACHE_MAX];
+    char     key[CLOCK_CACHE_ID_LEN];
+    char     name[1024];
+    if (!clock_cache_key(key, sizeof(key)) || !clock_cache_name(name, sizeof(name)))
+    {
+        return;
+    }
+    int num = clock_cache_read(keys, speeds);
+    int i   = 0;
+    while (i < num && strcmp(keys[i], key) != 0)
+    {
+        i++;
+    }
+    if (i == num)
+    {
+        if (num == CLOCK_CACHE_MAX)        // full, forget oldest
+        {
+            memmove(keys[0], keys[1], sizeof(keys[0]) * (CLOCK_CACHE_MAX - 1));
+            memmove(&speeds[0], &speeds[1], sizeof(speeds[0]) * (CLOCK_CACHE_MAX - 1));
+            num--;
+        }
+        i = num++;
+        snprintf(keys[i], CLOCK_CACHE_ID_LEN, "%s", key);
+    }
+    speeds[i] = hz;
+
+    FILE * file = fopen(name, "w");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "host_spi_calibrate: Can't write SPI clock cache \"%s\".\n", name);
+        return;
+    }
+    for (i = 0; i < num; i++)
+    {
+        fprintf(file, "%s %lu\n", keys[i], static_cast<unsigned long>(speeds[i]));
+    }
+    fclose(file);
+}
+
+// run verify passes times, returns true if no errors
+static bool calibrate_check(host_spi_verify_fn verify, int passes)
+{
+    for (int i = 0; i < passes; i++)
+    {
+        if (verify() != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Use cached SPI clock for this device (after a quick check) or, if sweep (or cached clock failed), try clocks
+// from host_spi_speeds fastest first and use (and cache) the fastest with no read-back errors.  Returns clock
+// used, or 0 if transport has no clock setting or no clock tried passed (clock is then left as it was).
+uint32_t host_spi_calibrate(host_spi_verify_fn verify, bool sweep)
+{
+    if (spi == nullptr || spi->set_speed == nullptr)
+    {
+        return 0;
+    }
+
+    uint32_t original = host_spi_speed();
+    uint32_t hz       = 0;
+    calibrating       = true;
+    if (!sweep)
+    {
+        uint32_t cached = clock_cache_lookup();
+        if (cached == 0)
+        {
+            calibrating = false;
+            return 0;
+        }
+        hz = host_spi_set_speed(cached);
+        if (calibrate_check(verify, 1))
+        {
+            printf("Using cached SPI clock %.3f MHz.\n", hz / 1000000.0);
+            calibrating = false;
+            calibrated  = true;
+            return hz;
+        }
+        printf("Cached SPI clock %.3f MHz failed check, calibrating...\n", hz / 1000000.0);
+    }
+
+    uint32_t tried = 0;
+    hz             = 0;
+    for (int i = 0; host_spi_speeds[i] != 0; i++)
+    {
+        uint32_t try_hz = host_spi_set_speed(host_spi_speeds[i]);
+        if (try_hz == tried)        // same clock as last (transport rounded down)
+        {
+            continue;
+        }
+        tried   = try_hz;
+        bool ok = calibrate_check(verify, CALIBRATE_PASSES);
+        printf("  SPI clock %7.3f MHz: %s\n", try_hz / 1000000.0, ok ? "okay" : "errors");
+        if (ok)
+        {
+            hz = try_hz;
+            break;
+        }
+    }
+    calibrating = false;
+
+    if (hz == 0)
+    {
+        host_spi_set_speed(original);
+        printf("SPI clock calibration FAILED (using %.3f MHz).\n", original / 1000000.0);
+        return 0;
+    }
+    printf("SPI clock calibrated to %.3f MHz.\n", hz / 1000000.0);
+    clock_cache_save(hz);
+    calibrated = true;
+
+    return hz;
+}
+
+// count link errors (e.g., bad command byte replies) and lower SPI clock after HOST_SPI_ERROR_LIMIT at one clock
+void host_spi_link_errors(unsigned int num)
+{
+    host_spi_stats.link_errors += num;
+    speed_errors += num;
+    if (calibrating || speed_errors < HOST_SPI_ERROR_LIMIT || spi == nullptr || spi->set_speed == nullptr)
+    {
+        return;
+    }
+
+    uint32_t hz = host_spi_speed();
+    for (int i = 0; host_spi_speeds[i] != 0; i++)
+    {
+        if (host_spi_speeds[i] < hz)
+        {
+            uint32_t new_hz = host_spi_set_speed(host_spi_speeds[i]);
+            host_spi_stats.speed_drops++;
+            printf("SPI link errors at %.3f MHz, lowering clock to %.3f MHz.\n", hz / 1000000.0, new_hz / 1000000.0);
+            if (calibrated)
+            {
+                clock_cache_save(new_hz);
+            }
+            return;
+        }
+    }
+    speed_errors = 0;        // already slowest
+}
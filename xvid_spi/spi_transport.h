@@ -0,0 +1,89 @@
+// spi_transport.h - host SPI routines with pluggable transport (FTDI hardware, software Xosera or Verilated Xosera)
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// The host_spi_* routines used by xvid_spi call the transport selected with host_spi_open.  Transports built in:
+//
+//  "ftdi"  FTDI FT2232H/FT232H MPSSE SPI to a real Xosera (ftdi_spi.cpp, unless built with HOST_SPI_NO_FTDI)
+//  "emu"   software Xosera target (emu_spi.cpp), decodes the SPI command/data bytes like the iCEBreaker
+//          SPI_INTERFACE and drives the functional emulator in xosera_emu (built with HOST_SPI_EMU)
+//  "vsim"  Verilated iCEBreaker top (spi_target.sv and xosera_main) driven bit by bit (vsim_spi.cpp, built with
+//          HOST_SPI_VSIM by "make vxvid_spi" in rtl, see sim.mk)
+//
+// A transport only needs open, close, cs and xfer_bytes, the others can be nullptr and are done with those.
+//
+// SPI clock calibration (for transports with set_speed): host_spi_calibrate tries the clocks in host_spi_speeds
+// fastest first, using a caller supplied read-back check, and keeps the fastest that had no errors.  The clock found
+// is cached per device_id in the file named by $XVID_SPI_CLOCK_CACHE (default "$HOME/.xvid_spi_clock") and used on
+// the next open after a quick check.  Link errors reported with host_spi_link_errors (e.g., command byte replies
+// that were not 0xCB) are counted, and after HOST_SPI_ERROR_LIMIT at one clock the next slower clock is used.
+#if !defined(SPI_TRANSPORT_H)
+#define SPI_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct host_spi_transport_t
+{
+    const char * name;                                          // name for host_spi_open (and xvid_spi -t option)
+    const char * description;                                   // shown in transport list
+    int (*open)();                                              // open transport (returns < 0 on error)
+    int (*close)();                                             // close transport
+    void (*cs)(bool cs);                                        // cs = false to select FPGA peripheral
+    int (*xfer_bytes)(size_t num, uint8_t * inout);             // send and receive num bytes
+    int (*xfer_select)(size_t num, uint8_t * inout);            // select, transfer, de-select (or nullptr)
+    int (*write_async)(size_t num, const uint8_t * data);       // queue select, write, de-select (or nullptr)
+    int (*flush)();                                             // wait until queued writes have been sent (or nullptr)
+    void (*delay_ms)(int ms);                                   // wait ms (nullptr to sleep, simulated advance time)
+    uint32_t (*set_speed)(uint32_t hz);                         // set SPI clock hz or next slower (0 gets, or nullptr)
+    const char * (*device_id)();                                // unique device name for clock cache (or nullptr)
+};
+
+// transfer counts since host_spi_open (for profiling SPI protocol overhead)
+struct host_spi_stats_t
+{
+    uint64_t xfers;               // transfers waiting for reply (host_spi_xfer_bytes and host_spi_xfer_select)
+    uint64_t xfer_bytes;          // bytes sent with reply
+    uint64_t writes;              // queued writes (host_spi_write_async)
+    uint64_t write_bytes;         // bytes sent without reply
+    uint64_t selects;             // times FPGA was selected
+    uint64_t link_errors;         // errors reported with host_spi_link_errors
+    uint64_t speed_drops;         // times SPI clock was lowered because of link errors
+};
+extern host_spi_stats_t host_spi_stats;
+
+#define HOST_SPI_ERROR_LIMIT 4        // link errors at one SPI clock before the next slower clock is used
+
+typedef int (*host_spi_verify_fn)();        // read-back check for host_spi_calibrate (returns errors)
+
+extern const host_spi_transport_t * const host_spi_transports[];        // built in transports (nullptr ends)
+extern const host_spi_transport_t         ftdi_spi_transport;            // "ftdi" (ftdi_spi.cpp)
+extern const host_spi_transport_t         emu_spi_transport;             // "emu" (emu_spi.cpp)
+extern const host_spi_transport_t         vsim_spi_transport;            // "vsim" (vsim_spi.cpp)
+extern const uint32_t                     host_spi_speeds[];             // clocks tried by calibration (0 ends)
+
+#if defined(HOST_SPI_EMU)
+struct XoseraDump;
+bool emu_spi_save_dump(XoseraDump & dump);        // "emu" transport emulator memory (false if not open)
+#endif
+
+int      host_spi_open(const char * name = nullptr);                   // open transport (nullptr for first built in)
+int      host_spi_close();                                             // close transport
+const host_spi_transport_t * host_spi_transport();                     // transport opened (or nullptr)
+void     host_spi_cs(bool cs);                                         // cs = false to select FPGA peripheral
+int      host_spi_xfer_bytes(size_t num, uint8_t * buffer);            // send and receive num bytes over SPI
+int      host_spi_xfer_select(size_t num, uint8_t * buffer);           // select, transfer num bytes, de-select
+int      host_spi_write_async(size_t num, const uint8_t * buffer);     // select, write, de-select queued
+int      host_spi_flush();                                             // wait until queued writes have been sent
+double   host_spi_write_rate(uint64_t * bytes);                        // MB/s of queued writes since last call
+void     host_spi_delay_ms(int ms);                                    // delay (in transport time)
+uint32_t host_spi_speed();                                             // SPI clock hz (0 if unknown)
+uint32_t host_spi_set_speed(uint32_t hz);                              // set SPI clock hz or next slower, returns hz
+uint32_t host_spi_calibrate(host_spi_verify_fn verify, bool sweep);    // cached or (sweep) fastest reliable clock hz
+void     host_spi_link_errors(unsigned int num);                       // count errors (lowers clock after limit)
+
+#endif        // SPI_TRANSPORT_H
@@ -0,0 +1,146 @@
+// vsim_spi.cpp - Verilated Xosera SPI target transport (see spi_transport.h)
+//
+// vim: set et ts=4 sw=4
+//
+// Copyright (c) 2020 Xark - https://hackaday.io/Xark
+//
+// See top-level LICENSE file for license information. (Hint: MIT)
+//
+// Drives the SPI pins of the Verilated iCEBreaker top (xosera_iceb.sv built with SPI_INTERFACE, so spi_target.sv
+// and the SPI command/data byte decoding in front of xosera_main) one bit at a time, like the FTDI MPSSE does:
+// COPI changes on SCK falling edge and CIPO is sampled before SCK rises, MSB first.  Built into xvid_spi with
+// "make vxvid_spi" in rtl (see sim.mk), which also compiles xvid_spi.cpp and spi_transport.cpp.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "verilated.h"
+
+#include "Vxosera_iceb.h"
+
+#include "../rtl/sim/video_mode_defs.h"
+#include "spi_transport.h"
+
+#define VSIM_SPI_HALF_CLOCKS 6         // default pixel clocks per SPI clock half period (~2 MHz SPI at 25 MHz)
+#define VSIM_CS_CLOCKS       4         // pixel clocks for CS change (spi_target input synchronizer)
+#define VSIM_RESET_CLOCKS    16        // pixel clocks with reset button held at open
+
+vluint64_t main_time;        // current simulation time (64-bit unsigned)
+
+double sc_time_stamp()
+{
+    return main_time;
+}
+
+static Vxosera_iceb * top;
+static uint64_t       half_clocks = VSIM_SPI_HALF_CLOCKS;        // pixel clocks per SPI clock half period
+
+static void vsim_clocks(uint64_t clocks)
+{
+    while (clocks--)
+    {
+        top->CLK = 1;        // clock rising
+        top->eval();
+        main_time++;
+        top->CLK = 0;        // clock falling
+        top->eval();
+        main_time++;
+    }
+}
+
+static int vsim_spi_open()
+{
+    top         = new Vxosera_iceb;
+    half_clocks = VSIM_SPI_HALF_CLOCKS;
+
+    top->LEDR_N    = 1;        // FPGA SPI de-selected
+    top->FLASH_SCK = 0;
+    top->FLASH_IO0 = 0;
+    top->RX        = 1;
+    top->BTN_N     = 0;        // reset button held
+    vsim_clocks(VSIM_RESET_CLOCKS);
+    top->BTN_N = 1;
+    vsim_clocks(VSIM_RESET_CLOCKS);
+
+    printf("Opened Verilated Xosera iCEBreaker SPI (%.3f MHz SPI clock)...\n", PIXEL_CLOCK_MHZ / (half_clocks * 2));
+
+    return 0;
+}
+
+static int vsim_spi_close()
+{
+    top->final();
+    delete top;
+    top = nullptr;
+
+    return 0;
+}
+
+static void vsim_spi_cs(bool cs)
+{
+    top->LEDR_N = cs ? 1 : 0;
+    vsim_clocks(VSIM_CS_CLOCKS);
+}
+
+static int vsim_spi_xfer_bytes(size_t num, uint8_t * inout)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        uint8_t out   = inout[i];
+        uint8_t reply = 0;
+        for (int bit = 7; bit >= 0; bit--)
+        {
+            top->FLASH_IO0 = (out >> bit) & 1;        // COPI set with SCK low
+            vsim_clocks(half_clocks);
+            reply          = static_cast<uint8_t>((reply << 1) | (top->FLASH_IO1 & 1));        // CIPO
+            top->FLASH_SCK = 1;
+            vsim_clocks(half_clocks);
+            top->FLASH_SCK = 0;
+        }
+        inout[i] = reply;
+    }
+    vsim_clocks(half_clocks);        // last SCK falling edge
+
+    return 0;
+}
+
+// set SPI clock to hz or next slower (whole pixel clocks per half period, 0 returns clock without setting it)
+static uint32_t vsim_spi_set_speed(uint32_t hz)
+{
+    if (hz != 0)
+    {
+        half_clocks = static_cast<uint64_t>(ceil(PIXEL_CLOCK_MHZ * 1000000.0 / (2.0 * hz)));
+        if (half_clocks < 1)
+        {
+            half_clocks = 1;
+        }
+    }
+
+    return static_cast<uint32_t>(PIXEL_CLOCK_MHZ * 1000000.0 / (2.0 * half_clocks));
+}
+
+static const char * vsim_spi_device_id()
+{
+    return "Vxosera_iceb";
+}
+
+static void vsim_spi_delay_ms(int ms)
+{
+    vsim_clocks(static_cast<uint64_t>(PIXEL_CLOCK_MHZ * 1000.0 * ms));
+}
+
+const host_spi_transport_t vsim_spi_transport = {"vsim",
+                                                 "Verilated iCEBreaker Xosera (spi_target.sv and xosera_main.sv)",
+                                                 vsim_spi_open,
+                                                 vsim_spi_close,
+                                                 vsim_spi_cs,
+                                                 vsim_spi_xfer_bytes,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr,
+                                                 vsim_spi_delay_ms,
+                                                 vsim_spi_set_speed,
+                                                 vsim_spi_device_id};
@@ -13,9 +13,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-#include "ftdi_spi.h"
+#include <string>
+#include <vector>
+
+#include "spi_transport.h"
+#include "../rtl/sim/frame_writer.h"
+#include "../xosera_emu/scanline_render.h"
 #include "../xosera_m68k_api/xosera_m68k_defs.h"
 
 static void hexdump(size_t num, uint8_t * mem)
@@ -31,9 +37,16 @@ static void hexdump(size_t num, uint8_t * mem)
     printf("\n");
 }
 
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 void delay_ms(int ms)
 {
-    usleep(ms * 1000);
+    host_spi_delay_ms(ms);
 }
 
 // SPI "bus command" message format. Always sends/receives two bytes:
@@ -67,9 +80,9 @@ enum
     SPI_CMD_REGMASK = 0x0F
 };
 
-#define DEBUG_HEXDUMP 1
+#define DEBUG_HEXDUMP 0
 
-#if 0
+#if 1
 #define MAX_SEND    1024
 #define FLUSH_QUEUE 1020
 #else
@@ -81,6 +94,7 @@ static uint8_t   send_buffer[MAX_SEND];
 static uint8_t   xmit_buffer[MAX_SEND];
 static uint8_t * send_ptr = send_buffer;
 static uint8_t   read_value;
+static bool      link_check;        // check command byte replies (after sync)
 
 size_t spi_queue_len()
 {
@@ -88,15 +102,28 @@ size_t spi_queue_len()
     return len;
 }
 
+// send queued commands and read replies into xmit_buffer (waits for any queued writes)
 inline int spi_queue_flush()
 {
     size_t len = spi_queue_len();
     if (len)
     {
-        host_spi_cs(false);        // select
         memcpy(xmit_buffer, send_buffer, len);
-        host_spi_xfer_bytes(len, xmit_buffer);
-        host_spi_cs(true);        // de-select
+        host_spi_xfer_select(len, xmit_buffer);        // select, transfer, de-select
+
+        // every command byte reply should be 0xCB, so these are a check on the SPI link
+        if (link_check)
+        {
+            unsigned int bad = 0;
+            for (size_t i = 0; i < len; i += 2)
+            {
+                bad += (xmit_buffer[i] != 0xcb);
+            }
+            if (bad)
+            {
+                host_spi_link_errors(bad);        // lowers SPI clock after too many errors
+            }
+        }
 
 #if DEBUG_HEXDUMP
         printf("SENT[%02zu]: ", len);
@@ -110,6 +137,24 @@ inline int spi_queue_flush()
     return len;
 }
 
+// send queued commands without waiting for replies (for writes, replies are not needed)
+inline int spi_queue_send()
+{
+    size_t len = spi_queue_len();
+    if (len)
+    {
+        host_spi_write_async(len, send_buffer);        // select, write, de-select (queued)
+
+#if DEBUG_HEXDUMP
+        printf("SENT[%02zu]: ", len);
+        hexdump(len, send_buffer);
+#endif
+        send_ptr = send_buffer;
+    }
+
+    return len;
+}
+
 inline int spi_queue_cmd(uint8_t cmd, uint8_t data)
 {
     int off     = static_cast<int>(send_ptr - send_buffer);
@@ -120,7 +165,8 @@ inline int spi_queue_cmd(uint8_t cmd, uint8_t data)
 
 void delay(int ms)
 {
-    spi_queue_flush();
+    spi_queue_send();
+    host_spi_flush();
     delay_ms(ms);
 }
 
@@ -130,7 +176,7 @@ static inline void xvid_setw(uint8_t r, uint16_t word)
     spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_BYTESEL | (r & SPI_CMD_REGMASK), word & 0xff);
     if (spi_queue_len() > FLUSH_QUEUE)
     {
-        spi_queue_flush();
+        spi_queue_send();
     }
 }
 
@@ -139,7 +185,7 @@ static inline void xvid_setlb(uint8_t r, uint8_t lsb)
     spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_BYTESEL | (r & SPI_CMD_REGMASK), lsb & 0xff);
     if (spi_queue_len() > FLUSH_QUEUE)
     {
-        spi_queue_flush();
+        spi_queue_send();
     }
 }
 
@@ -148,7 +194,7 @@ static inline void xvid_sethb(uint8_t r, uint8_t msb)
     spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | (r & SPI_CMD_REGMASK), msb & 0xff);
     if (spi_queue_len() > FLUSH_QUEUE)
     {
-        spi_queue_flush();
+        spi_queue_send();
     }
 }
 
@@ -157,8 +203,6 @@ static inline uint16_t xvid_getw(uint8_t r)
     int msb = spi_queue_cmd(SPI_CMD_CS | (r & SPI_CMD_REGMASK), 0xff);
     int lsb = spi_queue_cmd(SPI_CMD_CS | SPI_CMD_BYTESEL | (r & SPI_CMD_REGMASK), 0xff);
     spi_queue_flush();
-    assert(xmit_buffer[msb] == 0xcb);
-    assert(xmit_buffer[lsb] == 0xcb);
 
     return (xmit_buffer[msb + 1] << 8) | xmit_buffer[lsb + 1];
 }
@@ -168,7 +212,6 @@ static inline uint8_t xvid_getb(uint8_t r, uint8_t bytesel = 1)
 {
     int off = spi_queue_cmd(SPI_CMD_CS | (bytesel ? SPI_CMD_BYTESEL : 0) | (r & SPI_CMD_REGMASK), 0xff);
     spi_queue_flush();
-    assert(xmit_buffer[off] == 0xcb);
     return xmit_buffer[off + 1];
 }
 
@@ -181,6 +224,90 @@ static inline uint8_t xvid_getbh(uint8_t r)
     return xvid_getb(r, 0);
 }
 
+// VRAM streaming over SPI using the XM_DATA auto-increment registers
+//
+// The even byte written to XM_DATA (or XM_XDATA) is latched until the next even byte write, and the odd byte write
+// commits the word.  So sequential data writes only need the even byte command/data pair when the high byte changes
+// (2 SPI bytes per word instead of 4 for e.g. text with the same color attribute).
+//
+// Reads can't be packed (both bytes are needed and the odd byte read starts the next VRAM pre-read), but since the
+// data byte reply is the register read when its command byte was received, many XM_DATA reads can be queued in one
+// SPI transfer and the words picked out of the replies after (instead of one transfer and round-trip per word).
+
+// write num words to auto-increment data register r (XM_DATA or XM_XDATA), skipping unchanged even bytes
+static void spi_stream_data(uint8_t r, const uint16_t * words, size_t num)
+{
+    int even = -1;        // even byte latched (unknown at start)
+    for (size_t i = 0; i < num; i++)
+    {
+        uint8_t msb = words[i] >> 8;
+        if (msb != even)
+        {
+            spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | (r & SPI_CMD_REGMASK), msb);
+            even = msb;
+        }
+        spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_BYTESEL | (r & SPI_CMD_REGMASK), words[i] & 0xff);
+        if (spi_queue_len() > FLUSH_QUEUE)
+        {
+            spi_queue_send();
+        }
+    }
+}
+
+// write num words to VRAM starting at vaddr (leaves XM_WR_INCR = 1)
+static void spi_vram_write(uint16_t vaddr, const uint16_t * words, size_t num)
+{
+    xvid_setw(XM_WR_INCR, 0x0001);
+    xvid_setw(XM_WR_ADDR, vaddr);
+    spi_stream_data(XM_DATA, words, num);
+}
+
+// read num words from auto-increment data register r (XM_DATA or XM_XDATA), pipelined up to MAX_SEND/4 words per
+// SPI transfer (read address must be set)
+static void spi_read_data(uint8_t r, uint16_t * words, size_t num)
+{
+    while (num)
+    {
+        if (spi_queue_len() + 4 > MAX_SEND)
+        {
+            spi_queue_send();
+        }
+        int    first = static_cast<int>(spi_queue_len());
+        size_t count = (MAX_SEND - first) / 4;
+        if (count > num)
+        {
+            count = num;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            spi_queue_cmd(SPI_CMD_CS | (r & SPI_CMD_REGMASK), 0xff);
+            spi_queue_cmd(SPI_CMD_CS | SPI_CMD_BYTESEL | (r & SPI_CMD_REGMASK), 0xff);        // next pre-read
+        }
+        spi_queue_flush();
+        for (size_t i = 0; i < count; i++)
+        {
+            uint8_t * reply = xmit_buffer + first + (i * 4);
+            *words++        = (reply[1] << 8) | reply[3];
+        }
+        num -= count;
+    }
+}
+
+// read num words from VRAM starting at vaddr (leaves XM_RD_INCR = 1)
+static void spi_vram_read(uint16_t vaddr, uint16_t * words, size_t num)
+{
+    xvid_setw(XM_RD_INCR, 0x0001);
+    xvid_setw(XM_RD_ADDR, vaddr);        // pre-reads VRAM[vaddr]
+    spi_read_data(XM_DATA, words, num);
+}
+
+// read num words from XR registers or memory starting at xaddr (XR reads always increment by 1)
+static void spi_xr_read(uint16_t xaddr, uint16_t * words, size_t num)
+{
+    xvid_setw(XM_RD_XADDR, xaddr);        // pre-reads XR[xaddr]
+    spi_read_data(XM_XDATA, words, num);
+}
+
 static void xcolor(uint8_t color)
 {
     uint16_t wa = xvid_getw(XM_WR_ADDR);
@@ -225,7 +352,7 @@ static bool sync_Xosera(bool reset)
 {
     printf("Waiting for Xosera SPI sync%s...", reset ? " and reset" : "");
     fflush(stdout);
-    xvid_setw(XM_SYS_CTRL, 0x8000);
+    xvid_setw(XM_SYS_CTRL, SYS_CTRL_WR_MASK_F);        // VRAM writes to all nibbles
     host_spi_cs(true);        // de-select
     delay_ms(100);
     bool result = false;
@@ -264,15 +391,14 @@ static void reboot_Xosera(int8_t config)
         spi_queue_flush();
         host_spi_cs(true);        // de-select
         delay_ms(10);
+        xvid_setw(XM_RD_INCR, 0x0000);        // RD_ADDR write pre-reads VRAM and adds RD_INCR
         xvid_setw(XM_RD_ADDR, 0x1234);
-        xvid_setw(XM_RD_INCR, 0xABCD);
         spi_queue_flush();
-    } while (xvid_getw(XM_RD_ADDR) != 0x1234 || xvid_getw(XM_RD_INCR) != 0xABCD);
+    } while (xvid_getw(XM_RD_ADDR) != 0x1234 || xvid_getw(XM_RD_INCR) != 0x0000);
 
-    width  = ((xvid_getbl(XM_FEATURES) & 0xF) == 0) ? 640 : 848;
-    height = 480;
-    xvid_setw(XM_RD_XADDR, XM_FEATURES);        // select features
-    features = xvid_getw(XM_XDATA);
+    features = xvid_getw(XM_FEATURE);
+    width    = ((features & FEATURE_MONRES_F) == 0) ? 640 : 848;
+    height   = 480;
     printf("(%dx%d, features=0x%04x) ready.\n", width, height, features);
     columns = width / 8;
     rows    = height / 16;
@@ -588,18 +714,21 @@ static void test_mono_bitmap(const char * filename)
 
         while ((cnt = fread(mem_buffer, 1, 128 * 1024, file)) > 0)
         {
-            uint8_t * maddr = (uint8_t *)mem_buffer;
-            xvid_setw(XM_WR_ADDR, vaddr);
-            for (int i = 0; i < cnt; i += 2)
+            uint8_t *  maddr = (uint8_t *)mem_buffer;
+            uint16_t * words = (uint16_t *)mem_buffer;        // big-endian bytes to words (in place)
+            for (int i = 0; i < (cnt >> 1); i++)
             {
-                xvid_sethb(XM_DATA, *maddr++);
-                xvid_setlb(XM_DATA, *maddr++);
+                words[i] = (maddr[i * 2] << 8) | maddr[i * 2 + 1];
             }
+            spi_vram_write(vaddr, words, cnt >> 1);
             vaddr += (cnt >> 1);
         }
+        spi_queue_send();
 
+        uint64_t bytes = 0;
+        double   rate  = host_spi_write_rate(&bytes);
         fclose(file);
-        printf(" - done!\n");
+        printf(" - done! (%llu SPI bytes, %.2f MB/s)\n", static_cast<unsigned long long>(bytes), rate);
     }
     else
     {
@@ -610,6 +739,39 @@ static void test_mono_bitmap(const char * filename)
 
 static const uint16_t data_pat[8] = {0xA5A5, 0x5A5A, 0xFFFF, 0x0123, 0x4567, 0x89AB, 0xCDEF, 0x0220};
 
+#define VERIFY_REPEAT 16        // data_pat write/read-back repeats per link check (all in one SPI transfer)
+
+// write and read back data_pat with XM_RD_INCR in one SPI transfer, returns errors (link check for SPI clock
+// calibration, counting bad command byte replies too)
+static int spi_verify_link()
+{
+    spi_queue_send();
+    int off[VERIFY_REPEAT * 8];
+    for (int i = 0; i < VERIFY_REPEAT * 8; i++)
+    {
+        uint16_t v = data_pat[i & 7];
+        spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | (XM_RD_INCR & SPI_CMD_REGMASK), v >> 8);
+        spi_queue_cmd(SPI_CMD_CS | SPI_CMD_WR | SPI_CMD_BYTESEL | (XM_RD_INCR & SPI_CMD_REGMASK), v & 0xff);
+        off[i] = spi_queue_cmd(SPI_CMD_CS | (XM_RD_INCR & SPI_CMD_REGMASK), 0xff);
+        spi_queue_cmd(SPI_CMD_CS | SPI_CMD_BYTESEL | (XM_RD_INCR & SPI_CMD_REGMASK), 0xff);
+    }
+    size_t len = spi_queue_flush();
+
+    int errors = 0;
+    for (size_t i = 0; i < len; i += 2)
+    {
+        errors += (xmit_buffer[i] != 0xcb);
+    }
+    for (int i = 0; i < VERIFY_REPEAT * 8; i++)
+    {
+        uint16_t v = (xmit_buffer[off[i] + 1] << 8) | xmit_buffer[off[i] + 3];
+        errors += (v != data_pat[i & 7]);
+    }
+    xvid_setw(XM_RD_INCR, 0x0000);
+
+    return errors;
+}
+
 void test_reg_access()
 {
     xcls();
@@ -642,6 +804,10 @@ void test_reg_access()
         xprint(" <=> ");
 
         uint16_t cp = xvid_getw(XM_WR_ADDR);
+        if (r == XM_RD_ADDR)
+        {
+            xvid_setw(XM_RD_INCR, 0x0000);        // RD_ADDR write pre-reads VRAM and adds RD_INCR
+        }
         for (int i = 0; i < 8; i++)
         {
             uint16_t v = data_pat[i];
@@ -739,6 +905,228 @@ void test_reg_access()
     delay(2000);
 }
 
+#define STREAM_WORDS 0x4000        // words per stream benchmark pass
+#define STREAM_VADDR 0x8000        // VRAM address for stream benchmark (off screen)
+
+static uint16_t stream_words[STREAM_WORDS];
+static uint16_t stream_check[STREAM_WORDS];
+
+// print SPI bytes per word since start (stats at start) and words/sec the SPI clock allows for those bytes (the link
+// limit, not counting select gaps), with measured host words/sec (emulated transports measure emulator speed)
+static void stream_result(const char * name, double start, const host_spi_stats_t & stats)
+{
+    spi_queue_send();
+    host_spi_flush();
+    double   secs  = now_seconds() - start;
+    uint64_t bytes = (host_spi_stats.xfer_bytes - stats.xfer_bytes) + (host_spi_stats.write_bytes - stats.write_bytes);
+    uint64_t xfers = (host_spi_stats.xfers - stats.xfers) + (host_spi_stats.writes - stats.writes);
+    uint32_t hz    = host_spi_speed();
+    printf("  %-28s %9.0f words/sec at SPI clock, %5.2f SPI bytes/word, %llu transfers (%.0f words/sec measured)\n",
+           name,
+           bytes && hz ? STREAM_WORDS * (hz / 8.0) / static_cast<double>(bytes) : 0.0,
+           static_cast<double>(bytes) / STREAM_WORDS,
+           static_cast<unsigned long long>(xfers),
+           secs > 0.0 ? STREAM_WORDS / secs : 0.0);
+}
+
+static void stream_verify(const char * name)
+{
+    for (int i = 0; i < STREAM_WORDS; i++)
+    {
+        if (stream_check[i] != stream_words[i])
+        {
+            problem(name, STREAM_VADDR + i, stream_check[i], stream_words[i]);
+            break;
+        }
+    }
+}
+
+// compare per-register xvid_setw/xvid_getw VRAM access with spi_vram_write/spi_vram_read streaming
+void test_vram_stream()
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // pass 0 is text-like (same color attribute), pass 1 is pseudo-random (high byte changes)
+        printf("VRAM stream (%s words, %.3f MHz SPI clock):\n", pass ? "random" : "text", host_spi_speed() / 1000000.0);
+        uint32_t r = 0x12345678;
+        for (int i = 0; i < STREAM_WORDS; i++)
+        {
+            r               = r * 1103515245 + 12345;
+            stream_words[i] = pass ? (r >> 16) : (0x0200 | ((r >> 24) & 0x7f));
+        }
+
+        host_spi_stats_t stats = host_spi_stats;
+        double           start = now_seconds();
+        xvid_setw(XM_WR_INCR, 0x0001);
+        xvid_setw(XM_WR_ADDR, STREAM_VADDR);
+        for (int i = 0; i < STREAM_WORDS; i++)
+        {
+            xvid_setw(XM_DATA, stream_words[i]);
+        }
+        stream_result("xvid_setw write", start, stats);
+
+        stats = host_spi_stats;
+        start = now_seconds();
+        xvid_setw(XM_RD_INCR, 0x0001);
+        xvid_setw(XM_RD_ADDR, STREAM_VADDR);
+        for (int i = 0; i < STREAM_WORDS; i++)
+        {
+            stream_check[i] = xvid_getw(XM_DATA);
+        }
+        stream_result("xvid_getw read", start, stats);
+        stream_verify("xvid_getw read verify");
+
+        memset(stream_check, 0, sizeof(stream_check));
+        spi_vram_write(STREAM_VADDR, stream_check, STREAM_WORDS);        // clear
+
+        stats = host_spi_stats;
+        start = now_seconds();
+        spi_vram_write(STREAM_VADDR, stream_words, STREAM_WORDS);
+        stream_result("spi_vram_write", start, stats);
+
+        stats = host_spi_stats;
+        start = now_seconds();
+        spi_vram_read(STREAM_VADDR, stream_check, STREAM_WORDS);
+        stream_result("spi_vram_read", start, stats);
+        stream_verify("spi_vram_read verify");
+    }
+}
+
+// capture VRAM, XR registers and readable XR memory into dump with pipelined SPI reads (only the read address and
+// increment registers are changed, and they are put back), returns words read
+static size_t spi_capture(XoseraDump & dump)
+{
+    uint16_t rd_incr  = xvid_getw(XM_RD_INCR);
+    uint16_t rd_addr  = xvid_getw(XM_RD_ADDR);
+    uint16_t rd_xaddr = xvid_getw(XM_RD_XADDR);
+
+    dump.width  = width;
+    dump.height = height;
+    spi_xr_read(0x0000, dump.xr_regs.data(), XoseraDump::XR_REGS);
+    spi_vram_read(0x0000, dump.vram.data(), XoseraDump::VRAM_WORDS);
+    spi_xr_read(XR_TILE_ADDR, dump.tile.data(), XR_TILE_SIZE);
+    spi_xr_read(XR_COLOR_A_ADDR, dump.colorA.data(), XR_COLOR_A_SIZE);
+    spi_xr_read(XR_COLOR_B_ADDR, dump.colorB.data(), XR_COLOR_B_SIZE);
+    spi_xr_read(XR_COPPER_ADDR, dump.copper.data(), XR_COPPER_SIZE);
+    // POINTER memory is write-only (left zero, pointer is not rendered)
+
+    // read addresses were incremented after pre-read, so write the address before to pre-read the same word again
+    xvid_setw(XM_RD_INCR, rd_incr);
+    xvid_setw(XM_RD_ADDR, rd_addr - rd_incr);
+    xvid_setw(XM_RD_XADDR, rd_xaddr - 1);
+    spi_queue_send();
+    host_spi_flush();
+
+    return XoseraDump::XR_REGS + XoseraDump::VRAM_WORDS + XR_TILE_SIZE + XR_COLOR_A_SIZE + XR_COLOR_B_SIZE +
+           XR_COPPER_SIZE;
+}
+
+#if defined(HOST_SPI_EMU)
+// compare capture rendered with frame rendered from "emu" transport emulator memory, returns true if every pixel
+// matches
+static bool capture_check_emu(const XoseraDump & dump, const std::vector<uint32_t> & pixels)
+{
+    XoseraDump ref;
+    if (!emu_spi_save_dump(ref) || ref.width != dump.width || ref.height != dump.height)
+    {
+        printf("Capture check FAILED: no %dx%d emulator frame\n", dump.width, dump.height);
+        return false;
+    }
+    ScanlineRender        render(ref, ref.width, ref.height);
+    std::vector<uint32_t> ref_pixels(ref.width * ref.height);
+    render.render_frame(ref_pixels.data());
+
+    size_t diffs = 0;
+    size_t first = 0;
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        if (pixels[i] != ref_pixels[i] && diffs++ == 0)
+        {
+            first = i;
+        }
+    }
+    if (diffs)
+    {
+        printf("Capture check FAILED: %zu pixels differ from emulator frame (first at %zu,%zu: 0x%08x not 0x%08x)\n",
+               diffs,
+               first % dump.width,
+               first / dump.width,
+               pixels[first],
+               ref_pixels[first]);
+        return false;
+    }
+    printf("Capture matches emulator frame (%dx%d pixels).\n", dump.width, dump.height);
+
+    return true;
+}
+#endif
+
+// capture Xosera memory over SPI and render the frame it displays (for the current GFX_CTRL modes, without copper
+// changes during the frame) to png_name, and optionally save the memory dump (for xosera_render), returns true if
+// no SPI link errors during capture (and, with "emu" transport, capture matches the emulator frame)
+static bool capture_screen(const char * png_name, const char * dump_name)
+{
+    printf("Capturing Xosera VRAM and XR memory (%.3f MHz SPI clock)...\n", host_spi_speed() / 1000000.0);
+
+    XoseraDump       dump;
+    host_spi_stats_t stats = host_spi_stats;
+    double           start = now_seconds();
+    size_t           words = spi_capture(dump);
+    double           secs  = now_seconds() - start;
+
+    uint64_t bytes       = (host_spi_stats.xfer_bytes - stats.xfer_bytes) +
+                     (host_spi_stats.write_bytes - stats.write_bytes);
+    uint64_t link_errors = host_spi_stats.link_errors - stats.link_errors;
+
+    printf("Captured %zu words in %.3f sec (%.0f words/sec, %llu SPI bytes, %llu SPI link errors)\n",
+           words,
+           secs,
+           secs > 0.0 ? words / secs : 0.0,
+           static_cast<unsigned long long>(bytes),
+           static_cast<unsigned long long>(link_errors));
+    printf("  PA_GFX_CTRL=0x%04x PA_TILE_CTRL=0x%04x PB_GFX_CTRL=0x%04x PB_TILE_CTRL=0x%04x VID_CTRL=0x%04x\n",
+           dump.xr_regs[XR_PA_GFX_CTRL],
+           dump.xr_regs[XR_PA_TILE_CTRL],
+           dump.xr_regs[XR_PB_GFX_CTRL],
+           dump.xr_regs[XR_PB_TILE_CTRL],
+           dump.xr_regs[XR_VID_CTRL]);
+
+    std::string err;
+    if (dump_name && !dump.save(dump_name, err))
+    {
+        printf("Capture dump FAILED: %s\n", err.c_str());
+        return false;
+    }
+
+    ScanlineRender        render(dump, dump.width, dump.height);
+    std::vector<uint32_t> pixels(dump.width * dump.height);
+    render.render_frame(pixels.data());
+    if (!save_png_argb(png_name, pixels.data(), dump.width, dump.height))
+    {
+        printf("Capture FAILED: error writing \"%s\"\n", png_name);
+        return false;
+    }
+    printf("Rendered capture (%dx%d) to \"%s\"%s%s%s\n",
+           dump.width,
+           dump.height,
+           png_name,
+           dump_name ? " and dump to \"" : "",
+           dump_name ? dump_name : "",
+           dump_name ? "\"" : "");
+    if (link_errors)
+    {
+        printf("Capture had SPI link errors, it may not match display!\n");
+    }
+#if defined(HOST_SPI_EMU)
+    if (host_spi_transport() == &emu_spi_transport && !capture_check_emu(dump, pixels))
+    {
+        return false;
+    }
+#endif
+
+    return link_errors == 0;
+}
+
 void draw_buddy()
 {
     xvid_setw(XM_WR_XADDR, XR_PA_TILE_CTRL);        // A_font_ctrl
@@ -949,14 +1337,78 @@ void test_smoothscroll()
 }
 
 
-bool reset_only    = false;
-bool no_reset      = false;
-int  xosera_config = -1;
+bool         reset_only    = false;
+bool         no_reset      = false;
+int          xosera_config = -1;
+const char * transport     = nullptr;        // SPI transport name (nullptr for default, see spi_transport.h)
+bool         calibrate     = false;          // sweep SPI clocks for fastest reliable ("-C" option)
+uint32_t     spi_clock_hz  = 0;              // fixed SPI clock ("-s" option, 0 for cached or default)
+const char * capture_png   = nullptr;        // capture screen to PNG ("-P" option)
+const char * capture_dump  = nullptr;        // also save capture memory dump ("-M" option)
 
 #define MAX_CMDS 256
 int    num_cmds = 0;
 char * cmd_list[MAX_CMDS];
 
+#define MAX_TESTS 16
+int          num_tests = 0;
+const char * test_list[MAX_TESTS];        // tests to run instead of demo ("-T" option)
+
+// print SPI transfer counts (to see protocol overhead of a test)
+static void print_spi_stats(const char * name, double seconds)
+{
+    printf("%s: %llu transfers with reply (%llu bytes), %llu queued writes (%llu bytes), %llu selects, %.3f sec\n",
+           name,
+           static_cast<unsigned long long>(host_spi_stats.xfers),
+           static_cast<unsigned long long>(host_spi_stats.xfer_bytes),
+           static_cast<unsigned long long>(host_spi_stats.writes),
+           static_cast<unsigned long long>(host_spi_stats.write_bytes),
+           static_cast<unsigned long long>(host_spi_stats.selects),
+           seconds);
+    if (host_spi_stats.link_errors || host_spi_stats.speed_drops)
+    {
+        printf("%s: %llu SPI link errors, SPI clock lowered %llu times (now %.3f MHz)\n",
+               name,
+               static_cast<unsigned long long>(host_spi_stats.link_errors),
+               static_cast<unsigned long long>(host_spi_stats.speed_drops),
+               host_spi_speed() / 1000000.0);
+    }
+}
+
+// run tests named with "-T" (e.g., with "emu" transport for CI), returns true if no errors
+static bool run_tests()
+{
+    for (int i = 0; i < num_tests; i++)
+    {
+        memset(&host_spi_stats, 0, sizeof(host_spi_stats));
+        double start = now_seconds();
+        if (strcmp(test_list[i], "regs") == 0)
+        {
+            test_reg_access();
+        }
+        else if (strcmp(test_list[i], "scroll") == 0)
+        {
+            test_smoothscroll();
+        }
+        else if (strcmp(test_list[i], "stream") == 0)
+        {
+            test_vram_stream();
+        }
+        else
+        {
+            printf("Unknown test \"%s\" (tests are: regs scroll stream)\n", test_list[i]);
+            return false;
+        }
+        spi_queue_send();
+        host_spi_flush();
+        print_spi_stats(test_list[i], now_seconds() - start);
+    }
+
+    printf("%s (%u errors)\n", errors ? "Tests FAILED!" : "Tests passed.", errors);
+
+    return errors == 0;
+}
+
 int main(int argc, char ** argv)
 {
     for (int i = 1; i < argc; i++)
@@ -981,6 +1433,45 @@ int main(int argc, char ** argv)
             xosera_config = argv[i][2] & 0x3;
             continue;
         }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            transport = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "-C") == 0)
+        {
+            calibrate = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            spi_clock_hz = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+            continue;
+        }
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+        {
+            capture_png = argv[++i];
+            no_reset    = true;        // capture what is displayed
+            continue;
+        }
+        else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc)
+        {
+            capture_dump = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+        {
+            if (num_tests < MAX_TESTS)
+            {
+                test_list[num_tests++] = argv[++i];
+            }
+            else
+            {
+                printf("Too many tests (> %d)\n", MAX_TESTS);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
         else if (argv[i][0] == 'R' || argv[i][0] == 'r')
         {
             char * rn = strdup(argv[i]);
@@ -999,17 +1490,33 @@ int main(int argc, char ** argv)
         exit(EXIT_FAILURE);
     }
 
+    if (capture_dump && !capture_png)
+    {
+        printf("Option \"-M\" needs \"-P\" (dump is saved with screen capture)\n");
+        exit(EXIT_FAILURE);
+    }
+
     for (int i = 0; i < num_cmds; i++)
     {
         printf("CMD %d: %s\n", i, cmd_list[i]);
     }
 
-    if (host_spi_open() < 0)
+    if (host_spi_open(transport) < 0)
     {
         exit(EXIT_FAILURE);
     }
 
-    bool res = sync_Xosera(no_reset ? 0 : 1);
+    bool res   = sync_Xosera(no_reset ? 0 : 1);
+    link_check = res;
+
+    if (res && spi_clock_hz)
+    {
+        printf("SPI clock set to %.3f MHz.\n", host_spi_set_speed(spi_clock_hz) / 1000000.0);
+    }
+    else if (res)
+    {
+        host_spi_calibrate(spi_verify_link, calibrate);        // cached clock for device, or sweep with "-C"
+    }
 
     if (reset_only)
     {
@@ -1019,7 +1526,19 @@ int main(int argc, char ** argv)
         exit(res ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 
-    //    reboot_Xosera(xosera_config);
+    reboot_Xosera(xosera_config);
+
+    if (num_tests || capture_png)
+    {
+        bool passed = res && (num_tests == 0 || run_tests());
+        if (capture_png)
+        {
+            passed = capture_screen(capture_png, capture_dump) && passed;
+        }
+        host_spi_close();
+
+        exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
 
     // mono bitmap mode
     xvid_setw(XM_WR_XADDR, XR_PA_GFX_CTRL);